@@ -90,6 +90,7 @@ COMMON_SRC_FILES += \
 	Renderer/Point.cpp \
 	Renderer/QuadRasterizer.cpp \
 	Renderer/Renderer.cpp \
+	Renderer/RoutineCache.cpp \
 	Renderer/Sampler.cpp \
 	Renderer/SetupProcessor.cpp \
 	Renderer/Surface.cpp \
@@ -36,6 +36,7 @@ namespace sw
 	bool CPUID::SSE3 = detectSSE3();
 	bool CPUID::SSSE3 = detectSSSE3();
 	bool CPUID::SSE4_1 = detectSSE4_1();
+	bool CPUID::AVX2 = detectAVX2();
 	int CPUID::cores = detectCoreCount();
 	int CPUID::affinity = detectAffinity();
 
@@ -46,6 +47,7 @@ namespace sw
 	bool CPUID::enableSSE3 = true;
 	bool CPUID::enableSSSE3 = true;
 	bool CPUID::enableSSE4_1 = true;
+	bool CPUID::enableAVX2 = true;
 
 	void CPUID::setEnableMMX(bool enable)
 	{
@@ -58,6 +60,7 @@ namespace sw
 			enableSSE3 = false;
 			enableSSSE3 = false;
 			enableSSE4_1 = false;
+			enableAVX2 = false;
 		}
 	}
 
@@ -72,6 +75,7 @@ namespace sw
 			enableSSE3 = false;
 			enableSSSE3 = false;
 			enableSSE4_1 = false;
+			enableAVX2 = false;
 		}
 	}
 
@@ -90,6 +94,7 @@ namespace sw
 			enableSSE3 = false;
 			enableSSSE3 = false;
 			enableSSE4_1 = false;
+			enableAVX2 = false;
 		}
 	}
 
@@ -108,6 +113,7 @@ namespace sw
 			enableSSE3 = false;
 			enableSSSE3 = false;
 			enableSSE4_1 = false;
+			enableAVX2 = false;
 		}
 	}
 
@@ -126,6 +132,7 @@ namespace sw
 		{
 			enableSSSE3 = false;
 			enableSSE4_1 = false;
+			enableAVX2 = false;
 		}
 	}
 
@@ -144,6 +151,7 @@ namespace sw
 		else
 		{
 			enableSSE4_1 = false;
+			enableAVX2 = false;
 		}
 	}
 
@@ -160,15 +168,35 @@ namespace sw
 			enableSSE3 = true;
 			enableSSSE3 = true;
 		}
+		else
+		{
+			enableAVX2 = false;
+		}
 	}
 
-	static void cpuid(int registers[4], int info)
+	void CPUID::setEnableAVX2(bool enable)
+	{
+		enableAVX2 = enable;
+
+		if(enableAVX2)
+		{
+			enableMMX = true;
+			enableCMOV = true;
+			enableSSE = true;
+			enableSSE2 = true;
+			enableSSE3 = true;
+			enableSSSE3 = true;
+			enableSSE4_1 = true;
+		}
+	}
+
+	static void cpuid(int registers[4], int info, int subinfo = 0)
 	{
 		#if defined(__i386__) || defined(__x86_64__)
 			#if defined(_WIN32)
-				__cpuid(registers, info);
+				__cpuidex(registers, info, subinfo);
 			#else
-				__asm volatile("cpuid": "=a" (registers[0]), "=b" (registers[1]), "=c" (registers[2]), "=d" (registers[3]): "a" (info));
+				__asm volatile("cpuid": "=a" (registers[0]), "=b" (registers[1]), "=c" (registers[2]), "=d" (registers[3]): "a" (info), "c" (subinfo));
 			#endif
 		#else
 			registers[0] = 0;
@@ -178,6 +206,22 @@ namespace sw
 		#endif
 	}
 
+	// Returns the state components the OS saves on context switches
+	static unsigned long long xgetbv()
+	{
+		#if defined(__i386__) || defined(__x86_64__)
+			#if defined(_WIN32)
+				return _xgetbv(0);
+			#else
+				unsigned int eax, edx;
+				__asm volatile("xgetbv": "=a" (eax), "=d" (edx): "c" (0));
+				return ((unsigned long long)edx << 32) | eax;
+			#endif
+		#else
+			return 0;
+		#endif
+	}
+
 	bool CPUID::detectMMX()
 	{
 		int registers[4];
@@ -227,6 +271,30 @@ namespace sw
 		return SSE4_1 = (registers[2] & 0x00080000) != 0;
 	}
 
+	bool CPUID::detectAVX2()
+	{
+		int registers[4];
+		cpuid(registers, 0);
+
+		if(registers[0] < 7)
+		{
+			return AVX2 = false;
+		}
+
+		cpuid(registers, 1);
+		bool OSXSAVE = (registers[2] & 0x08000000) != 0;
+		bool AVX = (registers[2] & 0x10000000) != 0;
+
+		// The OS must preserve both the XMM and YMM register state
+		if(!OSXSAVE || !AVX || (xgetbv() & 0x6) != 0x6)
+		{
+			return AVX2 = false;
+		}
+
+		cpuid(registers, 7, 0);
+		return AVX2 = (registers[1] & 0x00000020) != 0;
+	}
+
 	int CPUID::detectCoreCount()
 	{
 		int cores = 0;
@@ -251,7 +319,6 @@ namespace sw
 		#endif
 
 		if(cores < 1)  cores = 1;
-		if(cores > 16) cores = 16;
 
 		return cores;   // FIXME: Number of physical cores
 	}
@@ -275,12 +342,23 @@ namespace sw
 
 				processAffinityMask >>= 1;
 			}
+		#elif defined(__linux__) && defined(CPU_COUNT)
+			cpu_set_t cpuSet;
+			CPU_ZERO(&cpuSet);
+
+			if(sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet) == 0)
+			{
+				cores = CPU_COUNT(&cpuSet);
+			}
+			else
+			{
+				return detectCoreCount();
+			}
 		#else
 			return detectCoreCount();   // FIXME: Assumes no affinity limitation
 		#endif
 
 		if(cores < 1)  cores = 1;
-		if(cores > 16) cores = 16;
 
 		return cores;
 	}
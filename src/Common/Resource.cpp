@@ -21,11 +21,7 @@ namespace sw
 {
 	Resource::Resource(size_t bytes) : size(bytes)
 	{
-		blocked = 0;
-
-		accessor = PUBLIC;
-		count = 0;
-		orphaned = false;
+		state = PUBLIC;
 
 		buffer = allocate(bytes);
 	}
@@ -37,21 +33,26 @@ namespace sw
 
 	void *Resource::lock(Accessor claimer)
 	{
+		if(acquire(claimer))
+		{
+			return buffer;
+		}
+
 		criticalSection.lock();
 
-		while(count > 0 && accessor != claimer)
+		// Announced before retrying, so the release of the last lock signals the event
+		state += BLOCKED_ONE;
+
+		while(!acquire(claimer))
 		{
-			blocked++;
 			criticalSection.unlock();
 
 			unblock.wait();
 
 			criticalSection.lock();
-			blocked--;
 		}
 
-		accessor = claimer;
-		count++;
+		state -= BLOCKED_ONE;
 
 		criticalSection.unlock();
 
@@ -60,121 +61,134 @@ namespace sw
 
 	void *Resource::lock(Accessor relinquisher, Accessor claimer)
 	{
-		criticalSection.lock();
+		if(!release(relinquisher))
+		{
+			return 0;
+		}
+
+		return lock(claimer);
+	}
 
-		// Release
-		while(count > 0 && accessor == relinquisher)
+	void Resource::unlock()
+	{
+		uint64_t current = state;
+
+		do
 		{
-			count--;
+			ASSERT((current & COUNT_MASK) != 0);
 
-			if(count == 0)
+			// Waiting threads and orphaned resources are handled while holding the mutex
+			if((current & COUNT_MASK) == COUNT_ONE && (current & (BLOCKED_MASK | ORPHANED)) != 0)
 			{
-				if(blocked)
-				{
-					unblock.signal();
-				}
-				else if(orphaned)
+				criticalSection.lock();
+
+				if(!released(state.fetch_sub(COUNT_ONE) - COUNT_ONE))
 				{
 					criticalSection.unlock();
-
-					delete this;
-
-					return 0;
 				}
+
+				return;
 			}
 		}
+		while(!state.compare_exchange_weak(current, current - COUNT_ONE));
+	}
+
+	void Resource::unlock(Accessor relinquisher)
+	{
+		ASSERT((state & COUNT_MASK) != 0);
 
-		// Acquire
-		while(count > 0 && accessor != claimer)
+		release(relinquisher);
+	}
+
+	void Resource::destruct()
+	{
+		criticalSection.lock();
+
+		uint64_t previous = state.fetch_or(ORPHANED);
+
+		if((previous & (COUNT_MASK | BLOCKED_MASK)) == 0)
 		{
-			blocked++;
 			criticalSection.unlock();
 
-			unblock.wait();
+			delete this;
 
-			criticalSection.lock();
-			blocked--;
+			return;
 		}
 
-		accessor = claimer;
-		count++;
-
 		criticalSection.unlock();
-
-		return buffer;
 	}
 
-	void Resource::unlock()
+	bool Resource::acquire(Accessor claimer)
 	{
-		criticalSection.lock();
-		ASSERT(count > 0);
-
-		count--;
+		uint64_t current = state;
 
-		if(count == 0)
+		do
 		{
-			if(blocked)
+			if((current & COUNT_MASK) != 0 && (current & ACCESSOR_MASK) != (uint64_t)claimer)
 			{
-				unblock.signal();
+				return false;
 			}
-			else if(orphaned)
-			{
-				criticalSection.unlock();
-
-				delete this;
 
-				return;
-			}
+			ASSERT((current & COUNT_MASK) != COUNT_MASK);
 		}
+		while(!state.compare_exchange_weak(current, ((current & ~ACCESSOR_MASK) + COUNT_ONE) | claimer));
 
-		criticalSection.unlock();
+		return true;
 	}
 
-	void Resource::unlock(Accessor relinquisher)
+	// Releases all locks held by the relinquisher. Returns false if the resource got deleted.
+	bool Resource::release(Accessor relinquisher)
 	{
-		criticalSection.lock();
-		ASSERT(count > 0);
+		uint64_t current = state;
 
-		while(count > 0 && accessor == relinquisher)
+		if((current & COUNT_MASK) == 0 || (current & ACCESSOR_MASK) != (uint64_t)relinquisher)
 		{
-			count--;
+			return true;
+		}
 
-			if(count == 0)
+		criticalSection.lock();
+
+		current = state;
+
+		while((current & COUNT_MASK) != 0 && (current & ACCESSOR_MASK) == (uint64_t)relinquisher)
+		{
+			if(state.compare_exchange_weak(current, current & ~COUNT_MASK))
 			{
-				if(blocked)
+				if(released(current & ~COUNT_MASK))
 				{
-					unblock.signal();
+					return false;
 				}
-				else if(orphaned)
-				{
-					criticalSection.unlock();
-
-					delete this;
 
-					return;
-				}
+				break;
 			}
 		}
 
 		criticalSection.unlock();
+
+		return true;
 	}
 
-	void Resource::destruct()
+	// Called with the mutex held, with the state after releasing locks. Returns true if the
+	// resource got deleted, in which case the mutex is no longer held.
+	bool Resource::released(uint64_t remaining)
 	{
-		criticalSection.lock();
-
-		if(count == 0 && !blocked)
+		if((remaining & COUNT_MASK) == 0)
 		{
-			criticalSection.unlock();
+			if(remaining & BLOCKED_MASK)
+			{
+				unblock.signal();
+			}
+			else if(remaining & ORPHANED)
+			{
+				criticalSection.unlock();
 
-			delete this;
+				delete this;
 
-			return;
+				return true;
+			}
 		}
 
-		orphaned = true;
-
-		criticalSection.unlock();
+		return false;
 	}
 
 	const void *Resource::data() const
@@ -17,6 +17,9 @@
 
 #include "MutexLock.hpp"
 
+#include <atomic>
+#include <cstdint>
+
 namespace sw
 {
 	enum Accessor
@@ -43,15 +46,30 @@ namespace sw
 		const size_t size;
 
 	private:
+		friend struct ResourceTestAccess;   // Lets unit tests observe the lock state
+
 		~Resource();   // Always call destruct() instead
 
+		bool acquire(Accessor claimer);
+		bool release(Accessor relinquisher);
+		bool released(uint64_t remaining);
+
+		// The lock state is packed in one word, so locks by the current accessor, or of
+		// an unlocked resource, only take an atomic operation. Waiting threads block on the event.
+		// The count is 64-bit since draw calls queued up ahead of the renderer each hold locks.
+		enum : uint64_t
+		{
+			ACCESSOR_MASK = 0x0000000000000003,
+			ORPHANED      = 0x0000000000000004,
+			BLOCKED_ONE   = 0x0000000000000008,   // Number of waiting threads
+			BLOCKED_MASK  = 0x0000000000007FF8,
+			COUNT_ONE     = 0x0000000000008000,   // Number of locks held by the accessor
+			COUNT_MASK    = 0xFFFFFFFFFFFF8000
+		};
+
 		MutexLock criticalSection;
 		Event unblock;
-		volatile int blocked;
-
-		volatile Accessor accessor;
-		volatile int count;
-		bool orphaned;
+		std::atomic<uint64_t> state;
 
 		void *buffer;
 	};
@@ -14,8 +14,162 @@
 
 #include "Thread.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct ParallelJob
+	{
+		const std::function<void(int)> *task;
+		int count;
+		std::atomic<int> next;
+		int finished;        // Guarded by jobMutex
+		int activeThreads;   // Helper threads working on the job, guarded by jobMutex
+	};
+
+	// Jobs split by parallelFor(), shared by their calling threads and a pool of helper
+	// threads. The helpers live while any renderer holds them, see acquireParallelFor().
+	std::mutex jobMutex;
+	std::condition_variable jobCondition;
+	std::condition_variable finishedCondition;
+	std::deque<ParallelJob*> jobQueue;
+	std::vector<sw::Thread*> helperThreads;
+	int helperUsers = 0;
+	int helperGeneration = 0;   // Helpers started before the last release exit
+
+	int runTasks(ParallelJob *job)
+	{
+		int completed = 0;
+
+		for(int i = job->next++; i < job->count; i = job->next++)
+		{
+			(*job->task)(i);
+			completed++;
+		}
+
+		return completed;
+	}
+
+	void helperThread(void *parameters)
+	{
+		int generation = static_cast<int>(reinterpret_cast<intptr_t>(parameters));
+
+		std::unique_lock<std::mutex> lock(jobMutex);
+
+		while(true)
+		{
+			jobCondition.wait(lock, [generation]() { return !jobQueue.empty() || generation != helperGeneration; });
+
+			if(generation != helperGeneration)
+			{
+				return;   // Queued jobs get completed by their calling threads
+			}
+
+			ParallelJob *job = jobQueue.front();
+			job->activeThreads++;
+
+			lock.unlock();
+			int completed = runTasks(job);
+			lock.lock();
+
+			// All tasks have been claimed
+			if(!jobQueue.empty() && jobQueue.front() == job)
+			{
+				jobQueue.pop_front();
+			}
+
+			job->finished += completed;
+			job->activeThreads--;
+			finishedCondition.notify_all();
+		}
+	}
+}
+
 namespace sw
 {
+	void parallelFor(int count, const std::function<void(int)> &task)
+	{
+		if(count <= 1)
+		{
+			if(count == 1)
+			{
+				task(0);
+			}
+
+			return;
+		}
+
+		ParallelJob job;
+		job.task = &task;
+		job.count = count;
+		job.next = 0;
+		job.finished = 0;
+		job.activeThreads = 0;
+
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobQueue.push_back(&job);
+			jobCondition.notify_all();
+		}
+
+		int completed = runTasks(&job);
+
+		std::unique_lock<std::mutex> lock(jobMutex);
+		job.finished += completed;
+
+		// Don't let helper threads pick up the job once it goes out of scope
+		auto queued = std::find(jobQueue.begin(), jobQueue.end(), &job);
+
+		if(queued != jobQueue.end())
+		{
+			jobQueue.erase(queued);
+		}
+
+		finishedCondition.wait(lock, [&job]() { return job.finished == job.count && job.activeThreads == 0; });
+	}
+
+	void acquireParallelFor(int threadCount)
+	{
+		std::unique_lock<std::mutex> lock(jobMutex);
+		helperUsers++;
+
+		// The calling thread of each job works on it too
+		void *generation = reinterpret_cast<void*>(static_cast<intptr_t>(helperGeneration));
+
+		while((int)helperThreads.size() < threadCount - 1)
+		{
+			helperThreads.push_back(new Thread(helperThread, generation));
+		}
+	}
+
+	void releaseParallelFor()
+	{
+		std::vector<Thread*> threads;
+
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+
+			if(--helperUsers > 0)
+			{
+				return;
+			}
+
+			helperGeneration++;
+			jobCondition.notify_all();
+			threads.swap(helperThreads);
+		}
+
+		for(Thread *thread : threads)
+		{
+			thread->join();
+			delete thread;
+		}
+	}
+
 	Thread::Thread(void (*threadFunction)(void *parameters), void *parameters)
 	{
 		Event init;
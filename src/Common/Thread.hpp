@@ -29,6 +29,7 @@
 #endif
 
 #include <stdlib.h>
+#include <functional>
 
 #if defined(__clang__)
 #if __has_include(<atomic>) // clang has an explicit check for the availability of atomic
@@ -294,6 +295,16 @@ namespace sw
 		#endif
 	}
 
+	// Calls task(i) for each i in [0, count) on the calling thread and a pool of
+	// helper threads, and returns once all of them have completed. Without helper
+	// threads, all tasks run on the calling thread.
+	void parallelFor(int count, const std::function<void(int)> &task);
+
+	// Reference counts the helper threads of parallelFor(). The pool grows to the
+	// largest thread count requested, and is joined once the last user releases it.
+	void acquireParallelFor(int threadCount);
+	void releaseParallelFor();
+
 	#if USE_STD_ATOMIC
 		class AtomicInt
 		{
@@ -1323,6 +1323,7 @@ namespace sw
 		state.sourceFormat = isStencil ? source->getStencilFormat() : source->getFormat(useSourceInternal);
 		state.destFormat = isStencil ? dest->getStencilFormat() : dest->getFormat(useDestInternal);
 		state.destSamples = dest->getSamples();
+		state.hash = state.computeHash();
 
 		criticalSection.lock();
 		Routine *blitRoutine = blitCache->query(state);
@@ -60,12 +60,29 @@ namespace sw
 
 			bool operator==(const State &state) const
 			{
+				if(hash != state.hash)
+				{
+					return false;
+				}
+
 				return memcmp(this, &state, sizeof(State)) == 0;
 			}
 
+			unsigned int computeHash() const
+			{
+				unsigned int hash = sourceFormat;
+				hash = hash * 31 + destFormat;
+				hash = hash * 31 + destSamples;
+				hash = hash * 31 + writeMask;
+				hash = hash * 31 + (clearOperation | filter << 1 | useStencil << 2 | convertSRGB << 3 | clampToEdge << 4);
+
+				return hash;
+			}
+
 			VkFormat sourceFormat;
 			VkFormat destFormat;
 			int destSamples;
+			unsigned int hash;
 		};
 
 		struct BlitData
@@ -225,6 +225,8 @@ namespace sw
 
 		pixelShader = nullptr;
 		vertexShader = nullptr;
+		routineCache = nullptr;
+		shaderHash = 0;
 
 		instanceID = 0;
 
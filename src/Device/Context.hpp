@@ -31,6 +31,7 @@ namespace sw
 	struct Primitive;
 	struct Vertex;
 	class Resource;
+	class SharedRoutineCache;
 
 	enum In   // Default input stream semantic
 	{
@@ -210,6 +211,8 @@ namespace sw
 		// Shaders
 		const PixelShader *pixelShader;
 		const VertexShader *vertexShader;
+		SharedRoutineCache *routineCache;   // Optional
+		uint64_t shaderHash;                // Of the shader code, keys the shared routines
 
 		// Instancing
 		int instanceID;
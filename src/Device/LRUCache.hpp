@@ -19,6 +19,9 @@
 
 namespace sw
 {
+	// Least recently used cache, indexed by a hash table on Key::hash.
+	// Entries are kept on a doubly linked list in order of use, so both
+	// lookup and eviction are O(1). Adding an existing key replaces its data.
 	template<class Key, class Data>
 	class LRUCache
 	{
@@ -27,21 +30,29 @@ namespace sw
 
 		~LRUCache();
 
-		Data *query(const Key &key) const;
+		Data *query(const Key &key);
 		Data *add(const Key &key, Data *data);
 	
 		int getSize() {return size;}
 		Key &getKey(int i) {return key[i];}
 
 	private:
+		int bucketIndex(unsigned int hash) const;
+		void link(int i);     // Make entry i the most recently used
+		void unlink(int i);   // Remove entry i from the usage list
+
 		int size;
-		int mask;
-		int top;
 		int fill;
+		int shift;   // 32 - log2(number of buckets)
+		int first;   // Most recently used entry
+		int last;    // Least recently used entry
 
 		Key *key;
-		Key **ref;
 		Data **data;
+		int *prev;     // Usage list
+		int *next;
+		int *bucket;   // First entry of each hash chain
+		int *chain;    // Next entry in the same hash chain
 	};
 }
 
@@ -51,19 +62,31 @@ namespace sw
 	LRUCache<Key, Data>::LRUCache(int n)
 	{
 		size = ceilPow2(n);
-		mask = size - 1;
-		top = 0;
 		fill = 0;
+		first = -1;
+		last = -1;
+
+		int buckets = 2 * size;   // Keep the chains short
+		shift = 32 - (int)log2(buckets);
 
 		key = new Key[size];
-		ref = new Key*[size];
 		data = new Data*[size];
+		prev = new int[size];
+		next = new int[size];
+		bucket = new int[buckets];
+		chain = new int[size];
 
 		for(int i = 0; i < size; i++)
 		{
 			data[i] = nullptr;
+			prev[i] = -1;
+			next[i] = -1;
+			chain[i] = -1;
+		}
 
-			ref[i] = &key[i];
+		for(int i = 0; i < buckets; i++)
+		{
+			bucket[i] = -1;
 		}
 	}
 
@@ -73,9 +96,6 @@ namespace sw
 		delete[] key;
 		key = nullptr;
 
-		delete[] ref;
-		ref = nullptr;
-
 		for(int i = 0; i < size; i++)
 		{
 			if(data[i])
@@ -87,34 +107,31 @@ namespace sw
 
 		delete[] data;
 		data = nullptr;
+
+		delete[] prev;
+		prev = nullptr;
+		delete[] next;
+		next = nullptr;
+		delete[] bucket;
+		bucket = nullptr;
+		delete[] chain;
+		chain = nullptr;
 	}
 
 	template<class Key, class Data>
-	Data *LRUCache<Key, Data>::query(const Key &key) const
+	Data *LRUCache<Key, Data>::query(const Key &key)
 	{
-		for(int i = top; i > top - fill; i--)
+		for(int i = bucket[bucketIndex(key.hash)]; i != -1; i = chain[i])
 		{
-			int j = i & mask;
-
-			if(key == *ref[j])
+			if(key == this->key[i])
 			{
-				Data *hit = data[j];
-
-				if(i != top)
+				if(i != first)
 				{
-					// Move one up
-					int k = (j + 1) & mask;
-
-					Data *swapD = data[k];
-					data[k] = data[j];
-					data[j] = swapD;
-
-					Key *swapK = ref[k];
-					ref[k] = ref[j];
-					ref[j] = swapK;
+					unlink(i);
+					link(i);
 				}
 
-				return hit;
+				return data[i];
 			}
 		}
 
@@ -124,22 +141,113 @@ namespace sw
 	template<class Key, class Data>
 	Data *LRUCache<Key, Data>::add(const Key &key, Data *data)
 	{
-		top = (top + 1) & mask;
-		fill = fill + 1 < size ? fill + 1 : size;
+		// Replace the data of an existing entry
+		for(int i = bucket[bucketIndex(key.hash)]; i != -1; i = chain[i])
+		{
+			if(key == this->key[i])
+			{
+				if(i != first)
+				{
+					unlink(i);
+					link(i);
+				}
+
+				data->bind();
+				this->data[i]->unbind();
+				this->data[i] = data;
+
+				return data;
+			}
+		}
+
+		int i;
+
+		if(fill < size)
+		{
+			i = fill++;
+		}
+		else
+		{
+			// Evict the least recently used entry
+			i = last;
+			unlink(i);
+
+			int *j = &bucket[bucketIndex(this->key[i].hash)];
+
+			while(*j != i)
+			{
+				j = &chain[*j];
+			}
+
+			*j = chain[i];
+		}
 
-		*ref[top] = key;
+		this->key[i] = key;
+
+		int b = bucketIndex(key.hash);
+		chain[i] = bucket[b];
+		bucket[b] = i;
+
+		link(i);
 
 		data->bind();
 
-		if(this->data[top])
+		if(this->data[i])
 		{
-			this->data[top]->unbind();
+			this->data[i]->unbind();
 		}
 
-		this->data[top] = data;
+		this->data[i] = data;
 
 		return data;
 	}
+
+	template<class Key, class Data>
+	int LRUCache<Key, Data>::bucketIndex(unsigned int hash) const
+	{
+		// Fibonacci hashing spreads the XOR-folded state hashes over all buckets
+		return (int)((hash * 0x9E3779B9u) >> shift);
+	}
+
+	template<class Key, class Data>
+	void LRUCache<Key, Data>::link(int i)
+	{
+		prev[i] = -1;
+		next[i] = first;
+
+		if(first != -1)
+		{
+			prev[first] = i;
+		}
+		else
+		{
+			last = i;
+		}
+
+		first = i;
+	}
+
+	template<class Key, class Data>
+	void LRUCache<Key, Data>::unlink(int i)
+	{
+		if(prev[i] != -1)
+		{
+			next[prev[i]] = next[i];
+		}
+		else
+		{
+			first = next[i];
+		}
+
+		if(next[i] != -1)
+		{
+			prev[next[i]] = prev[i];
+		}
+		else
+		{
+			last = prev[i];
+		}
+	}
 }
 
 #endif   // sw_LRUCache_hpp
@@ -771,11 +771,30 @@ namespace sw
 
 		if(!routine)
 		{
-			const bool integerPipeline = (context->pixelShaderModel() <= 0x0104);
-			QuadRasterizer *generator = new PixelProgram(state, context->pixelShader);
-			generator->generate();
-			routine = (*generator)(L"PixelRoutine_%0.8X", state.shaderID);
-			delete generator;
+			SharedRoutineCache *sharedCache = context->routineCache;
+			States sharedState;   // Without the process specific shader ID
+
+			if(sharedCache)
+			{
+				memcpy(&sharedState, static_cast<const States*>(&state), sizeof(States));
+				sharedState.shaderID = 0;
+				routine = sharedCache->query(SharedRoutineCache::PIXEL, &sharedState, sizeof(States), context->shaderHash);
+			}
+
+			if(!routine)
+			{
+				RetainObjectCodeScope retain(sharedCache != nullptr);   // Serialized by pipeline caches
+				const bool integerPipeline = (context->pixelShaderModel() <= 0x0104);
+				QuadRasterizer *generator = new PixelProgram(state, context->pixelShader);
+				generator->generate();
+				routine = (*generator)(L"PixelRoutine_%0.8X", state.shaderID);
+				delete generator;
+
+				if(sharedCache)
+				{
+					sharedCache->add(SharedRoutineCache::PIXEL, &sharedState, sizeof(States), context->shaderHash, routine);
+				}
+			}
 
 			routineCache->add(state, routine);
 		}
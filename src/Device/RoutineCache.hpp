@@ -23,6 +23,27 @@ namespace sw
 {
 	using namespace rr;
 
+	// Routine storage shared between renderers, like a Vulkan pipeline cache. Unlike the
+	// per-renderer caches it's keyed on the shader code's hash rather than on serial IDs,
+	// so entries remain valid across processes. Implementations must be thread-safe.
+	class SharedRoutineCache
+	{
+	public:
+		enum Type
+		{
+			VERTEX,
+			SETUP,
+			PIXEL
+		};
+
+		// The cache holds a reference to its routines for as long as it exists
+		virtual Routine *query(Type type, const void *state, size_t stateSize, uint64_t shaderHash) = 0;
+		virtual void add(Type type, const void *state, size_t stateSize, uint64_t shaderHash, Routine *routine) = 0;
+
+	protected:
+		virtual ~SharedRoutineCache() {}
+	};
+
 	template<class State>
 	class RoutineCache : public LRUCache<State, Routine>
 	{
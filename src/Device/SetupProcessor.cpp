@@ -22,6 +22,8 @@
 #include "Pipeline/Constants.hpp"
 #include "System/Debug.hpp"
 
+#include <string.h>
+
 namespace sw
 {
 	extern bool complementaryDepthBuffer;
@@ -150,10 +152,28 @@ namespace sw
 
 		if(!routine)
 		{
-			SetupRoutine *generator = new SetupRoutine(state);
-			generator->generate();
-			routine = generator->getRoutine();
-			delete generator;
+			SharedRoutineCache *sharedCache = context->routineCache;
+			States sharedState;
+
+			if(sharedCache)
+			{
+				memcpy(&sharedState, static_cast<const States*>(&state), sizeof(States));
+				routine = sharedCache->query(SharedRoutineCache::SETUP, &sharedState, sizeof(States), context->shaderHash);
+			}
+
+			if(!routine)
+			{
+				RetainObjectCodeScope retain(sharedCache != nullptr);   // Serialized by pipeline caches
+				SetupRoutine *generator = new SetupRoutine(state);
+				generator->generate();
+				routine = generator->getRoutine();
+				delete generator;
+
+				if(sharedCache)
+				{
+					sharedCache->add(SharedRoutineCache::SETUP, &sharedState, sizeof(States), context->shaderHash, routine);
+				}
+			}
 
 			routineCache->add(state, routine);
 		}
@@ -445,10 +445,29 @@ namespace sw
 
 		if(!routine)   // Create one
 		{
-			VertexRoutine *generator = new VertexProgram(state, context->vertexShader);
-			generator->generate();
-			routine = (*generator)(L"VertexRoutine_%0.8X", state.shaderID);
-			delete generator;
+			SharedRoutineCache *sharedCache = context->routineCache;
+			States sharedState;   // Without the process specific shader ID
+
+			if(sharedCache)
+			{
+				memcpy(&sharedState, static_cast<const States*>(&state), sizeof(States));
+				sharedState.shaderID = 0;
+				routine = sharedCache->query(SharedRoutineCache::VERTEX, &sharedState, sizeof(States), context->shaderHash);
+			}
+
+			if(!routine)
+			{
+				RetainObjectCodeScope retain(sharedCache != nullptr);   // Serialized by pipeline caches
+				VertexRoutine *generator = new VertexProgram(state, context->vertexShader);
+				generator->generate();
+				routine = (*generator)(L"VertexRoutine_%0.8X", state.shaderID);
+				delete generator;
+
+				if(sharedCache)
+				{
+					sharedCache->add(SharedRoutineCache::VERTEX, &sharedState, sizeof(States), context->shaderHash, routine);
+				}
+			}
 
 			routineCache->add(state, routine);
 		}
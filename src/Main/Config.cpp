@@ -50,6 +50,14 @@ namespace sw
 			compressedTexTotal = 0;
 			compressedTexFrame = 0;
 		#endif
+
+		vertexCacheLookups = 0;
+		vertexCacheLookupsTotal = 0;
+		vertexCacheLookupsFrame = 0;
+
+		vertexCacheMisses = 0;
+		vertexCacheMissesTotal = 0;
+		vertexCacheMissesFrame = 0;
 	};
 
 	void Profiler::nextFrame()
@@ -64,6 +72,12 @@ namespace sw
 			compressedTexTotal += compressedTexFrame;
 		#endif
 
+		vertexCacheLookupsFrame = vertexCacheLookups.exchange(0);
+		vertexCacheMissesFrame = vertexCacheMisses.exchange(0);
+
+		vertexCacheLookupsTotal += vertexCacheLookupsFrame;
+		vertexCacheMissesTotal += vertexCacheMissesFrame;
+
 		static double fpsTime = sw::Timer::seconds();
 
 		double time = sw::Timer::seconds();
@@ -17,6 +17,8 @@
 
 #include "Common/Types.hpp"
 
+#include <atomic>
+
 #define PERF_HUD 0       // Display time spent on vertex, setup and pixel processing for each thread
 #define PERF_PROFILE 0   // Profile various pipeline stages and display the timing in SwiftConfig
 
@@ -69,6 +71,14 @@ namespace sw
 		int64_t compressedTexTotal;
 		int64_t compressedTexFrame;
 		#endif
+
+		std::atomic<int64_t> vertexCacheLookups;
+		int64_t vertexCacheLookupsTotal;
+		int64_t vertexCacheLookupsFrame;
+
+		std::atomic<int64_t> vertexCacheMisses;   // Each miss processes four vertices
+		int64_t vertexCacheMissesTotal;
+		int64_t vertexCacheMissesFrame;
 	};
 
 	extern Profiler profiler;
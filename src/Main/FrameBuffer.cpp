@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <vector>
 
 #define ASYNCHRONOUS_BLIT false   // FIXME: Currently leads to rare race conditions
 
@@ -44,6 +45,10 @@ namespace sw
 		stride = 0;
 
 		windowed = !fullscreen || forceWindowed;
+		retained = false;
+		presentRectCount = 0;
+		presented = nullptr;
+		cursorRect = Rect(0, 0, 0, 0);
 
 		blitFunction = nullptr;
 		blitRoutine = nullptr;
@@ -99,8 +104,10 @@ namespace sw
 		cursor.positionY = y;
 	}
 
-	void FrameBuffer::copy(sw::Surface *source)
+	void FrameBuffer::copy(sw::Surface *source, const Rect *damage, int count)
 	{
+		presentRectCount = 0;
+
 		if(!source)
 		{
 			return;
@@ -123,6 +130,9 @@ namespace sw
 		updateState.cursorWidth = cursor.width;
 		updateState.cursorHeight = cursor.height;
 
+		Rect written;
+		bool damaged = source->takeDamage(written);
+
 		renderbuffer = source->lockInternal(0, 0, 0, sw::LOCK_READONLY, sw::PUBLIC);
 
 		if(!topLeftOrigin)
@@ -133,6 +143,50 @@ namespace sw
 		cursor.x = cursor.positionX - cursor.hotspotX;
 		cursor.y = cursor.positionY - cursor.hotspotY;
 
+		// Buffers which lose their contents, or get written in another format, are copied entirely
+		if(!retained || framebuffer != presented || memcmp(&blitState, &updateState, sizeof(BlitState)) != 0)
+		{
+			addPresentRect(Rect(0, 0, width, height));
+		}
+		else
+		{
+			if(damaged)
+			{
+				// Pixels outside of the damage reported by the application didn't change
+				for(int i = 0; i < (damage ? count : 1); i++)
+				{
+					Rect rect = written;
+
+					if(damage)
+					{
+						rect.clip(damage[i].x0, damage[i].y0, damage[i].x1, damage[i].y1);
+					}
+
+					if(!topLeftOrigin)
+					{
+						rect = Rect(rect.x0, height - rect.y1, rect.x1, height - rect.y0);
+					}
+
+					addPresentRect(rect);
+				}
+			}
+
+			// Restores the pixels under the previous cursor position
+			addPresentRect(cursorRect);
+		}
+
+		if(cursor.width > 0 && cursor.height > 0)
+		{
+			cursorRect = Rect(cursor.x, cursor.y, cursor.x + cursor.width, cursor.y + cursor.height);
+			addPresentRect(cursorRect);
+		}
+		else
+		{
+			cursorRect = Rect(0, 0, 0, 0);
+		}
+
+		presented = framebuffer;
+
 		if(ASYNCHRONOUS_BLIT)
 		{
 			blitEvent.signal();
@@ -149,6 +203,34 @@ namespace sw
 		profiler.nextFrame();   // Assumes every copy() is a full frame
 	}
 
+	void FrameBuffer::addPresentRect(Rect rect)
+	{
+		rect.clip(0, 0, width, height);
+
+		// Groups of four pixels are converted at once, keep their source addresses aligned
+		rect.x0 &= ~3;
+		rect.x1 = min((rect.x1 + 3) & ~3, width);
+
+		if(rect.x0 >= rect.x1 || rect.y0 >= rect.y1)
+		{
+			return;
+		}
+
+		if(presentRectCount < MAX_PRESENT_RECTS)
+		{
+			presentRect[presentRectCount++] = rect;
+		}
+		else   // Merge with the last rectangle
+		{
+			Rect &last = presentRect[MAX_PRESENT_RECTS - 1];
+
+			last.x0 = min(last.x0, rect.x0);
+			last.y0 = min(last.y0, rect.y0);
+			last.x1 = max(last.x1, rect.x1);
+			last.y1 = max(last.y1, rect.y1);
+		}
+	}
+
 	void FrameBuffer::copyLocked()
 	{
 		if(memcmp(&blitState, &updateState, sizeof(BlitState)) != 0)
@@ -157,33 +239,54 @@ namespace sw
 			delete blitRoutine;
 
 			blitRoutine = copyRoutine(blitState);
-			blitFunction = (void(*)(void*, void*, Cursor*))blitRoutine->getEntry();
+			blitFunction = (void(*)(void*, void*, Cursor*, Rect*))blitRoutine->getEntry();
+		}
+
+		// Large regions are split into bands of rows, converted concurrently
+		std::vector<Rect> bands;
+
+		for(int i = 0; i < presentRectCount; i++)
+		{
+			const Rect &rect = presentRect[i];
+			int bandHeight = max(PRESENT_BAND_PIXELS / rect.width(), 1);
+
+			for(int y = rect.y0; y < rect.y1; y += bandHeight)
+			{
+				bands.push_back(Rect(rect.x0, y, rect.x1, min(y + bandHeight, rect.y1)));
+			}
 		}
 
-		blitFunction(framebuffer, renderbuffer, &cursor);
+		parallelFor((int)bands.size(), [&](int band)
+		{
+			blitFunction(framebuffer, renderbuffer, &cursor, &bands[band]);
+		});
 	}
 
 	Routine *FrameBuffer::copyRoutine(const BlitState &state)
 	{
-		const int width = state.width;
-		const int height = state.height;
 		const int dBytes = Surface::bytes(state.destFormat);
 		const int dStride = state.destStride;
 		const int sBytes = Surface::bytes(state.sourceFormat);
 		const int sStride = state.sourceStride;
 
-		Function<Void(Pointer<Byte>, Pointer<Byte>, Pointer<Byte>)> function;
+		Function<Void(Pointer<Byte>, Pointer<Byte>, Pointer<Byte>, Pointer<Byte>)> function;
 		{
 			Pointer<Byte> dst(function.Arg<0>());
 			Pointer<Byte> src(function.Arg<1>());
 			Pointer<Byte> cursor(function.Arg<2>());
+			Pointer<Byte> region(function.Arg<3>());
+
+			Int left = *Pointer<Int>(region + OFFSET(Rect,x0));
+			Int top = *Pointer<Int>(region + OFFSET(Rect,y0));
+			Int right = *Pointer<Int>(region + OFFSET(Rect,x1));
+			Int bottom = *Pointer<Int>(region + OFFSET(Rect,y1));
 
-			For(Int y = 0, y < height, y++)
+			For(Int y = top, y < bottom, y++)
 			{
-				Pointer<Byte> d = dst + y * dStride;
-				Pointer<Byte> s = src + y * sStride;
+				Int x0 = left;
 
-				Int x0 = 0;
+				Pointer<Byte> d = dst + y * dStride + x0 * dBytes;
+				Pointer<Byte> s = src + y * sStride + x0 * sBytes;
 
 				switch(state.destFormat)
 				{
@@ -196,7 +299,7 @@ namespace sw
 						{
 						case FORMAT_X8R8G8B8:
 						case FORMAT_A8R8G8B8:
-							For(, x < width - 3, x += 4)
+							For(, x < right - 3, x += 4)
 							{
 								*Pointer<Int4>(d, 1) = *Pointer<Int4>(s, sStride % 16 ? 1 : 16);
 
@@ -206,7 +309,7 @@ namespace sw
 							break;
 						case FORMAT_X8B8G8R8:
 						case FORMAT_A8B8G8R8:
-							For(, x < width - 3, x += 4)
+							For(, x < right - 3, x += 4)
 							{
 								Int4 bgra = *Pointer<Int4>(s, sStride % 16 ? 1 : 16);
 
@@ -219,7 +322,7 @@ namespace sw
 							}
 							break;
 						case FORMAT_A16B16G16R16:
-							For(, x < width - 1, x += 2)
+							For(, x < right - 1, x += 2)
 							{
 								Short4 c0 = As<UShort4>(Swizzle(*Pointer<Short4>(s + 0), 0xC6)) >> 8;
 								Short4 c1 = As<UShort4>(Swizzle(*Pointer<Short4>(s + 8), 0xC6)) >> 8;
@@ -231,7 +334,7 @@ namespace sw
 							}
 							break;
 						case FORMAT_R5G6B5:
-							For(, x < width - 3, x += 4)
+							For(, x < right - 3, x += 4)
 							{
 								Int4 rgb = Int4(*Pointer<Short4>(s));
 
@@ -248,7 +351,7 @@ namespace sw
 							break;
 						}
 
-						For(, x < width, x++)
+						For(, x < right, x++)
 						{
 							switch(state.sourceFormat)
 							{
@@ -304,7 +407,7 @@ namespace sw
 						{
 						case FORMAT_X8B8G8R8:
 						case FORMAT_A8B8G8R8:
-							For(, x < width - 3, x += 4)
+							For(, x < right - 3, x += 4)
 							{
 								*Pointer<Int4>(d, 1) = *Pointer<Int4>(s, sStride % 16 ? 1 : 16);
 
@@ -314,7 +417,7 @@ namespace sw
 							break;
 						case FORMAT_X8R8G8B8:
 						case FORMAT_A8R8G8B8:
-							For(, x < width - 3, x += 4)
+							For(, x < right - 3, x += 4)
 							{
 								Int4 bgra = *Pointer<Int4>(s, sStride % 16 ? 1 : 16);
 
@@ -327,7 +430,7 @@ namespace sw
 							}
 							break;
 						case FORMAT_A16B16G16R16:
-							For(, x < width - 1, x += 2)
+							For(, x < right - 1, x += 2)
 							{
 								Short4 c0 = *Pointer<UShort4>(s + 0) >> 8;
 								Short4 c1 = *Pointer<UShort4>(s + 8) >> 8;
@@ -339,7 +442,7 @@ namespace sw
 							}
 							break;
 						case FORMAT_R5G6B5:
-							For(, x < width - 3, x += 4)
+							For(, x < right - 3, x += 4)
 							{
 								Int4 rgb = Int4(*Pointer<Short4>(s));
 
@@ -357,7 +460,7 @@ namespace sw
 							break;
 						}
 
-						For(, x < width, x++)
+						For(, x < right, x++)
 						{
 							switch(state.sourceFormat)
 							{
@@ -403,7 +506,7 @@ namespace sw
 					break;
 				case FORMAT_R8G8B8:
 					{
-						For(Int x = x0, x < width, x++)
+						For(Int x = x0, x < right, x++)
 						{
 							switch(state.sourceFormat)
 							{
@@ -445,7 +548,7 @@ namespace sw
 					break;
 				case FORMAT_R5G6B5:
 					{
-						For(Int x = x0, x < width, x++)
+						For(Int x = x0, x < right, x++)
 						{
 							switch(state.sourceFormat)
 							{
@@ -507,7 +610,7 @@ namespace sw
 				{
 					Int y = y0 + y1;
 
-					If(y >= 0 && y < height)
+					If(y >= top && y < bottom)
 					{
 						Pointer<Byte> d = dst + y * dStride + x0 * dBytes;
 						Pointer<Byte> s = src + y * sStride + x0 * sBytes;
@@ -517,7 +620,7 @@ namespace sw
 						{
 							Int x = x0 + x1;
 
-							If(x >= 0 && x < width)
+							If(x >= left && x < right)
 							{
 								blend(state, d, s, c);
 							}
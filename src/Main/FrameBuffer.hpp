@@ -45,6 +45,7 @@ namespace sw
 		virtual ~FrameBuffer() = 0;
 
 		virtual void flip(sw::Surface *source) = 0;
+		virtual void flip(sw::Surface *source, const Rect *damage, int count) { flip(source); }   // Damage in source coordinates
 		virtual void blit(sw::Surface *source, const Rect *sourceRect, const Rect *destRect) = 0;
 
 		virtual void *lock() = 0;
@@ -57,9 +58,15 @@ namespace sw
 		static Routine *copyRoutine(const BlitState &state);
 
 	protected:
-		void copy(sw::Surface *source);
+		void copy(sw::Surface *source, const Rect *damage = nullptr, int count = 0);
 
 		bool windowed;
+		bool retained;   // The native buffer keeps its contents between copies, so only damage has to be copied
+
+		enum {MAX_PRESENT_RECTS = 16};
+
+		Rect presentRect[MAX_PRESENT_RECTS];   // Native buffer regions written by the last copy
+		int presentRectCount;
 
 		void *framebuffer;   // Native window buffer.
 		int width;
@@ -69,11 +76,14 @@ namespace sw
 
 	private:
 		void copyLocked();
+		void addPresentRect(Rect rect);
 
 		static void threadFunction(void *parameters);
 
 		void *renderbuffer;   // Render target buffer.
 
+		enum {PRESENT_BAND_PIXELS = 128 * 1024};   // Pixels per band of rows converted by one thread
+
 		struct Cursor
 		{
 			void *image;
@@ -89,7 +99,10 @@ namespace sw
 
 		static Cursor cursor;
 
-		void (*blitFunction)(void *dst, void *src, Cursor *cursor);
+		void *presented;    // Native buffer written by the last copy
+		Rect cursorRect;    // Cursor rectangle written by the last copy
+
+		void (*blitFunction)(void *dst, void *src, Cursor *cursor, Rect *region);
 		Routine *blitRoutine;
 		BlitState blitState;     // State of the current blitRoutine.
 		BlitState updateState;   // State of the routine to be generated.
@@ -60,6 +60,7 @@ namespace sw
 		Visual *visual = match ? x_visual.visual : libX11->XDefaultVisual(x_display, screen);
 
 		mit_shm = (libX11->XShmQueryExtension && libX11->XShmQueryExtension(x_display) == True);
+		retained = true;   // The image is only written by copies
 
 		if(mit_shm)
 		{
@@ -141,15 +142,30 @@ namespace sw
 
 	void FrameBufferX11::blit(sw::Surface *source, const Rect *sourceRect, const Rect *destRect)
 	{
-		copy(source);
+		flip(source, nullptr, 0);
+	}
 
-		if(!mit_shm)
-		{
-			libX11->XPutImage(x_display, x_window, x_gc, x_image, 0, 0, 0, 0, width, height);
-		}
-		else
+	void FrameBufferX11::flip(sw::Surface *source, const Rect *damage, int count)
+	{
+		copy(source, damage, count);
+
+		// Without damage from the application, the whole image is uploaded to repaint
+		// any parts of the window which got exposed. Only the conversion is incremental.
+		Rect window(0, 0, width, height);
+		const Rect *rects = damage ? presentRect : &window;
+
+		for(int i = 0; i < (damage ? presentRectCount : 1); i++)
 		{
-			libX11->XShmPutImage(x_display, x_window, x_gc, x_image, 0, 0, 0, 0, width, height, False);
+			const Rect &rect = rects[i];
+
+			if(!mit_shm)
+			{
+				libX11->XPutImage(x_display, x_window, x_gc, x_image, rect.x0, rect.y0, rect.x0, rect.y0, rect.width(), rect.height());
+			}
+			else
+			{
+				libX11->XShmPutImage(x_display, x_window, x_gc, x_image, rect.x0, rect.y0, rect.x0, rect.y0, rect.width(), rect.height(), False);
+			}
 		}
 
 		libX11->XSync(x_display, False);
@@ -31,7 +31,8 @@ namespace sw
 
 		~FrameBufferX11() override;
 
-		void flip(sw::Surface *source) override { blit(source, nullptr, nullptr); }
+		void flip(sw::Surface *source) override { flip(source, nullptr, 0); }
+		void flip(sw::Surface *source, const Rect *damage, int count) override;
 		void blit(sw::Surface *source, const Rect *sourceRect, const Rect *destRect) override;
 
 		void *lock() override;
@@ -16,8 +16,10 @@
 
 #include "Config.hpp"
 #include "Common/Configurator.hpp"
+#include "Common/CPUID.hpp"
 #include "Common/Debug.hpp"
 #include "Common/Version.h"
+#include "Reactor/ExecutableMemory.hpp"
 
 #include <sstream>
 #include <stdio.h>
@@ -335,7 +337,11 @@ namespace sw
 		html += "</select></td>\n";
 		html += "</tr>\n";
 		html += "<tr><td>Vertex cache size:</td><td><select name='vertexCacheSize' title='The number of processed vertices being cached for reuse. Lower numbers save memory but require more vertices to be reprocessed.'>\n";
-		html += "<option value='64'"   + (config.vertexCacheSize == 64   ? selected : empty) + ">64 (default)</option>\n";
+		html += "<option value='64'"   + (config.vertexCacheSize == 64   ? selected : empty) + ">64</option>\n";
+		html += "<option value='128'"  + (config.vertexCacheSize == 128  ? selected : empty) + ">128</option>\n";
+		html += "<option value='256'"  + (config.vertexCacheSize == 256  ? selected : empty) + ">256 (default)</option>\n";
+		html += "<option value='512'"  + (config.vertexCacheSize == 512  ? selected : empty) + ">512</option>\n";
+		html += "<option value='1024'" + (config.vertexCacheSize == 1024 ? selected : empty) + ">1024</option>\n";
 		html += "</select></td>\n";
 		html += "</tr>\n";
 		html += "</table>\n";
@@ -357,6 +363,11 @@ namespace sw
 		html += "<option value='1'" + (config.perspectiveCorrection == 1 ? selected : empty) + ">On (default)</option>\n";
 		html += "</select></td>\n";
 		html += "</tr>\n";
+		html += "<tr><td>Compressed texture sampling:</td><td><select name='compressedTextureSampling' title='Samples DXT, ATI and ETC2 textures directly instead of decoding them when they are specified. Saves memory and upload time, at the cost of slower sampling. Applies to new textures.'>\n";
+		html += "<option value='0'" + (config.compressedTextureSampling == 0 ? selected : empty) + ">Off (default)</option>\n";
+		html += "<option value='1'" + (config.compressedTextureSampling == 1 ? selected : empty) + ">On</option>\n";
+		html += "</select></td>\n";
+		html += "</tr>\n";
 		html += "<tr><td>Transcendental function precision:</td><td><select name='transcendentalPrecision' title='The precision at which log/exp/pow/rcp/rsq/nrm shader instructions are computed. Lower settings can be faster but cause visual artifacts.'>\n";
 		html += "<option value='0'" + (config.transcendentalPrecision == 0 ? selected : empty) + ">Approximate</option>\n";
 		html += "<option value='1'" + (config.transcendentalPrecision == 1 ? selected : empty) + ">Partial</option>\n";
@@ -375,28 +386,38 @@ namespace sw
 		html += "<tr><td>Number of threads:</td><td><select name='threadCount' title='The number of rendering threads to be used.'>\n";
 		html += "<option value='-1'" + (config.threadCount == -1 ? selected : empty) + ">Core count</option>\n";
 		html += "<option value='0'"  + (config.threadCount == 0  ? selected : empty) + ">Process affinity (default)</option>\n";
-		html += "<option value='1'"  + (config.threadCount == 1  ? selected : empty) + ">1</option>\n";
-		html += "<option value='2'"  + (config.threadCount == 2  ? selected : empty) + ">2</option>\n";
-		html += "<option value='3'"  + (config.threadCount == 3  ? selected : empty) + ">3</option>\n";
-		html += "<option value='4'"  + (config.threadCount == 4  ? selected : empty) + ">4</option>\n";
-		html += "<option value='5'"  + (config.threadCount == 5  ? selected : empty) + ">5</option>\n";
-		html += "<option value='6'"  + (config.threadCount == 6  ? selected : empty) + ">6</option>\n";
-		html += "<option value='7'"  + (config.threadCount == 7  ? selected : empty) + ">7</option>\n";
-		html += "<option value='8'"  + (config.threadCount == 8  ? selected : empty) + ">8</option>\n";
-		html += "<option value='9'"  + (config.threadCount == 9  ? selected : empty) + ">9</option>\n";
-		html += "<option value='10'" + (config.threadCount == 10 ? selected : empty) + ">10</option>\n";
-		html += "<option value='11'" + (config.threadCount == 11 ? selected : empty) + ">11</option>\n";
-		html += "<option value='12'" + (config.threadCount == 12 ? selected : empty) + ">12</option>\n";
-		html += "<option value='13'" + (config.threadCount == 13 ? selected : empty) + ">13</option>\n";
-		html += "<option value='14'" + (config.threadCount == 14 ? selected : empty) + ">14</option>\n";
-		html += "<option value='15'" + (config.threadCount == 15 ? selected : empty) + ">15</option>\n";
-		html += "<option value='16'" + (config.threadCount == 16 ? selected : empty) + ">16</option>\n";
+
+		// The thread count is not limited, so offer at least every core of this machine
+		int maxThreadCount = std::max(std::max(16, CPUID::coreCount()), config.threadCount);
+
+		for(int threadCount = 1; threadCount <= maxThreadCount; threadCount++)
+		{
+			html += "<option value='" + itoa(threadCount) + "'" + (config.threadCount == threadCount ? selected : empty) + ">" + itoa(threadCount) + "</option>\n";
+		}
+
 		html += "</select></td></tr>\n";
+		html += "<tr><td>Pixel work distribution:</td><td><select name='tileSize' title='How the pixels of each primitive are divided between rendering threads. Tiles keep each screen region in the cache of a single core.'>\n";
+		html += "<option value='0'"   + (config.tileSize == 0   ? selected : empty) + ">Interleaved scanlines (default)</option>\n";
+		html += "<option value='16'"  + (config.tileSize == 16  ? selected : empty) + ">16x16 tiles</option>\n";
+		html += "<option value='32'"  + (config.tileSize == 32  ? selected : empty) + ">32x32 tiles</option>\n";
+		html += "<option value='64'"  + (config.tileSize == 64  ? selected : empty) + ">64x64 tiles</option>\n";
+		html += "<option value='128'" + (config.tileSize == 128 ? selected : empty) + ">128x128 tiles</option>\n";
+		html += "</select></td></tr>\n";
+		html += "<tr><td>Draw call queue size:</td><td><select name='drawCallQueueSize' title='The maximum number of draw calls in flight. Higher numbers let the application submit more small draw calls without waiting for the rendering threads.'>\n";
+		html += "<option value='16'"   + (config.drawCallQueueSize == 16   ? selected : empty) + ">16</option>\n";
+		html += "<option value='64'"   + (config.drawCallQueueSize == 64   ? selected : empty) + ">64</option>\n";
+		html += "<option value='256'"  + (config.drawCallQueueSize == 256  ? selected : empty) + ">256</option>\n";
+		html += "<option value='1024'" + (config.drawCallQueueSize == 1024 ? selected : empty) + ">1024 (default)</option>\n";
+		html += "<option value='4096'" + (config.drawCallQueueSize == 4096 ? selected : empty) + ">4096</option>\n";
+		html += "</select></td></tr>\n";
+		html += "<tr><td>Asynchronous routine compilation:</td><td><input name = 'asyncRoutineCompilation' type='checkbox'" + (config.asyncRoutineCompilation ? checked : empty) + " title='If checked new shader variants are compiled on background threads, so the application does not wait for them. If the JIT has a faster unoptimized tier, variants compiled with it are drawn with until the optimized ones are ready.'></td></tr>";
+		html += "<tr><td>Tiered routine compilation:</td><td><input name = 'tieredRoutineCompilation' type='checkbox'" + (config.tieredRoutineCompilation ? checked : empty) + " title='If checked new routines are first compiled without optimizations, and recompiled with them once frequently used.'></td></tr>";
 		html += "<tr><td>Enable SSE:</td><td><input name = 'enableSSE' type='checkbox'" + (config.enableSSE ? checked : empty) + " disabled='disabled' title='If checked enables the use of SSE instruction set extentions if supported by the CPU.'></td></tr>";
 		html += "<tr><td>Enable SSE2:</td><td><input name = 'enableSSE2' type='checkbox'" + (config.enableSSE2 ? checked : empty) + " title='If checked enables the use of SSE2 instruction set extentions if supported by the CPU.'></td></tr>";
 		html += "<tr><td>Enable SSE3:</td><td><input name = 'enableSSE3' type='checkbox'" + (config.enableSSE3 ? checked : empty) + " title='If checked enables the use of SSE3 instruction set extentions if supported by the CPU.'></td></tr>";
 		html += "<tr><td>Enable SSSE3:</td><td><input name = 'enableSSSE3' type='checkbox'" + (config.enableSSSE3 ? checked : empty) + " title='If checked enables the use of SSSE3 instruction set extentions if supported by the CPU.'></td></tr>";
 		html += "<tr><td>Enable SSE4.1:</td><td><input name = 'enableSSE4_1' type='checkbox'" + (config.enableSSE4_1 ? checked : empty) + " title='If checked enables the use of SSE4.1 instruction set extentions if supported by the CPU.'></td></tr>";
+		html += "<tr><td>Enable AVX2:</td><td><input name = 'enableAVX2' type='checkbox'" + (config.enableAVX2 ? checked : empty) + " title='If checked enables the use of AVX and AVX2 instruction set extentions if supported by the CPU.'></td></tr>";
 		html += "</table>\n";
 		html += "<h2><em>Compiler optimizations</em></h2>\n";
 		html += "<table>\n";
@@ -431,7 +452,7 @@ namespace sw
 		html += "<option value='0'" + (config.frameBufferAPI == 0 ? selected : empty) + ">DirectDraw (default)</option>\n";
 		html += "<option value='1'" + (config.frameBufferAPI == 1 ? selected : empty) + ">GDI</option>\n";
 		html += "</select></td>\n";
-		html += "<tr><td>DLL precaching:</td><td><input name = 'precache' type='checkbox'" + (config.precache == true ? checked : empty) + " title='If checked dynamically generated routines will be stored in a DLL for faster loading on application restart.'></td></tr>";
+		html += "<tr><td>Routine precaching:</td><td><input name = 'precache' type='checkbox'" + (config.precache == true ? checked : empty) + " title='If checked dynamically generated routines will be stored on disk for faster loading on application restart.'></td></tr>";
 		html += "<tr><td>Shadow mapping extensions:</td><td><select name='shadowMapping' title='Features that may accelerate or improve the quality of shadow mapping.'>\n";
 		html += "<option value='0'" + (config.shadowMapping == 0 ? selected : empty) + ">None</option>\n";
 		html += "<option value='1'" + (config.shadowMapping == 1 ? selected : empty) + ">Fetch4</option>\n";
@@ -467,6 +488,18 @@ namespace sw
 		html += "<p>FPS: " + ftoa(profiler.FPS) + "</p>\n";
 		html += "<p>Frame: " + itoa(profiler.framesTotal) + "</p>\n";
 
+		rr::ExecutableMemoryUsage codeMemory = rr::executableMemoryUsage();
+		html += "<p>Routine code memory (KiB): " + itoa((int)(codeMemory.used / 1024)) + " used, " + itoa((int)(codeMemory.reserved / 1024)) + " reserved, " + itoa((int)codeMemory.allocations) + " allocations</p>\n";
+
+		// Each miss shades four vertices
+		double averageVertexCacheLookups = profiler.vertexCacheLookupsTotal / std::max(profiler.framesTotal, 1) / 1.0e6f;
+		double averageVertexCacheMisses = profiler.vertexCacheMissesTotal / std::max(profiler.framesTotal, 1) / 1.0e6f;
+		double vertexCacheHitRate = 100.0 * (1.0 - (double)profiler.vertexCacheMissesTotal / std::max(profiler.vertexCacheLookupsTotal, (int64_t)1));
+
+		html += "<p>Vertex cache lookups (million): " + ftoa(profiler.vertexCacheLookupsFrame / 1.0e6f) + " (current), " + ftoa(averageVertexCacheLookups) + " (average)</p>\n";
+		html += "<p>Vertex cache misses (million): " + ftoa(profiler.vertexCacheMissesFrame / 1.0e6f) + " (current), " + ftoa(averageVertexCacheMisses) + " (average)</p>\n";
+		html += "<p>Vertex cache hit rate: " + ftoa(vertexCacheHitRate) + "%</p>\n";
+
 		#if PERF_PROFILE
 			int texTime = (int)(1000 * profiler.cycles[PERF_TEX] / profiler.cycles[PERF_PIXEL] + 0.5);
 			int shaderTime = (int)(1000 * profiler.cycles[PERF_SHADER] / profiler.cycles[PERF_PIXEL] + 0.5);
@@ -534,11 +567,14 @@ namespace sw
 	void SwiftConfig::parsePost(const char *post)
 	{
 		// Only enabled checkboxes appear in the POST
+		config.asyncRoutineCompilation = false;
+		config.tieredRoutineCompilation = false;
 		config.enableSSE = true;
 		config.enableSSE2 = false;
 		config.enableSSE3 = false;
 		config.enableSSSE3 = false;
 		config.enableSSE4_1 = false;
+		config.enableAVX2 = false;
 		config.disableServer = false;
 		config.forceWindowed = false;
 		config.complementaryDepthBuffer = false;
@@ -598,6 +634,10 @@ namespace sw
 			{
 				config.perspectiveCorrection = integer != 0;
 			}
+			else if(sscanf(post, "compressedTextureSampling=%d", &integer))
+			{
+				config.compressedTextureSampling = integer != 0;
+			}
 			else if(sscanf(post, "transcendentalPrecision=%d", &integer))
 			{
 				config.transcendentalPrecision = integer;
@@ -610,6 +650,14 @@ namespace sw
 			{
 				config.threadCount = integer;
 			}
+			else if(sscanf(post, "tileSize=%d", &integer))
+			{
+				config.tileSize = integer;
+			}
+			else if(sscanf(post, "drawCallQueueSize=%d", &integer))
+			{
+				config.drawCallQueueSize = integer;
+			}
 			else if(sscanf(post, "frameBufferAPI=%d", &integer))
 			{
 				config.frameBufferAPI = integer;
@@ -650,6 +698,13 @@ namespace sw
 					config.enableSSE4_1 = true;
 				}
 			}
+			else if(strstr(post, "enableAVX2=on"))
+			{
+				if(config.enableSSE4_1)
+				{
+					config.enableAVX2 = true;
+				}
+			}
 			else if(sscanf(post, "optimization%d=%d", &index, &integer))
 			{
 				config.optimization[index - 1] = (rr::Optimization)integer;
@@ -682,6 +737,14 @@ namespace sw
 			{
 				config.disable10BitMode = true;
 			}
+			else if(strstr(post, "asyncRoutineCompilation=on"))
+			{
+				config.asyncRoutineCompilation = true;
+			}
+			else if(strstr(post, "tieredRoutineCompilation=on"))
+			{
+				config.tieredRoutineCompilation = true;
+			}
 			else if(strstr(post, "precache=on"))
 			{
 				config.precache = true;
@@ -724,18 +787,24 @@ namespace sw
 		config.vertexRoutineCacheSize = ini.getInteger("Caches", "VertexRoutineCacheSize", 1024);
 		config.pixelRoutineCacheSize = ini.getInteger("Caches", "PixelRoutineCacheSize", 1024);
 		config.setupRoutineCacheSize = ini.getInteger("Caches", "SetupRoutineCacheSize", 1024);
-		config.vertexCacheSize = ini.getInteger("Caches", "VertexCacheSize", 64);
+		config.vertexCacheSize = ini.getInteger("Caches", "VertexCacheSize", 256);
 		config.textureSampleQuality = ini.getInteger("Quality", "TextureSampleQuality", 2);
 		config.mipmapQuality = ini.getInteger("Quality", "MipmapQuality", 1);
 		config.perspectiveCorrection = ini.getBoolean("Quality", "PerspectiveCorrection", true);
+		config.compressedTextureSampling = ini.getBoolean("Quality", "CompressedTextureSampling", false);
 		config.transcendentalPrecision = ini.getInteger("Quality", "TranscendentalPrecision", 2);
 		config.transparencyAntialiasing = ini.getInteger("Quality", "TransparencyAntialiasing", 0);
 		config.threadCount = ini.getInteger("Processor", "ThreadCount", DEFAULT_THREAD_COUNT);
+		config.tileSize = ini.getInteger("Processor", "TileSize", 0);
+		config.drawCallQueueSize = ini.getInteger("Processor", "DrawCallQueueSize", 1024);
+		config.asyncRoutineCompilation = ini.getBoolean("Processor", "AsyncRoutineCompilation", false);
+		config.tieredRoutineCompilation = ini.getBoolean("Processor", "TieredRoutineCompilation", false);
 		config.enableSSE = ini.getBoolean("Processor", "EnableSSE", true);
 		config.enableSSE2 = ini.getBoolean("Processor", "EnableSSE2", true);
 		config.enableSSE3 = ini.getBoolean("Processor", "EnableSSE3", true);
 		config.enableSSSE3 = ini.getBoolean("Processor", "EnableSSSE3", true);
 		config.enableSSE4_1 = ini.getBoolean("Processor", "EnableSSE4_1", true);
+		config.enableAVX2 = ini.getBoolean("Processor", "EnableAVX2", true);
 
 		for(int pass = 0; pass < 10; pass++)
 		{
@@ -786,14 +855,20 @@ namespace sw
 		ini.addValue("Quality", "TextureSampleQuality", itoa(config.textureSampleQuality));
 		ini.addValue("Quality", "MipmapQuality", itoa(config.mipmapQuality));
 		ini.addValue("Quality", "PerspectiveCorrection", itoa(config.perspectiveCorrection));
+		ini.addValue("Quality", "CompressedTextureSampling", itoa(config.compressedTextureSampling));
 		ini.addValue("Quality", "TranscendentalPrecision", itoa(config.transcendentalPrecision));
 		ini.addValue("Quality", "TransparencyAntialiasing", itoa(config.transparencyAntialiasing));
 		ini.addValue("Processor", "ThreadCount", itoa(config.threadCount));
+		ini.addValue("Processor", "TileSize", itoa(config.tileSize));
+		ini.addValue("Processor", "DrawCallQueueSize", itoa(config.drawCallQueueSize));
+		ini.addValue("Processor", "AsyncRoutineCompilation", itoa(config.asyncRoutineCompilation));
+		ini.addValue("Processor", "TieredRoutineCompilation", itoa(config.tieredRoutineCompilation));
 	//	ini.addValue("Processor", "EnableSSE", itoa(config.enableSSE));
 		ini.addValue("Processor", "EnableSSE2", itoa(config.enableSSE2));
 		ini.addValue("Processor", "EnableSSE3", itoa(config.enableSSE3));
 		ini.addValue("Processor", "EnableSSSE3", itoa(config.enableSSSE3));
 		ini.addValue("Processor", "EnableSSE4_1", itoa(config.enableSSE4_1));
+		ini.addValue("Processor", "EnableAVX2", itoa(config.enableAVX2));
 
 		for(int pass = 0; pass < 10; pass++)
 		{
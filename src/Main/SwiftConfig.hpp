@@ -41,13 +41,19 @@ namespace sw
 			int textureSampleQuality;
 			int mipmapQuality;
 			bool perspectiveCorrection;
+			bool compressedTextureSampling;
 			int transcendentalPrecision;
 			int threadCount;
+			int tileSize;
+			int drawCallQueueSize;
+			bool asyncRoutineCompilation;
+			bool tieredRoutineCompilation;
 			bool enableSSE;
 			bool enableSSE2;
 			bool enableSSE3;
 			bool enableSSSE3;
 			bool enableSSE4_1;
+			bool enableAVX2;
 			rr::Optimization optimization[10];
 			bool disableServer;
 			bool keepSystemCursor;
@@ -1365,7 +1365,7 @@ namespace egl
 		return parentTexture == parent;
 	}
 
-	void Image::loadImageData(GLsizei width, GLsizei height, GLsizei depth, int inputPitch, int inputHeight, GLenum format, GLenum type, const void *input, void *buffer)
+	void Image::loadImageData(GLsizei width, GLsizei height, GLsizei depth, int inputPitch, int inputHeight, GLenum format, GLenum type, const void *input, void *buffer, int destPitch, int destSlice)
 	{
 		Rectangle rect;
 		rect.bytes = gl::ComputePixelSize(format, type);
@@ -1374,8 +1374,8 @@ namespace egl
 		rect.depth = depth;
 		rect.inputPitch = inputPitch;
 		rect.inputHeight = inputHeight;
-		rect.destPitch = getPitch();
-		rect.destSlice = getSlice();
+		rect.destPitch = destPitch;
+		rect.destSlice = destSlice;
 
 		// [OpenGL ES 3.0.5] table 3.2 and 3.3.
 		switch(format)
@@ -1723,14 +1723,30 @@ namespace egl
 		GLsizei inputHeight = (unpackParameters.imageHeight == 0) ? height : unpackParameters.imageHeight;
 		char *input = ((char*)pixels) + gl::ComputePackingOffset(format, type, inputWidth, inputHeight, unpackParameters);
 
-		void *buffer = lock(xoffset, yoffset, zoffset, sw::LOCK_WRITEONLY);
-
-		if(buffer)
+		// Store the data straight in the layout used for rendering and sampling when only the
+		// padding differs, instead of copying it twice and keeping both buffers resident.
+		if(canLoadInternal())
 		{
-			loadImageData(width, height, depth, inputPitch, inputHeight, format, type, input, buffer);
+			void *buffer = lockInternal(xoffset, yoffset, zoffset, sw::LOCK_WRITEONLY, sw::PUBLIC);
+
+			if(buffer)
+			{
+				loadImageData(width, height, depth, inputPitch, inputHeight, format, type, input, buffer, getInternalPitchB(), getInternalSliceB());
+			}
+
+			unlockInternal();
 		}
+		else
+		{
+			void *buffer = lock(xoffset, yoffset, zoffset, sw::LOCK_WRITEONLY);
 
-		unlock();
+			if(buffer)
+			{
+				loadImageData(width, height, depth, inputPitch, inputHeight, format, type, input, buffer, getPitch(), getSlice());
+			}
+
+			unlock();
+		}
 
 		if(hasStencil())
 		{
@@ -35,6 +35,7 @@
 #endif
 
 #include <algorithm>
+#include <vector>
 
 namespace gl
 {
@@ -320,6 +321,31 @@ void WindowSurface::swap()
 	}
 }
 
+void WindowSurface::swap(const EGLint *rects, EGLint count)
+{
+	if(count == 0)
+	{
+		return swap();
+	}
+
+	if(backBuffer && frameBuffer)
+	{
+		// Both use a bottom-left origin
+		std::vector<sw::Rect> damage(count);
+
+		for(EGLint i = 0; i < count; i++)
+		{
+			const EGLint *rect = &rects[4 * i];
+
+			damage[i] = sw::Rect(rect[0], rect[1], rect[0] + rect[2], rect[1] + rect[3]);
+		}
+
+		frameBuffer->flip(backBuffer, damage.data(), count);
+
+		checkForResize();
+	}
+}
+
 EGLNativeWindowType WindowSurface::getWindowHandle() const
 {
 	return window;
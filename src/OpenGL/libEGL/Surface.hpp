@@ -36,6 +36,7 @@ class Surface : public gl::Surface, public gl::Object
 public:
 	virtual bool initialize();
 	virtual void swap() = 0;
+	virtual void swap(const EGLint *rects, EGLint count) { swap(); }   // Damage as x, y, width, height quadruples
 
 	egl::Image *getRenderTarget() override;
 	egl::Image *getDepthStencil() override;
@@ -121,6 +122,7 @@ public:
 
 	bool isWindowSurface() const override { return true; }
 	void swap() override;
+	void swap(const EGLint *rects, EGLint count) override;
 
 	EGLNativeWindowType getWindowHandle() const override;
 
@@ -237,6 +237,8 @@ const char *QueryString(EGLDisplay dpy, EGLint name)
 		               "EGL_KHR_fence_sync "
 		               "EGL_KHR_image_base "
 		               "EGL_KHR_surfaceless_context "
+		               "EGL_KHR_swap_buffers_with_damage "
+		               "EGL_EXT_swap_buffers_with_damage "
 		               "EGL_ANGLE_iosurface_client_buffer "
 		               "EGL_ANDROID_framebuffer_target "
 		               "EGL_ANDROID_recordable");
@@ -1113,6 +1115,33 @@ EGLBoolean SwapBuffers(EGLDisplay dpy, EGLSurface surface)
 	return success(EGL_TRUE);
 }
 
+EGLBoolean SwapBuffersWithDamageKHR(EGLDisplay dpy, EGLSurface surface, EGLint *rects, EGLint n_rects)
+{
+	TRACE("(EGLDisplay dpy = %p, EGLSurface surface = %p, EGLint *rects = %p, EGLint n_rects = %d)", dpy, surface, rects, n_rects);
+
+	egl::Display *display = egl::Display::get(dpy);
+	egl::Surface *eglSurface = (egl::Surface*)surface;
+
+	if(!validateSurface(display, eglSurface))
+	{
+		return EGL_FALSE;
+	}
+
+	if(surface == EGL_NO_SURFACE)
+	{
+		return error(EGL_BAD_SURFACE, EGL_FALSE);
+	}
+
+	if(n_rects < 0 || (n_rects > 0 && !rects))
+	{
+		return error(EGL_BAD_PARAMETER, EGL_FALSE);
+	}
+
+	eglSurface->swap(rects, n_rects);
+
+	return success(EGL_TRUE);
+}
+
 EGLBoolean CopyBuffers(EGLDisplay dpy, EGLSurface surface, EGLNativePixmapType target)
 {
 	TRACE("(EGLDisplay dpy = %p, EGLSurface surface = %p, EGLNativePixmapType target = %p)", dpy, surface, target);
@@ -1511,6 +1540,8 @@ __eglMustCastToProperFunctionPointerType GetProcAddress(const char *procname)
 		FUNCTION(eglReleaseThread),
 		FUNCTION(eglSurfaceAttrib),
 		FUNCTION(eglSwapBuffers),
+		FUNCTION(eglSwapBuffersWithDamageEXT),
+		FUNCTION(eglSwapBuffersWithDamageKHR),
 		FUNCTION(eglSwapInterval),
 		FUNCTION(eglTerminate),
 		FUNCTION(eglWaitClient),
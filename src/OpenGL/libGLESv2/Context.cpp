@@ -41,6 +41,7 @@
 #include <EGL/eglext.h>
 
 #include <algorithm>
+#include <climits>
 #include <string>
 
 namespace es2
@@ -2996,11 +2997,11 @@ void Context::applyState(GLenum drawMode)
 	device->setRasterizerDiscard(mState.rasterizerDiscardEnabled);
 }
 
-GLenum Context::applyVertexBuffer(GLint base, GLint first, GLsizei count, GLsizei instanceId)
+GLenum Context::applyVertexBuffer(GLint base, GLint first, GLsizei count, GLsizei instanceCount)
 {
 	TranslatedAttribute attributes[MAX_VERTEX_ATTRIBS];
 
-	GLenum err = mVertexDataManager->prepareVertexData(first, count, attributes, instanceId);
+	GLenum err = mVertexDataManager->prepareVertexData(first, count, attributes, instanceCount);
 	if(err != GL_NO_ERROR)
 	{
 		return err;
@@ -3022,10 +3023,14 @@ GLenum Context::applyVertexBuffer(GLint base, GLint first, GLsizei count, GLsize
 
 		int stride = attributes[i].stride;
 
-		buffer = (char*)buffer + stride * base;
+		if(!attributes[i].divisor)
+		{
+			buffer = (char*)buffer + stride * base;
+		}
 
 		sw::Stream attribute(resource, buffer, stride);
 
+		attribute.divisor = attributes[i].divisor;
 		attribute.type = attributes[i].type;
 		attribute.count = attributes[i].count;
 		attribute.normalized = attributes[i].normalized;
@@ -3045,6 +3050,7 @@ GLenum Context::applyIndexBuffer(const void *indices, GLuint start, GLuint end,
 	if(err == GL_NO_ERROR)
 	{
 		device->setIndexBuffer(indexInfo->indexBuffer);
+		device->setIndexRange(indexInfo->minIndex, indexInfo->maxIndex);
 	}
 
 	return err;
@@ -3581,11 +3587,15 @@ void Context::drawArrays(GLenum mode, GLint first, GLsizei count, GLsizei instan
 
 	applyState(mode);
 
-	for(int i = 0; i < instanceCount; ++i)
+	// The renderer draws all instances in one call, unless their total primitive count overflows
+	int maxInstances = std::max(INT_MAX / std::max(primitiveCount, 1) / verticesPerPrimitive, 1);
+
+	for(int i = 0; i < instanceCount; i += maxInstances)
 	{
-		device->setInstanceID(i);
+		int instances = std::min(instanceCount - i, maxInstances);
+		device->setInstances(i, instances);
 
-		GLenum err = applyVertexBuffer(0, first, count, i);
+		GLenum err = applyVertexBuffer(0, first, count, i + instances);
 		if(err != GL_NO_ERROR)
 		{
 			return error(err);
@@ -3611,7 +3621,7 @@ void Context::drawArrays(GLenum mode, GLint first, GLsizei count, GLsizei instan
 		}
 		if(transformFeedback)
 		{
-			transformFeedback->addVertexOffset(primitiveCount * verticesPerPrimitive);
+			transformFeedback->addVertexOffset(primitiveCount * verticesPerPrimitive * instances);
 		}
 	}
 }
@@ -3669,12 +3679,16 @@ void Context::drawElements(GLenum mode, GLuint start, GLuint end, GLsizei count,
 
 	applyState(internalMode);
 
-	for(int i = 0; i < instanceCount; ++i)
+	// The renderer draws all instances in one call, unless their total primitive count overflows
+	int maxInstances = std::max(INT_MAX / std::max<int>(indexInfo.primitiveCount, 1) / verticesPerPrimitive, 1);
+
+	for(int i = 0; i < instanceCount; i += maxInstances)
 	{
-		device->setInstanceID(i);
+		int instances = std::min(instanceCount - i, maxInstances);
+		device->setInstances(i, instances);
 
 		GLsizei vertexCount = indexInfo.maxIndex - indexInfo.minIndex + 1;
-		err = applyVertexBuffer(-(int)indexInfo.minIndex, indexInfo.minIndex, vertexCount, i);
+		err = applyVertexBuffer(-(int)indexInfo.minIndex, indexInfo.minIndex, vertexCount, i + instances);
 		if(err != GL_NO_ERROR)
 		{
 			return error(err);
@@ -3700,7 +3714,7 @@ void Context::drawElements(GLenum mode, GLuint start, GLuint end, GLsizei count,
 		}
 		if(transformFeedback)
 		{
-			transformFeedback->addVertexOffset(indexInfo.primitiveCount * verticesPerPrimitive);
+			transformFeedback->addVertexOffset(indexInfo.primitiveCount * verticesPerPrimitive * instances);
 		}
 	}
 }
@@ -109,7 +109,7 @@ unsigned int VertexDataManager::writeAttributeData(StreamingVertexBuffer *vertex
 	return streamOffset;
 }
 
-GLenum VertexDataManager::prepareVertexData(GLint start, GLsizei count, TranslatedAttribute *translated, GLsizei instanceId)
+GLenum VertexDataManager::prepareVertexData(GLint start, GLsizei count, TranslatedAttribute *translated, GLsizei instanceCount)
 {
 	if(!mStreamingBuffer)
 	{
@@ -130,7 +130,8 @@ GLenum VertexDataManager::prepareVertexData(GLint start, GLsizei count, Translat
 			if(!attrib.mBoundBuffer)
 			{
 				const bool isInstanced = attrib.mDivisor > 0;
-				mStreamingBuffer->addRequiredSpace(attrib.typeSize() * (isInstanced ? 1 : count));
+				GLsizei elementCount = isInstanced ? (instanceCount + attrib.mDivisor - 1) / attrib.mDivisor : count;
+				mStreamingBuffer->addRequiredSpace(attrib.typeSize() * elementCount);
 			}
 		}
 	}
@@ -148,8 +149,9 @@ GLenum VertexDataManager::prepareVertexData(GLint start, GLsizei count, Translat
 			{
 				const bool isInstanced = attrib.mDivisor > 0;
 
-				// Instanced vertices do not apply the 'start' offset
-				GLint firstVertexIndex = isInstanced ? instanceId / attrib.mDivisor : start;
+				// Instanced vertices do not apply the 'start' offset, the vertex routine steps through them per instance
+				GLint firstVertexIndex = isInstanced ? 0 : start;
+				GLsizei elementCount = isInstanced ? (instanceCount + attrib.mDivisor - 1) / attrib.mDivisor : count;
 
 				Buffer *buffer = attrib.mBoundBuffer;
 
@@ -166,11 +168,11 @@ GLenum VertexDataManager::prepareVertexData(GLint start, GLsizei count, Translat
 				{
 					translated[i].vertexBuffer = staticBuffer;
 					translated[i].offset = firstVertexIndex * attrib.stride() + static_cast<int>(attrib.mOffset);
-					translated[i].stride = isInstanced ? 0 : attrib.stride();
+					translated[i].stride = attrib.stride();
 				}
 				else
 				{
-					unsigned int streamOffset = writeAttributeData(mStreamingBuffer, firstVertexIndex, isInstanced ? 1 : count, attrib);
+					unsigned int streamOffset = writeAttributeData(mStreamingBuffer, firstVertexIndex, elementCount, attrib);
 
 					if(streamOffset == ~0u)
 					{
@@ -179,9 +181,11 @@ GLenum VertexDataManager::prepareVertexData(GLint start, GLsizei count, Translat
 
 					translated[i].vertexBuffer = mStreamingBuffer->getResource();
 					translated[i].offset = streamOffset;
-					translated[i].stride = isInstanced ? 0 : attrib.typeSize();
+					translated[i].stride = attrib.typeSize();
 				}
 
+				translated[i].divisor = attrib.mDivisor;
+
 				switch(attrib.mType)
 				{
 				case GL_BYTE:           translated[i].type = sw::STREAMTYPE_SBYTE;  break;
@@ -227,6 +231,7 @@ GLenum VertexDataManager::prepareVertexData(GLint start, GLsizei count, Translat
 				}
 				translated[i].count = 4;
 				translated[i].stride = 0;
+				translated[i].divisor = 0;
 				translated[i].offset = 0;
 				translated[i].normalized = false;
 			}
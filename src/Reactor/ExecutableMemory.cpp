@@ -34,6 +34,8 @@
 #endif
 
 #include <memory.h>
+#include <mutex>
+#include <vector>
 
 #undef allocate
 #undef deallocate
@@ -82,7 +84,7 @@ void *allocateRaw(size_t bytes, size_t alignment)
 	#endif
 }
 
-#if defined(LINUX_ENABLE_NAMED_MMAP)
+#if defined(__linux__)
 // Create a file descriptor for anonymous memory with the given
 // name. Returns -1 on failure.
 // TODO: remove once libc wrapper exists.
@@ -107,7 +109,9 @@ int memfd_create(const char* name, unsigned int flags)
 		return -1;
 	#endif
 }
+#endif  // defined(__linux__)
 
+#if defined(LINUX_ENABLE_NAMED_MMAP)
 // Returns a file descriptor for use with an anonymous mmap, if
 // memfd_create fails, -1 is returned. Note, the mappings should be
 // MAP_PRIVATE so that underlying pages aren't shared.
@@ -183,7 +187,8 @@ inline uintptr_t roundUp(uintptr_t x, uintptr_t m)
 	return (x + m - 1) & ~(m - 1);
 }
 
-void *allocateExecutable(size_t bytes)
+// Maps readable and writable pages for a chunk of the code arena
+static void *mapPages(size_t bytes)
 {
 	size_t pageSize = memoryPageSize();
 	size_t length = roundUp(bytes, pageSize);
@@ -249,22 +254,87 @@ void *allocateExecutable(size_t bytes)
 	return mapping;
 }
 
-void markExecutable(void *memory, size_t bytes)
+static void protectPages(void *memory, size_t bytes, bool executable)
 {
 	#if defined(_WIN32)
 		unsigned long oldProtection;
-		VirtualProtect(memory, bytes, PAGE_EXECUTE_READ, &oldProtection);
+		VirtualProtect(memory, bytes, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &oldProtection);
 	#elif defined(__Fuchsia__)
 		zx_status_t status = zx_vmar_protect(
-			zx_vmar_root_self(), ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_EXECUTE,
+			zx_vmar_root_self(), ZX_VM_FLAG_PERM_READ | (executable ? ZX_VM_FLAG_PERM_EXECUTE : ZX_VM_FLAG_PERM_WRITE),
 			reinterpret_cast<zx_vaddr_t>(memory), bytes);
 	    ASSERT(status != ZX_OK);
 	#else
-		mprotect(memory, bytes, PROT_READ | PROT_EXEC);
+		mprotect(memory, bytes, executable ? (PROT_READ | PROT_EXEC) : (PROT_READ | PROT_WRITE));
 	#endif
 }
 
-void deallocateExecutable(void *memory, size_t bytes)
+// Maps the same pages twice, readable and writable at the returned address, and readable
+// and executable at |executable|. Returns null if the platform can't alias memory.
+static void *mapAliasedPages(size_t bytes, void *&executable)
+{
+	#if defined(_WIN32)
+		HANDLE mapping = CreateFileMapping(INVALID_HANDLE_VALUE, nullptr, PAGE_EXECUTE_READWRITE, 0, (DWORD)bytes, nullptr);
+		if(!mapping)
+		{
+			return nullptr;
+		}
+
+		void *writable = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, bytes);
+		executable = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, bytes);
+		CloseHandle(mapping);   // The views keep the pages alive
+
+		if(!writable || !executable)
+		{
+			if(writable) UnmapViewOfFile(writable);
+			if(executable) UnmapViewOfFile(executable);
+			return nullptr;
+		}
+
+		return writable;
+	#elif defined(__linux__)
+		int fd = memfd_create("SwiftShader JIT", 1 /* MFD_CLOEXEC */);
+		if(fd == -1)
+		{
+			return nullptr;
+		}
+
+		void *writable = MAP_FAILED;
+		executable = MAP_FAILED;
+
+		if(ftruncate(fd, bytes) == 0)
+		{
+			writable = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			executable = mmap(nullptr, bytes, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+		}
+
+		close(fd);   // The mappings keep the pages alive
+
+		if(writable == MAP_FAILED || executable == MAP_FAILED)
+		{
+			if(writable != MAP_FAILED) munmap(writable, bytes);
+			if(executable != MAP_FAILED) munmap(executable, bytes);
+			return nullptr;
+		}
+
+		return writable;
+	#else
+		return nullptr;
+	#endif
+}
+
+static void unmapAliasedPages(void *writable, void *executable, size_t bytes)
+{
+	#if defined(_WIN32)
+		UnmapViewOfFile(writable);
+		UnmapViewOfFile(executable);
+	#elif defined(__linux__)
+		munmap(writable, bytes);
+		munmap(executable, bytes);
+	#endif
+}
+
+static void unmapPages(void *memory, size_t bytes)
 {
 	#if defined(_WIN32)
 		unsigned long oldProtection;
@@ -282,4 +352,374 @@ void deallocateExecutable(void *memory, size_t bytes)
 		deallocate(memory);
 	#endif
 }
+
+namespace
+{
+// Sub-allocates routine code from large chunks of pages, so small routines don't each
+// need a mapping of their own. Pages stay either writable or executable. Freed pages
+// are only made writable again when they get reused.
+class CodeArena
+{
+public:
+	void *allocate(size_t bytes);
+	void deallocate(void *memory, size_t bytes);
+
+	ExecutableMemoryUsage getUsage();
+
+private:
+	enum PageState : unsigned char
+	{
+		PAGE_FRESH,   // Writable, never used
+		PAGE_USED,
+		PAGE_FREED,   // Possibly still executable
+	};
+
+	struct Chunk
+	{
+		unsigned char *base;
+		size_t pageCount;
+		size_t usedPages;
+		std::vector<PageState> pages;
+	};
+
+	enum
+	{
+		CHUNK_PAGES = 256,   // 1 MiB with 4 kiB pages
+	};
+
+	std::mutex mutex;
+	std::vector<Chunk> chunks;
+	ExecutableMemoryUsage usage = {};
+};
+
+void *CodeArena::allocate(size_t bytes)
+{
+	size_t pageSize = memoryPageSize();
+	size_t count = roundUp(bytes, pageSize) / pageSize;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for(Chunk &chunk : chunks)
+	{
+		if(chunk.pageCount - chunk.usedPages < count)
+		{
+			continue;
+		}
+
+		// First fit
+		size_t run = 0;
+
+		for(size_t page = 0; page < chunk.pageCount; page++)
+		{
+			run = (chunk.pages[page] == PAGE_USED) ? 0 : run + 1;
+
+			if(run == count)
+			{
+				size_t first = page + 1 - count;
+				bool recycled = false;
+
+				for(size_t i = first; i <= page; i++)
+				{
+					recycled |= (chunk.pages[i] == PAGE_FREED);
+					chunk.pages[i] = PAGE_USED;
+				}
+
+				unsigned char *memory = chunk.base + first * pageSize;
+
+				if(recycled)
+				{
+					protectPages(memory, count * pageSize, false);
+				}
+
+				chunk.usedPages += count;
+				usage.used += count * pageSize;
+				usage.allocations++;
+
+				return memory;
+			}
+		}
+	}
+
+	Chunk chunk;
+	chunk.pageCount = count > CHUNK_PAGES ? count : CHUNK_PAGES;
+	chunk.base = (unsigned char*)mapPages(chunk.pageCount * pageSize);
+
+	if(!chunk.base)
+	{
+		return nullptr;
+	}
+
+	chunk.usedPages = count;
+	chunk.pages.assign(chunk.pageCount, PAGE_FRESH);
+
+	for(size_t i = 0; i < count; i++)
+	{
+		chunk.pages[i] = PAGE_USED;
+	}
+
+	chunks.push_back(chunk);
+
+	usage.reserved += chunk.pageCount * pageSize;
+	usage.used += count * pageSize;
+	usage.allocations++;
+
+	return chunk.base;
+}
+
+void CodeArena::deallocate(void *memory, size_t bytes)
+{
+	size_t pageSize = memoryPageSize();
+	size_t count = roundUp(bytes, pageSize) / pageSize;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for(size_t c = 0; c < chunks.size(); c++)
+	{
+		Chunk &chunk = chunks[c];
+
+		if(memory < chunk.base || memory >= chunk.base + chunk.pageCount * pageSize)
+		{
+			continue;
+		}
+
+		size_t first = ((unsigned char*)memory - chunk.base) / pageSize;
+
+		for(size_t i = first; i < first + count; i++)
+		{
+			ASSERT(chunk.pages[i] == PAGE_USED);
+			chunk.pages[i] = PAGE_FREED;
+		}
+
+		chunk.usedPages -= count;
+		usage.used -= count * pageSize;
+		usage.allocations--;
+
+		// Return empty chunks to the system, but keep one around for new routines
+		if(chunk.usedPages == 0 && (chunks.size() > 1 || chunk.pageCount > CHUNK_PAGES))
+		{
+			unmapPages(chunk.base, chunk.pageCount * pageSize);
+			usage.reserved -= chunk.pageCount * pageSize;
+			chunks.erase(chunks.begin() + c);
+		}
+
+		return;
+	}
+
+	ASSERT(false);   // Not allocated by the arena
+}
+
+ExecutableMemoryUsage CodeArena::getUsage()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return usage;
+}
+
+// Packs the code of routines into pages shared with other routines, at cache line
+// granularity. Each chunk is mapped twice, so code is written through one mapping
+// while other routines keep executing from the other. Neither mapping is both
+// writable and executable.
+class SharedCodeArena
+{
+public:
+	void *allocate(size_t bytes, size_t alignment, void *&writable);
+	void deallocate(void *executable, size_t bytes);
+
+	ExecutableMemoryUsage getUsage();
+
+private:
+	struct Chunk
+	{
+		unsigned char *writable;
+		unsigned char *executable;
+		size_t unitCount;
+		size_t usedUnits;
+		std::vector<bool> used;
+	};
+
+	enum
+	{
+		UNIT_SIZE = 64,
+		CHUNK_SIZE = 1 << 20,
+	};
+
+	std::mutex mutex;
+	std::vector<Chunk> chunks;
+	bool unsupported = false;   // Set when the platform can't alias pages
+	ExecutableMemoryUsage usage = {};
+};
+
+void *SharedCodeArena::allocate(size_t bytes, size_t alignment, void *&writable)
+{
+	if(alignment > UNIT_SIZE || bytes == 0)
+	{
+		return nullptr;
+	}
+
+	size_t count = roundUp(bytes, UNIT_SIZE) / UNIT_SIZE;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for(Chunk &chunk : chunks)
+	{
+		if(chunk.unitCount - chunk.usedUnits < count)
+		{
+			continue;
+		}
+
+		// First fit
+		size_t run = 0;
+
+		for(size_t unit = 0; unit < chunk.unitCount; unit++)
+		{
+			run = chunk.used[unit] ? 0 : run + 1;
+
+			if(run == count)
+			{
+				size_t first = unit + 1 - count;
+
+				for(size_t i = first; i <= unit; i++)
+				{
+					chunk.used[i] = true;
+				}
+
+				chunk.usedUnits += count;
+				usage.used += count * UNIT_SIZE;
+				usage.allocations++;
+
+				writable = chunk.writable + first * UNIT_SIZE;
+				return chunk.executable + first * UNIT_SIZE;
+			}
+		}
+	}
+
+	if(unsupported)
+	{
+		return nullptr;
+	}
+
+	Chunk chunk;
+	size_t size = roundUp(count * UNIT_SIZE > CHUNK_SIZE ? count * UNIT_SIZE : CHUNK_SIZE, memoryPageSize());
+	void *executable = nullptr;
+	chunk.writable = (unsigned char*)mapAliasedPages(size, executable);
+	chunk.executable = (unsigned char*)executable;
+
+	if(!chunk.writable)
+	{
+		unsupported = chunks.empty();   // Don't retry on every routine
+		return nullptr;
+	}
+
+	chunk.unitCount = size / UNIT_SIZE;
+	chunk.usedUnits = count;
+	chunk.used.assign(chunk.unitCount, false);
+
+	for(size_t i = 0; i < count; i++)
+	{
+		chunk.used[i] = true;
+	}
+
+	chunks.push_back(std::move(chunk));
+
+	usage.reserved += size;
+	usage.used += count * UNIT_SIZE;
+	usage.allocations++;
+
+	writable = chunks.back().writable;
+	return chunks.back().executable;
+}
+
+void SharedCodeArena::deallocate(void *executable, size_t bytes)
+{
+	size_t count = roundUp(bytes, UNIT_SIZE) / UNIT_SIZE;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for(size_t c = 0; c < chunks.size(); c++)
+	{
+		Chunk &chunk = chunks[c];
+
+		if(executable < chunk.executable || executable >= chunk.executable + chunk.unitCount * UNIT_SIZE)
+		{
+			continue;
+		}
+
+		size_t first = ((unsigned char*)executable - chunk.executable) / UNIT_SIZE;
+
+		for(size_t i = first; i < first + count; i++)
+		{
+			ASSERT(chunk.used[i]);
+			chunk.used[i] = false;
+		}
+
+		chunk.usedUnits -= count;
+		usage.used -= count * UNIT_SIZE;
+		usage.allocations--;
+
+		// Return empty chunks to the system, but keep one around for new routines
+		if(chunk.usedUnits == 0 && (chunks.size() > 1 || chunk.unitCount * UNIT_SIZE > CHUNK_SIZE))
+		{
+			unmapAliasedPages(chunk.writable, chunk.executable, chunk.unitCount * UNIT_SIZE);
+			usage.reserved -= chunk.unitCount * UNIT_SIZE;
+			chunks.erase(chunks.begin() + c);
+		}
+
+		return;
+	}
+
+	ASSERT(false);   // Not allocated by the arena
+}
+
+ExecutableMemoryUsage SharedCodeArena::getUsage()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return usage;
+}
+
+SharedCodeArena &sharedCodeArena()
+{
+	static SharedCodeArena *arena = new SharedCodeArena();   // Routines may outlive static destructors
+	return *arena;
+}
+
+CodeArena &codeArena()
+{
+	static CodeArena *arena = new CodeArena();   // Routines may outlive static destructors
+	return *arena;
+}
+}  // anonymous namespace
+
+void *allocateExecutable(size_t bytes)
+{
+	return codeArena().allocate(bytes);
+}
+
+void markExecutable(void *memory, size_t bytes)
+{
+	protectPages(memory, bytes, true);
+}
+
+void deallocateExecutable(void *memory, size_t bytes)
+{
+	codeArena().deallocate(memory, bytes);
+}
+
+void *allocateSharedCode(size_t bytes, size_t alignment, void *&writable)
+{
+	return sharedCodeArena().allocate(bytes, alignment, writable);
+}
+
+void deallocateSharedCode(void *executable, size_t bytes)
+{
+	sharedCodeArena().deallocate(executable, bytes);
+}
+
+ExecutableMemoryUsage executableMemoryUsage()
+{
+	ExecutableMemoryUsage pages = codeArena().getUsage();
+	ExecutableMemoryUsage shared = sharedCodeArena().getUsage();
+
+	return {pages.reserved + shared.reserved, pages.used + shared.used, pages.allocations + shared.allocations};
+}
 }
@@ -23,10 +23,26 @@ namespace rr
 {
 size_t memoryPageSize();
 
+// Executable memory is sub-allocated in whole pages from a shared arena
 void *allocateExecutable(size_t bytes);   // Allocates memory that can be made executable using markExecutable()
 void markExecutable(void *memory, size_t bytes);
 void deallocateExecutable(void *memory, size_t bytes);
 
+// Allocates executable memory which shares pages with other routines. It is written through
+// the |writable| alias of the returned address. Returns null if the platform doesn't support
+// aliased mappings, or the alignment exceeds a cache line.
+void *allocateSharedCode(size_t bytes, size_t alignment, void *&writable);
+void deallocateSharedCode(void *executable, size_t bytes);
+
+struct ExecutableMemoryUsage
+{
+	size_t reserved;      // Bytes mapped by the arena
+	size_t used;          // Bytes of pages handed out
+	size_t allocations;
+};
+
+ExecutableMemoryUsage executableMemoryUsage();
+
 template<typename P>
 P unaligned_read(P *address)
 {
@@ -47,12 +47,12 @@
 	#include "llvm/Analysis/LoopPass.h"
 	#include "llvm/ExecutionEngine/ExecutionEngine.h"
 	#include "llvm/ExecutionEngine/JITSymbol.h"
+	#include "llvm/ExecutionEngine/ObjectCache.h"
 	#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 	#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 	#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
 	#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 	#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
-	#include "llvm/ExecutionEngine/SectionMemoryManager.h"
 	#include "llvm/IR/Constants.h"
 	#include "llvm/IR/DataLayout.h"
 	#include "llvm/IR/Function.h"
@@ -64,6 +64,7 @@
 	#include "llvm/IR/Mangler.h"
 	#include "llvm/IR/Module.h"
 	#include "llvm/Support/Error.h"
+	#include "llvm/Support/Memory.h"
 	#include "llvm/Support/TargetSelect.h"
 	#include "llvm/Target/TargetOptions.h"
 	#include "llvm/Transforms/InstCombine/InstCombine.h"
@@ -79,8 +80,11 @@
 	#include <unordered_map>
 #endif
 
+#include <atomic>
+#include <mutex>
 #include <numeric>
 #include <fstream>
+#include <cstring>
 
 #if defined(__i386__) || defined(__x86_64__)
 #include <xmmintrin.h>
@@ -118,13 +122,34 @@ namespace rr
 
 namespace
 {
-	rr::LLVMReactorJIT *reactorJIT = nullptr;
-	llvm::IRBuilder<> *builder = nullptr;
-	llvm::LLVMContext *context = nullptr;
-	llvm::Module *module = nullptr;
-	llvm::Function *function = nullptr;
+	// State of the routine being built by the current thread
+	thread_local rr::LLVMReactorJIT *reactorJIT = nullptr;
+	thread_local llvm::IRBuilder<> *builder = nullptr;
+	thread_local llvm::LLVMContext *context = nullptr;
+	thread_local llvm::Module *module = nullptr;
+	thread_local llvm::Function *function = nullptr;
+
+	// A JIT together with the context its IR is built in. Each one is
+	// used by a single Nucleus at a time, so routines can be compiled
+	// concurrently on different threads.
+	struct JITSession
+	{
+		rr::LLVMReactorJIT *reactorJIT;
+		llvm::LLVMContext *context;
+		llvm::IRBuilder<> *builder;
+	};
+
+	thread_local JITSession *jitSession = nullptr;
+	std::vector<JITSession*> idleSessions;
+	rr::MutexLock sessionPoolMutex;
 
-	rr::MutexLock codegenMutex;
+	// Sessions beyond this many are destroyed when their Nucleus ends, instead
+	// of lingering in the pool after a burst of concurrent compilation.
+	const size_t maxIdleSessions = 4;
+
+#if REACTOR_LLVM_VERSION < 7
+	rr::MutexLock codegenMutex;   // The legacy JIT is not thread safe
+#endif
 
 #if REACTOR_LLVM_VERSION >= 7
 	llvm::Value *lowerPAVG(llvm::Value *x, llvm::Value *y)
@@ -556,6 +581,214 @@ namespace rr
 		}
 	};
 
+	// Allocates all sections of a compiled module from one arena allocation. Code and
+	// read-only data get packed into pages shared with other modules, and are written
+	// through a writable alias of them. Where aliasing isn't supported they get pages
+	// of their own, made executable with a single protection change. Writable data
+	// always gets pages of its own.
+	class ArenaMemoryManager : public llvm::RTDyldMemoryManager
+	{
+	public:
+		~ArenaMemoryManager() override
+		{
+			if(shared.executable)
+			{
+				deallocateSharedCode(shared.executable, shared.size);
+			}
+
+			for(const Block &block : blocks)
+			{
+				deallocateExecutable(block.memory, block.size);
+			}
+		}
+
+		bool needsToReserveAllocationSpace() override
+		{
+			return true;
+		}
+
+		void reserveAllocationSpace(uintptr_t codeSize, uint32_t codeAlign,
+		                            uintptr_t roDataSize, uint32_t roDataAlign,
+		                            uintptr_t rwDataSize, uint32_t rwDataAlign) override
+		{
+			size_t readOnlySize = alignUp(codeSize, roDataAlign) + roDataSize;
+
+			if(readOnlySize > 0)
+			{
+				void *alias = nullptr;
+				shared.executable = static_cast<uint8_t*>(allocateSharedCode(readOnlySize, std::max(codeAlign, roDataAlign), alias));
+
+				if(shared.executable)
+				{
+					shared.writable = static_cast<uint8_t*>(alias);
+					shared.size = readOnlySize;
+					readOnly = {shared.writable, shared.writable + readOnlySize};
+
+					if(rwDataSize > 0)
+					{
+						reserveWritable(rwDataSize);
+					}
+
+					return;
+				}
+			}
+
+			size_t readOnlyPages = alignUp(readOnlySize, memoryPageSize());
+			size_t size = readOnlyPages + alignUp(rwDataSize, memoryPageSize());
+
+			if(size == 0)
+			{
+				return;
+			}
+
+			uint8_t *memory = static_cast<uint8_t*>(allocateExecutable(size));
+
+			if(!memory)
+			{
+				return;   // Sections get allocated individually
+			}
+
+			blocks.push_back({memory, size, readOnlyPages});
+			readOnly = {memory, memory + readOnlySize};
+			writable = {memory + readOnlyPages, memory + readOnlyPages + rwDataSize};
+		}
+
+		uint8_t *allocateCodeSection(uintptr_t size, unsigned alignment, unsigned sectionID, llvm::StringRef sectionName) override
+		{
+			return allocate(readOnly, size, alignment, true);
+		}
+
+		uint8_t *allocateDataSection(uintptr_t size, unsigned alignment, unsigned sectionID, llvm::StringRef sectionName, bool isReadOnly) override
+		{
+			return isReadOnly ? allocate(readOnly, size, alignment, true) : allocate(writable, size, alignment, false);
+		}
+
+		void notifyObjectLoaded(llvm::RuntimeDyld &dyld, const llvm::object::ObjectFile &object) override
+		{
+			// Sections in shared pages were written through the writable alias, but run from the executable one.
+			// Sections are never empty, so their addresses are distinct.
+			for(uint8_t *section : sharedSections)
+			{
+				dyld.mapSectionAddress(section, reinterpret_cast<uintptr_t>(shared.executable + (section - shared.writable)));
+			}
+		}
+
+		bool finalizeMemory(std::string *errorMessage) override
+		{
+			if(shared.executable)
+			{
+				llvm::sys::Memory::InvalidateInstructionCache(shared.executable, shared.size);
+			}
+
+			for(const Block &block : blocks)
+			{
+				if(block.executableSize > 0)
+				{
+					llvm::sys::Memory::InvalidateInstructionCache(block.memory, block.executableSize);
+					markExecutable(block.memory, block.executableSize);
+				}
+			}
+
+			return false;   // No error
+		}
+
+	private:
+		struct Block
+		{
+			uint8_t *memory;
+			size_t size;
+			size_t executableSize;   // Leading bytes which hold code and read-only data
+		};
+
+		struct Region
+		{
+			uint8_t *next;
+			uint8_t *end;
+		};
+
+		struct SharedBlock
+		{
+			uint8_t *executable;
+			uint8_t *writable;
+			size_t size;
+		};
+
+		void reserveWritable(size_t size)
+		{
+			size = alignUp(size, memoryPageSize());
+			uint8_t *memory = static_cast<uint8_t*>(allocateExecutable(size));
+
+			if(memory)
+			{
+				blocks.push_back({memory, size, 0});
+				writable = {memory, memory + size};
+			}
+		}
+
+		static size_t alignUp(size_t size, size_t alignment)
+		{
+			alignment = alignment ? alignment : 1;
+			return (size + alignment - 1) & ~(alignment - 1);
+		}
+
+		uint8_t *allocate(Region &region, size_t size, size_t alignment, bool executable)
+		{
+			if(region.next)
+			{
+				uint8_t *memory = region.next + (alignUp((uintptr_t)region.next, alignment) - (uintptr_t)region.next);
+
+				if(memory + size <= region.end)
+				{
+					region.next = memory + size;
+
+					if(&region == &readOnly && shared.executable)
+					{
+						sharedSections.push_back(memory);
+					}
+
+					return memory;
+				}
+			}
+
+			// Doesn't fit the reservation, so it gets pages of its own
+			size_t length = alignUp(size, memoryPageSize());
+			uint8_t *memory = static_cast<uint8_t*>(allocateExecutable(length));
+
+			if(memory)
+			{
+				blocks.push_back({memory, length, executable ? length : 0});
+			}
+
+			return memory;
+		}
+
+		std::vector<Block> blocks;
+		SharedBlock shared = {};
+		std::vector<uint8_t*> sharedSections;   // Within the writable alias
+		Region readOnly = {};
+		Region writable = {};
+	};
+
+	// Captures the object file of each compiled module, for persistent caching
+	class ObjectCodeCapture : public llvm::ObjectCache
+	{
+	public:
+		void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) override
+		{
+			if(RetainObjectCodeScope::active())
+			{
+				objectCode.assign(object.getBufferStart(), object.getBufferEnd());
+			}
+		}
+
+		std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override
+		{
+			return nullptr;   // Cached routines are linked directly by loadRoutine()
+		}
+
+		std::vector<uint8_t> objectCode;
+	};
+
 	class LLVMReactorJIT
 	{
 	private:
@@ -567,9 +800,12 @@ namespace rr
 		std::shared_ptr<llvm::orc::SymbolResolver> resolver;
 		std::unique_ptr<llvm::TargetMachine> targetMachine;
 		const llvm::DataLayout dataLayout;
+		ObjectCodeCapture objectCodeCapture;
 		ObjLayer objLayer;
 		CompileLayer compileLayer;
 		size_t emittedFunctionsNum;
+		std::mutex mutex;   // Routines may be released on any thread
+		std::atomic<int> references;   // Held by the session and by each live routine
 
 	public:
 		LLVMReactorJIT(const char *arch, const llvm::SmallVectorImpl<std::string>& mattrs,
@@ -603,14 +839,25 @@ namespace rr
 				session,
 				[this](llvm::orc::VModuleKey) {
 					return ObjLayer::Resources{
-						std::make_shared<llvm::SectionMemoryManager>(),
+						std::make_shared<ArenaMemoryManager>(),
 						resolver};
 				}),
-			compileLayer(objLayer, llvm::orc::SimpleCompiler(*targetMachine)),
-			emittedFunctionsNum(0)
+			compileLayer(objLayer, llvm::orc::SimpleCompiler(*targetMachine, &objectCodeCapture)),
+			emittedFunctionsNum(0),
+			references(1)
 		{
 		}
 
+		// Drops a reference. The JIT owns the code of its routines, so it is
+		// only deleted once its session has ended and all of them are released.
+		void release()
+		{
+			if(--references == 0)
+			{
+				delete this;
+			}
+		}
+
 		void startSession()
 		{
 			::module = new llvm::Module("", *::context);
@@ -618,12 +865,17 @@ namespace rr
 
 		void endSession()
 		{
+			delete ::module;   // Only still owned if no routine was acquired
+
 			::function = nullptr;
 			::module = nullptr;
 		}
 
-		LLVMRoutine *acquireRoutine(llvm::Function *func)
+		LLVMRoutine *acquireRoutine(llvm::Function *func, bool optimize)
 		{
+			// Instruction selection and register allocation dominate the compile time
+			targetMachine->setOptLevel(optimize ? llvm::CodeGenOpt::Default : llvm::CodeGenOpt::None);
+
 			std::string name = "f" + llvm::Twine(emittedFunctionsNum++).str();
 			func->setName(name);
 			func->setLinkage(llvm::GlobalValue::ExternalLinkage);
@@ -633,6 +885,8 @@ namespace rr
 			::module = nullptr;
 			mod->setDataLayout(dataLayout);
 
+			std::lock_guard<std::mutex> lock(mutex);
+
 			auto moduleKey = session.allocateVModule();
 			llvm::cantFail(compileLayer.addModule(moduleKey, std::move(mod)));
 
@@ -650,8 +904,70 @@ namespace rr
 				return nullptr;
 			}
 
+			std::vector<uint8_t> objectCode;
+
+			if(!objectCodeCapture.objectCode.empty())
+			{
+				objectCode.assign(mangledName.begin(), mangledName.end());
+				objectCode.push_back('\0');
+				objectCode.insert(objectCode.end(), objectCodeCapture.objectCode.begin(), objectCodeCapture.objectCode.end());
+				objectCodeCapture.objectCode.clear();
+			}
+
+			void *addr = reinterpret_cast<void *>(static_cast<intptr_t>(expectAddr.get()));
+			references++;
+			return new LLVMRoutine(addr, releaseRoutineCallback, this, moduleKey, std::move(objectCode));
+		}
+
+		LLVMRoutine *loadRoutine(const void *objectCode, size_t size)
+		{
+			const char *mangledName = static_cast<const char*>(objectCode);
+			size_t nameLength = strnlen(mangledName, size);
+
+			if(nameLength == 0 || nameLength == size)
+			{
+				return nullptr;   // Malformed
+			}
+
+			llvm::StringRef object(mangledName + nameLength + 1, size - nameLength - 1);
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto moduleKey = session.allocateVModule();
+
+			if(llvm::Error error = objLayer.addObject(moduleKey, llvm::MemoryBuffer::getMemBufferCopy(object)))
+			{
+				llvm::consumeError(std::move(error));
+				return nullptr;
+			}
+
+			llvm::JITSymbol symbol = objLayer.findSymbolIn(moduleKey, mangledName, false);
+
+			if(!symbol)
+			{
+				llvm::cantFail(objLayer.removeObject(moduleKey));
+				return nullptr;
+			}
+
+			llvm::Expected<llvm::JITTargetAddress> expectAddr = symbol.getAddress();
+
+			if(!expectAddr)
+			{
+				llvm::consumeError(expectAddr.takeError());
+				llvm::cantFail(objLayer.removeObject(moduleKey));
+				return nullptr;
+			}
+
+			std::vector<uint8_t> retainedCode;
+
+			if(RetainObjectCodeScope::active())
+			{
+				retainedCode.assign(mangledName, mangledName + size);
+			}
+
 			void *addr = reinterpret_cast<void *>(static_cast<intptr_t>(expectAddr.get()));
-			return new LLVMRoutine(addr, releaseRoutineCallback, this, moduleKey);
+			references++;
+			return new LLVMRoutine(addr, releaseRoutineCallback, this, moduleKey, std::move(retainedCode));
 		}
 
 		void optimize(llvm::Module *module)
@@ -686,17 +1002,43 @@ namespace rr
 	private:
 		void releaseRoutineModule(llvm::orc::VModuleKey moduleKey)
 		{
+			std::lock_guard<std::mutex> lock(mutex);
 			llvm::cantFail(compileLayer.removeModule(moduleKey));
 		}
 
 		static void releaseRoutineCallback(LLVMReactorJIT *jit, uint64_t moduleKey)
 		{
 			jit->releaseRoutineModule(moduleKey);
+			jit->release();
 		}
 	};
 #endif
 
 	Optimization optimization[10] = {InstructionCombining, Disabled};
+	std::atomic<bool> retainObjectCode(false);
+
+	static thread_local int retainObjectCodeScopes = 0;
+
+	RetainObjectCodeScope::RetainObjectCodeScope(bool retain) : retain(retain)
+	{
+		if(retain)
+		{
+			retainObjectCodeScopes++;
+		}
+	}
+
+	RetainObjectCodeScope::~RetainObjectCodeScope()
+	{
+		if(retain)
+		{
+			retainObjectCodeScopes--;
+		}
+	}
+
+	bool RetainObjectCodeScope::active()
+	{
+		return retainObjectCode || retainObjectCodeScopes > 0;
+	}
 
 	enum EmulatedType
 	{
@@ -805,21 +1147,19 @@ namespace rr
 		return llvm::cast<llvm::VectorType>(T(type))->getNumElements();
 	}
 
-	Nucleus::Nucleus()
+	// Checks a session out of the pool, or creates one. It's used by one thread at a time.
+	static JITSession *acquireJITSession()
 	{
-		::codegenMutex.lock();   // Reactor and LLVM are currently not thread safe
-
-		llvm::InitializeNativeTarget();
+		static std::once_flag targetInitialized;
+		std::call_once(targetInitialized, []()
+		{
+			llvm::InitializeNativeTarget();
 
 #if REACTOR_LLVM_VERSION >= 7
-		llvm::InitializeNativeTargetAsmPrinter();
-		llvm::InitializeNativeTargetAsmParser();
+			llvm::InitializeNativeTargetAsmPrinter();
+			llvm::InitializeNativeTargetAsmParser();
 #endif
-
-		if(!::context)
-		{
-			::context = new llvm::LLVMContext();
-		}
+		});
 
 		#if defined(__x86_64__)
 			static const char arch[] = "x86-64";
@@ -873,20 +1213,26 @@ namespace rr
 		// targetOpts.NoNaNsFPMath = true;
 #endif
 
-		if(!::reactorJIT)
+		JITSession *session = nullptr;
+
+		::sessionPoolMutex.lock();
+		if(!::idleSessions.empty())
 		{
-#if REACTOR_LLVM_VERSION < 7
-			::reactorJIT = new LLVMReactorJIT(arch, mattrs);
-#else
-			::reactorJIT = new LLVMReactorJIT(arch, mattrs, targetOpts);
-#endif
+			session = ::idleSessions.back();
+			::idleSessions.pop_back();
 		}
+		::sessionPoolMutex.unlock();
 
-		::reactorJIT->startSession();
-
-		if(!::builder)
+		if(!session)
 		{
-			::builder = new llvm::IRBuilder<>(*::context);
+			session = new JITSession;
+			session->context = new llvm::LLVMContext();
+#if REACTOR_LLVM_VERSION < 7
+			session->reactorJIT = new LLVMReactorJIT(arch, mattrs);
+#else
+			session->reactorJIT = new LLVMReactorJIT(arch, mattrs, targetOpts);
+#endif
+			session->builder = new llvm::IRBuilder<>(*session->context);
 
 			#if defined(_WIN32) && REACTOR_LLVM_VERSION < 7
 				HMODULE CodeAnalyst = LoadLibrary("CAJitNtfyLib.dll");
@@ -900,13 +1246,64 @@ namespace rr
 				}
 			#endif
 		}
+
+		return session;
+	}
+
+	static void releaseJITSession(JITSession *session)
+	{
+		::sessionPoolMutex.lock();
+		bool pooled = ::idleSessions.size() < maxIdleSessions;
+		if(pooled)
+		{
+			::idleSessions.push_back(session);
+		}
+		::sessionPoolMutex.unlock();
+
+		if(!pooled)
+		{
+			// Routines no longer reference the IR once compiled, so only the JIT
+			// has to outlive the session
+			delete session->builder;
+			delete session->context;
+#if REACTOR_LLVM_VERSION < 7
+			delete session->reactorJIT;
+#else
+			session->reactorJIT->release();
+#endif
+			delete session;
+		}
+	}
+
+	Nucleus::Nucleus()
+	{
+#if REACTOR_LLVM_VERSION < 7
+		::codegenMutex.lock();
+#endif
+
+		::jitSession = acquireJITSession();
+
+		::reactorJIT = ::jitSession->reactorJIT;
+		::context = ::jitSession->context;
+		::builder = ::jitSession->builder;
+
+		::reactorJIT->startSession();
 	}
 
 	Nucleus::~Nucleus()
 	{
 		::reactorJIT->endSession();
 
+		::reactorJIT = nullptr;
+		::context = nullptr;
+		::builder = nullptr;
+
+		releaseJITSession(::jitSession);
+		::jitSession = nullptr;
+
+#if REACTOR_LLVM_VERSION < 7
 		::codegenMutex.unlock();
+#endif
 	}
 
 	Routine *Nucleus::acquireRoutine(const wchar_t *name, bool runOptimizations)
@@ -952,7 +1349,16 @@ namespace rr
 			::module->print(file, 0);
 		}
 
+#if REACTOR_LLVM_VERSION < 7
 		LLVMRoutine *routine = ::reactorJIT->acquireRoutine(::function);
+#else
+		LLVMRoutine *routine = ::reactorJIT->acquireRoutine(::function, runOptimizations);
+#endif
+
+		if(routine)
+		{
+			routine->optimized = runOptimizations;
+		}
 
 #if defined(_WIN32) && REACTOR_LLVM_VERSION < 7
 		if(CodeAnalystLogJITCode)
@@ -964,6 +1370,29 @@ namespace rr
 		return routine;
 	}
 
+	bool Nucleus::hasFastUnoptimizedTier()
+	{
+		#if REACTOR_LLVM_VERSION < 7
+			return false;   // The legacy JIT always generates code at its aggressive level
+		#else
+			return true;   // Instruction selection and register allocation at CodeGenOpt::None
+		#endif
+	}
+
+	Routine *Nucleus::loadRoutine(const void *objectCode, size_t size)
+	{
+#if REACTOR_LLVM_VERSION < 7
+		return nullptr;   // Not supported by the legacy JIT
+#else
+		// Linking doesn't build IR, so this leaves the state of any Nucleus on this thread alone
+		JITSession *session = acquireJITSession();
+		Routine *routine = session->reactorJIT->loadRoutine(objectCode, size);
+		releaseJITSession(session);
+
+		return routine;
+#endif
+	}
+
 	void Nucleus::optimize()
 	{
 		::reactorJIT->optimize(::module);
@@ -18,6 +18,7 @@
 #include "Routine.hpp"
 
 #include <cstdint>
+#include <vector>
 
 namespace rr
 {
@@ -58,8 +59,8 @@ namespace rr
 	{
 	public:
 		LLVMRoutine(void *ent, void (*callback)(LLVMReactorJIT *, uint64_t),
-		            LLVMReactorJIT *jit, uint64_t key)
-			: entry(ent), dtor(callback), reactorJIT(jit), moduleKey(key)
+		            LLVMReactorJIT *jit, uint64_t key, std::vector<uint8_t> &&object)
+			: entry(ent), dtor(callback), reactorJIT(jit), moduleKey(key), objectCode(std::move(object))
 		{ }
 
 		virtual ~LLVMRoutine();
@@ -69,12 +70,20 @@ namespace rr
 			return entry;
 		}
 
+		const void *getObjectCode(size_t &size)
+		{
+			size = objectCode.size();
+			return size ? objectCode.data() : nullptr;
+		}
+
 	private:
 		const void *entry;
 
 		void (*dtor)(LLVMReactorJIT *, uint64_t);
 		LLVMReactorJIT *reactorJIT;
 		uint64_t moduleKey;
+
+		std::vector<uint8_t> objectCode;   // Entry symbol name, null terminated, followed by the object file
 	};
 #endif  // REACTOR_LLVM_VERSION < 7
 }
@@ -15,8 +15,10 @@
 #ifndef rr_Nucleus_hpp
 #define rr_Nucleus_hpp
 
+#include <atomic>
 #include <cassert>
 #include <cstdarg>
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -45,6 +47,21 @@ namespace rr
 	};
 
 	extern Optimization optimization[10];
+	extern std::atomic<bool> retainObjectCode;   // Keep relocatable code of new routines, see Routine::getObjectCode()
+
+	// Keeps the relocatable code of the routines this thread generates while in scope,
+	// independent of retainObjectCode
+	class RetainObjectCodeScope
+	{
+	public:
+		explicit RetainObjectCodeScope(bool retain = true);
+		~RetainObjectCodeScope();
+
+		static bool active();
+
+	private:
+		const bool retain;
+	};
 
 	class Nucleus
 	{
@@ -55,6 +72,13 @@ namespace rr
 
 		Routine *acquireRoutine(const wchar_t *name, bool runOptimizations = true);
 
+		// Whether acquiring a routine without optimizations takes substantially less time,
+		// so it's worth generating it first and the optimized routine later
+		static bool hasFastUnoptimizedTier();
+
+		// Links code previously obtained from Routine::getObjectCode() by the same build
+		static Routine *loadRoutine(const void *objectCode, size_t size);
+
 		static Value *allocateStackVariable(Type *type, int arraySize = 0);
 		static BasicBlock *createBasicBlock();
 		static BasicBlock *getInsertBlock();
@@ -2258,6 +2258,7 @@ namespace rr
 		}
 
 		Routine *operator()(const wchar_t *name, ...);
+		Routine *acquireUnoptimized(const wchar_t *name, ...);   // Faster to generate, for tiered compilation
 
 	protected:
 		Nucleus *core;
@@ -2769,6 +2770,19 @@ namespace rr
 		return core->acquireRoutine(fullName, true);
 	}
 
+	template<typename Return, typename... Arguments>
+	Routine *Function<Return(Arguments...)>::acquireUnoptimized(const wchar_t *name, ...)
+	{
+		wchar_t fullName[1024 + 1];
+
+		va_list vararg;
+		va_start(vararg, name);
+		vswprintf(fullName, 1024, name, vararg);
+		va_end(vararg);
+
+		return core->acquireRoutine(fullName, false);
+	}
+
 	template<class T, class S>
 	RValue<T> ReinterpretCast(RValue<S> val)
 	{
@@ -13,9 +13,13 @@
 // limitations under the License.
 
 #include "Reactor.hpp"
+#include "ExecutableMemory.hpp"
 
 #include "gtest/gtest.h"
 
+#include <thread>
+#include <vector>
+
 using namespace rr;
 
 int reference(int *p, int y)
@@ -992,6 +996,162 @@ TEST(ReactorUnitTests, MulAdd)
 	delete routine;
 }
 
+// Routines get built and run on several threads at once
+TEST(ReactorUnitTests, ConcurrentCompilation)
+{
+	const int threadCount = 8;
+	const int routinesPerThread = 16;
+
+	std::vector<std::thread> threads;
+	int failures[threadCount] = {};
+
+	for(int t = 0; t < threadCount; t++)
+	{
+		threads.emplace_back([t, &failures]()
+		{
+			for(int r = 0; r < routinesPerThread; r++)
+			{
+				const int factor = t * routinesPerThread + r;
+
+				Routine *routine = nullptr;
+
+				{
+					Function<Int(Int)> function;
+					{
+						Int x = function.Arg<0>();
+						Int sum = 0;
+
+						For(Int i = 0, i < x, i++)
+						{
+							sum += Int(factor);
+						}
+
+						Return(sum);
+					}
+
+					routine = function(L"concurrent");
+				}
+
+				if(!routine)
+				{
+					failures[t]++;
+					continue;
+				}
+
+				int (*callable)(int) = (int(*)(int))routine->getEntry();
+
+				if(callable(5) != 5 * factor)
+				{
+					failures[t]++;
+				}
+
+				delete routine;
+			}
+		});
+	}
+
+	for(auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	for(int t = 0; t < threadCount; t++)
+	{
+		EXPECT_EQ(failures[t], 0) << "thread " << t;
+	}
+}
+
+// Linking cached code doesn't disturb a routine being built on the same thread
+TEST(ReactorUnitTests, LoadRoutineWhileBuilding)
+{
+	Routine *cached = nullptr;
+
+	{
+		RetainObjectCodeScope retain;
+
+		Function<Int(Int)> function;
+		{
+			Int x = function.Arg<0>();
+			Return(x * Int(3));
+		}
+
+		cached = function(L"cached");
+	}
+
+	ASSERT_NE(cached, nullptr);
+
+	size_t codeSize = 0;
+	const void *code = cached->getObjectCode(codeSize);
+
+	Routine *routine = nullptr;
+	Routine *loaded = nullptr;
+
+	{
+		Function<Int(Int)> function;
+		{
+			Int x = function.Arg<0>();
+
+			if(code)
+			{
+				loaded = Nucleus::loadRoutine(code, codeSize);
+			}
+
+			Return(x + Int(7));
+		}
+
+		routine = function(L"building");
+	}
+
+	ASSERT_NE(routine, nullptr);
+	EXPECT_EQ(((int(*)(int))routine->getEntry())(5), 12);
+
+	if(loaded)
+	{
+		EXPECT_EQ(((int(*)(int))loaded->getEntry())(5), 15);
+	}
+
+	delete loaded;
+	delete routine;
+	delete cached;
+}
+
+#if (defined(__linux__) || defined(_WIN32)) && defined(REACTOR_LLVM_BACKEND)
+// Small routines share pages of executable memory. Subzero writes code in place, a page per routine.
+TEST(ReactorUnitTests, SharedCodePages)
+{
+	const int count = 8;
+	Routine *routine[count] = {};
+
+	size_t usedBefore = executableMemoryUsage().used;
+
+	for(int i = 0; i < count; i++)
+	{
+		Function<Int(Int)> function;
+		{
+			Int x = function.Arg<0>();
+			Return(x * Int(i + 2));
+		}
+
+		routine[i] = function(L"shared");
+	}
+
+	EXPECT_LT(executableMemoryUsage().used - usedBefore, count * memoryPageSize());
+
+	for(int i = 0; i < count; i++)
+	{
+		ASSERT_NE(routine[i], nullptr);
+
+		int (*callable)(int) = (int(*)(int))routine[i]->getEntry();
+		EXPECT_EQ(callable(3), 3 * (i + 2));
+	}
+
+	for(int i = 0; i < count; i++)
+	{
+		delete routine[i];
+	}
+}
+#endif
+
 int main(int argc, char **argv)
 {
 	::testing::InitGoogleTest(&argc, argv);
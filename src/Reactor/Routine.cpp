@@ -17,12 +17,18 @@
 #include "Thread.hpp"
 
 #include <cassert>
+#include <cstring>
+
+#if defined(__linux__)
+#include <link.h>
+#endif
 
 namespace rr
 {
-	Routine::Routine()
+	Routine::Routine() : useCount(0)
 	{
 		bindCount = 0;
+		optimized = true;
 	}
 
 	void Routine::bind()
@@ -44,4 +50,112 @@ namespace rr
 	{
 		assert(bindCount == 0);
 	}
+
+	bool Routine::isOptimized() const
+	{
+		return optimized;
+	}
+
+	int Routine::countUse()
+	{
+		return ++useCount;
+	}
+
+	const void *Routine::getObjectCode(size_t &size)
+	{
+		size = 0;
+		return nullptr;
+	}
+
+	#if defined(__linux__)
+	static int findBuildID(dl_phdr_info *info, size_t, void *buildID)
+	{
+		uintptr_t self = reinterpret_cast<uintptr_t>(&findBuildID);
+		bool containsSelf = false;
+
+		for(int i = 0; i < info->dlpi_phnum; i++)
+		{
+			const ElfW(Phdr) &header = info->dlpi_phdr[i];
+			uintptr_t start = info->dlpi_addr + header.p_vaddr;
+
+			if(header.p_type == PT_LOAD && self >= start && self < start + header.p_memsz)
+			{
+				containsSelf = true;
+			}
+		}
+
+		if(!containsSelf)
+		{
+			return 0;   // Keep looking
+		}
+
+		for(int i = 0; i < info->dlpi_phnum; i++)
+		{
+			const ElfW(Phdr) &header = info->dlpi_phdr[i];
+
+			if(header.p_type != PT_NOTE)
+			{
+				continue;
+			}
+
+			const char *note = reinterpret_cast<const char*>(info->dlpi_addr + header.p_vaddr);
+			const char *end = note + header.p_memsz;
+
+			while(note + sizeof(ElfW(Nhdr)) <= end)
+			{
+				const ElfW(Nhdr) *noteHeader = reinterpret_cast<const ElfW(Nhdr)*>(note);
+				const char *name = note + sizeof(ElfW(Nhdr));
+				const char *desc = name + ((noteHeader->n_namesz + 3) & ~3);
+
+				if(noteHeader->n_type == NT_GNU_BUILD_ID && noteHeader->n_namesz == 4 && memcmp(name, "GNU", 4) == 0)
+				{
+					memset(buildID, 0, BUILD_ID_SIZE);
+					memcpy(buildID, desc, noteHeader->n_descsz < BUILD_ID_SIZE ? noteHeader->n_descsz : BUILD_ID_SIZE);
+					return 1;
+				}
+
+				note = desc + ((noteHeader->n_descsz + 3) & ~3);
+			}
+		}
+
+		return 1;   // Found ourselves, but no build ID note
+	}
+	#endif
+
+	struct BuildID
+	{
+		BuildID()
+		{
+			// Without a build ID note, fall back to the time this file was compiled
+			const char timestamp[] = __DATE__ __TIME__;
+			memset(bytes, 0, sizeof(bytes));
+			memcpy(bytes, timestamp, sizeof(timestamp) < sizeof(bytes) ? sizeof(timestamp) : sizeof(bytes));
+
+			#if defined(__linux__)
+				dl_iterate_phdr(findBuildID, bytes);
+			#endif
+		}
+
+		uint8_t bytes[BUILD_ID_SIZE];
+	};
+
+	const uint8_t *buildID()
+	{
+		static const BuildID id;   // Thread-safe initialization, caches are used concurrently
+
+		return id.bytes;
+	}
+
+	uint64_t hashBytes(uint64_t hash, const void *data, size_t size)
+	{
+		const uint8_t *bytes = static_cast<const uint8_t*>(data);
+
+		for(size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+
+		return hash;
+	}
 }
@@ -15,6 +15,10 @@
 #ifndef rr_Routine_hpp
 #define rr_Routine_hpp
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
 namespace rr
 {
 	class Routine
@@ -26,13 +30,48 @@ namespace rr
 
 		virtual const void *getEntry() = 0;
 
+		// Relocatable code which Nucleus::loadRoutine() can link back in, for
+		// persistent caching. Only retained if retainObjectCode or a
+		// RetainObjectCodeScope was in effect when the routine was generated.
+		// Returns null otherwise.
+		virtual const void *getObjectCode(size_t &size);
+
 		// Reference counting
 		void bind();
 		void unbind();
 
+		// Tiered compilation. Routines generated without optimizations can count
+		// their uses, so the frequently used ones can be regenerated with them.
+		bool isOptimized() const;
+		int countUse();   // Returns the number of uses so far
+
+	protected:
+		friend class Nucleus;
+
+		bool optimized;
+
 	private:
 		volatile int bindCount;
+		std::atomic<int> useCount;   // Counted by multiple renderers concurrently
 	};
+
+	// Persistent routine caches must only load object code generated by the same
+	// build, for the same instruction set extensions. These identify both.
+	enum { BUILD_ID_SIZE = 20 };
+	const uint8_t *buildID();   // GNU build ID of the module containing Reactor, or its compile time
+	uint64_t hashBytes(uint64_t hash, const void *data, size_t size);   // FNV-1a
+
+	template<class CPUID>
+	uint32_t cpuFeatures()
+	{
+		return CPUID::supportsMMX()    << 0 |
+		       CPUID::supportsCMOV()   << 1 |
+		       CPUID::supportsSSE()    << 2 |
+		       CPUID::supportsSSE2()   << 3 |
+		       CPUID::supportsSSE3()   << 4 |
+		       CPUID::supportsSSSE3()  << 5 |
+		       CPUID::supportsSSE4_1() << 6;
+	}
 }
 
 #endif   // rr_Routine_hpp
@@ -55,16 +55,17 @@
 
 namespace
 {
-	Ice::GlobalContext *context = nullptr;
-	Ice::Cfg *function = nullptr;
-	Ice::CfgNode *basicBlock = nullptr;
-	Ice::CfgLocalAllocatorScope *allocator = nullptr;
-	rr::Routine *routine = nullptr;
+	// Each thread builds its own routine, so codegen state is thread-local
+	thread_local Ice::GlobalContext *context = nullptr;
+	thread_local Ice::Cfg *function = nullptr;
+	thread_local Ice::CfgNode *basicBlock = nullptr;
+	thread_local Ice::CfgLocalAllocatorScope *allocator = nullptr;
+	thread_local rr::Routine *routine = nullptr;
 
-	std::mutex codegenMutex;
+	std::once_flag flagsInitialized;
 
-	Ice::ELFFileStreamer *elfFile = nullptr;
-	Ice::Fdstream *out = nullptr;
+	thread_local Ice::ELFFileStreamer *elfFile = nullptr;
+	thread_local Ice::Fdstream *out = nullptr;
 }
 
 namespace
@@ -199,6 +200,30 @@ namespace rr
 	}
 
 	Optimization optimization[10] = {InstructionCombining, Disabled};
+	std::atomic<bool> retainObjectCode(false);
+
+	static thread_local int retainObjectCodeScopes = 0;
+
+	RetainObjectCodeScope::RetainObjectCodeScope(bool retain) : retain(retain)
+	{
+		if(retain)
+		{
+			retainObjectCodeScopes++;
+		}
+	}
+
+	RetainObjectCodeScope::~RetainObjectCodeScope()
+	{
+		if(retain)
+		{
+			retainObjectCodeScopes--;
+		}
+	}
+
+	bool RetainObjectCodeScope::active()
+	{
+		return retainObjectCode || retainObjectCodeScopes > 0;
+	}
 
 	using ElfHeader = std::conditional<sizeof(void*) == 8, Elf64_Ehdr, Elf32_Ehdr>::type;
 	using SectionHeader = std::conditional<sizeof(void*) == 8, Elf64_Shdr, Elf32_Shdr>::type;
@@ -498,6 +523,11 @@ namespace rr
 			{
 				position = std::numeric_limits<std::size_t>::max();   // Can't stream more data after this
 
+				if(keepObjectCode)
+				{
+					objectCode.assign(buffer.begin(), buffer.end());   // Before relocation
+				}
+
 				size_t codeSize = 0;
 				entry = loadImage(&buffer[0], codeSize);
 
@@ -513,10 +543,21 @@ namespace rr
 			return entry;
 		}
 
+		const void *getObjectCode(size_t &size) override
+		{
+			getEntry();
+
+			size = objectCode.size();
+			return size ? objectCode.data() : nullptr;
+		}
+
+		bool keepObjectCode = false;   // Decided when generated, since loading is deferred to getEntry()
+
 	private:
 		void *entry;
 		std::vector<uint8_t, ExecutableAllocator<uint8_t>> buffer;
 		std::size_t position;
+		std::vector<uint8_t> objectCode;
 
 		#if defined(_WIN32)
 		DWORD oldProtection;
@@ -525,26 +566,28 @@ namespace rr
 
 	Nucleus::Nucleus()
 	{
-		::codegenMutex.lock();   // Reactor is currently not thread safe
-
-		Ice::ClFlags &Flags = Ice::ClFlags::Flags;
-		Ice::ClFlags::getParsedClFlags(Flags);
+		// Subzero's flags are process-wide, so they're only set up once
+		std::call_once(flagsInitialized, []()
+		{
+			Ice::ClFlags &Flags = Ice::ClFlags::Flags;
+			Ice::ClFlags::getParsedClFlags(Flags);
 
-		#if defined(__arm__)
-			Flags.setTargetArch(Ice::Target_ARM32);
-			Flags.setTargetInstructionSet(Ice::ARM32InstructionSet_HWDivArm);
-		#elif defined(__mips__)
-			Flags.setTargetArch(Ice::Target_MIPS32);
-			Flags.setTargetInstructionSet(Ice::BaseInstructionSet);
-		#else   // x86
-			Flags.setTargetArch(sizeof(void*) == 8 ? Ice::Target_X8664 : Ice::Target_X8632);
-			Flags.setTargetInstructionSet(CPUID::SSE4_1 ? Ice::X86InstructionSet_SSE4_1 : Ice::X86InstructionSet_SSE2);
-		#endif
-		Flags.setOutFileType(Ice::FT_Elf);
-		Flags.setOptLevel(Ice::Opt_2);
-		Flags.setApplicationBinaryInterface(Ice::ABI_Platform);
-		Flags.setVerbose(false ? Ice::IceV_Most : Ice::IceV_None);
-		Flags.setDisableHybridAssembly(true);
+			#if defined(__arm__)
+				Flags.setTargetArch(Ice::Target_ARM32);
+				Flags.setTargetInstructionSet(Ice::ARM32InstructionSet_HWDivArm);
+			#elif defined(__mips__)
+				Flags.setTargetArch(Ice::Target_MIPS32);
+				Flags.setTargetInstructionSet(Ice::BaseInstructionSet);
+			#else   // x86
+				Flags.setTargetArch(sizeof(void*) == 8 ? Ice::Target_X8664 : Ice::Target_X8632);
+				Flags.setTargetInstructionSet(CPUID::SSE4_1 ? Ice::X86InstructionSet_SSE4_1 : Ice::X86InstructionSet_SSE2);
+			#endif
+			Flags.setOutFileType(Ice::FT_Elf);
+			Flags.setOptLevel(Ice::Opt_2);
+			Flags.setApplicationBinaryInterface(Ice::ABI_Platform);
+			Flags.setVerbose(false ? Ice::IceV_Most : Ice::IceV_None);
+			Flags.setDisableHybridAssembly(true);
+		});
 
 		static llvm::raw_os_ostream cout(std::cout);
 		static llvm::raw_os_ostream cerr(std::cerr);
@@ -575,7 +618,12 @@ namespace rr
 		delete ::elfFile;
 		delete ::out;
 
-		::codegenMutex.unlock();
+		::routine = nullptr;
+		::allocator = nullptr;
+		::function = nullptr;
+		::context = nullptr;
+		::elfFile = nullptr;
+		::out = nullptr;
 	}
 
 	Routine *Nucleus::acquireRoutine(const wchar_t *name, bool runOptimizations)
@@ -589,7 +637,11 @@ namespace rr
 		std::string asciiName(wideName.begin(), wideName.end());
 		::function->setFunctionName(Ice::GlobalString::createWithString(::context, asciiName));
 
-		optimize();
+		// Subzero's optimization level is process-wide, so only Reactor's own passes are skipped
+		if(runOptimizations)
+		{
+			optimize();
+		}
 
 		::function->translate();
 		assert(!::function->hasError());
@@ -613,12 +665,33 @@ namespace rr
 		objectWriter->setUndefinedSyms(::context->getConstantExternSyms());
 		objectWriter->writeNonUserSections();
 
-		Routine *handoffRoutine = ::routine;
+		ELFMemoryStreamer *handoffRoutine = static_cast<ELFMemoryStreamer*>(::routine);
 		::routine = nullptr;
+		handoffRoutine->optimized = runOptimizations;
+		handoffRoutine->keepObjectCode = RetainObjectCodeScope::active();
 
 		return handoffRoutine;
 	}
 
+	bool Nucleus::hasFastUnoptimizedTier()
+	{
+		return false;   // Subzero's optimization level is process-wide, only Reactor's own passes are skipped
+	}
+
+	Routine *Nucleus::loadRoutine(const void *objectCode, size_t size)
+	{
+		ELFMemoryStreamer *routine = new ELFMemoryStreamer();
+		routine->writeBytes(llvm::StringRef(static_cast<const char*>(objectCode), size));
+
+		if(!routine->getEntry())
+		{
+			delete routine;
+			return nullptr;
+		}
+
+		return routine;
+	}
+
 	void Nucleus::optimize()
 	{
 		rr::optimize(::function);
@@ -6389,38 +6462,38 @@ namespace rr
 		return T(Ice::IceType_v4i32);
 	}
 
-	Half::Half(RValue<Float> cast)
-	{
-		UInt fp32i = As<UInt>(cast);
-		UInt abs = fp32i & 0x7FFFFFFF;
-		UShort fp16i((fp32i & 0x80000000) >> 16); // sign
-
-		If(abs > 0x47FFEFFF) // Infinity
-		{
-			fp16i |= UShort(0x7FFF);
-		}
-		Else
-		{
-			If(abs < 0x38800000) // Denormal
-			{
-				Int mantissa = (abs & 0x007FFFFF) | 0x00800000;
-				Int e = 113 - (abs >> 23);
-				abs = IfThenElse(e < 24, mantissa >> e, Int(0));
-				fp16i |= UShort((abs + 0x00000FFF + ((abs >> 13) & 1)) >> 13);
-			}
-			Else
-			{
-				fp16i |= UShort((abs + 0xC8000000 + 0x00000FFF + ((abs >> 13) & 1)) >> 13);
-			}
-		}
-
-		storeValue(fp16i.loadValue());
-	}
-
-	Type *Half::getType()
-	{
-		return T(Ice::IceType_i16);
-	}
+	Half::Half(RValue<Float> cast)
+	{
+		UInt fp32i = As<UInt>(cast);
+		UInt abs = fp32i & 0x7FFFFFFF;
+		UShort fp16i((fp32i & 0x80000000) >> 16); // sign
+
+		If(abs > 0x47FFEFFF) // Infinity
+		{
+			fp16i |= UShort(0x7FFF);
+		}
+		Else
+		{
+			If(abs < 0x38800000) // Denormal
+			{
+				Int mantissa = (abs & 0x007FFFFF) | 0x00800000;
+				Int e = 113 - (abs >> 23);
+				abs = IfThenElse(e < 24, mantissa >> e, Int(0));
+				fp16i |= UShort((abs + 0x00000FFF + ((abs >> 13) & 1)) >> 13);
+			}
+			Else
+			{
+				fp16i |= UShort((abs + 0xC8000000 + 0x00000FFF + ((abs >> 13) & 1)) >> 13);
+			}
+		}
+
+		storeValue(fp16i.loadValue());
+	}
+
+	Type *Half::getType()
+	{
+		return T(Ice::IceType_i16);
+	}
 
 	Float::Float(RValue<Int> cast)
 	{
@@ -6437,34 +6510,34 @@ namespace rr
 		storeValue(result.value);
 	}
 
-	Float::Float(RValue<Half> cast)
-	{
-		Int fp16i(As<UShort>(cast));
-
-		Int s = (fp16i >> 15) & 0x00000001;
-		Int e = (fp16i >> 10) & 0x0000001F;
-		Int m = fp16i & 0x000003FF;
-
-		UInt fp32i(s << 31);
-		If(e == 0)
-		{
-			If(m != 0)
-			{
-				While((m & 0x00000400) == 0)
-				{
-					m <<= 1;
-					e -= 1;
-				}
-
-				fp32i |= As<UInt>(((e + (127 - 15) + 1) << 23) | ((m & ~0x00000400) << 13));
-			}
-		}
-		Else
-		{
-			fp32i |= As<UInt>(((e + (127 - 15)) << 23) | (m << 13));
-		}
-
-		storeValue(As<Float>(fp32i).value);
+	Float::Float(RValue<Half> cast)
+	{
+		Int fp16i(As<UShort>(cast));
+
+		Int s = (fp16i >> 15) & 0x00000001;
+		Int e = (fp16i >> 10) & 0x0000001F;
+		Int m = fp16i & 0x000003FF;
+
+		UInt fp32i(s << 31);
+		If(e == 0)
+		{
+			If(m != 0)
+			{
+				While((m & 0x00000400) == 0)
+				{
+					m <<= 1;
+					e -= 1;
+				}
+
+				fp32i |= As<UInt>(((e + (127 - 15) + 1) << 23) | ((m & ~0x00000400) << 13));
+			}
+		}
+		Else
+		{
+			fp32i |= As<UInt>(((e + (127 - 15)) << 23) | (m << 13));
+		}
+
+		storeValue(As<Float>(fp32i).value);
 	}
 
 	Float::Float(float x)
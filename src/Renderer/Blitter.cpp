@@ -18,6 +18,7 @@
 #include "Reactor/Reactor.hpp"
 #include "Common/Memory.hpp"
 #include "Common/Debug.hpp"
+#include "Common/Thread.hpp"
 
 namespace sw
 {
@@ -102,34 +103,62 @@ namespace sw
 		}
 
 		bool useDestInternal = !dest->isExternalDirty();
+
+		// Clears of the entire surface are only written to memory once rows get used
+		if(useDestInternal && dest->isEntire(dRect))
+		{
+			unsigned int pattern = (Surface::bytes(dest->getFormat()) == 2) ? (packed | (packed << 16)) : packed;
+
+			if(dest->deferInternalClear(pattern))
+			{
+				return true;
+			}
+		}
+
+		if(useDestInternal)
+		{
+			dest->limitDamage(dRect);   // Only consumed by internal locks
+		}
+
 		uint8_t *slice = (uint8_t*)dest->lock(dRect.x0, dRect.y0, dRect.slice, sw::LOCK_WRITEONLY, sw::PUBLIC, useDestInternal);
 
-		for(int j = 0; j < dest->getSamples(); j++)
+		int samples = dest->getSamples();
+		int bytes = Surface::bytes(dest->getFormat());
+		int pitchB = dest->getPitchB(useDestInternal);
+		int sliceB = dest->getSliceB(useDestInternal);
+		int width = dRect.x1 - dRect.x0;
+		int height = dRect.y1 - dRect.y0;
+
+		// Bands of rows of each sample are cleared concurrently
+		int bandHeight = max(BLIT_BAND_PIXELS / max(width, 1), 1);
+		int bandsPerSample = (height + bandHeight - 1) / bandHeight;
+
+		parallelFor(samples * bandsPerSample, [&](int band)
 		{
-			uint8_t *d = slice;
+			int y0 = (band % bandsPerSample) * bandHeight;
+			int y1 = min(y0 + bandHeight, height);
+			uint8_t *d = slice + (band / bandsPerSample) * sliceB + y0 * pitchB;
 
-			switch(Surface::bytes(dest->getFormat()))
+			switch(bytes)
 			{
 			case 2:
-				for(int i = dRect.y0; i < dRect.y1; i++)
+				for(int i = y0; i < y1; i++)
 				{
-					sw::clear((uint16_t*)d, packed, dRect.x1 - dRect.x0);
-					d += dest->getPitchB(useDestInternal);
+					sw::clear((uint16_t*)d, packed, width);
+					d += pitchB;
 				}
 				break;
 			case 4:
-				for(int i = dRect.y0; i < dRect.y1; i++)
+				for(int i = y0; i < y1; i++)
 				{
-					sw::clear((uint32_t*)d, packed, dRect.x1 - dRect.x0);
-					d += dest->getPitchB(useDestInternal);
+					sw::clear((uint32_t*)d, packed, width);
+					d += pitchB;
 				}
 				break;
 			default:
 				assert(false);
 			}
-
-			slice += dest->getSliceB(useDestInternal);
-		}
+		});
 
 		dest->unlock(useDestInternal);
 
@@ -166,6 +195,7 @@ namespace sw
 		}
 
 		source->lockInternal(0, 0, sRect.slice, sw::LOCK_READONLY, sw::PUBLIC);
+		dest->limitDamage(dRect);
 		dest->lockInternal(0, 0, dRect.slice, sw::LOCK_WRITEONLY, sw::PUBLIC);
 
 		float w = sRect.width() / dRect.width();
@@ -1418,25 +1448,36 @@ namespace sw
 		state.sourceFormat = isStencil ? source->getStencilFormat() : source->getFormat(useSourceInternal);
 		state.destFormat = isStencil ? dest->getStencilFormat() : dest->getFormat(useDestInternal);
 		state.destSamples = dest->getSamples();
+		state.hash = state.computeHash();
 
+		// The lock is only held for cache lookups, so concurrent blits don't wait for each
+		// other's routines to be generated. Routines are bound while in use, to survive eviction.
 		criticalSection.lock();
 		Routine *blitRoutine = blitCache->query(state);
 
+		if(blitRoutine)
+		{
+			blitRoutine->bind();
+		}
+
+		criticalSection.unlock();
+
 		if(!blitRoutine)
 		{
 			blitRoutine = generate(state);
 
 			if(!blitRoutine)
 			{
-				criticalSection.unlock();
 				return false;
 			}
 
+			blitRoutine->bind();
+
+			criticalSection.lock();
 			blitCache->add(state, blitRoutine);
+			criticalSection.unlock();
 		}
 
-		criticalSection.unlock();
-
 		void (*blitFunction)(const BlitData *data) = (void(*)(const BlitData*))blitRoutine->getEntry();
 
 		BlitData data;
@@ -1446,6 +1487,11 @@ namespace sw
 
 		data.source = isStencil ? source->lockStencil(0, 0, 0, sw::PUBLIC) :
 		                          source->lock(0, 0, sourceRect.slice, sw::LOCK_READONLY, sw::PUBLIC, useSourceInternal);
+		if(!isStencil && useDestInternal)
+		{
+			dest->limitDamage(dRect);   // Only consumed by internal locks
+		}
+
 		data.dest = isStencil ? dest->lockStencil(0, 0, 0, sw::PUBLIC) :
 		                        dest->lock(0, 0, destRect.slice, isRGBA ? (isEntireDest ? sw::LOCK_DISCARD : sw::LOCK_WRITEONLY) : sw::LOCK_READWRITE, sw::PUBLIC, useDestInternal);
 		data.sPitchB = isStencil ? source->getStencilPitchB() : source->getPitchB(useSourceInternal);
@@ -1465,7 +1511,21 @@ namespace sw
 		data.sWidth = source->getWidth();
 		data.sHeight = source->getHeight();
 
-		blitFunction(&data);
+		// Large blits are split into bands of rows, running concurrently. Bands start at
+		// even rows so quad layouts are never split.
+		int bandHeight = max(align<2>(BLIT_BAND_PIXELS / max(dRect.width(), 1)), 2);
+		int bandCount = (dRect.y1 - (dRect.y0 & ~1) + bandHeight - 1) / bandHeight;
+
+		parallelFor(bandCount, [&](int band)
+		{
+			BlitData bandData = data;
+			bandData.y0d = (band == 0) ? dRect.y0 : (dRect.y0 & ~1) + band * bandHeight;
+			bandData.y1d = min((dRect.y0 & ~1) + (band + 1) * bandHeight, dRect.y1);
+
+			blitFunction(&bandData);
+		});
+
+		blitRoutine->unbind();
 
 		if(isStencil)
 		{
@@ -23,6 +23,11 @@
 
 namespace sw
 {
+	enum
+	{
+		BLIT_BAND_PIXELS = 128 * 1024   // Pixels per band of rows processed by one thread
+	};
+
 	class Blitter
 	{
 		struct Options
@@ -60,12 +65,29 @@ namespace sw
 
 			bool operator==(const State &state) const
 			{
+				if(hash != state.hash)
+				{
+					return false;
+				}
+
 				return memcmp(this, &state, sizeof(State)) == 0;
 			}
 
+			unsigned int computeHash() const
+			{
+				unsigned int hash = sourceFormat;
+				hash = hash * 31 + destFormat;
+				hash = hash * 31 + destSamples;
+				hash = hash * 31 + writeMask;
+				hash = hash * 31 + (clearOperation | filter << 1 | useStencil << 2 | convertSRGB << 3 | clampToEdge << 4);
+
+				return hash;
+			}
+
 			Format sourceFormat;
 			Format destFormat;
 			int destSamples;
+			unsigned int hash;
 		};
 
 		struct BlitData
@@ -303,7 +303,12 @@ namespace sw
 		pixelShader = 0;
 		vertexShader = 0;
 
-		instanceID = 0;
+		firstInstance = 0;
+		instanceCount = 1;
+
+		minIndex = 1;
+		maxIndex = 0;
+		bulkVertices = false;
 
 		occlusionEnabled = false;
 		transformFeedbackQueryEnabled = false;
@@ -489,7 +489,13 @@ namespace sw
 		float bias;
 
 		// Instancing
-		int instanceID;
+		int firstInstance;
+		int instanceCount;
+
+		// Range of the indices, if known
+		unsigned int minIndex;
+		unsigned int maxIndex;
+		bool bulkVertices;   // Shade the index range up front instead of through the vertex cache
 
 		// Fixed-function vertex pipeline state
 		bool lightingEnable;
@@ -16,6 +16,7 @@
 
 #include "Surface.hpp"
 #include "Primitive.hpp"
+#include "Renderer.hpp"
 #include "Shader/PixelPipeline.hpp"
 #include "Shader/PixelProgram.hpp"
 #include "Shader/PixelShader.hpp"
@@ -1037,6 +1038,23 @@ namespace sw
 		state.multiSample = context->getMultiSampleCount();
 		state.multiSampleMask = context->multiSampleMask;
 
+		// Hierarchical depth keeps a bound per tile, so it requires tile-based rasterization
+		Surface *depthBuffer = context->depthBuffer;
+		int tileSize = Renderer::getTileSize();
+
+		if(state.depthTestActive && tileSize != 0 && depthBuffer->getDepth() == 1 && depthBuffer->getSuperSampleCount() == 1 && !complementaryDepthBuffer)
+		{
+			bool lessCompare = (state.depthCompareMode == DEPTH_LESS) || (state.depthCompareMode == DEPTH_LESSEQUAL);
+			unsigned int sampleMask = (1 << state.multiSample) - 1;
+			bool fullCoverage = ((state.multiSampleMask & sampleMask) == sampleMask) && !state.shaderContainsKill && !state.alphaTestActive();
+
+			state.hiZ = true;
+			state.hiZTileShift = sw::log2(tileSize) - 3;
+			state.hiZTest = lessCompare && !state.stencilActive && !state.depthOverride;
+			state.hiZTighten = state.hiZTest && state.depthWriteEnable && fullCoverage;
+			state.hiZInvalidate = state.depthWriteEnable && !lessCompare && (state.depthCompareMode != DEPTH_NEVER) && (state.depthCompareMode != DEPTH_EQUAL);
+		}
+
 		if(state.multiSample > 1 && context->pixelShader)
 		{
 			state.centroid = context->pixelShader->containsCentroid();
@@ -1188,25 +1206,137 @@ namespace sw
 
 		if(!routine)
 		{
-			const bool integerPipeline = (context->pixelShaderModel() <= 0x0104);
+			State persistentState;
+			uint64_t shaderHash = persistentKey(state, persistentState);
+
+			routine = routineCache->load(persistentState, shaderHash);
+
+			if(!routine)
+			{
+				if(asyncRoutineCompilation && Nucleus::hasFastUnoptimizedTier())
+				{
+					// Don't make rendering threads wait for an optimized routine. Generating one without
+					// optimizations is fast, and it's used until the optimized one replaces it. With
+					// tiered compilation that only happens once it's drawn with frequently.
+					AsyncRoutine *unoptimized = new AsyncRoutine(generateRoutine(state, false, false));
+
+					if(tieredRoutineCompilation)
+					{
+						routine = unoptimized;
+					}
+					else
+					{
+						routine = generateRoutine(state, true, true, unoptimized);
+						unoptimized->unbind();
+					}
+				}
+				else
+				{
+					// Without a faster tier the state is only generated once, on a generation thread
+					// when asynchronous, so the application thread doesn't wait for it
+					routine = generateRoutine(state, !tieredRoutineCompilation, asyncRoutineCompilation);
+				}
+			}
+			else if(asyncRoutineCompilation)
+			{
+				routine = new AsyncRoutine(routine);
+			}
+
+			routineCache->add(state, routine);
+
+			if(asyncRoutineCompilation)
+			{
+				routine->unbind();   // Created with a reference for us, the cache holds it now
+			}
+		}
+
+		return routine;
+	}
+
+	Routine *PixelProcessor::tierUp(const State &state, Routine *routine)
+	{
+		if(!routine->isOptimized() && routine->countUse() == TIER_UP_USE_COUNT)
+		{
+			// Frequently drawn with, so regenerate it with optimizations. That's never done on this thread,
+			// since draw calls keep using this routine until the optimized one is ready.
+			AsyncRoutine *fallback = asyncRoutineCompilation ? static_cast<AsyncRoutine*>(routine) : new AsyncRoutine(routine);   // All cached routines are AsyncRoutines in that mode
+			routine = generateRoutine(state, true, true, fallback);
+			routineCache->add(state, routine);
+			routine->unbind();
+
+			if(!asyncRoutineCompilation)
+			{
+				fallback->unbind();   // Held by the optimized routine now
+			}
+		}
+
+		return routine;
+	}
+
+	uint64_t PixelProcessor::persistentKey(const State &state, State &persistentState) const
+	{
+		// Shader serial IDs differ between processes, so the persistent cache is keyed on the shader contents
+		memcpy(&persistentState, &state, sizeof(State));
+		persistentState.shaderID = 0;
+		persistentState.hash = 0;
+
+		return (precachePixel && context->pixelShader) ? context->pixelShader->computeContentHash() : 0;
+	}
+
+	Routine *PixelProcessor::generateRoutine(const State &state, bool optimize, bool background, AsyncRoutine *fallback)
+	{
+		const bool integerPipeline = (context->pixelShaderModel() <= 0x0104);
+		const PixelShader *shader = context->pixelShader;
+
+		State persistentState;
+		uint64_t shaderHash = persistentKey(state, persistentState);
+
+		auto generate = [=]() -> Routine*
+		{
 			QuadRasterizer *generator = nullptr;
 
 			if(integerPipeline)
 			{
-				generator = new PixelPipeline(state, context->pixelShader);
+				generator = new PixelPipeline(state, shader);
 			}
 			else
 			{
-				generator = new PixelProgram(state, context->pixelShader);
+				generator = new PixelProgram(state, shader);
 			}
 
 			generator->generate();
-			routine = (*generator)(L"PixelRoutine_%0.8X", state.shaderID);
+			Routine *routine = optimize ? (*generator)(L"PixelRoutine_%0.8X", state.shaderID) :
+			                              generator->acquireUnoptimized(L"PixelRoutine_%0.8X", state.shaderID);
 			delete generator;
 
-			routineCache->add(state, routine);
+			if(optimize)   // Loaded routines don't get regenerated
+			{
+				routineCache->store(persistentState, shaderHash, routine);
+			}
+
+			return routine;
+		};
+
+		if(!background)
+		{
+			return generate();
 		}
 
-		return routine;
+		if(shader)
+		{
+			shader->addGeneratorReference();
+		}
+
+		return new AsyncRoutine([=]()
+		{
+			Routine *routine = generate();
+
+			if(shader)
+			{
+				shader->releaseGeneratorReference();
+			}
+
+			return routine;
+		}, optimize, fallback);
 	}
 }
@@ -67,6 +67,11 @@ namespace sw
 			bool wBasedFog                            : 1;
 			bool perspective                          : 1;
 			bool depthClamp                           : 1;
+			bool hiZ                                  : 1;   // Keep hierarchical depth bounds per tile
+			unsigned int hiZTileShift                 : 3;   // Log2 of the tile size minus three
+			bool hiZTest                              : 1;   // Skip tiles whose bound is closer than the primitive
+			bool hiZTighten                           : 1;   // Lower the bound of fully covered tiles
+			bool hiZInvalidate                        : 1;   // Depth writes can move further away
 
 			bool alphaBlendActive                     : 1;
 			BlendFactor sourceBlendFactor             : BITS(BLEND_LAST);
@@ -185,7 +190,7 @@ namespace sw
 		};
 
 	public:
-		typedef void (*RoutinePointer)(const Primitive *primitive, int count, int thread, DrawData *draw);
+		typedef void (*RoutinePointer)(const Primitive *primitive, int count, int thread, int tile, DrawData *draw);
 
 		PixelProcessor(Context *context);
 
@@ -307,6 +312,7 @@ namespace sw
 	protected:
 		const State update() const;
 		Routine *routine(const State &state);
+		Routine *tierUp(const State &state, Routine *routine);   // Counts a draw call using the routine
 		void setRoutineCacheSize(int routineCacheSize);
 
 		// Shader constants
@@ -333,6 +339,9 @@ namespace sw
 
 		void setFogRanges(float start, float end);
 
+		uint64_t persistentKey(const State &state, State &persistentState) const;
+		Routine *generateRoutine(const State &state, bool optimize, bool background, AsyncRoutine *fallback = nullptr);   // Background generation returns an AsyncRoutine, referenced for the caller
+
 		Context *const context;
 
 		RoutineCache<State> *routineCache;
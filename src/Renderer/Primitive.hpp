@@ -38,6 +38,8 @@ namespace sw
 	{
 		int yMin;
 		int yMax;
+		int xMin;   // Horizontal bounds, only used for tile-based rasterization
+		int xMax;
 
 		float4 xQuad;
 		float4 yQuad;
@@ -50,20 +50,69 @@ namespace sw
 		constants = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData,constants));
 		occlusion = 0;
 		int clusterCount = Renderer::getClusterCount();
+		int tileSize = Renderer::getTileSize();
 
 		Do
 		{
 			Int yMin = *Pointer<Int>(primitive + OFFSET(Primitive,yMin));
 			Int yMax = *Pointer<Int>(primitive + OFFSET(Primitive,yMax));
 
-			Int cluster2 = cluster + cluster;
-			yMin += clusterCount * 2 - 2 - cluster2;
-			yMin &= -clusterCount * 2;
-			yMin += cluster2;
+			if(tileSize != 0)
+			{
+				// Tile-based rasterization. The clusters claim the tiles overlapped by the
+				// batch, and each call only covers the part of the primitives in one tile.
+				const int tileShift = sw::log2(tileSize);
+
+				Int xMin = *Pointer<Int>(primitive + OFFSET(Primitive,xMin));
+				Int xMax = *Pointer<Int>(primitive + OFFSET(Primitive,xMax));
+				Int yFirst = yMin;
+
+				yMin &= 0xFFFFFFFE;
+
+				Int tx = tile & 0xFFFF;
+				Int ty = tile >> 16;
+				Int x0 = tx << tileShift;
+				Int x1 = x0 + tileSize;
+				Int y0 = Max(yMin, ty << tileShift);
+				Int y1 = Min(yMax, (ty + 1) << tileShift);
+
+				If(y0 < y1 && xMin < x1 && x0 < xMax)
+				{
+					if(state.hiZ)
+					{
+						ASSERT(state.hiZTileShift + 3 == tileShift);
 
-			If(yMin < yMax)
+						hierarchicalDepth(tx, ty, x0, x1, y0, y1, yFirst, xMin, xMax, yMax);
+					}
+					else
+					{
+						rasterize(y0, y1, x0, x1);
+					}
+				}
+			}
+			else
 			{
-				rasterize(yMin, yMax);
+				// Round to the first pair of scanlines owned by this cluster
+				if((clusterCount & (clusterCount - 1)) == 0)
+				{
+					Int cluster2 = cluster + cluster;
+					yMin += clusterCount * 2 - 2 - cluster2;
+					yMin &= -clusterCount * 2;
+					yMin += cluster2;
+				}
+				else
+				{
+					yMin &= 0xFFFFFFFE;
+					yMin += ((cluster - (yMin >> 1) % clusterCount + clusterCount) % clusterCount) * 2;
+				}
+
+				If(yMin < yMax)
+				{
+					Int xMin = 0;   // Unused without tiling
+					Int xMax = 0;
+
+					rasterize(yMin, yMax, xMin, xMax);
+				}
 			}
 
 			primitive += sizeof(Primitive) * state.multiSample;
@@ -73,9 +122,10 @@ namespace sw
 
 		if(state.occlusionEnabled)
 		{
-			UInt clusterOcclusion = *Pointer<UInt>(data + OFFSET(DrawData,occlusion) + 4 * cluster);
+			Pointer<Byte> occlusionCounter = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData,occlusion)) + 4 * cluster;
+			UInt clusterOcclusion = *Pointer<UInt>(occlusionCounter);
 			clusterOcclusion += occlusion;
-			*Pointer<UInt>(data + OFFSET(DrawData,occlusion) + 4 * cluster) = clusterOcclusion;
+			*Pointer<UInt>(occlusionCounter) = clusterOcclusion;
 		}
 
 		#if PERF_PROFILE
@@ -83,15 +133,111 @@ namespace sw
 
 			for(int i = 0; i < PERF_TIMERS; i++)
 			{
-				*Pointer<Long>(data + OFFSET(DrawData,cycles[i]) + 8 * cluster) += cycles[i];
+				Pointer<Byte> clusterCycles = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData,cycles)) + 8 * (i * clusterCount) + 8 * cluster;
+				*Pointer<Long>(clusterCycles) += cycles[i];
 			}
 		#endif
 
 		Return();
 	}
 
-	void QuadRasterizer::rasterize(Int &yMin, Int &yMax)
+	void QuadRasterizer::hierarchicalDepth(Int &tx, Int &ty, Int &x0, Int &x1, Int &y0, Int &y1, Int &yFirst, Int &xMin, Int &xMax, Int &yMax)
 	{
+		Int hiZWidth = *Pointer<Int>(data + OFFSET(DrawData,hiZWidth));
+		Int hiZHeight = *Pointer<Int>(data + OFFSET(DrawData,hiZHeight));
+		Int tileY0 = ty << (state.hiZTileShift + 3);
+		Int tileY1 = tileY0 + (8 << state.hiZTileShift);
+
+		// Render targets can be larger than the depth buffer
+		Bool inside = (x0 < hiZWidth) && (tileY0 < hiZHeight);
+		Pointer<Byte> bound = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData,hiZ)) + (ty * *Pointer<Int>(data + OFFSET(DrawData,hiZPitch)) + tx) * sizeof(float);
+
+		if(state.hiZInvalidate)
+		{
+			If(inside)
+			{
+				*Pointer<Float>(bound) = Float(INFINITY);
+			}
+		}
+
+		if(!state.hiZTest)
+		{
+			rasterize(y0, y1, x0, x1);
+
+			return;
+		}
+
+		// Depth range of the primitive's plane over the tile, padded by a pixel to include any sample offsets
+		Float A = *Pointer<Float>(primitive + OFFSET(Primitive,z.A));
+		Float B = *Pointer<Float>(primitive + OFFSET(Primitive,z.B));
+		Float C = *Pointer<Float>(primitive + OFFSET(Primitive,z.C));
+
+		Float Ax0 = A * Float(x0 - 1);
+		Float Ax1 = A * Float(x1 + 1);
+		Float By0 = B * Float(tileY0 - 1);
+		Float By1 = B * Float(tileY1 + 1);
+
+		// Margin for the rounding of the per-pixel interpolation
+		Float error = (Abs(C) + Max(Abs(Ax0), Abs(Ax1)) + Max(Abs(By0), Abs(By1))) * Float(1.0f / (1 << 20));
+
+		Float zMin = C + Min(Ax0, Ax1) + Min(By0, By1) - error;
+		Float zMax = C + Max(Ax0, Ax1) + Max(By0, By1) + error;
+
+		if(state.depthClamp)
+		{
+			zMin = Min(Max(zMin, Float(0.0f)), Float(1.0f));
+			zMax = Min(Max(zMax, Float(0.0f)), Float(1.0f));
+		}
+
+		// Every depth in the tile is at most the bound, so further primitives fail a less-than test everywhere
+		Float tileBound = Float(INFINITY);
+
+		If(inside)
+		{
+			tileBound = *Pointer<Float>(bound);
+		}
+
+		If(!(zMin > tileBound))
+		{
+			rasterize(y0, y1, x0, x1);
+		}
+
+		if(state.hiZTighten)
+		{
+			// Afterwards the tile's depth is at most zMax, if the primitive covered all of its pixels
+			Int coverX1 = Min(x1, hiZWidth);
+			Int coverY1 = Min(tileY1, hiZHeight);
+
+			If(inside && zMax < tileBound && yFirst <= tileY0 && yMax >= coverY1 && xMin <= x0 && xMax >= coverX1)
+			{
+				Bool covered = true;
+
+				For(Int y = tileY0, y < coverY1, y++)
+				{
+					for(unsigned int q = 0; q < state.multiSample; q++)
+					{
+						Pointer<Byte> span = primitive + q * sizeof(Primitive) + OFFSET(Primitive,outline) + y * sizeof(Primitive::Span);
+
+						Int left = Int(*Pointer<UShort>(span + OFFSET(Primitive::Span,left)));
+						Int right = Int(*Pointer<UShort>(span + OFFSET(Primitive::Span,right)));
+
+						covered = covered && (left <= x0) && (right >= coverX1);
+					}
+				}
+
+				If(covered)
+				{
+					*Pointer<Float>(bound) = zMax;
+				}
+			}
+		}
+	}
+
+	void QuadRasterizer::rasterize(Int &yMin, Int &yMax, Int &xMin, Int &xMax)
+	{
+		const bool tiled = (Renderer::getTileSize() != 0);
+		const int yStep = tiled ? 2 : 2 * Renderer::getClusterCount();   // Rows processed per iteration, times the number of interleaved clusters
+
 		Pointer<Byte> cBuffer[RENDERTARGETS];
 		Pointer<Byte> zBuffer;
 		Pointer<Byte> sBuffer;
@@ -131,6 +277,11 @@ namespace sw
 
 			x0 &= 0xFFFFFFFE;
 
+			if(tiled)
+			{
+				x0 = Max(x0, xMin);
+			}
+
 			Int x1a = Int(*Pointer<Short>(primitive + OFFSET(Primitive,outline->right) + (y + 0) * sizeof(Primitive::Span)));
 			Int x1b = Int(*Pointer<Short>(primitive + OFFSET(Primitive,outline->right) + (y + 1) * sizeof(Primitive::Span)));
 			Int x1 = Max(x1a, x1b);
@@ -142,6 +293,11 @@ namespace sw
 				x1 = Max(x1, Max(x1a, x1b));
 			}
 
+			if(tiled)
+			{
+				x1 = Min(x1, xMax);
+			}
+
 			Float4 yyyy = Float4(Float(y)) + *Pointer<Float4>(primitive + OFFSET(Primitive,yQuad), 16);
 
 			if(interpolateZ())
@@ -276,7 +432,7 @@ namespace sw
 					xRight[q] = Swizzle(xRight[q], 0xF5) - Short4(0, 1, 0, 1);
 				}
 
-				For(Int x = x0, x < x1, x += 2)
+				For(Int x = x0, x < x1, x += 2)   // One 2x2 quad per iteration, see docs/Index.md on vector width
 				{
 					Short4 xxxx = Short4(x);
 					Int cMask[4];
@@ -291,27 +447,25 @@ namespace sw
 				}
 			}
 
-			int clusterCount = Renderer::getClusterCount();
-
 			for(int index = 0; index < RENDERTARGETS; index++)
 			{
 				if(state.colorWriteActive(index))
 				{
-					cBuffer[index] += *Pointer<Int>(data + OFFSET(DrawData,colorPitchB[index])) << (1 + sw::log2(clusterCount));   // FIXME: Precompute
+					cBuffer[index] += *Pointer<Int>(data + OFFSET(DrawData,colorPitchB[index])) * yStep;   // FIXME: Precompute
 				}
 			}
 
 			if(state.depthTestActive)
 			{
-				zBuffer += *Pointer<Int>(data + OFFSET(DrawData,depthPitchB)) << (1 + sw::log2(clusterCount));   // FIXME: Precompute
+				zBuffer += *Pointer<Int>(data + OFFSET(DrawData,depthPitchB)) * yStep;   // FIXME: Precompute
 			}
 
 			if(state.stencilActive)
 			{
-				sBuffer += *Pointer<Int>(data + OFFSET(DrawData,stencilPitchB)) << (1 + sw::log2(clusterCount));   // FIXME: Precompute
+				sBuffer += *Pointer<Int>(data + OFFSET(DrawData,stencilPitchB)) * yStep;   // FIXME: Precompute
 			}
 
-			y += 2 * clusterCount;
+			y += yStep;
 		}
 		Until(y >= yMax)
 	}
@@ -54,7 +54,8 @@ namespace sw
 		const PixelShader *const shader;
 
 	private:
-		void rasterize(Int &yMin, Int &yMax);
+		void rasterize(Int &yMin, Int &yMax, Int &xMin, Int &xMax);
+		void hierarchicalDepth(Int &tx, Int &ty, Int &x0, Int &x1, Int &y0, Int &y1, Int &yFirst, Int &xMin, Int &xMax, Int &yMax);
 	};
 }
 
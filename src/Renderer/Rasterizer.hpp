@@ -23,16 +23,17 @@ namespace sw
 {
 	using namespace rr;
 
-	class Rasterizer : public Function<Void(Pointer<Byte>, Int, Int, Pointer<Byte>)>
+	class Rasterizer : public Function<Void(Pointer<Byte>, Int, Int, Int, Pointer<Byte>)>
 	{
 	public:
-		Rasterizer() : primitive(Arg<0>()), count(Arg<1>()), cluster(Arg<2>()), data(Arg<3>()) {}
+		Rasterizer() : primitive(Arg<0>()), count(Arg<1>()), cluster(Arg<2>()), tile(Arg<3>()), data(Arg<4>()) {}
 		virtual ~Rasterizer() {};
 
 	protected:
 		Pointer<Byte> primitive;
 		Int count;
 		Int cluster;
+		Int tile;   // Column in the low and row in the high 16 bits, only used for tile-based rasterization
 		Pointer<Byte> data;
 	};
 }
@@ -31,6 +31,8 @@
 #include "Common/Timer.hpp"
 #include "Common/Debug.hpp"
 
+#include <algorithm>
+
 #undef max
 
 bool disableServer = true;
@@ -56,15 +58,19 @@ namespace sw
 	extern bool exactColorRounding;
 	extern TransparencyAntialiasing transparencyAntialiasing;
 	extern bool forceClearRegisters;
+	extern bool compressedTextureSampling;
 
 	extern bool precacheVertex;
 	extern bool precacheSetup;
 	extern bool precachePixel;
 
 	static const int batchSize = 128;
+	static const unsigned int bulkVertexMin = 1024;   // Smaller index ranges are shaded well enough through the vertex cache
+	static const size_t vertexWindowPoolSize = 2 * VertexWindow::IN_FLIGHT;   // Windows kept for reuse
 	AtomicInt threadCount(1);
 	AtomicInt Renderer::unitCount(1);
 	AtomicInt Renderer::clusterCount(1);
+	AtomicInt Renderer::tileSize(0);
 
 	TranscendentalPrecision logPrecision = ACCURATE;
 	TranscendentalPrecision expPrecision = ACCURATE;
@@ -129,22 +135,80 @@ namespace sw
 		psDirtyConstI = 16;
 		psDirtyConstB = 16;
 
+		vsConstantsSubmission = 0;
+		psConstantsSubmission = 0;
+
 		references = -1;
 
+		bulkVertices = false;
+
+		for(VertexWindow *&window : vertexWindow)
+		{
+			window = nullptr;
+		}
+
 		data = (DrawData*)allocate(sizeof(DrawData));
 		data->constants = &constants;
+		data->occlusion = nullptr;
+
+		#if PERF_PROFILE
+			data->cycles = nullptr;
+		#endif
 	}
 
 	DrawCall::~DrawCall()
 	{
 		delete queries;
 
+		for(VertexWindow *window : vertexWindow)
+		{
+			delete window;
+		}
+
+		deallocate(data->occlusion);
+
+		#if PERF_PROFILE
+			deallocate(data->cycles);
+		#endif
+
 		deallocate(data);
 	}
 
+	void DrawCall::setClusterCount(int clusterCount)
+	{
+		deallocate(data->occlusion);
+		data->occlusion = (unsigned int*)allocate(clusterCount * sizeof(unsigned int));
+
+		#if PERF_PROFILE
+			deallocate(data->cycles);
+			data->cycles = (int64_t*)allocate(PERF_TIMERS * clusterCount * sizeof(int64_t));
+		#endif
+	}
+
+	void ConstantUpdates::update(uint64_t submission, unsigned int end)
+	{
+		while(!updates.empty() && updates.back().end <= end)
+		{
+			updates.pop_back();   // Covered by this update, which is more recent
+		}
+
+		updates.push_back({submission, end});
+	}
+
+	unsigned int ConstantUpdates::since(uint64_t submission) const
+	{
+		// Submissions increase and ends decrease along the list, so the first update
+		// after the submission has the highest end of all the updates after it
+		auto update = std::upper_bound(updates.begin(), updates.end(), submission,
+		                               [](uint64_t submission, const Update &update) { return submission < update.submission; });
+
+		return (update != updates.end()) ? update->end : 0;
+	}
+
 	Renderer::Renderer(Context *context, Conventions conventions, bool exactColorRounding) : VertexProcessor(context), PixelProcessor(context), SetupProcessor(context), context(context), viewport()
 	{
 		setGlobalRenderingSettings(conventions, exactColorRounding);
+		AsyncRoutine::acquireThreads();
 
 		setRenderTarget(0, 0);
 		clipper = new Clipper(symmetricNormalizedDepth);
@@ -155,52 +219,53 @@ namespace sw
 		updateProjectionMatrix = true;
 		updateClipPlanes = true;
 
+		// Per-thread, per-unit and per-cluster state is allocated by initializeThreads()
+		worker = nullptr;
+		resume = nullptr;
+		suspend = nullptr;
+		task = nullptr;
+		vertexTask = nullptr;
+
+		triangleBatch = nullptr;
+		primitiveBatch = nullptr;
+		primitiveProgress = nullptr;
+		pixelProgress = nullptr;
+		tileProgress = nullptr;
+		tileGridColumns = 0;
+
+		taskDeque = nullptr;
+		taskCount = 0;
+		queuedTasks = 0;
+		pendingRoutine = nullptr;
+
 		#if PERF_HUD
-			resetTimers();
+			vertexTime = nullptr;
+			setupTime = nullptr;
+			pixelTime = nullptr;
 		#endif
 
-		for(int i = 0; i < 16; i++)
-		{
-			vertexTask[i] = 0;
-
-			worker[i] = 0;
-			resume[i] = 0;
-			suspend[i] = 0;
-		}
-
 		threadsAwake = 0;
 		resumeApp = new Event();
 
 		currentDraw = 0;
 		nextDraw = 0;
+		submissions = 0;
 
-		qHead = 0;
-		qSize = 0;
-
-		for(int i = 0; i < 16; i++)
-		{
-			triangleBatch[i] = 0;
-			primitiveBatch[i] = 0;
-		}
-
-		for(int draw = 0; draw < DRAW_COUNT; draw++)
-		{
-			drawCall[draw] = new DrawCall();
-			drawList[draw] = drawCall[draw];
-		}
-
-		for(int unit = 0; unit < 16; unit++)
-		{
-			primitiveProgress[unit].init();
-		}
-
-		for(int cluster = 0; cluster < 16; cluster++)
-		{
-			pixelProgress[cluster].init();
-		}
+		drawCall = nullptr;
+		drawCallCount = 0;
+		drawCallSearch = 0;
+		drawList = nullptr;
+		drawCount = 0;
+		drawCountBits = 0;
+		vertexCacheSize = 0;
 
 		clipFlags = 0;
 
+		vertexRoutine = nullptr;
+		setupRoutine = nullptr;
+		pixelRoutine = nullptr;
+		asyncRoutines = false;
+
 		swiftConfig = new SwiftConfig(disableServer);
 		updateConfiguration(true);
 
@@ -211,6 +276,9 @@ namespace sw
 	{
 		sync->destruct();
 
+		AsyncRoutine::waitForAll();   // Generators reference the routine caches
+		AsyncRoutine::releaseThreads();
+
 		delete clipper;
 		clipper = nullptr;
 
@@ -220,11 +288,19 @@ namespace sw
 		terminateThreads();
 		delete resumeApp;
 
-		for(int draw = 0; draw < DRAW_COUNT; draw++)
+		for(int draw = 0; draw < drawCallCount; draw++)
 		{
 			delete drawCall[draw];
 		}
 
+		delete[] drawCall;
+		delete[] drawList;
+
+		for(VertexWindow *window : vertexWindows)
+		{
+			delete window;
+		}
+
 		delete swiftConfig;
 	}
 
@@ -251,6 +327,12 @@ namespace sw
 
 		context->drawType = drawType;
 
+		// Large meshes which reuse their vertices get them shaded up front, in parallel, a window of primitives at a time
+		unsigned int indexRange = context->maxIndex - context->minIndex + 1;
+		context->bulkVertices = (drawType & 0x0F) == DRAW_TRIANGLELIST && (drawType & 0xF0) != DRAW_NONINDEXED &&
+		                        context->minIndex <= context->maxIndex && indexRange >= bulkVertexMin &&
+		                        3 * (uint64_t)count >= 2 * indexRange && context->instanceCount == 1;
+
 		updateConfiguration();
 		updateClipper();
 
@@ -279,6 +361,13 @@ namespace sw
 				vertexRoutine = VertexProcessor::routine(vertexState);
 				setupRoutine = SetupProcessor::routine(setupState);
 				pixelRoutine = PixelProcessor::routine(pixelState);
+				asyncRoutines = asyncRoutineCompilation;
+			}
+
+			if(tieredRoutineCompilation)
+			{
+				vertexRoutine = VertexProcessor::tierUp(vertexState, vertexRoutine);
+				pixelRoutine = PixelProcessor::tierUp(pixelState, pixelRoutine);
 			}
 
 			int batch = batchSize / ms;
@@ -318,24 +407,17 @@ namespace sw
 
 			do
 			{
-				for(int i = 0; i < DRAW_COUNT; i++)
-				{
-					if(drawCall[i]->references == -1)
-					{
-						draw = drawCall[i];
-						drawList[nextDraw & DRAW_COUNT_BITS] = draw;
-
-						break;
-					}
-				}
+				draw = allocateDrawCall();
 
-				if(!draw)
+				if(!draw)   // Queue full
 				{
 					resumeApp->wait();
 				}
 			}
 			while(!draw);
 
+			drawList[nextDraw & drawCountBits] = draw;
+
 			DrawData *data = draw->data;
 
 			if(queries.size() != 0)
@@ -362,9 +444,20 @@ namespace sw
 			draw->vertexRoutine = vertexRoutine;
 			draw->setupRoutine = setupRoutine;
 			draw->pixelRoutine = pixelRoutine;
-			draw->vertexPointer = (VertexProcessor::RoutinePointer)vertexRoutine->getEntry();
 			draw->setupPointer = (SetupProcessor::RoutinePointer)setupRoutine->getEntry();
-			draw->pixelPointer = (PixelProcessor::RoutinePointer)pixelRoutine->getEntry();
+
+			if(asyncRoutines)   // Don't wait for the routines to be generated
+			{
+				draw->vertexPointer = nullptr;
+				draw->pixelPointer = nullptr;
+				draw->routinesPending = true;
+			}
+			else
+			{
+				draw->vertexPointer = (VertexProcessor::RoutinePointer)vertexRoutine->getEntry();
+				draw->pixelPointer = (PixelProcessor::RoutinePointer)pixelRoutine->getEntry();
+				draw->routinesPending = false;
+			}
 			draw->setupPrimitives = setupPrimitives;
 			draw->setupState = setupState;
 
@@ -373,6 +466,7 @@ namespace sw
 				draw->vertexStream[i] = context->input[i].resource;
 				data->input[i] = context->input[i].buffer;
 				data->stride[i] = context->input[i].stride;
+				data->divisor[i] = context->input[i].divisor;
 
 				if(draw->vertexStream[i])
 				{
@@ -407,25 +501,31 @@ namespace sw
 
 			if(context->pixelShader)
 			{
-				if(draw->psDirtyConstF)
+				unsigned int dirtyConstF = max(draw->psDirtyConstF, psConstF.since(draw->psConstantsSubmission));
+				unsigned int dirtyConstI = max(draw->psDirtyConstI, psConstI.since(draw->psConstantsSubmission));
+				unsigned int dirtyConstB = max(draw->psDirtyConstB, psConstB.since(draw->psConstantsSubmission));
+
+				if(dirtyConstF)
 				{
-					memcpy(&data->ps.cW, PixelProcessor::cW, sizeof(word4) * 4 * (draw->psDirtyConstF < 8 ? draw->psDirtyConstF : 8));
-					memcpy(&data->ps.c, PixelProcessor::c, sizeof(float4) * draw->psDirtyConstF);
+					memcpy(&data->ps.cW, PixelProcessor::cW, sizeof(word4) * 4 * (dirtyConstF < 8 ? dirtyConstF : 8));
+					memcpy(&data->ps.c, PixelProcessor::c, sizeof(float4) * dirtyConstF);
 					draw->psDirtyConstF = 0;
 				}
 
-				if(draw->psDirtyConstI)
+				if(dirtyConstI)
 				{
-					memcpy(&data->ps.i, PixelProcessor::i, sizeof(int4) * draw->psDirtyConstI);
+					memcpy(&data->ps.i, PixelProcessor::i, sizeof(int4) * dirtyConstI);
 					draw->psDirtyConstI = 0;
 				}
 
-				if(draw->psDirtyConstB)
+				if(dirtyConstB)
 				{
-					memcpy(&data->ps.b, PixelProcessor::b, sizeof(bool) * draw->psDirtyConstB);
+					memcpy(&data->ps.b, PixelProcessor::b, sizeof(bool) * dirtyConstB);
 					draw->psDirtyConstB = 0;
 				}
 
+				draw->psConstantsSubmission = submissions;
+
 				PixelProcessor::lockUniformBuffers(data->ps.u, draw->pUniformBuffers);
 			}
 			else
@@ -466,28 +566,29 @@ namespace sw
 					}
 				}
 
-				if(draw->vsDirtyConstF)
+				unsigned int dirtyConstF = max(draw->vsDirtyConstF, vsConstF.since(draw->vsConstantsSubmission));
+				unsigned int dirtyConstI = max(draw->vsDirtyConstI, vsConstI.since(draw->vsConstantsSubmission));
+				unsigned int dirtyConstB = max(draw->vsDirtyConstB, vsConstB.since(draw->vsConstantsSubmission));
+
+				if(dirtyConstF)
 				{
-					memcpy(&data->vs.c, VertexProcessor::c, sizeof(float4) * draw->vsDirtyConstF);
+					memcpy(&data->vs.c, VertexProcessor::c, sizeof(float4) * dirtyConstF);
 					draw->vsDirtyConstF = 0;
 				}
 
-				if(draw->vsDirtyConstI)
+				if(dirtyConstI)
 				{
-					memcpy(&data->vs.i, VertexProcessor::i, sizeof(int4) * draw->vsDirtyConstI);
+					memcpy(&data->vs.i, VertexProcessor::i, sizeof(int4) * dirtyConstI);
 					draw->vsDirtyConstI = 0;
 				}
 
-				if(draw->vsDirtyConstB)
+				if(dirtyConstB)
 				{
-					memcpy(&data->vs.b, VertexProcessor::b, sizeof(bool) * draw->vsDirtyConstB);
+					memcpy(&data->vs.b, VertexProcessor::b, sizeof(bool) * dirtyConstB);
 					draw->vsDirtyConstB = 0;
 				}
 
-				if(context->vertexShader->isInstanceIdDeclared())
-				{
-					data->instanceID = context->instanceID;
-				}
+				draw->vsConstantsSubmission = submissions;
 
 				VertexProcessor::lockUniformBuffers(data->vs.u, draw->vUniformBuffers);
 				VertexProcessor::lockTransformFeedbackBuffers(data->vs.t, data->vs.reg, data->vs.row, data->vs.col, data->vs.str, draw->transformFeedbackBuffers);
@@ -564,7 +665,7 @@ namespace sw
 				{
 					for(int i = 0; i < PERF_TIMERS; i++)
 					{
-						data->cycles[i][cluster] = 0;
+						data->cycles[i * clusterCount + cluster] = 0;
 					}
 				}
 			#endif
@@ -649,6 +750,9 @@ namespace sw
 						data->colorBuffer[index] += q * ms * context->renderTarget[index]->getSliceB(true);
 						data->colorPitchB[index] = context->renderTarget[index]->getInternalPitchB();
 						data->colorSliceB[index] = context->renderTarget[index]->getInternalSliceB();
+
+						// Primitives are clipped to the scissor rectangle
+						context->renderTarget[index]->addDamage(scissor);
 					}
 				}
 
@@ -663,6 +767,21 @@ namespace sw
 					data->depthBuffer += q * ms * context->depthBuffer->getSliceB(true);
 					data->depthPitchB = context->depthBuffer->getInternalPitchB();
 					data->depthSliceB = context->depthBuffer->getInternalSliceB();
+
+					if(pixelState.hiZ)
+					{
+						int hiZTileSize = 8 << pixelState.hiZTileShift;
+
+						data->hiZ = context->depthBuffer->getHiZ(hiZTileSize);
+						data->hiZPitch = context->depthBuffer->getHiZPitch(hiZTileSize);
+						data->hiZWidth = context->depthBuffer->getWidth();
+						data->hiZHeight = context->depthBuffer->getHeight();
+					}
+					else if(pixelState.depthWriteEnable)
+					{
+						// Without tiling no bounds are kept, so writes leave them stale
+						context->depthBuffer->invalidateHiZ();
+					}
 				}
 
 				if(draw->stencilBuffer)
@@ -684,14 +803,29 @@ namespace sw
 				data->scissorY1 = scissor.y1;
 			}
 
+			// Instances are laid out one after the other, with batches never straddling two of them
 			draw->primitive = 0;
-			draw->count = count;
+			draw->count = count * context->instanceCount;
+			draw->instancePrimitives = count;
+			draw->firstInstance = context->firstInstance;
 
-			draw->references = (count + batch - 1) / batch;
+			draw->bulkVertices = vertexState.bulkVertices;
 
-			schedulerMutex.lock();
+			if(draw->bulkVertices)
+			{
+				ASSERT(VertexWindow::PRIMITIVES % batch == 0);   // Batches don't straddle windows
+
+				draw->vertexWindowCount = (count + VertexWindow::PRIMITIVES - 1) / VertexWindow::PRIMITIVES;
+				draw->nextVertexWindow = 0;
+			}
+
+			draw->references = context->instanceCount * ((count + batch - 1) / batch);
+
+			++submissions;   // Later constant updates aren't in this draw call's data
 			++nextDraw; // Atomic
-			schedulerMutex.unlock();
+
+			// Pairs with the fence in scheduleTask() before threads suspend themselves
+			std::atomic_thread_fence(std::memory_order_seq_cst);
 
 			#ifndef NDEBUG
 			if(threadCount == 1)   // Use main thread for draw execution
@@ -706,12 +840,11 @@ namespace sw
 			{
 				if(!threadsAwake)
 				{
-					suspend[0]->wait();
-
-					threadsAwake = 1;
-					task[0].type = Task::RESUME;
-
-					resume[0]->signal();
+					// A thread which saw this draw call may still be undoing its suspension.
+					// The count is only exact while holding the scheduler mutex.
+					schedulerMutex.lock();
+					wakeThreads();
+					schedulerMutex.unlock();
 				}
 			}
 		}
@@ -772,8 +905,78 @@ namespace sw
 		}
 	}
 
-	void Renderer::findAvailableTasks()
+	void Renderer::TaskDeque::init(int capacity)
+	{
+		tasks = new Task[capacity];
+		mask = capacity - 1;
+		top = 0;
+		bottom = 0;
+	}
+
+	void Renderer::TaskDeque::free()
+	{
+		delete[] tasks;
+		tasks = nullptr;
+	}
+
+	void Renderer::TaskDeque::push(const Task &task)
 	{
+		int b = bottom.load(std::memory_order_relaxed);
+
+		tasks[b & mask] = task;
+
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	bool Renderer::TaskDeque::pop(Task &task)
+	{
+		int b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int t = top.load(std::memory_order_relaxed);
+
+		if(t > b)   // Empty
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		task = tasks[b & mask];
+
+		if(t == b)   // Last task, race against thieves
+		{
+			bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+
+			return won;
+		}
+
+		return true;
+	}
+
+	bool Renderer::TaskDeque::steal(Task &task)
+	{
+		int t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int b = bottom.load(std::memory_order_acquire);
+
+		if(t >= b)   // Empty
+		{
+			return false;
+		}
+
+		task = tasks[t & mask];
+
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	void Renderer::findAvailableTasks(int threadIndex)
+	{
+		TaskDeque &deque = taskDeque[threadIndex];
+
+		pendingRoutine = nullptr;
+
 		// Find pixel tasks
 		for(int cluster = 0; cluster < clusterCount; cluster++)
 		{
@@ -787,7 +990,7 @@ namespace sw
 						{
 							if(pixelProgress[cluster].processedPrimitives == primitiveProgress[unit].firstPrimitive)   // Previous primitives have been rendered
 							{
-								Task &task = taskQueue[qHead];
+								Task task;
 								task.type = Task::PIXELS;
 								task.primitiveUnit = unit;
 								task.pixelCluster = cluster;
@@ -795,8 +998,8 @@ namespace sw
 								pixelProgress[cluster].executing = true;
 
 								// Commit to the task queue
-								qHead = (qHead + 1) & TASK_COUNT_BITS;
-								qSize++;
+								deque.push(task);
+								++queuedTasks; // Atomic
 
 								break;
 							}
@@ -814,7 +1017,7 @@ namespace sw
 
 		for(int unit = 0; unit < unitCount; unit++)
 		{
-			DrawCall *draw = drawList[currentDraw & DRAW_COUNT_BITS];
+			DrawCall *draw = drawList[currentDraw & drawCountBits];
 
 			int primitive = draw->primitive;
 			int count = draw->count;
@@ -828,76 +1031,234 @@ namespace sw
 					return;   // No more primitives to process
 				}
 
-				draw = drawList[currentDraw & DRAW_COUNT_BITS];
+				draw = drawList[currentDraw & drawCountBits];
+			}
+
+			if(draw->routinesPending && !resolveRoutines(draw))
+			{
+				return;   // Draw calls are processed in order
+			}
+
+			if(draw->bulkVertices)   // Primitives are assembled from the vertices of their window
+			{
+				for(VertexWindow *&window : draw->vertexWindow)
+				{
+					if(window && window->references == 0)   // All its primitives gathered their vertices
+					{
+						releaseVertexWindow(window);
+						window = nullptr;
+					}
+				}
+
+				int next = draw->nextVertexWindow;
+				VertexWindow *&nextWindow = draw->vertexWindow[next % VertexWindow::IN_FLIGHT];
+
+				if(next < draw->vertexWindowCount && !nextWindow && !primitiveProgress[unit].references)
+				{
+					int windowPrimitives = min(draw->count - next * VertexWindow::PRIMITIVES, (int)VertexWindow::PRIMITIVES);
+
+					nextWindow = allocateVertexWindow();
+					nextWindow->index = next;
+					nextWindow->shaded = 0;
+					nextWindow->references = (windowPrimitives + draw->batchSize - 1) / draw->batchSize;
+					draw->nextVertexWindow = next + 1;
+
+					Task task;
+					task.type = Task::VERTICES;
+					task.primitiveUnit = unit;
+					task.vertexWindow = next;
+
+					primitiveProgress[unit].drawCall = currentDraw;
+					primitiveProgress[unit].references = -1;
+
+					// Commit to the task queue
+					deque.push(task);
+					++queuedTasks; // Atomic
+
+					continue;
+				}
+
+				int current = draw->primitive / VertexWindow::PRIMITIVES;
+				VertexWindow *window = draw->vertexWindow[current % VertexWindow::IN_FLIGHT];
+
+				if(!window || window->index != current || !window->shaded)
+				{
+					continue;   // Wait for the vertices of the next primitives
+				}
 			}
 
 			if(!primitiveProgress[unit].references)   // Task not already being executed and not still in use by a pixel unit
 			{
 				primitive = draw->primitive;
-				count = draw->count;
+				int instancePrimitives = draw->instancePrimitives;
 				int batch = draw->batchSize;
 
+				count = instancePrimitives - primitive % instancePrimitives;   // Remaining in this instance
+				batch = count >= batch ? batch : count;
+
 				primitiveProgress[unit].drawCall = currentDraw;
 				primitiveProgress[unit].firstPrimitive = primitive;
-				primitiveProgress[unit].primitiveCount = count - primitive >= batch ? batch : count - primitive;
+				primitiveProgress[unit].primitiveCount = batch;
 
 				draw->primitive += batch;
 
-				Task &task = taskQueue[qHead];
+				Task task;
 				task.type = Task::PRIMITIVES;
 				task.primitiveUnit = unit;
 
 				primitiveProgress[unit].references = -1;
 
 				// Commit to the task queue
-				qHead = (qHead + 1) & TASK_COUNT_BITS;
-				qSize++;
+				deque.push(task);
+				++queuedTasks; // Atomic
 			}
 		}
 	}
 
-	void Renderer::scheduleTask(int threadIndex)
+	bool Renderer::resolveRoutines(DrawCall *draw)
 	{
-		schedulerMutex.lock();
+		AsyncRoutine *vertexRoutine = static_cast<AsyncRoutine*>(draw->vertexRoutine);
+		AsyncRoutine *pixelRoutine = static_cast<AsyncRoutine*>(draw->pixelRoutine);
 
-		int curThreadsAwake = threadsAwake;
+		if(!vertexRoutine->isReady())
+		{
+			pendingRoutine = vertexRoutine;
+			return false;
+		}
 
-		if((int)qSize < threadCount - curThreadsAwake + 1)
+		if(!pixelRoutine->isReady())
 		{
-			findAvailableTasks();
+			pendingRoutine = pixelRoutine;
+			return false;
 		}
 
-		if(qSize != 0)
+		draw->vertexPointer = (VertexProcessor::RoutinePointer)vertexRoutine->getEntry();
+		draw->pixelPointer = (PixelProcessor::RoutinePointer)pixelRoutine->getEntry();
+		draw->routinesPending = false;
+
+		return true;
+	}
+
+	bool Renderer::acquireTask(int threadIndex)
+	{
+		// Take the most recently found task of this thread first, then steal the oldest tasks of other threads
+		if(taskDeque[threadIndex].pop(task[threadIndex]))
 		{
-			task[threadIndex] = taskQueue[(qHead - qSize) & TASK_COUNT_BITS];
-			qSize--;
+			--queuedTasks; // Atomic
+			return true;
+		}
 
-			if(curThreadsAwake != threadCount)
+		for(int i = 1; i < threadCount; i++)
+		{
+			int victim = (threadIndex + i) % threadCount;
+
+			if(taskDeque[victim].steal(task[threadIndex]))
 			{
-				int wakeup = qSize - curThreadsAwake + 1;
+				--queuedTasks; // Atomic
+				return true;
+			}
+		}
+
+		return false;
+	}
 
-				for(int i = 0; i < threadCount && wakeup > 0; i++)
+	void Renderer::wakeThreads()
+	{
+		// Must be called with the scheduler mutex held
+		int curThreadsAwake = threadsAwake;
+
+		if(curThreadsAwake != threadCount)
+		{
+			int wakeup = queuedTasks - curThreadsAwake + 1;
+
+			for(int i = 0; i < threadCount && wakeup > 0; i++)
+			{
+				if(task[i].type == Task::SUSPEND)
 				{
-					if(task[i].type == Task::SUSPEND)
-					{
-						suspend[i]->wait();
-						task[i].type = Task::RESUME;
-						resume[i]->signal();
+					suspend[i]->wait();
+					task[i].type = Task::RESUME;
+					resume[i]->signal();
 
-						++threadsAwake; // Atomic
-						wakeup--;
-					}
+					++threadsAwake; // Atomic
+					wakeup--;
 				}
 			}
 		}
-		else
+	}
+
+	void Renderer::scheduleTask(int threadIndex)
+	{
+		// Number of times to look for work before suspending the thread. Spinning briefly
+		// avoids a sleep and wake-up round trip for work that arrives shortly after.
+		const int spinCount = 64;
+
+		for(int attempt = 0; ; attempt++)
 		{
-			task[threadIndex].type = Task::SUSPEND;
+			if(acquireTask(threadIndex))
+			{
+				return;
+			}
 
-			--threadsAwake; // Atomic
-		}
+			bool suspendWhenIdle = (attempt >= spinCount);
+
+			if(suspendWhenIdle)
+			{
+				schedulerMutex.lock();
+			}
+			else if(!schedulerMutex.attemptLock())
+			{
+				Thread::yield();   // Another thread is finding tasks, try stealing them
+				continue;
+			}
+
+			int publishedDraws = nextDraw;
+
+			findAvailableTasks(threadIndex);
+
+			if(taskDeque[threadIndex].pop(task[threadIndex]))
+			{
+				--queuedTasks; // Atomic
+
+				wakeThreads();
+				schedulerMutex.unlock();
+
+				return;
+			}
+
+			if(pendingRoutine)   // Wait for it without holding up other threads
+			{
+				AsyncRoutine *routine = pendingRoutine;
+				schedulerMutex.unlock();
+
+				routine->wait();
+				attempt = 0;
+
+				continue;
+			}
+
+			if(suspendWhenIdle)
+			{
+				--threadsAwake; // Atomic
 
-		schedulerMutex.unlock();
+				// Draw calls are published without taking the scheduler mutex. Either this thread
+				// observes a new draw call here, or Renderer::draw() observes it being suspended.
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				if(nextDraw == publishedDraws)
+				{
+					task[threadIndex].type = Task::SUSPEND;
+					schedulerMutex.unlock();
+
+					return;
+				}
+
+				++threadsAwake; // Atomic
+				attempt = 0;
+			}
+
+			schedulerMutex.unlock();
+			Thread::yield();
+		}
 	}
 
 	void Renderer::executeTask(int threadIndex)
@@ -908,16 +1269,27 @@ namespace sw
 
 		switch(task[threadIndex].type)
 		{
+		case Task::VERTICES:
+			{
+				int unit = task[threadIndex].primitiveUnit;
+
+				processVertices(unit, task[threadIndex].vertexWindow, threadIndex);
+
+				#if PERF_HUD
+					vertexTime[threadIndex] += Timer::ticks() - startTick;
+				#endif
+			}
+			break;
 		case Task::PRIMITIVES:
 			{
 				int unit = task[threadIndex].primitiveUnit;
 
 				int input = primitiveProgress[unit].firstPrimitive;
 				int count = primitiveProgress[unit].primitiveCount;
-				DrawCall *draw = drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
+				DrawCall *draw = drawList[primitiveProgress[unit].drawCall & drawCountBits];
 				int (Renderer::*setupPrimitives)(int batch, int count) = draw->setupPrimitives;
 
-				processPrimitiveVertices(unit, input, count, draw->count, threadIndex);
+				processPrimitiveVertices(unit, input, count, draw->instancePrimitives, threadIndex);
 
 				#if PERF_HUD
 					int64_t time = Timer::ticks();
@@ -932,6 +1304,11 @@ namespace sw
 					visible = (this->*setupPrimitives)(unit, count);
 				}
 
+				if(tileSize != 0)
+				{
+					binPrimitives(unit, visible, draw->setupState.multiSample);
+				}
+
 				primitiveProgress[unit].visible = visible;
 				primitiveProgress[unit].references = clusterCount;
 
@@ -949,11 +1326,47 @@ namespace sw
 				{
 					int cluster = task[threadIndex].pixelCluster;
 					Primitive *primitive = primitiveBatch[unit];
-					DrawCall *draw = drawList[pixelProgress[cluster].drawCall & DRAW_COUNT_BITS];
+					DrawCall *draw = drawList[pixelProgress[cluster].drawCall & drawCountBits];
 					DrawData *data = draw->data;
 					PixelProcessor::RoutinePointer pixelRoutine = draw->pixelPointer;
 
-					pixelRoutine(primitive, visible, cluster, data);
+					// Fill in deferred clears of the rows covered by the primitives
+					int ms = draw->setupState.multiSample;
+					int yMin = primitive[0].yMin;
+					int yMax = primitive[0].yMax;
+
+					for(int i = 1; i < visible; i++)
+					{
+						yMin = min(yMin, primitive[i * ms].yMin);
+						yMax = max(yMax, primitive[i * ms].yMax);
+					}
+
+					for(int index = 0; index < RENDERTARGETS; index++)
+					{
+						if(draw->renderTarget[index])
+						{
+							draw->renderTarget[index]->materializeClears(yMin & ~1, yMax + 1);
+						}
+					}
+
+					if(draw->depthBuffer)
+					{
+						draw->depthBuffer->materializeClears(yMin & ~1, yMax + 1);
+					}
+
+					if(draw->stencilBuffer)
+					{
+						draw->stencilBuffer->materializeClears(yMin & ~1, yMax + 1);
+					}
+
+					if(tileSize != 0)
+					{
+						processTiles(unit, cluster, draw);
+					}
+					else
+					{
+						pixelRoutine(primitive, visible, cluster, 0, data);
+					}
 				}
 
 				finishRendering(task[threadIndex]);
@@ -978,12 +1391,89 @@ namespace sw
 		sync->unlock();
 	}
 
+	void Renderer::binPrimitives(int unit, int visible, int multiSample)
+	{
+		const int tileShift = log2(tileSize);
+		Primitive *primitive = primitiveBatch[unit];
+
+		int x0 = tileGridColumns;
+		int y0 = tileGridColumns;
+		int x1 = 0;
+		int y1 = 0;
+
+		for(int i = 0; i < visible; i++, primitive += multiSample)
+		{
+			if(primitive->yMin < primitive->yMax && primitive->xMin < primitive->xMax)
+			{
+				x0 = min(x0, primitive->xMin >> tileShift);
+				y0 = min(y0, primitive->yMin >> tileShift);
+				x1 = max(x1, ((primitive->xMax - 1) >> tileShift) + 1);
+				y1 = max(y1, ((primitive->yMax - 1) >> tileShift) + 1);
+			}
+		}
+
+		x0 = max(x0, 0);
+		y0 = max(y0, 0);
+		x1 = min(x1, tileGridColumns);
+		y1 = min(y1, tileGridColumns);
+
+		PrimitiveProgress &progress = primitiveProgress[unit];
+
+		progress.tileX0 = x0;
+		progress.tileY0 = y0;
+		progress.tileColumns = max(x1 - x0, 0);
+		progress.tileCount = max(x1 - x0, 0) * max(y1 - y0, 0);
+		progress.nextTile = 0;
+	}
+
+	void Renderer::processTiles(int unit, int cluster, DrawCall *draw)
+	{
+		PrimitiveProgress &progress = primitiveProgress[unit];
+		Primitive *primitive = primitiveBatch[unit];
+		int visible = progress.visible;
+
+		// Clusters take the next unclaimed tile until none are left, so work stays balanced
+		// however the primitives are spread over the screen. Each tile holds a ticket queue,
+		// which keeps the batches overlapping it in order.
+		while(true)
+		{
+			progress.tileMutex.lock();
+
+			int index = progress.nextTile;
+
+			if(index >= progress.tileCount)
+			{
+				progress.tileMutex.unlock();
+				break;
+			}
+
+			progress.nextTile = index + 1;
+
+			int tx = progress.tileX0 + index % progress.tileColumns;
+			int ty = progress.tileY0 + index / progress.tileColumns;
+			TileProgress &tile = tileProgress[ty * tileGridColumns + tx];
+			int ticket = tile.issued++ - 1;   // Atomic
+
+			progress.tileMutex.unlock();
+
+			// Claims are issued in batch order, and the earlier ones are already being rendered
+			while(tile.completed != ticket)
+			{
+				Thread::yield();
+			}
+
+			draw->pixelPointer(primitive, visible, cluster, ty << 16 | tx, draw->data);
+
+			++tile.completed;   // Atomic
+		}
+	}
+
 	void Renderer::finishRendering(Task &pixelTask)
 	{
 		int unit = pixelTask.primitiveUnit;
 		int cluster = pixelTask.pixelCluster;
 
-		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
+		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & drawCountBits];
 		DrawData &data = *draw.data;
 		int primitive = primitiveProgress[unit].firstPrimitive;
 		int count = primitiveProgress[unit].primitiveCount;
@@ -1010,7 +1500,7 @@ namespace sw
 					{
 						for(int i = 0; i < PERF_TIMERS; i++)
 						{
-							profiler.cycles[i] += data.cycles[i][cluster];
+							profiler.cycles[i] += data.cycles[i * clusterCount + cluster];
 						}
 					}
 				#endif
@@ -1100,6 +1590,15 @@ namespace sw
 					}
 				}
 
+				for(VertexWindow *&window : draw.vertexWindow)
+				{
+					if(window)
+					{
+						releaseVertexWindow(window);
+						window = nullptr;
+					}
+				}
+
 				draw.vertexRoutine->unbind();
 				draw.setupRoutine->unbind();
 				draw.pixelRoutine->unbind();
@@ -1114,21 +1613,161 @@ namespace sw
 		pixelProgress[cluster].executing = false;
 	}
 
+	void Renderer::processVertices(int unit, int index, int thread)
+	{
+		DrawCall *draw = drawList[primitiveProgress[unit].drawCall & drawCountBits];
+		VertexWindow *window = draw->vertexWindow[index % VertexWindow::IN_FLIGHT];
+		VertexTask *task = vertexTask[thread];
+
+		unsigned int start = index * VertexWindow::PRIMITIVES;
+		unsigned int count = 3 * min((unsigned int)draw->count - start, (unsigned int)VertexWindow::PRIMITIVES);
+		unsigned int indices[3 * VertexWindow::PRIMITIVES];
+
+		switch(draw->drawType)
+		{
+		case DRAW_INDEXEDTRIANGLELIST8:
+			{
+				const unsigned char *source = (const unsigned char*)draw->data->indices + 3 * start;
+
+				for(unsigned int i = 0; i < count; i++)
+				{
+					indices[i] = source[i];
+				}
+			}
+			break;
+		case DRAW_INDEXEDTRIANGLELIST16:
+			{
+				const unsigned short *source = (const unsigned short*)draw->data->indices + 3 * start;
+
+				for(unsigned int i = 0; i < count; i++)
+				{
+					indices[i] = source[i];
+				}
+			}
+			break;
+		case DRAW_INDEXEDTRIANGLELIST32:
+			{
+				const unsigned int *source = (const unsigned int*)draw->data->indices + 3 * start;
+
+				for(unsigned int i = 0; i < count; i++)
+				{
+					indices[i] = source[i];
+				}
+			}
+			break;
+		default:
+			ASSERT(false);
+			return;
+		}
+
+		// Give each referenced group of four indices a slot, in order of first use. The hash
+		// table is kept under half full, so linear probing stays short.
+		const int tableBits = 11;
+		static_assert((1 << tableBits) >= 2 * VertexWindow::MAX_QUADS, "Hash table too small");
+
+		unsigned int key[1 << tableBits] = {};   // Group of four plus one, zero when empty
+		unsigned short quadSlot[1 << tableBits];
+		unsigned int quadCount = 0;
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			unsigned int quad = indices[i] >> 2;
+			unsigned int hash = (quad * 0x9E3779B1u) >> (32 - tableBits);
+
+			while(key[hash] != 0 && key[hash] != quad + 1)
+			{
+				hash = (hash + 1) & ((1 << tableBits) - 1);
+			}
+
+			if(key[hash] == 0)
+			{
+				key[hash] = quad + 1;
+				quadSlot[hash] = quadCount;
+				window->quad[quadCount++] = quad << 2;
+			}
+
+			window->slot[i] = quadSlot[hash] * 4 + (indices[i] & 3);
+		}
+
+		task->vertexCount = 4 * quadCount;
+		task->primitiveStart = 0;
+		task->instanceID = draw->firstInstance;
+
+		draw->vertexPointer(window->vertex, window->quad, task, draw->data);
+
+		window->shaded = 1;
+		primitiveProgress[unit].references = 0;
+	}
+
+	VertexWindow *Renderer::allocateVertexWindow()
+	{
+		vertexWindowMutex.lock();
+
+		VertexWindow *window = nullptr;
+
+		if(!vertexWindows.empty())
+		{
+			window = vertexWindows.back();
+			vertexWindows.pop_back();
+		}
+
+		vertexWindowMutex.unlock();
+
+		return window ? window : new VertexWindow;
+	}
+
+	void Renderer::releaseVertexWindow(VertexWindow *window)
+	{
+		vertexWindowMutex.lock();
+
+		if(vertexWindows.size() < vertexWindowPoolSize)
+		{
+			vertexWindows.push_back(window);
+			window = nullptr;
+		}
+
+		vertexWindowMutex.unlock();
+
+		delete window;
+	}
+
 	void Renderer::processPrimitiveVertices(int unit, unsigned int start, unsigned int triangleCount, unsigned int loop, int thread)
 	{
 		Triangle *triangle = triangleBatch[unit];
 		int primitiveDrawCall = primitiveProgress[unit].drawCall;
-		DrawCall *draw = drawList[primitiveDrawCall & DRAW_COUNT_BITS];
+		DrawCall *draw = drawList[primitiveDrawCall & drawCountBits];
 		DrawData *data = draw->data;
 		VertexTask *task = vertexTask[thread];
 
 		const void *indices = data->indices;
 		VertexProcessor::RoutinePointer vertexRoutine = draw->vertexPointer;
 
-		if(task->vertexCache.drawCall != primitiveDrawCall)
+		unsigned int instance = start / loop;
+		unsigned int primitiveNumber = start;   // Across all instances, for transform feedback
+		start -= instance * loop;
+		instance += draw->firstInstance;
+
+		if(task->vertexCache.drawCall != primitiveDrawCall || task->instanceID != instance)
 		{
 			task->vertexCache.clear();
 			task->vertexCache.drawCall = primitiveDrawCall;
+			task->instanceID = instance;
+		}
+
+		if(draw->bulkVertices)   // Gather the vertices shaded for the window
+		{
+			VertexWindow *window = draw->vertexWindow[(start / VertexWindow::PRIMITIVES) % VertexWindow::IN_FLIGHT];
+			const unsigned short *slot = &window->slot[3 * (start % VertexWindow::PRIMITIVES)];
+			Vertex *vertex = &triangle->v0;
+
+			for(unsigned int i = 0; i < triangleCount * 3; i++)
+			{
+				vertex[i] = window->vertex[slot[i]];
+			}
+
+			--window->references;   // Atomic
+
+			return;
 		}
 
 		unsigned int batch[128][3];   // FIXME: Adjust to dynamic batch size
@@ -1556,9 +2195,14 @@ namespace sw
 			return;
 		}
 
-		task->primitiveStart = start;
+		task->primitiveStart = primitiveNumber;
 		task->vertexCount = triangleCount * 3;
 		vertexRoutine(&triangle->v0, (unsigned int*)&batch, task, data);
+
+		profiler.vertexCacheLookups += task->vertexCache.lookups;
+		profiler.vertexCacheMisses += task->vertexCache.misses;
+		task->vertexCache.lookups = 0;
+		task->vertexCache.misses = 0;
 	}
 
 	int Renderer::setupSolidTriangles(int unit, int count)
@@ -1566,7 +2210,7 @@ namespace sw
 		Triangle *triangle = triangleBatch[unit];
 		Primitive *primitive = primitiveBatch[unit];
 
-		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
+		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & drawCountBits];
 		SetupProcessor::State &state = draw.setupState;
 		const SetupProcessor::RoutinePointer &setupRoutine = draw.setupPointer;
 
@@ -1612,7 +2256,7 @@ namespace sw
 		Primitive *primitive = primitiveBatch[unit];
 		int visible = 0;
 
-		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
+		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & drawCountBits];
 		SetupProcessor::State &state = draw.setupState;
 
 		const Vertex &v0 = triangle[0].v0;
@@ -1669,7 +2313,7 @@ namespace sw
 		Primitive *primitive = primitiveBatch[unit];
 		int visible = 0;
 
-		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
+		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & drawCountBits];
 		SetupProcessor::State &state = draw.setupState;
 
 		const Vertex &v0 = triangle[0].v0;
@@ -1713,7 +2357,7 @@ namespace sw
 		Primitive *primitive = primitiveBatch[unit];
 		int visible = 0;
 
-		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
+		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & drawCountBits];
 		SetupProcessor::State &state = draw.setupState;
 
 		int ms = state.multiSample;
@@ -1738,7 +2382,7 @@ namespace sw
 		Primitive *primitive = primitiveBatch[unit];
 		int visible = 0;
 
-		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
+		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & drawCountBits];
 		SetupProcessor::State &state = draw.setupState;
 
 		int ms = state.multiSample;
@@ -2034,20 +2678,73 @@ namespace sw
 	void Renderer::initializeThreads()
 	{
 		unitCount = ceilPow2(threadCount);
-		clusterCount = ceilPow2(threadCount);
+		clusterCount = threadCount;   // Need not be a power of 2
+
+		// Blits and surface decodes split their work over as many threads as rendering
+		acquireParallelFor(threadCount);
+
+		triangleBatch = new Triangle*[unitCount];
+		primitiveBatch = new Primitive*[unitCount];
+		primitiveProgress = new PrimitiveProgress[unitCount];
 
 		for(int i = 0; i < unitCount; i++)
 		{
 			triangleBatch[i] = (Triangle*)allocate(batchSize * sizeof(Triangle));
 			primitiveBatch[i] = (Primitive*)allocate(batchSize * sizeof(Primitive));
+			primitiveProgress[i].init();
+		}
+
+		pixelProgress = new PixelProgress[clusterCount];
+
+		for(int cluster = 0; cluster < clusterCount; cluster++)
+		{
+			pixelProgress[cluster].init();
+			pixelProgress[cluster].drawCall = nextDraw;   // All previous draw calls have completed
 		}
 
+		if(tileSize != 0)
+		{
+			tileGridColumns = OUTLINE_RESOLUTION / tileSize;
+			tileProgress = new TileProgress[tileGridColumns * tileGridColumns];
+
+			for(int tile = 0; tile < tileGridColumns * tileGridColumns; tile++)
+			{
+				tileProgress[tile].issued = 0;
+				tileProgress[tile].completed = 0;
+			}
+		}
+
+		taskCount = ceilPow2(unitCount + clusterCount);
+		queuedTasks = 0;
+
+		for(int draw = 0; draw < drawCallCount; draw++)
+		{
+			drawCall[draw]->setClusterCount(clusterCount);
+		}
+
+		worker = new Thread*[threadCount];
+		resume = new Event*[threadCount];
+		suspend = new Event*[threadCount];
+		task = new Task[threadCount];
+		taskDeque = new TaskDeque[threadCount];
+		vertexTask = new VertexTask*[threadCount];
+
+		#if PERF_HUD
+			vertexTime = new int64_t[threadCount];
+			setupTime = new int64_t[threadCount];
+			pixelTime = new int64_t[threadCount];
+
+			resetTimers();
+		#endif
+
 		for(int i = 0; i < threadCount; i++)
 		{
 			vertexTask[i] = (VertexTask*)allocate(sizeof(VertexTask));
-			vertexTask[i]->vertexCache.drawCall = -1;
+			vertexTask[i]->vertexCache.init(vertexCacheSize);
+			vertexTask[i]->instanceID = 0;
 
 			task[i].type = Task::SUSPEND;
+			taskDeque[i].init(taskCount);
 
 			resume[i] = new Event();
 			suspend[i] = new Event();
@@ -2064,6 +2761,74 @@ namespace sw
 		}
 	}
 
+	void Renderer::setDrawCallQueueSize(int size)
+	{
+		// Only called while the worker threads are idle
+		size = ceilPow2(clamp(size, 16, 65536));
+
+		if(size == drawCount)
+		{
+			return;
+		}
+
+		for(int draw = size; draw < drawCallCount; draw++)
+		{
+			delete drawCall[draw];
+		}
+
+		DrawCall **pool = new DrawCall*[size];
+
+		for(int draw = 0; draw < size; draw++)
+		{
+			pool[draw] = (draw < drawCallCount) ? drawCall[draw] : nullptr;
+		}
+
+		delete[] drawCall;
+		drawCall = pool;
+		drawCallCount = min(drawCallCount, size);
+		drawCallSearch = 0;
+
+		delete[] drawList;
+		drawList = new DrawCall*[size];
+		drawCount = size;
+		drawCountBits = size - 1;
+
+		// All previous draw calls have completed, so none of the old ring entries are needed
+		currentDraw = nextDraw;
+	}
+
+	DrawCall *Renderer::allocateDrawCall()
+	{
+		// Reuse a retired draw call, starting where the last search left off
+		for(int i = 0; i < drawCallCount; i++)
+		{
+			int index = drawCallSearch + i;
+
+			if(index >= drawCallCount)
+			{
+				index -= drawCallCount;
+			}
+
+			if(drawCall[index]->references == -1)
+			{
+				drawCallSearch = (index + 1 < drawCallCount) ? index + 1 : 0;
+
+				return drawCall[index];
+			}
+		}
+
+		if(drawCallCount == drawCount)
+		{
+			return nullptr;   // Every slot of the ring is in flight
+		}
+
+		DrawCall *draw = new DrawCall();
+		draw->setClusterCount(clusterCount);
+		drawCall[drawCallCount++] = draw;
+
+		return draw;
+	}
+
 	void Renderer::terminateThreads()
 	{
 		while(threadsAwake != 0)
@@ -2071,6 +2836,11 @@ namespace sw
 			Thread::sleep(1);
 		}
 
+		if(!worker)
+		{
+			return;   // Threads not initialized
+		}
+
 		for(int thread = 0; thread < threadCount; thread++)
 		{
 			if(worker[thread])
@@ -2087,18 +2857,53 @@ namespace sw
 				suspend[thread] = 0;
 			}
 
+			vertexTask[thread]->vertexCache.free();
 			deallocate(vertexTask[thread]);
 			vertexTask[thread] = 0;
+
+			taskDeque[thread].free();
 		}
 
-		for(int i = 0; i < 16; i++)
+		releaseParallelFor();
+
+		for(int i = 0; i < unitCount; i++)
 		{
 			deallocate(triangleBatch[i]);
-			triangleBatch[i] = 0;
-
 			deallocate(primitiveBatch[i]);
-			primitiveBatch[i] = 0;
 		}
+
+		delete[] worker;
+		worker = nullptr;
+		delete[] resume;
+		resume = nullptr;
+		delete[] suspend;
+		suspend = nullptr;
+		delete[] task;
+		task = nullptr;
+		delete[] taskDeque;
+		taskDeque = nullptr;
+		delete[] vertexTask;
+		vertexTask = nullptr;
+
+		delete[] triangleBatch;
+		triangleBatch = nullptr;
+		delete[] primitiveBatch;
+		primitiveBatch = nullptr;
+		delete[] primitiveProgress;
+		primitiveProgress = nullptr;
+		delete[] pixelProgress;
+		pixelProgress = nullptr;
+		delete[] tileProgress;
+		tileProgress = nullptr;
+
+		#if PERF_HUD
+			delete[] vertexTime;
+			vertexTime = nullptr;
+			delete[] setupTime;
+			setupTime = nullptr;
+			delete[] pixelTime;
+			pixelTime = nullptr;
+		#endif
 	}
 
 	void Renderer::loadConstants(const VertexShader *vertexShader)
@@ -2192,6 +2997,16 @@ namespace sw
 	void Renderer::setIndexBuffer(Resource *indexBuffer)
 	{
 		context->indexBuffer = indexBuffer;
+
+		// Unknown until specified
+		context->minIndex = 1;
+		context->maxIndex = 0;
+	}
+
+	void Renderer::setIndexRange(unsigned int minIndex, unsigned int maxIndex)
+	{
+		context->minIndex = minIndex;
+		context->maxIndex = maxIndex;
 	}
 
 	void Renderer::setMultiSampleMask(unsigned int mask)
@@ -2563,13 +3378,7 @@ namespace sw
 
 	void Renderer::setPixelShaderConstantF(unsigned int index, const float value[4], unsigned int count)
 	{
-		for(unsigned int i = 0; i < DRAW_COUNT; i++)
-		{
-			if(drawCall[i]->psDirtyConstF < index + count)
-			{
-				drawCall[i]->psDirtyConstF = index + count;
-			}
-		}
+		psConstF.update(submissions, index + count);
 
 		for(unsigned int i = 0; i < count; i++)
 		{
@@ -2580,13 +3389,7 @@ namespace sw
 
 	void Renderer::setPixelShaderConstantI(unsigned int index, const int value[4], unsigned int count)
 	{
-		for(unsigned int i = 0; i < DRAW_COUNT; i++)
-		{
-			if(drawCall[i]->psDirtyConstI < index + count)
-			{
-				drawCall[i]->psDirtyConstI = index + count;
-			}
-		}
+		psConstI.update(submissions, index + count);
 
 		for(unsigned int i = 0; i < count; i++)
 		{
@@ -2597,13 +3400,7 @@ namespace sw
 
 	void Renderer::setPixelShaderConstantB(unsigned int index, const int *boolean, unsigned int count)
 	{
-		for(unsigned int i = 0; i < DRAW_COUNT; i++)
-		{
-			if(drawCall[i]->psDirtyConstB < index + count)
-			{
-				drawCall[i]->psDirtyConstB = index + count;
-			}
-		}
+		psConstB.update(submissions, index + count);
 
 		for(unsigned int i = 0; i < count; i++)
 		{
@@ -2614,13 +3411,7 @@ namespace sw
 
 	void Renderer::setVertexShaderConstantF(unsigned int index, const float value[4], unsigned int count)
 	{
-		for(unsigned int i = 0; i < DRAW_COUNT; i++)
-		{
-			if(drawCall[i]->vsDirtyConstF < index + count)
-			{
-				drawCall[i]->vsDirtyConstF = index + count;
-			}
-		}
+		vsConstF.update(submissions, index + count);
 
 		for(unsigned int i = 0; i < count; i++)
 		{
@@ -2631,13 +3422,7 @@ namespace sw
 
 	void Renderer::setVertexShaderConstantI(unsigned int index, const int value[4], unsigned int count)
 	{
-		for(unsigned int i = 0; i < DRAW_COUNT; i++)
-		{
-			if(drawCall[i]->vsDirtyConstI < index + count)
-			{
-				drawCall[i]->vsDirtyConstI = index + count;
-			}
-		}
+		vsConstI.update(submissions, index + count);
 
 		for(unsigned int i = 0; i < count; i++)
 		{
@@ -2648,13 +3433,7 @@ namespace sw
 
 	void Renderer::setVertexShaderConstantB(unsigned int index, const int *boolean, unsigned int count)
 	{
-		for(unsigned int i = 0; i < DRAW_COUNT; i++)
-		{
-			if(drawCall[i]->vsDirtyConstB < index + count)
-			{
-				drawCall[i]->vsDirtyConstB = index + count;
-			}
-		}
+		vsConstB.update(submissions, index + count);
 
 		for(unsigned int i = 0; i < count; i++)
 		{
@@ -2765,9 +3544,14 @@ namespace sw
 			SwiftConfig::Configuration configuration = {};
 			swiftConfig->getConfiguration(configuration);
 
+			AsyncRoutine::waitForAll();   // Generators use the current settings and routine caches
+
 			precacheVertex = !newConfiguration && configuration.precache;
 			precacheSetup = !newConfiguration && configuration.precache;
 			precachePixel = !newConfiguration && configuration.precache;
+			retainObjectCode = !newConfiguration && configuration.precache;   // Needed for storing new routines on disk
+			asyncRoutineCompilation = configuration.asyncRoutineCompilation;
+			tieredRoutineCompilation = configuration.tieredRoutineCompilation;
 
 			VertexProcessor::setRoutineCacheSize(configuration.vertexRoutineCacheSize);
 			PixelProcessor::setRoutineCacheSize(configuration.pixelRoutineCacheSize);
@@ -2789,6 +3573,7 @@ namespace sw
 			}
 
 			setPerspectiveCorrection(configuration.perspectiveCorrection);
+			compressedTextureSampling = configuration.compressedTextureSampling;
 
 			switch(configuration.transcendentalPrecision)
 			{
@@ -2844,6 +3629,19 @@ namespace sw
 			default: threadCount = configuration.threadCount; break;
 			}
 
+			setDrawCallQueueSize(configuration.drawCallQueueSize);
+			vertexCacheSize = clamp(configuration.vertexCacheSize, 64, 4096);
+
+			switch(configuration.tileSize)
+			{
+			case 16:  tileSize = 16;  break;
+			case 32:  tileSize = 32;  break;
+			case 64:  tileSize = 64;  break;
+			case 128: tileSize = 128; break;
+			default:  tileSize = 0;   break;
+			}
+
+			CPUID::setEnableAVX2(configuration.enableAVX2);
 			CPUID::setEnableSSE4_1(configuration.enableSSE4_1);
 			CPUID::setEnableSSSE3(configuration.enableSSSE3);
 			CPUID::setEnableSSE3(configuration.enableSSE3);
@@ -2867,7 +3665,7 @@ namespace sw
 		#endif
 		}
 
-		if(!initialUpdate && !worker[0])
+		if(!initialUpdate && !worker)
 		{
 			initializeThreads();
 		}
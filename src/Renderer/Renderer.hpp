@@ -24,12 +24,15 @@
 #include "Common/Thread.hpp"
 #include "Main/Config.hpp"
 
+#include <atomic>
 #include <list>
+#include <vector>
 
 namespace sw
 {
 	class Clipper;
 	struct DrawCall;
+	struct VertexWindow;
 	class PixelShader;
 	class VertexShader;
 	class SwiftConfig;
@@ -126,6 +129,7 @@ namespace sw
 
 		const void *input[MAX_VERTEX_INPUTS];
 		unsigned int stride[MAX_VERTEX_INPUTS];
+		unsigned int divisor[MAX_VERTEX_INPUTS];
 		Texture mipmap[TOTAL_IMAGE_UNITS];
 		const void *indices;
 
@@ -159,8 +163,6 @@ namespace sw
 
 		PS ps;
 
-		int instanceID;
-
 		VertexProcessor::PointSprite point;
 		float lineWidth;
 
@@ -168,10 +170,10 @@ namespace sw
 		PixelProcessor::Stencil stencilCCW;
 		PixelProcessor::Fog fog;
 		PixelProcessor::Factor factor;
-		unsigned int occlusion[16];   // Number of pixels passing depth test
+		unsigned int *occlusion;   // Number of pixels passing depth test, per cluster
 
 		#if PERF_PROFILE
-			int64_t cycles[PERF_TIMERS][16];
+			int64_t *cycles;   // [PERF_TIMERS][clusterCount]
 		#endif
 
 		TextureStage::Uniforms textureStage[8];
@@ -196,6 +198,10 @@ namespace sw
 		float *depthBuffer;
 		int depthPitchB;
 		int depthSliceB;
+		float *hiZ;   // Per tile depth bounds
+		int hiZPitch;
+		int hiZWidth;
+		int hiZHeight;
 		unsigned char *stencilBuffer;
 		int stencilPitchB;
 		int stencilSliceB;
@@ -221,12 +227,31 @@ namespace sw
 		float maxZ;
 	};
 
+	// Records how far constants were modified before each submission, so that a draw call
+	// reused from the pool only copies the constants changed since it was last set up
+	class ConstantUpdates
+	{
+	public:
+		void update(uint64_t submission, unsigned int end);
+		unsigned int since(uint64_t submission) const;   // Highest end modified after the given submission
+
+	private:
+		struct Update
+		{
+			uint64_t submission;
+			unsigned int end;
+		};
+
+		std::vector<Update> updates;   // Only the latest update up to each end is kept, so ends decrease
+	};
+
 	class Renderer : public VertexProcessor, public PixelProcessor, public SetupProcessor
 	{
 		struct Task
 		{
 			enum Type
 			{
+				VERTICES,
 				PRIMITIVES,
 				PIXELS,
 
@@ -237,6 +262,27 @@ namespace sw
 			AtomicInt type;
 			AtomicInt primitiveUnit;
 			AtomicInt pixelCluster;
+			AtomicInt vertexWindow;
+		};
+
+		// Bounded work-stealing deque (Chase-Lev). Only the owning thread pushes and
+		// pops at the bottom, other threads steal from the top without locking.
+		class TaskDeque
+		{
+		public:
+			void init(int capacity);   // Must be a power of 2
+			void free();
+
+			void push(const Task &task);
+			bool pop(Task &task);
+			bool steal(Task &task);
+
+		private:
+			Task *tasks;
+			int mask;
+
+			std::atomic<int> top;
+			std::atomic<int> bottom;
 		};
 
 		struct PrimitiveProgress
@@ -248,6 +294,11 @@ namespace sw
 				primitiveCount = 0;
 				visible = 0;
 				references = 0;
+				tileX0 = 0;
+				tileY0 = 0;
+				tileColumns = 0;
+				tileCount = 0;
+				nextTile = 0;
 			}
 
 			AtomicInt drawCall;
@@ -255,6 +306,20 @@ namespace sw
 			AtomicInt primitiveCount;
 			AtomicInt visible;
 			AtomicInt references;
+
+			// Tiles overlapped by the visible primitives, claimed in raster order by the clusters
+			AtomicInt tileX0;
+			AtomicInt tileY0;
+			AtomicInt tileColumns;
+			AtomicInt tileCount;
+			AtomicInt nextTile;
+			MutexLock tileMutex;   // Claims and tile tickets are issued together
+		};
+
+		struct TileProgress
+		{
+			AtomicInt issued;      // Tickets handed to batches, in pixel processing order
+			AtomicInt completed;   // Batches rendered, so the ticket which can go next
 		};
 
 		struct PixelProgress
@@ -286,6 +351,7 @@ namespace sw
 		void blit3D(Surface *source, Surface *dest);
 
 		void setIndexBuffer(Resource *indexBuffer);
+		void setIndexRange(unsigned int minIndex, unsigned int maxIndex);
 
 		void setMultiSampleMask(unsigned int mask);
 		void setTransparencyAntialiasing(TransparencyAntialiasing transparencyAntialiasing);
@@ -363,16 +429,25 @@ namespace sw
 		#endif
 
 		static int getClusterCount() { return clusterCount; }
+		static int getTileSize() { return tileSize; }
 
 	private:
 		static void threadFunction(void *parameters);
 		void threadLoop(int threadIndex);
 		void taskLoop(int threadIndex);
-		void findAvailableTasks();
+		void findAvailableTasks(int threadIndex);
+		bool resolveRoutines(DrawCall *draw);
+		bool acquireTask(int threadIndex);
+		void wakeThreads();
 		void scheduleTask(int threadIndex);
 		void executeTask(int threadIndex);
 		void finishRendering(Task &pixelTask);
+		void binPrimitives(int unit, int visible, int multiSample);
+		void processTiles(int unit, int cluster, DrawCall *draw);
 
+		void processVertices(int unit, int index, int thread);
+		VertexWindow *allocateVertexWindow();
+		void releaseVertexWindow(VertexWindow *window);
 		void processPrimitiveVertices(int unit, unsigned int start, unsigned int count, unsigned int loop, int thread);
 
 		int setupSolidTriangles(int batch, int count);
@@ -389,6 +464,8 @@ namespace sw
 		void updateConfiguration(bool initialUpdate = false);
 		void initializeThreads();
 		void terminateThreads();
+		void setDrawCallQueueSize(int size);
+		DrawCall *allocateDrawCall();
 
 		void loadConstants(const VertexShader *vertexShader);
 		void loadConstants(const PixelShader *pixelShader);
@@ -400,8 +477,8 @@ namespace sw
 		Rect scissor;
 		int clipFlags;
 
-		Triangle *triangleBatch[16];
-		Primitive *primitiveBatch[16];
+		Triangle **triangleBatch;     // Per primitive unit
+		Primitive **primitiveBatch;   // Per primitive unit
 
 		// User-defined clipping planes
 		Plane userPlane[MAX_CLIP_PLANES];
@@ -410,45 +487,59 @@ namespace sw
 
 		AtomicInt exitThreads;
 		AtomicInt threadsAwake;
-		Thread *worker[16];
-		Event *resume[16];         // Events for resuming threads
-		Event *suspend[16];        // Events for suspending threads
+		Thread **worker;
+		Event **resume;            // Events for resuming threads
+		Event **suspend;           // Events for suspending threads
 		Event *resumeApp;          // Event for resuming the application thread
 
-		PrimitiveProgress primitiveProgress[16];
-		PixelProgress pixelProgress[16];
-		Task task[16];   // Current tasks for threads
+		PrimitiveProgress *primitiveProgress;   // Per primitive unit
+		PixelProgress *pixelProgress;           // Per pixel cluster
+		TileProgress *tileProgress;             // Per tile, for tile-based rasterization
+		int tileGridColumns;
+		Task *task;   // Current tasks for threads
 
-		enum {
-			DRAW_COUNT = 16,   // Number of draw calls buffered (must be power of 2)
-			DRAW_COUNT_BITS = DRAW_COUNT - 1,
-		};
-		DrawCall *drawCall[DRAW_COUNT];
-		DrawCall *drawList[DRAW_COUNT];
+		DrawCall **drawCall;   // Pool of draw calls, grown on demand up to drawCount
+		int drawCallCount;     // Number of draw calls allocated in the pool
+		int drawCallSearch;    // Pool index to start looking for a free draw call
+		DrawCall **drawList;   // Ring of draw calls in flight, indexed by draw number
+		int drawCount;         // Ring size (power of 2)
+		int drawCountBits;     // drawCount - 1
 
 		AtomicInt currentDraw;
 		AtomicInt nextDraw;
 
-		enum {
-			TASK_COUNT = 32,   // Size of the task queue (must be power of 2)
-			TASK_COUNT_BITS = TASK_COUNT - 1,
-		};
-		Task taskQueue[TASK_COUNT];
-		AtomicInt qHead;
-		AtomicInt qSize;
+		uint64_t submissions;   // Draw calls set up so far, tags the constant updates which follow
+		ConstantUpdates vsConstF;
+		ConstantUpdates vsConstI;
+		ConstantUpdates vsConstB;
+		ConstantUpdates psConstF;
+		ConstantUpdates psConstI;
+		ConstantUpdates psConstB;
+
+		TaskDeque *taskDeque;   // Per thread
+		int taskCount;          // Capacity of each deque (power of 2, holds a task for every unit and cluster)
+		AtomicInt queuedTasks;
+
+		int vertexCacheSize;   // Number of post-transform vertices cached by each thread
 
 		static AtomicInt unitCount;
 		static AtomicInt clusterCount;
+		static AtomicInt tileSize;   // Width and height of the tiles claimed by the clusters, 0 for interleaved scanlines
 
-		MutexLock schedulerMutex;
+		MutexLock schedulerMutex;   // Serializes finding new tasks, not taking them
+		AsyncRoutine *pendingRoutine;   // Still being generated, holding up the next draw call
 
 		#if PERF_HUD
-			int64_t vertexTime[16];
-			int64_t setupTime[16];
-			int64_t pixelTime[16];
+			int64_t *vertexTime;
+			int64_t *setupTime;
+			int64_t *pixelTime;
 		#endif
 
-		VertexTask *vertexTask[16];
+		VertexTask **vertexTask;
+
+		// Windows of bulk shaded vertices, kept for later draw calls
+		MutexLock vertexWindowMutex;
+		std::vector<VertexWindow*> vertexWindows;
 
 		SwiftConfig *swiftConfig;
 
@@ -462,6 +553,27 @@ namespace sw
 		Routine *vertexRoutine;
 		Routine *setupRoutine;
 		Routine *pixelRoutine;
+		bool asyncRoutines;   // Vertex and pixel routines are AsyncRoutines
+	};
+
+	// Vertices of a window of consecutive primitives of a bulk shaded draw call. Every
+	// group of four consecutive indices referenced by the window is shaded once.
+	struct VertexWindow
+	{
+		enum
+		{
+			PRIMITIVES = 256,   // Multiple of the batch size
+			MAX_QUADS = 3 * PRIMITIVES,
+			IN_FLIGHT = 4       // Windows of a draw call shaded or gathered from at a time
+		};
+
+		int index;              // Within the draw call
+		AtomicInt shaded;
+		AtomicInt references;   // Primitive batches yet to gather their vertices
+
+		unsigned int quad[MAX_QUADS];            // First index of each shaded group of four
+		unsigned short slot[3 * PRIMITIVES];    // Shaded vertex of each index of the primitives
+		Vertex vertex[4 * MAX_QUADS];
 	};
 
 	struct DrawCall
@@ -470,6 +582,8 @@ namespace sw
 
 		~DrawCall();
 
+		void setClusterCount(int clusterCount);   // Reallocates the per-cluster storage
+
 		AtomicInt drawType;
 		AtomicInt batchSize;
 
@@ -480,6 +594,7 @@ namespace sw
 		VertexProcessor::RoutinePointer vertexPointer;
 		SetupProcessor::RoutinePointer setupPointer;
 		PixelProcessor::RoutinePointer pixelPointer;
+		bool routinesPending;   // Vertex and pixel pointers are set by the scheduler once generated
 
 		int (Renderer::*setupPrimitives)(int batch, int count);
 		SetupProcessor::State setupState;
@@ -494,6 +609,7 @@ namespace sw
 		Resource* vUniformBuffers[MAX_UNIFORM_BUFFER_BINDINGS];
 		Resource* transformFeedbackBuffers[MAX_TRANSFORM_FEEDBACK_INTERLEAVED_COMPONENTS];
 
+		// Constants to copy regardless of their updates, for new draw calls and after fixed-function use
 		unsigned int vsDirtyConstF;
 		unsigned int vsDirtyConstI;
 		unsigned int vsDirtyConstB;
@@ -502,12 +618,23 @@ namespace sw
 		unsigned int psDirtyConstI;
 		unsigned int psDirtyConstB;
 
+		uint64_t vsConstantsSubmission;   // Submission which last copied the vertex shader constants
+		uint64_t psConstantsSubmission;
+
 		std::list<Query*> *queries;
 
 		AtomicInt clipFlags;
 
 		AtomicInt primitive;    // Current primitive to enter pipeline
-		AtomicInt count;        // Number of primitives to render
+		AtomicInt count;        // Number of primitives to render, for all instances
+		AtomicInt instancePrimitives;   // Number of primitives per instance
+		AtomicInt firstInstance;
+
+		// Vertices shaded in bulk ahead of primitive assembly, one window of primitives at a time
+		bool bulkVertices;
+		int vertexWindowCount;
+		int nextVertexWindow;   // Next window to be shaded, advanced by the scheduler
+		VertexWindow *vertexWindow[VertexWindow::IN_FLIGHT];   // Indexed by window modulo IN_FLIGHT, or null
 		AtomicInt references;   // Remaining references to this draw call, 0 when done drawing, -1 when resources unlocked and slot is free
 
 		DrawData *data;
@@ -0,0 +1,474 @@
+// Copyright 2016 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "RoutineCache.hpp"
+
+#include "Renderer.hpp"
+#include "Common/CPUID.hpp"
+#include "Common/Thread.hpp"
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace sw
+{
+	extern bool halfIntegerCoordinates;
+	extern bool symmetricNormalizedDepth;
+	extern bool booleanFaceRegister;
+	extern bool fullPixelPositionRegister;
+	extern bool leadingVertexFirst;
+	extern bool secondaryColor;
+	extern bool colorsDefaultToZero;
+
+	extern bool complementaryDepthBuffer;
+	extern bool postBlendSRGB;
+	extern bool exactColorRounding;
+	extern TransparencyAntialiasing transparencyAntialiasing;
+	extern bool forceClearRegisters;
+}
+
+#if defined(__linux__)
+namespace
+{
+	using namespace sw;
+
+	enum
+	{
+		ROUTINE_FILE_MAGIC = 0x43525753,   // "SWRC"
+		ROUTINE_FILE_VERSION = 1,
+	};
+
+	struct RoutineFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t keySize;
+		uint32_t codeSize;
+		uint64_t checksum;   // Of the key and the code
+	};
+
+	// Everything besides the processor state which gets baked into generated routines
+	struct RoutineSettings
+	{
+		unsigned char buildID[rr::BUILD_ID_SIZE];
+		int clusterCount;
+		int tileSize;
+		int precision[4];
+		int transparencyAntialiasing;
+		int optimization[10];
+		unsigned int cpuFeatures;
+		unsigned int flags;
+	};
+
+	RoutineSettings currentSettings()
+	{
+		RoutineSettings settings;
+		memset(&settings, 0, sizeof(settings));
+
+		memcpy(settings.buildID, rr::buildID(), sizeof(settings.buildID));
+
+		settings.clusterCount = Renderer::getClusterCount();
+		settings.tileSize = Renderer::getTileSize();
+		settings.precision[0] = logPrecision;
+		settings.precision[1] = expPrecision;
+		settings.precision[2] = rcpPrecision;
+		settings.precision[3] = rsqPrecision;
+		settings.transparencyAntialiasing = transparencyAntialiasing;
+
+		for(int pass = 0; pass < 10; pass++)
+		{
+			settings.optimization[pass] = rr::optimization[pass];
+		}
+
+		settings.cpuFeatures = rr::cpuFeatures<CPUID>();
+
+		settings.flags = halfIntegerCoordinates    << 0 |
+		                 symmetricNormalizedDepth  << 1 |
+		                 booleanFaceRegister       << 2 |
+		                 fullPixelPositionRegister << 3 |
+		                 leadingVertexFirst        << 4 |
+		                 secondaryColor            << 5 |
+		                 colorsDefaultToZero       << 6 |
+		                 complementaryDepthBuffer  << 7 |
+		                 postBlendSRGB             << 8 |
+		                 exactColorRounding        << 9 |
+		                 forceClearRegisters       << 10 |
+		                 perspectiveCorrection     << 11;
+
+		return settings;
+	}
+
+	std::string cacheDirectory()
+	{
+		const char *directory = getenv("SWIFTSHADER_ROUTINE_CACHE_DIR");
+
+		if(directory && *directory)
+		{
+			return directory;
+		}
+
+		const char *cacheHome = getenv("XDG_CACHE_HOME");
+
+		if(cacheHome && *cacheHome)
+		{
+			return std::string(cacheHome) + "/swiftshader";
+		}
+
+		const char *home = getenv("HOME");
+
+		if(home && *home)
+		{
+			return std::string(home) + "/.cache/swiftshader";
+		}
+
+		return "";
+	}
+
+	// Builds the full key and returns the file it is stored in
+	std::string routineFile(const char *precache, const void *state, size_t stateSize, uint64_t shaderHash, std::vector<unsigned char> &key)
+	{
+		RoutineSettings settings = currentSettings();
+
+		key.resize(sizeof(settings) + stateSize + sizeof(shaderHash));
+		memcpy(&key[0], &settings, sizeof(settings));
+		memcpy(&key[sizeof(settings)], state, stateSize);
+		memcpy(&key[sizeof(settings) + stateSize], &shaderHash, sizeof(shaderHash));
+
+		std::string directory = cacheDirectory();
+
+		if(directory.empty())
+		{
+			return "";
+		}
+
+		uint64_t digest = rr::hashBytes(0xCBF29CE484222325ull, precache, strlen(precache));
+		digest = rr::hashBytes(digest, &key[0], key.size());
+
+		char name[32];
+		snprintf(name, sizeof(name), "-%016llx.bin", (unsigned long long)digest);
+
+		return directory + "/" + precache + name;
+	}
+}
+#endif
+
+namespace sw
+{
+	Routine *loadPersistentRoutine(const char *precache, const void *state, size_t stateSize, uint64_t shaderHash)
+	{
+		#if defined(__linux__)
+			std::vector<unsigned char> key;
+			std::string path = routineFile(precache, state, stateSize, shaderHash, key);
+
+			if(path.empty())
+			{
+				return nullptr;
+			}
+
+			int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+			if(file == -1)
+			{
+				return nullptr;
+			}
+
+			struct stat status;
+			Routine *routine = nullptr;
+
+			if(fstat(file, &status) == 0 && (size_t)status.st_size > sizeof(RoutineFileHeader))
+			{
+				size_t size = status.st_size;
+				void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+				if(mapping != MAP_FAILED)
+				{
+					const RoutineFileHeader *header = static_cast<const RoutineFileHeader*>(mapping);
+					const unsigned char *fileKey = reinterpret_cast<const unsigned char*>(header + 1);
+					const unsigned char *code = fileKey + key.size();
+
+					if(header->magic == ROUTINE_FILE_MAGIC &&
+					   header->version == ROUTINE_FILE_VERSION &&
+					   header->keySize == key.size() &&
+					   header->codeSize != 0 &&
+					   sizeof(RoutineFileHeader) + header->keySize + header->codeSize == size &&
+					   memcmp(fileKey, &key[0], key.size()) == 0 &&
+					   rr::hashBytes(0xCBF29CE484222325ull, fileKey, header->keySize + header->codeSize) == header->checksum)
+					{
+						routine = Nucleus::loadRoutine(code, header->codeSize);
+					}
+
+					munmap(mapping, size);
+				}
+			}
+
+			close(file);
+
+			return routine;
+		#else
+			return nullptr;
+		#endif
+	}
+
+	void storePersistentRoutine(const char *precache, const void *state, size_t stateSize, uint64_t shaderHash, Routine *routine)
+	{
+		#if defined(__linux__)
+			size_t codeSize = 0;
+			const void *code = routine->getObjectCode(codeSize);
+
+			if(!code)
+			{
+				return;
+			}
+
+			std::vector<unsigned char> key;
+			std::string path = routineFile(precache, state, stateSize, shaderHash, key);
+
+			if(path.empty())
+			{
+				return;
+			}
+
+			RoutineFileHeader header;
+			header.magic = ROUTINE_FILE_MAGIC;
+			header.version = ROUTINE_FILE_VERSION;
+			header.keySize = (uint32_t)key.size();
+			header.codeSize = (uint32_t)codeSize;
+			header.checksum = rr::hashBytes(rr::hashBytes(0xCBF29CE484222325ull, &key[0], key.size()), code, codeSize);
+
+			// Create the directory and its parent, if needed
+			std::string directory = path.substr(0, path.rfind('/'));
+			std::string parent = directory.substr(0, directory.rfind('/'));
+			mkdir(parent.c_str(), 0700);
+			mkdir(directory.c_str(), 0700);
+
+			// Write to a temporary file and rename it, so other processes never see partial files
+			char suffix[32];
+			snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+			std::string temporary = path + suffix;
+
+			int file = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+			if(file == -1)
+			{
+				return;
+			}
+
+			bool written = write(file, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+			               write(file, &key[0], key.size()) == (ssize_t)key.size() &&
+			               write(file, code, codeSize) == (ssize_t)codeSize;
+
+			close(file);
+
+			if(!written || rename(temporary.c_str(), path.c_str()) != 0)
+			{
+				unlink(temporary.c_str());
+			}
+		#endif
+	}
+}
+
+namespace
+{
+	using namespace sw;
+
+	// Routines waiting for a generation thread. Generation threads are started on first
+	// use and joined when the last renderer is destroyed.
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::condition_variable idleCondition;
+	std::deque<AsyncRoutine*> generationQueue;
+	int pendingRoutines = 0;   // Queued or being generated
+	std::vector<Thread*> generationThreads;
+	int threadUsers = 0;
+	int threadGeneration = 0;   // Threads started before the last release exit once idle
+}
+
+namespace sw
+{
+	bool asyncRoutineCompilation = false;
+	bool tieredRoutineCompilation = false;
+
+	AsyncRoutine::AsyncRoutine(const std::function<Routine*()> &generator, bool optimized, AsyncRoutine *fallback) : generator(generator), routine(nullptr), fallback(fallback), ready(false)
+	{
+		this->optimized = optimized;
+
+		if(fallback)
+		{
+			fallback->bind();   // Draw calls may use its code until this routine is released
+		}
+
+		bind();   // Held by the creator, since generation may complete before it gets cached
+		bind();   // Held by the queue until generated
+
+		std::unique_lock<std::mutex> lock(queueMutex);
+
+		if(generationThreads.empty())
+		{
+			int threadCount = clamp(CPUID::processAffinity() / 2, 1, 4);
+			void *generation = reinterpret_cast<void*>(static_cast<intptr_t>(threadGeneration));
+
+			for(int i = 0; i < threadCount; i++)
+			{
+				generationThreads.push_back(new Thread(generationThread, generation));
+			}
+		}
+
+		generationQueue.push_back(this);
+		pendingRoutines++;
+		queueCondition.notify_one();
+	}
+
+	AsyncRoutine::AsyncRoutine(Routine *routine) : routine(routine), fallback(nullptr), ready(true)
+	{
+		optimized = routine->isOptimized();
+		routine->bind();
+
+		bind();   // Held by the creator
+	}
+
+	AsyncRoutine::~AsyncRoutine()
+	{
+		if(routine)
+		{
+			routine->unbind();
+		}
+
+		if(fallback)
+		{
+			fallback->unbind();
+		}
+	}
+
+	const void *AsyncRoutine::getEntry()
+	{
+		if(!ready && fallback && fallback->isReady())
+		{
+			return fallback->getEntry();
+		}
+
+		wait();
+
+		return routine->getEntry();
+	}
+
+	const void *AsyncRoutine::getObjectCode(size_t &size)
+	{
+		wait();
+
+		return routine->getObjectCode(size);
+	}
+
+	bool AsyncRoutine::isReady() const
+	{
+		return ready || (fallback && fallback->isReady());   // The fallback can be used in the meantime
+	}
+
+	void AsyncRoutine::wait()
+	{
+		if(!ready)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			readyCondition.wait(lock, [this]() { return ready.load(); });
+		}
+	}
+
+	void AsyncRoutine::waitForAll()
+	{
+		std::unique_lock<std::mutex> lock(queueMutex);
+		idleCondition.wait(lock, []() { return pendingRoutines == 0; });
+	}
+
+	void AsyncRoutine::acquireThreads()
+	{
+		std::unique_lock<std::mutex> lock(queueMutex);
+		threadUsers++;
+	}
+
+	void AsyncRoutine::releaseThreads()
+	{
+		std::vector<Thread*> threads;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+
+			if(--threadUsers > 0)
+			{
+				return;
+			}
+
+			threadGeneration++;
+			queueCondition.notify_all();
+			threads.swap(generationThreads);
+		}
+
+		for(Thread *thread : threads)
+		{
+			thread->join();
+			delete thread;
+		}
+	}
+
+	void AsyncRoutine::generationThread(void *parameters)
+	{
+		int generation = static_cast<int>(reinterpret_cast<intptr_t>(parameters));
+
+		while(true)
+		{
+			AsyncRoutine *asyncRoutine = nullptr;
+
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, [generation]() { return !generationQueue.empty() || generation != threadGeneration; });
+
+				if(generationQueue.empty())
+				{
+					return;   // Only exit once the queue has been drained
+				}
+
+				asyncRoutine = generationQueue.front();
+				generationQueue.pop_front();
+			}
+
+			asyncRoutine->generate();
+			asyncRoutine->unbind();
+
+			std::unique_lock<std::mutex> lock(queueMutex);
+			pendingRoutines--;
+			idleCondition.notify_all();
+		}
+	}
+
+	void AsyncRoutine::generate()
+	{
+		Routine *generated = generator();
+		generated->bind();
+		generator = nullptr;   // Release captured state
+
+		std::unique_lock<std::mutex> lock(mutex);
+		routine = generated;
+		ready = true;
+		readyCondition.notify_all();
+	}
+}
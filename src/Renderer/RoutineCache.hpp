@@ -19,10 +19,69 @@
 
 #include "Reactor/Reactor.hpp"
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
 namespace sw
 {
 	using namespace rr;
 
+	extern bool asyncRoutineCompilation;
+	extern bool tieredRoutineCompilation;
+
+	enum
+	{
+		TIER_UP_USE_COUNT = 16   // Draw calls after which an unoptimized routine gets regenerated
+	};
+
+	// Routine which is generated on a background thread. It can be cached and bound right
+	// away, while getEntry() blocks until the code is ready, unless a fallback routine was
+	// provided. Routines which are already available can be wrapped too, so all cached
+	// routines share this interface. Either way it's created with a reference held by the
+	// creator, which must unbind() it once it has been cached or handed on.
+	class AsyncRoutine : public Routine
+	{
+	public:
+		AsyncRoutine(const std::function<Routine*()> &generator, bool optimized, AsyncRoutine *fallback = nullptr);
+		explicit AsyncRoutine(Routine *routine);
+
+		~AsyncRoutine() override;
+
+		const void *getEntry() override;
+		const void *getObjectCode(size_t &size) override;
+
+		bool isReady() const;
+		void wait();
+
+		// Blocks until all queued routines have been generated
+		static void waitForAll();
+
+		// Generation threads are joined once every renderer has released them
+		static void acquireThreads();
+		static void releaseThreads();
+
+	private:
+		static void generationThread(void *parameters);
+
+		void generate();
+
+		std::function<Routine*()> generator;
+		Routine *routine;
+		AsyncRoutine *fallback;
+		std::atomic<bool> ready;
+
+		std::mutex mutex;
+		std::condition_variable readyCondition;
+	};
+
+	// On-disk routine storage, only implemented on Linux. The state must not contain anything
+	// which differs between processes, like shader serial IDs; the shader contents are keyed
+	// by their hash instead.
+	Routine *loadPersistentRoutine(const char *precache, const void *state, size_t stateSize, uint64_t shaderHash);
+	void storePersistentRoutine(const char *precache, const void *state, size_t stateSize, uint64_t shaderHash, Routine *routine);
+
 	template<class State>
 	class RoutineCache : public LRUCache<State, Routine>
 	{
@@ -30,6 +89,10 @@ namespace sw
 		RoutineCache(int n, const char *precache = nullptr);
 		~RoutineCache();
 
+		// Persistent cache, only used when a precache name is given
+		Routine *load(const State &state, uint64_t shaderHash);
+		void store(const State &state, uint64_t shaderHash, Routine *routine);
+
 	private:
 		const char *precache;
 		#if defined(_WIN32)
@@ -46,6 +109,21 @@ namespace sw
 	RoutineCache<State>::~RoutineCache()
 	{
 	}
+
+	template<class State>
+	Routine *RoutineCache<State>::load(const State &state, uint64_t shaderHash)
+	{
+		return precache ? loadPersistentRoutine(precache, &state, sizeof(State), shaderHash) : nullptr;
+	}
+
+	template<class State>
+	void RoutineCache<State>::store(const State &state, uint64_t shaderHash, Routine *routine)
+	{
+		if(precache)
+		{
+			storePersistentRoutine(precache, &state, sizeof(State), shaderHash, routine);
+		}
+	}
 }
 
 #endif   // sw_RoutineCache_hpp
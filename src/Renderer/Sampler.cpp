@@ -46,6 +46,7 @@ namespace sw
 			for(int face = 0; face < 6; face++)
 			{
 				mipmap.buffer[face] = &zero;
+				surface[level][face] = nullptr;
 			}
 		}
 
@@ -114,12 +115,14 @@ namespace sw
 
 	void Sampler::setTextureLevel(int face, int level, Surface *surface, TextureType type)
 	{
+		this->surface[level][face] = surface;
+
 		if(surface)
 		{
 			Mipmap &mipmap = texture.mipmap[level];
 
 			border = surface->getBorder();
-			mipmap.buffer[face] = surface->lockInternal(-border, -border, 0, LOCK_UNLOCKED, PRIVATE);
+			mipmap.buffer[face] = surface->lockInternal(-border, -border, 0, LOCK_UNLOCKED, PRIVATE);   // Decoded by getTextureData()
 
 			if(face == 0)
 			{
@@ -413,6 +416,22 @@ namespace sw
 
 	const Texture &Sampler::getTextureData()
 	{
+		// Only decode the levels and faces which can get sampled
+		int levels = (mipmapFilter() == MIPMAP_NONE) ? 1 : MIPMAP_LEVELS;
+		int faces = (textureType == TEXTURE_CUBE) ? 6 : 1;
+
+		for(int level = 0; level < levels; level++)
+		{
+			for(int face = 0; face < faces; face++)
+			{
+				// Levels past the last one repeat it
+				if(surface[level][face] && (level == 0 || surface[level][face] != surface[level - 1][face]))
+				{
+					surface[level][face]->updateInternal();
+				}
+			}
+		}
+
 		return texture;
 	}
 
@@ -238,6 +238,7 @@ namespace sw
 		CompareFunc compare;
 
 		Texture texture;
+		Surface *surface[MIPMAP_LEVELS][6];   // Updated when the texture data is used
 		float exp2LOD;
 
 		static FilterType maximumTextureFilterQuality;
@@ -229,10 +229,17 @@ namespace sw
 
 		if(!routine)
 		{
-			SetupRoutine *generator = new SetupRoutine(state);
-			generator->generate();
-			routine = generator->getRoutine();
-			delete generator;
+			routine = routineCache->load(state, 0);
+
+			if(!routine)
+			{
+				SetupRoutine *generator = new SetupRoutine(state);
+				generator->generate();
+				routine = generator->getRoutine();
+				delete generator;
+
+				routineCache->store(state, 0, routine);
+			}
 
 			routineCache->add(state, routine);
 		}
@@ -56,6 +56,7 @@ namespace sw
 			this->resource = resource;
 			this->buffer = buffer;
 			this->stride = stride;
+			this->divisor = 0;
 		}
 
 		Stream &define(StreamType type, unsigned int count, bool normalized = false)
@@ -84,6 +85,7 @@ namespace sw
 			resource = 0;
 			buffer = &null;
 			stride = 0;
+			divisor = 0;
 			type = STREAMTYPE_FLOAT;
 			count = 0;
 			normalized = false;
@@ -99,6 +101,7 @@ namespace sw
 		StreamType type;
 		unsigned char count;
 		bool normalized;
+		unsigned int divisor;   // Advance once every 'divisor' instances instead of per vertex, when non-zero
 	};
 }
 
@@ -23,11 +23,20 @@
 #include "Common/CPUID.hpp"
 #include "Common/Resource.hpp"
 #include "Common/Debug.hpp"
+#include "Common/Thread.hpp"
 #include "Reactor/Reactor.hpp"
 
 #if defined(__i386__) || defined(__x86_64__)
 	#include <xmmintrin.h>
 	#include <emmintrin.h>
+	#include <immintrin.h>
+
+	// AVX2 code paths are compiled for their own target and only called when CPUID::supportsAVX2()
+	#if defined(_MSC_VER)
+		#define SW_TARGET_AVX2
+	#else
+		#define SW_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
 #endif
 
 #undef min
@@ -39,6 +48,8 @@ namespace sw
 	extern bool complementaryDepthBuffer;
 	extern TranscendentalPrecision logPrecision;
 
+	bool compressedTextureSampling = false;   // Sample compressed formats directly instead of decoding them
+
 	unsigned int *Surface::palette = 0;
 	unsigned int Surface::paletteID = 0;
 
@@ -1137,7 +1148,11 @@ namespace sw
 		case LOCK_WRITEONLY:
 		case LOCK_READWRITE:
 		case LOCK_DISCARD:
-			dirty = true;
+			{
+				int row = max(y, 0) + max(z, 0) * height;
+				dirtyRow = dirty ? min(dirtyRow, row) : row;
+				dirty = true;
+			}
 			break;
 		default:
 			ASSERT(false);
@@ -1274,13 +1289,14 @@ namespace sw
 		external.border = 0;
 		external.lock = LOCK_UNLOCKED;
 		external.dirty = true;
+		external.dirtyRow = 0;
 
 		internal.buffer = nullptr;
 		internal.width = width;
 		internal.height = height;
 		internal.depth = depth;
 		internal.samples = 1;
-		internal.format = selectInternalFormat(format);
+		internal.format = selectInternalFormat(format, 0);
 		internal.bytes = bytes(internal.format);
 		internal.pitchB = pitchB(internal.width, 0, internal.format, false);
 		internal.pitchP = pitchP(internal.width, 0, internal.format, false);
@@ -1289,6 +1305,7 @@ namespace sw
 		internal.border = 0;
 		internal.lock = LOCK_UNLOCKED;
 		internal.dirty = false;
+		internal.dirtyRow = 0;
 
 		stencil.buffer = nullptr;
 		stencil.width = width;
@@ -1304,9 +1321,27 @@ namespace sw
 		stencil.border = 0;
 		stencil.lock = LOCK_UNLOCKED;
 		stencil.dirty = false;
+		stencil.dirtyRow = 0;
 
 		dirtyContents = true;
 		paletteUsed = 0;
+
+		internalClear.pending = false;
+		internalClear.band = nullptr;
+		internalClear.bandCount = 0;
+		stencilClear.pending = false;
+		stencilClear.band = nullptr;
+		stencilClear.bandCount = 0;
+
+		for(int i = 0; i < HierarchicalDepth::TILE_SIZES; i++)
+		{
+			hiZ.bound[i] = nullptr;
+		}
+
+		hiZ.current = -1;
+
+		damage = getRect();
+		damageLimited = false;
 	}
 
 	Surface::Surface(Resource *texture, int width, int height, int depth, int border, int samples, Format format, bool lockable, bool renderTarget, int pitchPprovided) : lockable(lockable), renderTarget(renderTarget)
@@ -1331,13 +1366,14 @@ namespace sw
 		external.border = 0;
 		external.lock = LOCK_UNLOCKED;
 		external.dirty = false;
+		external.dirtyRow = 0;
 
 		internal.buffer = nullptr;
 		internal.width = width;
 		internal.height = height;
 		internal.depth = depth;
 		internal.samples = (short)samples;
-		internal.format = selectInternalFormat(format);
+		internal.format = selectInternalFormat(format, border);
 		internal.bytes = bytes(internal.format);
 		internal.pitchB = !pitchPprovided ? pitchB(internal.width, border, internal.format, renderTarget) : pitchPprovided * internal.bytes;
 		internal.pitchP = !pitchPprovided ? pitchP(internal.width, border, internal.format, renderTarget) : pitchPprovided;
@@ -1346,6 +1382,7 @@ namespace sw
 		internal.border = (short)border;
 		internal.lock = LOCK_UNLOCKED;
 		internal.dirty = false;
+		internal.dirtyRow = 0;
 
 		stencil.buffer = nullptr;
 		stencil.width = width;
@@ -1361,9 +1398,27 @@ namespace sw
 		stencil.border = 0;
 		stencil.lock = LOCK_UNLOCKED;
 		stencil.dirty = false;
+		stencil.dirtyRow = 0;
 
 		dirtyContents = true;
 		paletteUsed = 0;
+
+		internalClear.pending = false;
+		internalClear.band = nullptr;
+		internalClear.bandCount = 0;
+		stencilClear.pending = false;
+		stencilClear.band = nullptr;
+		stencilClear.bandCount = 0;
+
+		for(int i = 0; i < HierarchicalDepth::TILE_SIZES; i++)
+		{
+			hiZ.bound[i] = nullptr;
+		}
+
+		hiZ.current = -1;
+
+		damage = getRect();
+		damageLimited = false;
 	}
 
 	Surface::~Surface()
@@ -1389,6 +1444,14 @@ namespace sw
 
 		deallocate(stencil.buffer);
 
+		delete[] internalClear.band;
+		delete[] stencilClear.band;
+
+		for(int i = 0; i < HierarchicalDepth::TILE_SIZES; i++)
+		{
+			delete[] hiZ.bound[i];
+		}
+
 		external.buffer = nullptr;
 		internal.buffer = nullptr;
 		stencil.buffer = nullptr;
@@ -1398,6 +1461,8 @@ namespace sw
 	{
 		resource->lock(client);
 
+		materializeClear(internal, internalClear, 0, internal.height);
+
 		if(!external.buffer)
 		{
 			if(internal.buffer && identicalBuffers())
@@ -1462,6 +1527,28 @@ namespace sw
 			}
 		}
 
+		// The renderer fills in deferred clears of the rows it draws to
+		if(client != MANAGED && lock != LOCK_UNLOCKED)
+		{
+			if(lock == LOCK_DISCARD && x == 0 && y == 0 && z == 0)
+			{
+				internalClear.pending = false;
+			}
+			else
+			{
+				materializeClear(internal, internalClear, 0, internal.height);
+			}
+
+			// Depth written by other clients can be further away than the bounds
+			if(lock != LOCK_READONLY)
+			{
+				hiZ.current = -1;
+
+				addDamage(damageLimited ? damageLimit : getRect());
+				damageLimited = false;
+			}
+		}
+
 		// FIXME: WHQL requires conversion to lower external precision and back
 		if(logPrecision >= WHQL)
 		{
@@ -1487,16 +1574,15 @@ namespace sw
 			}
 		}
 
-		if(external.dirty || (isPalette(external.format) && paletteUsed != Surface::paletteID))
+		if(lock == LOCK_DISCARD)
 		{
-			if(lock != LOCK_DISCARD)
-			{
-				update(internal, external);
-			}
-
 			external.dirty = false;
 			paletteUsed = Surface::paletteID;
 		}
+		else if(lock != LOCK_UNLOCKED)   // Unlocked access only obtains the address, see updateInternal()
+		{
+			updateInternal();
+		}
 
 		switch(lock)
 		{
@@ -1523,10 +1609,27 @@ namespace sw
 	void Surface::unlockInternal()
 	{
 		internal.unlockRect();
+		damageLimited = false;   // Read-only and managed locks don't consume the limit
 
 		resource->unlock();
 	}
 
+	void Surface::updateInternal()
+	{
+		materializeClear(internal, internalClear, 0, internal.height);
+
+		if(external.dirty || (isPalette(external.format) && paletteUsed != Surface::paletteID))
+		{
+			update(internal, external);
+
+			external.dirty = false;
+			paletteUsed = Surface::paletteID;
+			hiZ.current = -1;
+
+			addDamage(getRect());
+		}
+	}
+
 	void *Surface::lockStencil(int x, int y, int front, Accessor client)
 	{
 		resource->lock(client);
@@ -1541,6 +1644,11 @@ namespace sw
 			stencil.buffer = allocateBuffer(stencil.width, stencil.height, stencil.depth, stencil.border, stencil.samples, stencil.format);
 		}
 
+		if(client != MANAGED)
+		{
+			materializeClear(stencil, stencilClear, 0, stencil.height);
+		}
+
 		return stencil.lockRect(x, y, front, LOCK_READWRITE);   // FIXME
 	}
 
@@ -1876,6 +1984,65 @@ namespace sw
 		return B > 0 ? sliceB(width, height, border, format, target) / B : 0;
 	}
 
+	int Surface::blockHeight(Format format)
+	{
+		switch(format)
+		{
+		case FORMAT_DXT1:
+		case FORMAT_DXT3:
+		case FORMAT_DXT5:
+		case FORMAT_ATI1:
+		case FORMAT_ATI2:
+		case FORMAT_ETC1:
+		case FORMAT_R11_EAC:
+		case FORMAT_SIGNED_R11_EAC:
+		case FORMAT_RG11_EAC:
+		case FORMAT_SIGNED_RG11_EAC:
+		case FORMAT_RGB8_ETC2:
+		case FORMAT_SRGB8_ETC2:
+		case FORMAT_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+		case FORMAT_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+		case FORMAT_RGBA8_ETC2_EAC:
+		case FORMAT_SRGB8_ALPHA8_ETC2_EAC:
+		case FORMAT_RGBA_ASTC_4x4_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_4x4_KHR:
+		case FORMAT_RGBA_ASTC_5x4_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_5x4_KHR:
+			return 4;
+		case FORMAT_RGBA_ASTC_5x5_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_5x5_KHR:
+		case FORMAT_RGBA_ASTC_6x5_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_6x5_KHR:
+		case FORMAT_RGBA_ASTC_8x5_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_8x5_KHR:
+		case FORMAT_RGBA_ASTC_10x5_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_10x5_KHR:
+			return 5;
+		case FORMAT_RGBA_ASTC_6x6_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_6x6_KHR:
+		case FORMAT_RGBA_ASTC_8x6_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_8x6_KHR:
+		case FORMAT_RGBA_ASTC_10x6_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_10x6_KHR:
+			return 6;
+		case FORMAT_RGBA_ASTC_8x8_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_8x8_KHR:
+		case FORMAT_RGBA_ASTC_10x8_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_10x8_KHR:
+			return 8;
+		case FORMAT_RGBA_ASTC_10x10_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_10x10_KHR:
+		case FORMAT_RGBA_ASTC_12x10_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_12x10_KHR:
+			return 10;
+		case FORMAT_RGBA_ASTC_12x12_KHR:
+		case FORMAT_SRGB8_ALPHA8_ASTC_12x12_KHR:
+			return 12;
+		default:
+			return 1;
+		}
+	}
+
 	void Surface::update(Buffer &destination, Buffer &source)
 	{
 	//	ASSERT(source.lock != LOCK_UNLOCKED);
@@ -1885,60 +2052,117 @@ namespace sw
 		{
 			ASSERT(source.dirty && !destination.dirty);
 
-			switch(source.format)
+			int rows = blockHeight(source.format);
+
+			// Multisampled, planar and block compressed destination buffers are updated as a whole
+			if(source.samples > 1 || destination.samples > 1 || blockHeight(destination.format) != 1 ||
+			   source.width != destination.width || source.height != destination.height || source.depth != destination.depth ||
+			   source.format == FORMAT_YV12_BT601 || source.format == FORMAT_YV12_BT709 || source.format == FORMAT_YV12_JFIF)
 			{
-			case FORMAT_R8G8B8:		decodeR8G8B8(destination, source);		break;   // FIXME: Check destination format
-			case FORMAT_X1R5G5B5:	decodeX1R5G5B5(destination, source);	break;   // FIXME: Check destination format
-			case FORMAT_A1R5G5B5:	decodeA1R5G5B5(destination, source);	break;   // FIXME: Check destination format
-			case FORMAT_X4R4G4B4:	decodeX4R4G4B4(destination, source);	break;   // FIXME: Check destination format
-			case FORMAT_A4R4G4B4:	decodeA4R4G4B4(destination, source);	break;   // FIXME: Check destination format
-			case FORMAT_P8:			decodeP8(destination, source);			break;   // FIXME: Check destination format
-			case FORMAT_DXT1:		decodeDXT1(destination, source);		break;   // FIXME: Check destination format
-			case FORMAT_DXT3:		decodeDXT3(destination, source);		break;   // FIXME: Check destination format
-			case FORMAT_DXT5:		decodeDXT5(destination, source);		break;   // FIXME: Check destination format
-			case FORMAT_ATI1:		decodeATI1(destination, source);		break;   // FIXME: Check destination format
-			case FORMAT_ATI2:		decodeATI2(destination, source);		break;   // FIXME: Check destination format
-			case FORMAT_R11_EAC:         decodeEAC(destination, source, 1, false); break; // FIXME: Check destination format
-			case FORMAT_SIGNED_R11_EAC:  decodeEAC(destination, source, 1, true);  break; // FIXME: Check destination format
-			case FORMAT_RG11_EAC:        decodeEAC(destination, source, 2, false); break; // FIXME: Check destination format
-			case FORMAT_SIGNED_RG11_EAC: decodeEAC(destination, source, 2, true);  break; // FIXME: Check destination format
-			case FORMAT_ETC1:
-			case FORMAT_RGB8_ETC2:                      decodeETC2(destination, source, 0, false); break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ETC2:                     decodeETC2(destination, source, 0, true);  break; // FIXME: Check destination format
-			case FORMAT_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:  decodeETC2(destination, source, 1, false); break; // FIXME: Check destination format
-			case FORMAT_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2: decodeETC2(destination, source, 1, true);  break; // FIXME: Check destination format
-			case FORMAT_RGBA8_ETC2_EAC:                 decodeETC2(destination, source, 8, false); break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ETC2_EAC:          decodeETC2(destination, source, 8, true);  break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_4x4_KHR:           decodeASTC(destination, source, 4,  4,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_5x4_KHR:           decodeASTC(destination, source, 5,  4,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_5x5_KHR:           decodeASTC(destination, source, 5,  5,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_6x5_KHR:           decodeASTC(destination, source, 6,  5,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_6x6_KHR:           decodeASTC(destination, source, 6,  6,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_8x5_KHR:           decodeASTC(destination, source, 8,  5,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_8x6_KHR:           decodeASTC(destination, source, 8,  6,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_8x8_KHR:           decodeASTC(destination, source, 8,  8,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_10x5_KHR:          decodeASTC(destination, source, 10, 5,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_10x6_KHR:          decodeASTC(destination, source, 10, 6,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_10x8_KHR:          decodeASTC(destination, source, 10, 8,  1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_10x10_KHR:         decodeASTC(destination, source, 10, 10, 1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_12x10_KHR:         decodeASTC(destination, source, 12, 10, 1, false); break; // FIXME: Check destination format
-			case FORMAT_RGBA_ASTC_12x12_KHR:         decodeASTC(destination, source, 12, 12, 1, false); break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_4x4_KHR:   decodeASTC(destination, source, 4,  4,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_5x4_KHR:   decodeASTC(destination, source, 5,  4,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_5x5_KHR:   decodeASTC(destination, source, 5,  5,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_6x5_KHR:   decodeASTC(destination, source, 6,  5,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_6x6_KHR:   decodeASTC(destination, source, 6,  6,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_8x5_KHR:   decodeASTC(destination, source, 8,  5,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_8x6_KHR:   decodeASTC(destination, source, 8,  6,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_8x8_KHR:   decodeASTC(destination, source, 8,  8,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_10x5_KHR:  decodeASTC(destination, source, 10, 5,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_10x6_KHR:  decodeASTC(destination, source, 10, 6,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_10x8_KHR:  decodeASTC(destination, source, 10, 8,  1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_10x10_KHR: decodeASTC(destination, source, 10, 10, 1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_12x10_KHR: decodeASTC(destination, source, 12, 10, 1, true);  break; // FIXME: Check destination format
-			case FORMAT_SRGB8_ALPHA8_ASTC_12x12_KHR: decodeASTC(destination, source, 12, 12, 1, true);  break; // FIXME: Check destination format
-			default:				genericUpdate(destination, source);		break;
+				decode(destination, source);
+				return;
 			}
+
+			// Rows above the first modified one are still up to date. The lock origin is all
+			// we know of the modified region, so everything below it gets decoded again.
+			int firstRow = source.dirty ? source.dirtyRow : 0;
+			int firstSlice = min(firstRow / source.height, source.depth - 1);
+			firstRow = (firstRow - firstSlice * source.height) / rows * rows;
+
+			// Bands of rows, aligned to compressed blocks, are decoded concurrently. They don't
+			// become renderer tasks: the lock has to return the decoded data, and renderer
+			// threads work through draw calls in order, so the bands would wait for every
+			// queued draw call. The parallelFor() pool has as many threads as the renderers.
+			const int bandHeight = max(64 / rows, 1) * rows;
+			int bandsPerSlice = (source.height + bandHeight - 1) / bandHeight;
+			int firstBand = firstSlice * bandsPerSlice + firstRow / bandHeight;
+			int bandCount = source.depth * bandsPerSlice - firstBand;
+			int rowsPerPitch = (source.format == FORMAT_ATI1 || source.format == FORMAT_ATI2) ? 1 : rows;   // ATI pitch is computed per row
+
+			parallelFor(bandCount, [&](int band)
+			{
+				int z = (firstBand + band) / bandsPerSlice;
+				int y = ((firstBand + band) % bandsPerSlice) * bandHeight;
+
+				if(band == 0)
+				{
+					y = firstRow;
+				}
+
+				Buffer sourceBand;
+				sourceBand = source;
+				sourceBand.buffer = (byte*)source.buffer + (y / rowsPerPitch) * source.pitchB + z * source.sliceB;
+				sourceBand.height = min(bandHeight * (y / bandHeight + 1), source.height) - y;
+				sourceBand.depth = 1;
+
+				Buffer destinationBand;
+				destinationBand = destination;
+				destinationBand.buffer = (byte*)destination.buffer + y * destination.pitchB + z * destination.sliceB;
+				destinationBand.height = sourceBand.height;
+				destinationBand.depth = 1;
+
+				decode(destinationBand, sourceBand);
+			});
+		}
+	}
+
+	void Surface::decode(Buffer &destination, Buffer &source)
+	{
+		switch(source.format)
+		{
+		case FORMAT_R8G8B8:		decodeR8G8B8(destination, source);		break;   // FIXME: Check destination format
+		case FORMAT_X1R5G5B5:	decodeX1R5G5B5(destination, source);	break;   // FIXME: Check destination format
+		case FORMAT_A1R5G5B5:	decodeA1R5G5B5(destination, source);	break;   // FIXME: Check destination format
+		case FORMAT_X4R4G4B4:	decodeX4R4G4B4(destination, source);	break;   // FIXME: Check destination format
+		case FORMAT_A4R4G4B4:	decodeA4R4G4B4(destination, source);	break;   // FIXME: Check destination format
+		case FORMAT_A2R10G10B10:	decode1010102(destination, source);	break;
+		case FORMAT_A2B10G10R10:	decode1010102(destination, source);	break;
+		case FORMAT_P8:			decodeP8(destination, source);			break;   // FIXME: Check destination format
+		case FORMAT_DXT1:		decodeDXT1(destination, source);		break;   // FIXME: Check destination format
+		case FORMAT_DXT3:		decodeDXT3(destination, source);		break;   // FIXME: Check destination format
+		case FORMAT_DXT5:		decodeDXT5(destination, source);		break;   // FIXME: Check destination format
+		case FORMAT_ATI1:		decodeATI1(destination, source);		break;   // FIXME: Check destination format
+		case FORMAT_ATI2:		decodeATI2(destination, source);		break;   // FIXME: Check destination format
+		case FORMAT_R11_EAC:         decodeEAC(destination, source, 1, false); break; // FIXME: Check destination format
+		case FORMAT_SIGNED_R11_EAC:  decodeEAC(destination, source, 1, true);  break; // FIXME: Check destination format
+		case FORMAT_RG11_EAC:        decodeEAC(destination, source, 2, false); break; // FIXME: Check destination format
+		case FORMAT_SIGNED_RG11_EAC: decodeEAC(destination, source, 2, true);  break; // FIXME: Check destination format
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:                      decodeETC2(destination, source, 0, false); break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ETC2:                     decodeETC2(destination, source, 0, true);  break; // FIXME: Check destination format
+		case FORMAT_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:  decodeETC2(destination, source, 1, false); break; // FIXME: Check destination format
+		case FORMAT_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2: decodeETC2(destination, source, 1, true);  break; // FIXME: Check destination format
+		case FORMAT_RGBA8_ETC2_EAC:                 decodeETC2(destination, source, 8, false); break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ETC2_EAC:          decodeETC2(destination, source, 8, true);  break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_4x4_KHR:           decodeASTC(destination, source, 4,  4,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_5x4_KHR:           decodeASTC(destination, source, 5,  4,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_5x5_KHR:           decodeASTC(destination, source, 5,  5,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_6x5_KHR:           decodeASTC(destination, source, 6,  5,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_6x6_KHR:           decodeASTC(destination, source, 6,  6,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_8x5_KHR:           decodeASTC(destination, source, 8,  5,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_8x6_KHR:           decodeASTC(destination, source, 8,  6,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_8x8_KHR:           decodeASTC(destination, source, 8,  8,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_10x5_KHR:          decodeASTC(destination, source, 10, 5,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_10x6_KHR:          decodeASTC(destination, source, 10, 6,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_10x8_KHR:          decodeASTC(destination, source, 10, 8,  1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_10x10_KHR:         decodeASTC(destination, source, 10, 10, 1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_12x10_KHR:         decodeASTC(destination, source, 12, 10, 1, false); break; // FIXME: Check destination format
+		case FORMAT_RGBA_ASTC_12x12_KHR:         decodeASTC(destination, source, 12, 12, 1, false); break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_4x4_KHR:   decodeASTC(destination, source, 4,  4,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_5x4_KHR:   decodeASTC(destination, source, 5,  4,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_5x5_KHR:   decodeASTC(destination, source, 5,  5,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_6x5_KHR:   decodeASTC(destination, source, 6,  5,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_6x6_KHR:   decodeASTC(destination, source, 6,  6,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_8x5_KHR:   decodeASTC(destination, source, 8,  5,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_8x6_KHR:   decodeASTC(destination, source, 8,  6,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_8x8_KHR:   decodeASTC(destination, source, 8,  8,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_10x5_KHR:  decodeASTC(destination, source, 10, 5,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_10x6_KHR:  decodeASTC(destination, source, 10, 6,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_10x8_KHR:  decodeASTC(destination, source, 10, 8,  1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_10x10_KHR: decodeASTC(destination, source, 10, 10, 1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_12x10_KHR: decodeASTC(destination, source, 12, 10, 1, true);  break; // FIXME: Check destination format
+		case FORMAT_SRGB8_ALPHA8_ASTC_12x12_KHR: decodeASTC(destination, source, 12, 12, 1, true);  break; // FIXME: Check destination format
+		default:				genericUpdate(destination, source);		break;
 		}
 	}
 
@@ -1990,6 +2214,140 @@ namespace sw
 		destination.unlockRect();
 	}
 
+#if defined(__i386__) || defined(__x86_64__)
+	// Expands one packed 16-bit channel into its 8888 position: (((c & mask) * multiplier + bias) >> shift) & result
+	struct PackedChannel
+	{
+		unsigned int mask;
+		unsigned int multiplier;
+		unsigned int bias;
+		int shift;
+		unsigned int result;
+	};
+
+	static const PackedChannel channelsX1R5G5B5[4] =
+	{
+		{0x0000, 0,      0xFF000000, 0, 0xFF000000},
+		{0x7C00, 134771, 0x800000,   8, 0x00FF0000},
+		{0x03E0, 16846,  0x8000,     8, 0x0000FF00},
+		{0x001F, 2106,   0x80,       8, 0x000000FF},
+	};
+
+	static const PackedChannel channelsA1R5G5B5[4] =
+	{
+		{0x8000, 130560, 0,          0, 0xFF000000},
+		{0x7C00, 134771, 0x800000,   8, 0x00FF0000},
+		{0x03E0, 16846,  0x8000,     8, 0x0000FF00},
+		{0x001F, 2106,   0x80,       8, 0x000000FF},
+	};
+
+	static const PackedChannel channelsX4R4G4B4[4] =
+	{
+		{0x0000, 0,          0xFF000000, 0, 0xFF000000},
+		{0x0F00, 0x00001100, 0,          0, 0x00FF0000},
+		{0x00F0, 0x00000110, 0,          0, 0x0000FF00},
+		{0x000F, 0x00000011, 0,          0, 0x000000FF},
+	};
+
+	static const PackedChannel channelsA4R4G4B4[4] =
+	{
+		{0xF000, 0x00011000, 0,          0, 0xFF000000},
+		{0x0F00, 0x00001100, 0,          0, 0x00FF0000},
+		{0x00F0, 0x00000110, 0,          0, 0x0000FF00},
+		{0x000F, 0x00000011, 0,          0, 0x000000FF},
+	};
+
+	// Decodes eight 16-bit texels per iteration into 8888, returns the number of texels written
+	static SW_TARGET_AVX2 int decodePackedRowAVX2(unsigned int *destination, const unsigned short *source, int width, const PackedChannel channels[4])
+	{
+		int x = 0;
+
+		for(; x + 8 <= width; x += 8)
+		{
+			__m256i c = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(source + x)));
+			__m256i argb = _mm256_setzero_si256();
+
+			for(int i = 0; i < 4; i++)
+			{
+				__m256i channel = _mm256_and_si256(c, _mm256_set1_epi32(channels[i].mask));
+				channel = _mm256_mullo_epi32(channel, _mm256_set1_epi32(channels[i].multiplier));
+				channel = _mm256_add_epi32(channel, _mm256_set1_epi32(channels[i].bias));
+				channel = _mm256_srli_epi32(channel, channels[i].shift);
+				channel = _mm256_and_si256(channel, _mm256_set1_epi32(channels[i].result));
+				argb = _mm256_or_si256(argb, channel);
+			}
+
+			_mm256_storeu_si256((__m256i*)(destination + x), argb);
+		}
+
+		return x;
+	}
+
+	// Decodes eight R8G8B8 texels per iteration into X8R8G8B8, returns the number of texels written
+	static SW_TARGET_AVX2 int decodeR8G8B8RowAVX2(unsigned int *destination, const unsigned char *source, int width)
+	{
+		const __m256i dwords = _mm256_setr_epi32(0, 1, 2, 2, 3, 4, 5, 5);
+		const __m256i texels = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		                                        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+
+		int x = 0;
+
+		// Loads are 32 bytes wide, so stop while they stay within the row
+		for(; x + 11 <= width; x += 8)
+		{
+			__m256i c = _mm256_loadu_si256((const __m256i*)(source + 3 * x));
+			c = _mm256_permutevar8x32_epi32(c, dwords);
+			c = _mm256_shuffle_epi8(c, texels);
+			c = _mm256_or_si256(c, alpha);
+
+			_mm256_storeu_si256((__m256i*)(destination + x), c);
+		}
+
+		return x;
+	}
+
+	// Expands eight 10-10-10-2 texels per iteration into A16B16G16R16, returns the number of texels written.
+	// Matches the float conversion of Buffer::read() and Buffer::write() bit for bit, without FMA.
+	static SW_TARGET_AVX2 int decode1010102RowAVX2(unsigned short *destination, const unsigned int *source, int width, bool bgr)
+	{
+		const __m256i mask10 = _mm256_set1_epi32(0x3FF);
+		const __m256 scale10 = _mm256_set1_ps(1.0f / 0x3FF);
+		const __m256 scale2 = _mm256_set1_ps(1.0f / 3);
+		const __m256 max16 = _mm256_set1_ps(65535.0f);
+		const __m256 half = _mm256_set1_ps(0.5f);
+
+		int x = 0;
+
+		for(; x + 8 <= width; x += 8)
+		{
+			__m256i c = _mm256_loadu_si256((const __m256i*)(source + x));
+
+			__m256 low = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(c, mask10)), scale10);
+			__m256 g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 10), mask10)), scale10);
+			__m256 high = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 20), mask10)), scale10);
+			__m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c, 30)), scale2);
+
+			__m256i r16 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(bgr ? low : high, max16), half));
+			__m256i g16 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(g, max16), half));
+			__m256i b16 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(bgr ? high : low, max16), half));
+			__m256i a16 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(a, max16), half));
+
+			__m256i rg = _mm256_or_si256(r16, _mm256_slli_epi32(g16, 16));
+			__m256i ba = _mm256_or_si256(b16, _mm256_slli_epi32(a16, 16));
+
+			// Texels 0, 1, 4, 5 and 2, 3, 6, 7
+			__m256i even = _mm256_unpacklo_epi32(rg, ba);
+			__m256i odd = _mm256_unpackhi_epi32(rg, ba);
+
+			_mm256_storeu_si256((__m256i*)(destination + 4 * x), _mm256_permute2x128_si256(even, odd, 0x20));
+			_mm256_storeu_si256((__m256i*)(destination + 4 * x + 16), _mm256_permute2x128_si256(even, odd, 0x31));
+		}
+
+		return x;
+	}
+#endif
+
 	void Surface::decodeR8G8B8(Buffer &destination, Buffer &source)
 	{
 		unsigned char *sourceSlice = (unsigned char*)source.lockRect(0, 0, 0, sw::LOCK_READONLY);
@@ -2008,8 +2366,18 @@ namespace sw
 			{
 				unsigned char *sourceElement = sourceRow;
 				unsigned char *destinationElement = destinationRow;
+				int x = 0;
 
-				for(int x = 0; x < width; x++)
+				#if defined(__i386__) || defined(__x86_64__)
+					if(CPUID::supportsAVX2() && source.bytes == 3 && destination.bytes == 4)
+					{
+						x = decodeR8G8B8RowAVX2((unsigned int*)destinationRow, sourceRow, width);
+						sourceElement += x * source.bytes;
+						destinationElement += x * destination.bytes;
+					}
+				#endif
+
+				for(; x < width; x++)
 				{
 					unsigned int b = sourceElement[0];
 					unsigned int g = sourceElement[1];
@@ -2033,6 +2401,62 @@ namespace sw
 		destination.unlockRect();
 	}
 
+	void Surface::decode1010102(Buffer &destination, Buffer &source)
+	{
+		if(destination.format != FORMAT_A16B16G16R16)
+		{
+			genericUpdate(destination, source);
+			return;
+		}
+
+		unsigned char *sourceSlice = (unsigned char*)source.lockRect(0, 0, 0, sw::LOCK_READONLY);
+		unsigned char *destinationSlice = (unsigned char*)destination.lockRect(0, 0, 0, sw::LOCK_UPDATE);
+
+		int depth = min(destination.depth, source.depth);
+		int height = min(destination.height, source.height);
+		int width = min(destination.width, source.width);
+
+		for(int z = 0; z < depth; z++)
+		{
+			unsigned char *sourceRow = sourceSlice;
+			unsigned char *destinationRow = destinationSlice;
+
+			for(int y = 0; y < height; y++)
+			{
+				unsigned char *sourceElement = sourceRow;
+				unsigned char *destinationElement = destinationRow;
+				int x = 0;
+
+				#if defined(__i386__) || defined(__x86_64__)
+					if(CPUID::supportsAVX2())
+					{
+						x = decode1010102RowAVX2((unsigned short*)destinationRow, (unsigned int*)sourceRow, width, source.format == FORMAT_A2B10G10R10);
+						sourceElement += x * source.bytes;
+						destinationElement += x * destination.bytes;
+					}
+				#endif
+
+				for(; x < width; x++)
+				{
+					Color<float> color = source.read(sourceElement);
+					destination.write(destinationElement, color);
+
+					sourceElement += source.bytes;
+					destinationElement += destination.bytes;
+				}
+
+				sourceRow += source.pitchB;
+				destinationRow += destination.pitchB;
+			}
+
+			sourceSlice += source.sliceB;
+			destinationSlice += destination.sliceB;
+		}
+
+		source.unlockRect();
+		destination.unlockRect();
+	}
+
 	void Surface::decodeX1R5G5B5(Buffer &destination, Buffer &source)
 	{
 		unsigned char *sourceSlice = (unsigned char*)source.lockRect(0, 0, 0, sw::LOCK_READONLY);
@@ -2051,8 +2475,18 @@ namespace sw
 			{
 				unsigned char *sourceElement = sourceRow;
 				unsigned char *destinationElement = destinationRow;
+				int x = 0;
 
-				for(int x = 0; x < width; x++)
+				#if defined(__i386__) || defined(__x86_64__)
+					if(CPUID::supportsAVX2() && source.bytes == 2 && destination.bytes == 4)
+					{
+						x = decodePackedRowAVX2((unsigned int*)destinationRow, (unsigned short*)sourceRow, width, channelsX1R5G5B5);
+						sourceElement += x * source.bytes;
+						destinationElement += x * destination.bytes;
+					}
+				#endif
+
+				for(; x < width; x++)
 				{
 					unsigned int xrgb = *(unsigned short*)sourceElement;
 
@@ -2096,8 +2530,18 @@ namespace sw
 			{
 				unsigned char *sourceElement = sourceRow;
 				unsigned char *destinationElement = destinationRow;
+				int x = 0;
 
-				for(int x = 0; x < width; x++)
+				#if defined(__i386__) || defined(__x86_64__)
+					if(CPUID::supportsAVX2() && source.bytes == 2 && destination.bytes == 4)
+					{
+						x = decodePackedRowAVX2((unsigned int*)destinationRow, (unsigned short*)sourceRow, width, channelsA1R5G5B5);
+						sourceElement += x * source.bytes;
+						destinationElement += x * destination.bytes;
+					}
+				#endif
+
+				for(; x < width; x++)
 				{
 					unsigned int argb = *(unsigned short*)sourceElement;
 
@@ -2142,8 +2586,18 @@ namespace sw
 			{
 				unsigned char *sourceElement = sourceRow;
 				unsigned char *destinationElement = destinationRow;
+				int x = 0;
 
-				for(int x = 0; x < width; x++)
+				#if defined(__i386__) || defined(__x86_64__)
+					if(CPUID::supportsAVX2() && source.bytes == 2 && destination.bytes == 4)
+					{
+						x = decodePackedRowAVX2((unsigned int*)destinationRow, (unsigned short*)sourceRow, width, channelsX4R4G4B4);
+						sourceElement += x * source.bytes;
+						destinationElement += x * destination.bytes;
+					}
+				#endif
+
+				for(; x < width; x++)
 				{
 					unsigned int xrgb = *(unsigned short*)sourceElement;
 
@@ -2187,8 +2641,18 @@ namespace sw
 			{
 				unsigned char *sourceElement = sourceRow;
 				unsigned char *destinationElement = destinationRow;
+				int x = 0;
 
-				for(int x = 0; x < width; x++)
+				#if defined(__i386__) || defined(__x86_64__)
+					if(CPUID::supportsAVX2() && source.bytes == 2 && destination.bytes == 4)
+					{
+						x = decodePackedRowAVX2((unsigned int*)destinationRow, (unsigned short*)sourceRow, width, channelsA4R4G4B4);
+						sourceElement += x * source.bytes;
+						destinationElement += x * destination.bytes;
+					}
+				#endif
+
+				for(; x < width; x++)
 				{
 					unsigned int argb = *(unsigned short*)sourceElement;
 
@@ -2598,16 +3062,19 @@ namespace sw
 
 		if(isSRGB)
 		{
-			static byte sRGBtoLinearTable[256];
-			static bool sRGBtoLinearTableDirty = true;
-			if(sRGBtoLinearTableDirty)
+			// Initialized once, also when bands are decoded concurrently
+			static const struct SRGBToLinearTable
 			{
-				for(int i = 0; i < 256; i++)
+				SRGBToLinearTable()
 				{
-					sRGBtoLinearTable[i] = static_cast<byte>(sRGBtoLinear(static_cast<float>(i) / 255.0f) * 255.0f + 0.5f);
+					for(int i = 0; i < 256; i++)
+					{
+						table[i] = static_cast<byte>(sRGBtoLinear(static_cast<float>(i) / 255.0f) * 255.0f + 0.5f);
+					}
 				}
-				sRGBtoLinearTableDirty = false;
-			}
+
+				byte table[256];
+			} sRGBtoLinearTable;
 
 			// Perform sRGB conversion in place after decoding
 			byte *src = (byte*)internal.lockRect(0, 0, 0, LOCK_READWRITE);
@@ -2619,7 +3086,7 @@ namespace sw
 					byte *srcPix = srcRow + x * internal.bytes;
 					for(int i = 0; i < 3; i++)
 					{
-						srcPix[i] = sRGBtoLinearTable[srcPix[i]];
+						srcPix[i] = sRGBtoLinearTable.table[srcPix[i]];
 					}
 				}
 			}
@@ -2937,6 +3404,14 @@ namespace sw
 		case FORMAT_YV12_BT601:
 		case FORMAT_YV12_BT709:
 		case FORMAT_YV12_JFIF:
+		case FORMAT_DXT1:
+		case FORMAT_DXT3:
+		case FORMAT_DXT5:
+		case FORMAT_ATI1:
+		case FORMAT_ATI2:
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:
+		case FORMAT_RGBA8_ETC2_EAC:
 			return true;
 		case FORMAT_A8B8G8R8I:
 		case FORMAT_A16B16G16R16I:
@@ -3036,6 +3511,24 @@ namespace sw
 		}
 	}
 
+	bool Surface::isCompressedSampleable(Format format)
+	{
+		switch(format)
+		{
+		case FORMAT_DXT1:
+		case FORMAT_DXT3:
+		case FORMAT_DXT5:
+		case FORMAT_ATI1:
+		case FORMAT_ATI2:
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:
+		case FORMAT_RGBA8_ETC2_EAC:
+			return true;
+		default:
+			return false;
+		}
+	}
+
 	bool Surface::isCompressed(Format format)
 	{
 		switch(format)
@@ -3218,6 +3711,14 @@ namespace sw
 		case FORMAT_YV12_BT601:     return 3;
 		case FORMAT_YV12_BT709:     return 3;
 		case FORMAT_YV12_JFIF:      return 3;
+		case FORMAT_DXT1:           return 4;
+		case FORMAT_DXT3:           return 4;
+		case FORMAT_DXT5:           return 4;
+		case FORMAT_ATI1:           return 1;
+		case FORMAT_ATI2:           return 2;
+		case FORMAT_ETC1:           return 3;
+		case FORMAT_RGB8_ETC2:      return 3;
+		case FORMAT_RGBA8_ETC2_EAC: return 4;
 		default:
 			ASSERT(false);
 		}
@@ -3230,7 +3731,7 @@ namespace sw
 		return allocate(size(width, height, depth, border, samples, format));
 	}
 
-	void Surface::memfill4(void *buffer, int pattern, int bytes)
+	void Surface::memfill4(void *buffer, int pattern, int bytes, bool streaming)
 	{
 		while((size_t)buffer & 0x1 && bytes >= 1)
 		{
@@ -3256,20 +3757,37 @@ namespace sw
 					bytes -= 4;
 				}
 
-				__m128 quad = _mm_set_ps1((float&)pattern);
+				float value;
+				memcpy(&value, &pattern, sizeof(value));
+				__m128 quad = _mm_set_ps1(value);
 
 				float *pointer = (float*)buffer;
 				int qxwords = bytes / 64;
 				bytes -= qxwords * 64;
 
-				while(qxwords--)
+				if(streaming)
+				{
+					while(qxwords--)
+					{
+						_mm_stream_ps(pointer + 0, quad);
+						_mm_stream_ps(pointer + 4, quad);
+						_mm_stream_ps(pointer + 8, quad);
+						_mm_stream_ps(pointer + 12, quad);
+
+						pointer += 16;
+					}
+				}
+				else
 				{
-					_mm_stream_ps(pointer + 0, quad);
-					_mm_stream_ps(pointer + 4, quad);
-					_mm_stream_ps(pointer + 8, quad);
-					_mm_stream_ps(pointer + 12, quad);
+					while(qxwords--)
+					{
+						_mm_store_ps(pointer + 0, quad);
+						_mm_store_ps(pointer + 4, quad);
+						_mm_store_ps(pointer + 8, quad);
+						_mm_store_ps(pointer + 12, quad);
 
-					pointer += 16;
+						pointer += 16;
+					}
 				}
 
 				buffer = pointer;
@@ -3309,6 +3827,210 @@ namespace sw
 		return (rect.x0 == 0 && rect.y0 == 0 && rect.x1 == internal.width && rect.y1 == internal.height && internal.depth == 1);
 	}
 
+	bool Surface::deferInternalClear(unsigned int pattern)
+	{
+		if(internal.format == FORMAT_NULL || internal.depth != 1 || internal.border != 0)
+		{
+			return false;
+		}
+
+		// Waits for rendering to finish, and replaces any clear which is still deferred
+		void *buffer = lockInternal(0, 0, 0, LOCK_DISCARD, PUBLIC);
+
+		// Surfaces which wrap other memory are cleared immediately
+		bool deferred = (buffer == internal.buffer) && deferClear(internal, internalClear, pattern);
+
+		unlockInternal();
+
+		return deferred;
+	}
+
+	bool Surface::deferStencilClear(unsigned int pattern)
+	{
+		if(stencil.format == FORMAT_NULL || stencil.depth != 1 || stencil.border != 0)
+		{
+			return false;
+		}
+
+		resource->lock(PUBLIC);
+
+		// Replaced, so the previous clear doesn't need to be filled in
+		stencilClear.pending = false;
+
+		lockStencil(0, 0, 0, PUBLIC);
+		bool deferred = deferClear(stencil, stencilClear, pattern);
+		unlockStencil();
+
+		resource->unlock();
+
+		return deferred;
+	}
+
+	void Surface::materializeClears(int y0, int y1)
+	{
+		materializeClear(internal, internalClear, y0, y1);
+		materializeClear(stencil, stencilClear, y0, y1);
+	}
+
+	bool Surface::deferClear(Buffer &buffer, DeferredClear &clear, unsigned int pattern)
+	{
+		if(!buffer.buffer || buffer.pitchB <= 0)
+		{
+			return false;
+		}
+
+		if(!clear.band)
+		{
+			int rows = buffer.sliceB / buffer.pitchB;
+
+			clear.bandCount = (rows + DeferredClear::BAND_ROWS - 1) / DeferredClear::BAND_ROWS;
+			clear.band = new std::atomic<int>[clear.bandCount];
+		}
+
+		for(int i = 0; i < clear.bandCount; i++)
+		{
+			clear.band[i] = DeferredClear::PENDING;
+		}
+
+		clear.pattern = pattern;
+		clear.pending = true;
+
+		return true;
+	}
+
+	void Surface::materializeClear(Buffer &buffer, DeferredClear &clear, int y0, int y1)
+	{
+		if(!clear.pending)
+		{
+			return;
+		}
+
+		int rows = buffer.sliceB / buffer.pitchB;
+		int firstBand = max(y0, 0) / DeferredClear::BAND_ROWS;
+		int lastBand = min((y1 + DeferredClear::BAND_ROWS - 1) / DeferredClear::BAND_ROWS, clear.bandCount);
+
+		for(int i = firstBand; i < lastBand; i++)
+		{
+			if(clear.band[i] == DeferredClear::FILLED)
+			{
+				continue;
+			}
+
+			int state = DeferredClear::PENDING;
+
+			if(clear.band[i].compare_exchange_strong(state, DeferredClear::FILLING))
+			{
+				int row0 = i * DeferredClear::BAND_ROWS;
+				int row1 = min(row0 + DeferredClear::BAND_ROWS, rows);
+
+				for(int sample = 0; sample < buffer.samples; sample++)
+				{
+					byte *rowStart = (byte*)buffer.buffer + sample * buffer.sliceB + row0 * buffer.pitchB;
+					memfill4(rowStart, clear.pattern, (row1 - row0) * buffer.pitchB, false);   // Shaded next, so keep it cached
+				}
+
+				clear.band[i] = DeferredClear::FILLED;
+			}
+			else   // Being filled by another thread
+			{
+				while(clear.band[i] != DeferredClear::FILLED)
+				{
+					Thread::yield();
+				}
+			}
+		}
+
+		if(firstBand == 0 && lastBand == clear.bandCount)
+		{
+			clear.pending = false;
+		}
+	}
+
+	float *Surface::getHiZ(int tileSize)
+	{
+		int index = (int)log2(tileSize) - HierarchicalDepth::MIN_TILE_SHIFT;
+
+		if(index < 0 || index >= HierarchicalDepth::TILE_SIZES || internal.depth != 1)
+		{
+			return nullptr;
+		}
+
+		if(!hiZ.bound[index])
+		{
+			int rows = (internal.height + tileSize - 1) / tileSize;
+
+			hiZ.bound[index] = new float[getHiZPitch(tileSize) * rows];
+		}
+
+		// Bounds for other tile sizes, or after writes by other clients, are stale
+		if(hiZ.current != index)
+		{
+			hiZ.current = index;
+			fillHiZ(INFINITY);
+		}
+
+		return hiZ.bound[index];
+	}
+
+	int Surface::getHiZPitch(int tileSize) const
+	{
+		return (internal.width + tileSize - 1) / tileSize;
+	}
+
+	void Surface::fillHiZ(float depth)
+	{
+		if(hiZ.current < 0)
+		{
+			return;
+		}
+
+		int tileSize = 1 << (hiZ.current + HierarchicalDepth::MIN_TILE_SHIFT);
+		int rows = (internal.height + tileSize - 1) / tileSize;
+		int count = getHiZPitch(tileSize) * rows;
+
+		for(int i = 0; i < count; i++)
+		{
+			hiZ.bound[hiZ.current][i] = depth;
+		}
+	}
+
+	void Surface::addDamage(const Rect &rect)
+	{
+		Rect clipped = rect;
+		clipped.clip(0, 0, internal.width, internal.height);
+
+		if(clipped.x0 >= clipped.x1 || clipped.y0 >= clipped.y1)
+		{
+			return;
+		}
+
+		if(damage.x0 >= damage.x1 || damage.y0 >= damage.y1)
+		{
+			damage = clipped;
+		}
+		else
+		{
+			damage.x0 = min(damage.x0, clipped.x0);
+			damage.y0 = min(damage.y0, clipped.y0);
+			damage.x1 = max(damage.x1, clipped.x1);
+			damage.y1 = max(damage.y1, clipped.y1);
+		}
+	}
+
+	void Surface::limitDamage(const Rect &rect)
+	{
+		damageLimit = rect;
+		damageLimited = true;
+	}
+
+	bool Surface::takeDamage(Rect &rect)
+	{
+		rect = damage;
+		damage = Rect(0, 0, 0, 0);
+
+		return rect.x0 < rect.x1 && rect.y0 < rect.y1;
+	}
+
 	Rect Surface::getRect() const
 	{
 		return Rect(0, 0, internal.width, internal.height);
@@ -3341,6 +4063,25 @@ namespace sw
 		const bool entire = x0 == 0 && y0 == 0 && width == internal.width && height == internal.height;
 		const Lock lock = entire ? LOCK_DISCARD : LOCK_WRITEONLY;
 
+		// Locking invalidates the hierarchical depth, but an entire clear sets a known bound
+		int hiZIndex = (entire && !complementaryDepthBuffer) ? hiZ.current : -1;
+
+		if(entire)
+		{
+			float value = (hasQuadLayout(internal.format) && complementaryDepthBuffer) ? 1 - depth : depth;
+
+			unsigned int pattern;
+			memcpy(&pattern, &value, sizeof(pattern));
+
+			if(deferInternalClear(pattern))
+			{
+				hiZ.current = hiZIndex;
+				fillHiZ(depth);
+
+				return;
+			}
+		}
+
 		int x1 = x0 + width;
 		int y1 = y0 + height;
 
@@ -3443,6 +4184,12 @@ namespace sw
 
 			unlockInternal();
 		}
+
+		if(hiZIndex >= 0)
+		{
+			hiZ.current = hiZIndex;
+			fillHiZ(depth);
+		}
 	}
 
 	void Surface::clearStencil(unsigned char s, unsigned char mask, int x0, int y0, int width, int height)
@@ -3482,6 +4229,14 @@ namespace sw
 		unsigned int fill = maskedS;
 		fill = fill | (fill << 8) | (fill << 16) | (fill << 24);
 
+		if(mask == 0xFF && x0 == 0 && y0 == 0 && width == internal.width && height == internal.height)
+		{
+			if(deferStencilClear(fill))
+			{
+				return;
+			}
+		}
+
 		char *buffer = (char*)lockStencil(0, 0, 0, PUBLIC);
 
 		// Stencil buffers are assumed to use quad layout
@@ -3741,8 +4496,24 @@ namespace sw
 		       external.samples == internal.samples;
 	}
 
-	Format Surface::selectInternalFormat(Format format) const
+	bool Surface::canLoadInternal() const
+	{
+		// Only the padding differs, so the external buffer isn't needed to hold the data
+		return ownExternal &&
+		       external.format == internal.format &&
+		       external.samples == 1 &&
+		       internal.samples == 1 &&
+		       !identicalBuffers();
+	}
+
+	Format Surface::selectInternalFormat(Format format, int border) const
 	{
+		// Compressed blocks can't be laid out with a border, so those surfaces keep decoding
+		if(compressedTextureSampling && isCompressedSampleable(format) && border == 0)
+		{
+			return format;
+		}
+
 		switch(format)
 		{
 		case FORMAT_NULL:
@@ -3998,6 +4769,163 @@ namespace sw
 		Surface::paletteID++;
 	}
 
+#if defined(__i386__) || defined(__x86_64__)
+	// Averages the samples of unsigned normalized 8 or 16-bit components, 32 bytes at a time.
+	// Rows of any width are handled by finishing the tail in scalar code, using the same
+	// pairwise rounding as the SSE2 paths so the result does not depend on the code path.
+	template<typename T, int samples>
+	static SW_TARGET_AVX2 void resolveUnormAVX2(unsigned char *source, int rowBytes, int height, int pitch, int slice)
+	{
+		for(int y = 0; y < height; y++)
+		{
+			unsigned char *row = source + y * pitch;
+			int x = 0;
+
+			for(; x + 32 <= rowBytes; x += 32)
+			{
+				__m256i c[samples];
+
+				for(int i = 0; i < samples; i++)
+				{
+					c[i] = _mm256_loadu_si256((__m256i*)(row + i * slice + x));
+				}
+
+				for(int n = samples / 2; n >= 1; n /= 2)
+				{
+					for(int i = 0; i < n; i++)
+					{
+						c[i] = (sizeof(T) == 1) ? _mm256_avg_epu8(c[2 * i], c[2 * i + 1]) : _mm256_avg_epu16(c[2 * i], c[2 * i + 1]);
+					}
+				}
+
+				_mm256_storeu_si256((__m256i*)(row + x), c[0]);
+			}
+
+			for(; x < rowBytes; x += sizeof(T))
+			{
+				unsigned int c[samples];
+
+				for(int i = 0; i < samples; i++)
+				{
+					c[i] = *(T*)(row + i * slice + x);
+				}
+
+				for(int n = samples / 2; n >= 1; n /= 2)
+				{
+					for(int i = 0; i < n; i++)
+					{
+						c[i] = (c[2 * i] + c[2 * i + 1] + 1) >> 1;
+					}
+				}
+
+				*(T*)(row + x) = (T)c[0];
+			}
+		}
+	}
+
+	// Averages the samples of 32-bit float components, eight at a time
+	template<int samples>
+	static SW_TARGET_AVX2 void resolveFloatAVX2(unsigned char *source, int rowBytes, int height, int pitch, int slice)
+	{
+		const __m256 scale = _mm256_set1_ps(1.0f / samples);
+
+		for(int y = 0; y < height; y++)
+		{
+			unsigned char *row = source + y * pitch;
+			int x = 0;
+
+			for(; x + 32 <= rowBytes; x += 32)
+			{
+				__m256 c[samples];
+
+				for(int i = 0; i < samples; i++)
+				{
+					c[i] = _mm256_loadu_ps((float*)(row + i * slice + x));
+				}
+
+				for(int n = samples / 2; n >= 1; n /= 2)
+				{
+					for(int i = 0; i < n; i++)
+					{
+						c[i] = _mm256_add_ps(c[2 * i], c[2 * i + 1]);
+					}
+				}
+
+				_mm256_storeu_ps((float*)(row + x), _mm256_mul_ps(c[0], scale));
+			}
+
+			for(; x < rowBytes; x += 4)
+			{
+				float c[samples];
+
+				for(int i = 0; i < samples; i++)
+				{
+					c[i] = *(float*)(row + i * slice + x);
+				}
+
+				for(int n = samples / 2; n >= 1; n /= 2)
+				{
+					for(int i = 0; i < n; i++)
+					{
+						c[i] = c[2 * i] + c[2 * i + 1];
+					}
+				}
+
+				*(float*)(row + x) = c[0] * (1.0f / samples);
+			}
+		}
+	}
+
+	// Returns false for formats without an AVX2 resolve, which then take the SSE or C++ paths
+	static bool resolveAVX2(Format format, int samples, unsigned char *source, int rowBytes, int height, int pitch, int slice)
+	{
+		switch(format)
+		{
+		case FORMAT_X8R8G8B8:
+		case FORMAT_A8R8G8B8:
+		case FORMAT_X8B8G8R8:
+		case FORMAT_A8B8G8R8:
+		case FORMAT_SRGB8_X8:
+		case FORMAT_SRGB8_A8:
+			switch(samples)
+			{
+			case 2:  resolveUnormAVX2<unsigned char, 2>(source, rowBytes, height, pitch, slice); return true;
+			case 4:  resolveUnormAVX2<unsigned char, 4>(source, rowBytes, height, pitch, slice); return true;
+			case 8:  resolveUnormAVX2<unsigned char, 8>(source, rowBytes, height, pitch, slice); return true;
+			case 16: resolveUnormAVX2<unsigned char, 16>(source, rowBytes, height, pitch, slice); return true;
+			}
+			break;
+		case FORMAT_G16R16:
+		case FORMAT_A16B16G16R16:   // Also holds 10-10-10-2 formats
+			switch(samples)
+			{
+			case 2:  resolveUnormAVX2<unsigned short, 2>(source, rowBytes, height, pitch, slice); return true;
+			case 4:  resolveUnormAVX2<unsigned short, 4>(source, rowBytes, height, pitch, slice); return true;
+			case 8:  resolveUnormAVX2<unsigned short, 8>(source, rowBytes, height, pitch, slice); return true;
+			case 16: resolveUnormAVX2<unsigned short, 16>(source, rowBytes, height, pitch, slice); return true;
+			}
+			break;
+		case FORMAT_R32F:
+		case FORMAT_G32R32F:
+		case FORMAT_A32B32G32R32F:
+		case FORMAT_X32B32G32R32F:
+		case FORMAT_X32B32G32R32F_UNSIGNED:   // Also holds half-float formats
+			switch(samples)
+			{
+			case 2:  resolveFloatAVX2<2>(source, rowBytes, height, pitch, slice); return true;
+			case 4:  resolveFloatAVX2<4>(source, rowBytes, height, pitch, slice); return true;
+			case 8:  resolveFloatAVX2<8>(source, rowBytes, height, pitch, slice); return true;
+			case 16: resolveFloatAVX2<16>(source, rowBytes, height, pitch, slice); return true;
+			}
+			break;
+		default:
+			break;
+		}
+
+		return false;
+	}
+#endif
+
 	void Surface::resolve()
 	{
 		if(internal.samples <= 1 || !internal.dirty || !renderTarget || internal.format == FORMAT_NULL)
@@ -4007,6 +4935,23 @@ namespace sw
 
 		ASSERT(internal.depth == 1);  // Unimplemented
 
+		// Bands of rows are resolved concurrently
+		const int bandHeight = 32;
+		int bandCount = (internal.height + bandHeight - 1) / bandHeight;
+
+		parallelFor(bandCount, [this](int band)
+		{
+			Buffer rows;
+			rows = internal;
+			rows.buffer = (byte*)internal.buffer + band * bandHeight * internal.pitchB;
+			rows.height = min(bandHeight, internal.height - band * bandHeight);
+
+			resolve(rows);
+		});
+	}
+
+	void Surface::resolve(Buffer &internal)
+	{
 		void *source = internal.lockRect(0, 0, 0, LOCK_READWRITE);
 
 		int width = internal.width;
@@ -4031,6 +4976,13 @@ namespace sw
 		unsigned char *sourceE = sourceD + slice;
 		unsigned char *sourceF = sourceE + slice;
 
+		#if defined(__i386__) || defined(__x86_64__)
+			if(CPUID::supportsAVX2() && resolveAVX2(internal.format, internal.samples, source0, width * internal.bytes, height, pitch, slice))
+			{
+				return;
+			}
+		#endif
+
 		if(internal.format == FORMAT_X8R8G8B8 || internal.format == FORMAT_A8R8G8B8 ||
 		   internal.format == FORMAT_X8B8G8R8 || internal.format == FORMAT_A8B8G8R8 ||
 		   internal.format == FORMAT_SRGB8_X8 || internal.format == FORMAT_SRGB8_A8)
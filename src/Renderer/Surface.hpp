@@ -19,6 +19,8 @@
 #include "Main/Config.hpp"
 #include "Common/Resource.hpp"
 
+#include <atomic>
+
 namespace sw
 {
 	class Resource;
@@ -274,6 +276,7 @@ namespace sw
 			AtomicInt lock;
 
 			bool dirty;   // Sibling internal/external buffer doesn't match.
+			int dirtyRow;   // First modified row, counting the rows of all slices.
 		};
 
 	protected:
@@ -308,6 +311,8 @@ namespace sw
 
 		virtual void *lockInternal(int x, int y, int z, Lock lock, Accessor client) = 0;
 		virtual void unlockInternal() = 0;
+		void updateInternal();   // Decode external data modified since the last update.
+		bool canLoadInternal() const;   // External data can be stored directly in the internal layout.
 		inline Format getInternalFormat() const;
 		inline int getInternalPitchB() const;
 		inline int getInternalPitchP() const;
@@ -332,6 +337,15 @@ namespace sw
 		Rect getRect() const;
 		void clearDepth(float depth, int x0, int y0, int width, int height);
 		void clearStencil(unsigned char stencil, unsigned char mask, int x0, int y0, int width, int height);
+		bool deferInternalClear(unsigned int pattern);   // Clears the entire internal buffer once rows get used.
+		bool deferStencilClear(unsigned int pattern);
+		void materializeClears(int y0, int y1);   // Writes deferred clears of the given rows to memory.
+		float *getHiZ(int tileSize);              // Upper bound of the depth in each tile, for hierarchical depth culling.
+		int getHiZPitch(int tileSize) const;      // Tiles per row of the hierarchical depth bounds.
+		inline void invalidateHiZ();
+		void addDamage(const Rect &rect);         // Marks pixels which have to be presented again.
+		void limitDamage(const Rect &rect);       // The next write lock only damages the given rectangle.
+		bool takeDamage(Rect &rect);              // Damage since the previous call, false if there is none.
 		void fill(const Color<float> &color, int x0, int y0, int width, int height);
 
 		Color<float> readExternal(int x, int y, int z) const;
@@ -376,6 +390,7 @@ namespace sw
 		static bool isSRGBwritable(Format format);
 		static bool isSRGBformat(Format format);
 		static bool isCompressed(Format format);
+		static bool isCompressedSampleable(Format format);
 		static bool isSignedNonNormalizedInteger(Format format);
 		static bool isUnsignedNonNormalizedInteger(Format format);
 		static bool isNonNormalizedInteger(Format format);
@@ -470,6 +485,7 @@ namespace sw
 		static void decodeA1R5G5B5(Buffer &destination, Buffer &source);
 		static void decodeX4R4G4B4(Buffer &destination, Buffer &source);
 		static void decodeA4R4G4B4(Buffer &destination, Buffer &source);
+		static void decode1010102(Buffer &destination, Buffer &source);
 		static void decodeP8(Buffer &destination, Buffer &source);
 
 		static void decodeDXT1(Buffer &internal, Buffer &external);
@@ -482,19 +498,71 @@ namespace sw
 		static void decodeASTC(Buffer &internal, Buffer &external, int xSize, int ySize, int zSize, bool isSRGB);
 
 		static void update(Buffer &destination, Buffer &source);
+		static void decode(Buffer &destination, Buffer &source);
 		static void genericUpdate(Buffer &destination, Buffer &source);
+		static int blockHeight(Format format);
 		static void *allocateBuffer(int width, int height, int depth, int border, int samples, Format format);
-		static void memfill4(void *buffer, int pattern, int bytes);
+		static void memfill4(void *buffer, int pattern, int bytes, bool streaming = true);   // Non-temporal stores when streaming
 
 		bool identicalBuffers() const;
-		Format selectInternalFormat(Format format) const;
+		Format selectInternalFormat(Format format, int border) const;
 
 		void resolve();
+		static void resolve(Buffer &internal);
+
+		// Clear of an entire buffer, filled in per band of rows when they first get used.
+		struct DeferredClear
+		{
+			enum
+			{
+				BAND_ROWS = 32
+			};
+
+			enum BandState
+			{
+				FILLED,
+				PENDING,
+				FILLING
+			};
+
+			std::atomic<bool> pending;
+			std::atomic<int> *band;
+			int bandCount;
+			unsigned int pattern;
+		};
+
+		static bool deferClear(Buffer &buffer, DeferredClear &clear, unsigned int pattern);
+		static void materializeClear(Buffer &buffer, DeferredClear &clear, int y0, int y1);
+
+		// Upper bounds of the depth of each tile. Pixel routines keep the bounds of the tile size
+		// they rasterize with up to date, other writes to the depth buffer invalidate them.
+		struct HierarchicalDepth
+		{
+			enum
+			{
+				MIN_TILE_SHIFT = 3,   // 8 pixels
+				TILE_SIZES = 5        // 8, 16, 32, 64 and 128 pixels
+			};
+
+			float *bound[TILE_SIZES];
+			int current;   // Index of the bounds being kept up to date, -1 if none are
+		};
+
+		void fillHiZ(float depth);
 
 		Buffer external;
 		Buffer internal;
 		Buffer stencil;
 
+		DeferredClear internalClear;
+		DeferredClear stencilClear;
+
+		HierarchicalDepth hiZ;
+
+		Rect damage;         // Bounds of the pixels written since the last presentation
+		Rect damageLimit;
+		bool damageLimited;
+
 		const bool lockable;
 		const bool renderTarget;
 
@@ -534,6 +602,11 @@ namespace sw
 		return external.height;
 	}
 
+	void Surface::invalidateHiZ()
+	{
+		hiZ.current = -1;
+	}
+
 	int Surface::getDepth() const
 	{
 		return external.depth;
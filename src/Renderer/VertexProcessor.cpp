@@ -20,6 +20,7 @@
 #include "Shader/PixelShader.hpp"
 #include "Shader/Constants.hpp"
 #include "Common/Math.hpp"
+#include "Common/Memory.hpp"
 #include "Common/Debug.hpp"
 
 #include <string.h>
@@ -28,9 +29,37 @@ namespace sw
 {
 	bool precacheVertex = false;
 
+	void VertexCache::init(int size)
+	{
+		int sets = ceilPow2(max(size, 4 * WAYS)) / (4 * WAYS);
+
+		vertex = (Vertex(*)[4])allocate(sets * WAYS * sizeof(Vertex[4]));
+		tag = (unsigned int*)allocate(sets * WAYS * sizeof(unsigned int));
+		victim = (unsigned int*)allocate(sets * sizeof(unsigned int));
+		setMask = sets - 1;
+
+		for(int i = 0; i < sets; i++)
+		{
+			victim[i] = 0;
+		}
+
+		lookups = 0;
+		misses = 0;
+
+		drawCall = -1;
+		clear();
+	}
+
+	void VertexCache::free()
+	{
+		deallocate(vertex);
+		deallocate(tag);
+		deallocate(victim);
+	}
+
 	void VertexCache::clear()
 	{
-		for(int i = 0; i < 16; i++)
+		for(unsigned int i = 0; i < (setMask + 1) * WAYS; i++)
 		{
 			tag[i] = 0x80000000;
 		}
@@ -354,9 +383,10 @@ namespace sw
 		context->vertexFogMode = fogMode;
 	}
 
-	void VertexProcessor::setInstanceID(int instanceID)
+	void VertexProcessor::setInstances(int firstInstance, int instanceCount)
 	{
-		context->instanceID = instanceID;
+		context->firstInstance = firstInstance;
+		context->instanceCount = instanceCount;
 	}
 
 	void VertexProcessor::setColorVertexEnable(bool colorVertexEnable)
@@ -975,6 +1005,9 @@ namespace sw
 		state.transformFeedbackQueryEnabled = context->transformFeedbackQueryEnabled;
 		state.transformFeedbackEnabled = context->transformFeedbackEnabled;
 
+		// Transform feedback needs vertices in primitive order, and texture sampling shades vertices one at a time
+		state.bulkVertices = context->bulkVertices && !state.transformFeedbackEnabled && !state.textureSampling;
+
 		// Note: Quads aren't handled for verticesPerPrimitive, but verticesPerPrimitive is used for transform feedback,
 		//       which is an OpenGL ES 3.0 feature, and OpenGL ES 3.0 doesn't support quads as a primitive type.
 		DrawType type = static_cast<DrawType>(static_cast<unsigned int>(drawType) & 0xF);
@@ -985,6 +1018,7 @@ namespace sw
 			state.input[i].type = context->input[i].type;
 			state.input[i].count = context->input[i].count;
 			state.input[i].normalized = context->input[i].normalized;
+			state.input[i].instanced = context->input[i].divisor != 0;
 			state.input[i].attribType = context->vertexShader ? context->vertexShader->getAttribType(i) : VertexShader::ATTRIBTYPE_FLOAT;
 		}
 
@@ -1094,6 +1128,92 @@ namespace sw
 		Routine *routine = routineCache->query(state);
 
 		if(!routine)   // Create one
+		{
+			State persistentState;
+			uint64_t shaderHash = persistentKey(state, persistentState);
+
+			routine = routineCache->load(persistentState, shaderHash);
+
+			if(!routine)
+			{
+				if(asyncRoutineCompilation && Nucleus::hasFastUnoptimizedTier())
+				{
+					// Don't make rendering threads wait for an optimized routine. Generating one without
+					// optimizations is fast, and it's used until the optimized one replaces it. With
+					// tiered compilation that only happens once it's drawn with frequently.
+					AsyncRoutine *unoptimized = new AsyncRoutine(generateRoutine(state, false, false));
+
+					if(tieredRoutineCompilation)
+					{
+						routine = unoptimized;
+					}
+					else
+					{
+						routine = generateRoutine(state, true, true, unoptimized);
+						unoptimized->unbind();
+					}
+				}
+				else
+				{
+					// Without a faster tier the state is only generated once, on a generation thread
+					// when asynchronous, so the application thread doesn't wait for it
+					routine = generateRoutine(state, !tieredRoutineCompilation, asyncRoutineCompilation);
+				}
+			}
+			else if(asyncRoutineCompilation)
+			{
+				routine = new AsyncRoutine(routine);
+			}
+
+			routineCache->add(state, routine);
+
+			if(asyncRoutineCompilation)
+			{
+				routine->unbind();   // Created with a reference for us, the cache holds it now
+			}
+		}
+
+		return routine;
+	}
+
+	Routine *VertexProcessor::tierUp(const State &state, Routine *routine)
+	{
+		if(!routine->isOptimized() && routine->countUse() == TIER_UP_USE_COUNT)
+		{
+			// Frequently drawn with, so regenerate it with optimizations. That's never done on this thread,
+			// since draw calls keep using this routine until the optimized one is ready.
+			AsyncRoutine *fallback = asyncRoutineCompilation ? static_cast<AsyncRoutine*>(routine) : new AsyncRoutine(routine);   // All cached routines are AsyncRoutines in that mode
+			routine = generateRoutine(state, true, true, fallback);
+			routineCache->add(state, routine);
+			routine->unbind();
+
+			if(!asyncRoutineCompilation)
+			{
+				fallback->unbind();   // Held by the optimized routine now
+			}
+		}
+
+		return routine;
+	}
+
+	uint64_t VertexProcessor::persistentKey(const State &state, State &persistentState) const
+	{
+		// Shader serial IDs differ between processes, so the persistent cache is keyed on the shader contents
+		memcpy(&persistentState, &state, sizeof(State));
+		persistentState.shaderID = 0;
+		persistentState.hash = 0;
+
+		return (precacheVertex && !state.fixedFunction) ? context->vertexShader->computeContentHash() : 0;
+	}
+
+	Routine *VertexProcessor::generateRoutine(const State &state, bool optimize, bool background, AsyncRoutine *fallback)
+	{
+		const VertexShader *shader = state.fixedFunction ? nullptr : context->vertexShader;
+
+		State persistentState;
+		uint64_t shaderHash = persistentKey(state, persistentState);
+
+		auto generate = [=]() -> Routine*
 		{
 			VertexRoutine *generator = nullptr;
 
@@ -1103,16 +1223,42 @@ namespace sw
 			}
 			else
 			{
-				generator = new VertexProgram(state, context->vertexShader);
+				generator = new VertexProgram(state, shader);
 			}
 
 			generator->generate();
-			routine = (*generator)(L"VertexRoutine_%0.8X", state.shaderID);
+			Routine *routine = optimize ? (*generator)(L"VertexRoutine_%0.8X", state.shaderID) :
+			                              generator->acquireUnoptimized(L"VertexRoutine_%0.8X", state.shaderID);
 			delete generator;
 
-			routineCache->add(state, routine);
+			if(optimize)   // Loaded routines don't get regenerated
+			{
+				routineCache->store(persistentState, shaderHash, routine);
+			}
+
+			return routine;
+		};
+
+		if(!background)
+		{
+			return generate();
 		}
 
-		return routine;
+		if(shader)
+		{
+			shader->addGeneratorReference();
+		}
+
+		return new AsyncRoutine([=]()
+		{
+			Routine *routine = generate();
+
+			if(shader)
+			{
+				shader->releaseGeneratorReference();
+			}
+
+			return routine;
+		}, optimize, fallback);
 	}
 }
@@ -24,12 +24,21 @@ namespace sw
 {
 	struct DrawData;
 
-	struct VertexCache   // FIXME: Variable size
+	struct VertexCache   // Set associative, each line holds four vertices with consecutive indices
 	{
+		enum {WAYS = 2};
+
+		void init(int size);   // Number of vertices, rounded up to a power of two
+		void free();
 		void clear();
 
-		Vertex vertex[16][4];
-		unsigned int tag[16];
+		Vertex (*vertex)[4];     // [sets][WAYS]
+		unsigned int *tag;       // [sets][WAYS]
+		unsigned int *victim;    // [sets], way to replace on the next miss
+		unsigned int setMask;
+
+		unsigned int lookups;    // Counted by the vertex routine, and collected by the renderer for the profiler
+		unsigned int misses;
 
 		int drawCall;
 	};
@@ -38,6 +47,7 @@ namespace sw
 	{
 		unsigned int vertexCount;
 		unsigned int primitiveStart;
+		unsigned int instanceID;
 		VertexCache vertexCache;
 	};
 
@@ -81,6 +91,7 @@ namespace sw
 			bool preTransformed : 1;
 			bool superSampling  : 1;
 			bool multiSampling  : 1;
+			bool bulkVertices   : 1;
 
 			struct TextureState
 			{
@@ -103,6 +114,7 @@ namespace sw
 				StreamType type    : BITS(STREAMTYPE_LAST);
 				unsigned int count : 3;
 				bool normalized    : 1;
+				bool instanced     : 1;
 				unsigned int attribType : BITS(VertexShader::ATTRIBTYPE_LAST);
 			};
 
@@ -220,7 +232,7 @@ namespace sw
 		void setLightAttenuation(unsigned int light, float constant, float linear, float quadratic);
 		void setLightRange(unsigned int light, float lightRange);
 
-		void setInstanceID(int instanceID);
+		void setInstances(int firstInstance, int instanceCount);
 
 		void setFogEnable(bool fogEnable);
 		void setVertexFogMode(FogMode fogMode);
@@ -286,6 +298,7 @@ namespace sw
 
 		const State update(DrawType drawType);
 		Routine *routine(const State &state);
+		Routine *tierUp(const State &state, Routine *routine);   // Counts a draw call using the routine
 
 		bool isFixedFunction();
 		void setRoutineCacheSize(int cacheSize);
@@ -326,6 +339,9 @@ namespace sw
 		void setCameraTransform(const Matrix &M, int i);
 		void setNormalTransform(const Matrix &M, int i);
 
+		uint64_t persistentKey(const State &state, State &persistentState) const;
+		Routine *generateRoutine(const State &state, bool optimize, bool background, AsyncRoutine *fallback = nullptr);   // Background generation returns an AsyncRoutine, referenced for the caller
+
 		Context *const context;
 
 		RoutineCache<State> *routineCache;
@@ -74,6 +74,11 @@ namespace sw
 		unsigned short linearToSRGB12_16[4096];
 		unsigned short sRGBtoLinear12_16[4096];
 
+		// ETC2 and EAC block decoding
+		int etcModifiers[8][4];
+		int etcDistances[8];
+		int eacModifiers[16][8];
+
 		// Centroid parameters
 		float4 sampleX[4][16];
 		float4 sampleY[4][16];
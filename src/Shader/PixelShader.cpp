@@ -58,6 +58,25 @@ namespace sw
 
 	PixelShader::~PixelShader()
 	{
+		waitForGenerators();
+	}
+
+	uint64_t PixelShader::computeContentHash() const
+	{
+		uint64_t hash = Shader::computeContentHash();
+
+		for(int i = 0; i < MAX_FRAGMENT_INPUTS; i++)
+		{
+			for(int component = 0; component < 4; component++)
+			{
+				const Semantic &semantic = input[i][component];
+				hash = combineHash(hash, semantic.usage | semantic.index << 8 | semantic.centroid << 16 | semantic.flat << 17);
+			}
+		}
+
+		hash = combineHash(hash, vPosDeclared << 0 | vFaceDeclared << 1 | zOverride << 2 | kill << 3 | centroid << 4);
+
+		return hash;
 	}
 
 	int PixelShader::validate(const unsigned long *const token)
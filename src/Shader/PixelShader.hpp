@@ -44,6 +44,8 @@ namespace sw
 		bool isVPosDeclared() const { return vPosDeclared; }
 		bool isVFaceDeclared() const { return vFaceDeclared; }
 
+		uint64_t computeContentHash() const override;
+
 	private:
 		void analyze();
 		void analyzeZOverride();
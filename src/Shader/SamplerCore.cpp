@@ -46,6 +46,56 @@ namespace
 		default: ASSERT(false);
 		}
 	}
+
+	// Gathers the 32-bit word at the given byte offset of each lane's block
+	sw::Int4 loadBlockWords(sw::Pointer<sw::Byte> block[4], int offset)
+	{
+		sw::Int4 words;
+
+		for(int n = 0; n < 4; n++)
+		{
+			words = sw::Insert(words, *sw::Pointer<sw::Int>(block[n] + offset), n);
+		}
+
+		return words;
+	}
+
+	// Reads table[index] for each lane
+	sw::Int4 lookup(sw::Pointer<sw::Byte> table, const sw::Int4 &index)
+	{
+		sw::Int4 values;
+
+		for(int n = 0; n < 4; n++)
+		{
+			values = sw::Insert(values, sw::Pointer<sw::Int>(table)[sw::Extract(index, n)], n);
+		}
+
+		return values;
+	}
+
+	sw::Int4 select(const sw::Int4 &mask, const sw::Int4 &a, const sw::Int4 &b)
+	{
+		return (mask & a) | (~mask & b);
+	}
+
+	sw::Int4 select(const sw::Int4 &index, const sw::Int4 &v0, const sw::Int4 &v1, const sw::Int4 &v2, const sw::Int4 &v3)
+	{
+		return (sw::CmpEQ(index, sw::Int4(0)) & v0) |
+		       (sw::CmpEQ(index, sw::Int4(1)) & v1) |
+		       (sw::CmpEQ(index, sw::Int4(2)) & v2) |
+		       (sw::CmpEQ(index, sw::Int4(3)) & v3);
+	}
+
+	// Replicates the top bits of a 4 to 7-bit value into the low bits of its 8-bit expansion
+	sw::Int4 extendTo8bit(const sw::Int4 &v, int bits)
+	{
+		return (v << (unsigned char)(8 - bits)) | (v >> (unsigned char)(2 * bits - 8));
+	}
+
+	sw::Int4 clampByte(const sw::Int4 &v)
+	{
+		return sw::Min(sw::Max(v, sw::Int4(0)), sw::Int4(0xFF));
+	}
 }
 
 namespace sw
@@ -212,6 +262,14 @@ namespace sw
 					case FORMAT_YV12_BT601:
 					case FORMAT_YV12_BT709:
 					case FORMAT_YV12_JFIF:
+					case FORMAT_DXT1:
+					case FORMAT_DXT3:
+					case FORMAT_DXT5:
+					case FORMAT_ATI1:
+					case FORMAT_ATI2:
+					case FORMAT_ETC1:
+					case FORMAT_RGB8_ETC2:
+					case FORMAT_RGBA8_ETC2_EAC:
 						if(componentCount < 2) c.y = Short4(defaultColorValue);
 						if(componentCount < 3) c.z = Short4(defaultColorValue);
 						if(componentCount < 4) c.w = Short4(0x1000);
@@ -440,6 +498,14 @@ namespace sw
 				case FORMAT_YV12_BT601:
 				case FORMAT_YV12_BT709:
 				case FORMAT_YV12_JFIF:
+				case FORMAT_DXT1:
+				case FORMAT_DXT3:
+				case FORMAT_DXT5:
+				case FORMAT_ATI1:
+				case FORMAT_ATI2:
+				case FORMAT_ETC1:
+				case FORMAT_RGB8_ETC2:
+				case FORMAT_RGBA8_ETC2_EAC:
 					if(componentCount < 2) c.y = Float4(defaultColorValue);
 					if(componentCount < 3) c.z = Float4(defaultColorValue);
 					if(componentCount < 4) c.w = Float4(1.0f);
@@ -1226,10 +1292,17 @@ namespace sw
 		address(w, z0, z0, fv, mipmap, offset.z, filter, OFFSET(Mipmap, depth), state.addressingModeW, function);
 
 		Int4 pitchP = *Pointer<Int4>(mipmap + OFFSET(Mipmap, pitchP), 16);
+		Int4 sliceP = *Pointer<Int4>(mipmap + OFFSET(Mipmap, sliceP), 16);
+
+		if(hasCompressedTextureFormat())   // Blocks are located from the texel coordinates
+		{
+			pitchP = Int4(1);
+			sliceP = Int4(1);
+		}
+
 		y0 *= pitchP;
 		if(hasThirdCoordinate())
 		{
-			Int4 sliceP = *Pointer<Int4>(mipmap + OFFSET(Mipmap, sliceP), 16);
 			z0 *= sliceP;
 		}
 
@@ -1296,6 +1369,13 @@ namespace sw
 
 		Int4 pitchP = *Pointer<Int4>(mipmap + OFFSET(Mipmap, pitchP), 16);
 		Int4 sliceP = *Pointer<Int4>(mipmap + OFFSET(Mipmap, sliceP), 16);
+
+		if(hasCompressedTextureFormat())   // Blocks are located from the texel coordinates
+		{
+			pitchP = Int4(1);
+			sliceP = Int4(1);
+		}
+
 		y0 *= pitchP;
 		z0 *= sliceP;
 
@@ -1652,7 +1732,7 @@ namespace sw
 		return As<Short4>(UShort4(tmp));
 	}
 
-	void SamplerCore::computeIndices(UInt index[4], Short4 uuuu, Short4 vvvv, Short4 wwww, Vector4f &offset, const Pointer<Byte> &mipmap, SamplerFunction function)
+	void SamplerCore::computeTexelCoordinates(Short4 &uuuu, Short4 &vvvv, Short4 &wwww, Vector4f &offset, const Pointer<Byte> &mipmap, SamplerFunction function)
 	{
 		bool texelFetch = (function == Fetch);
 		bool hasOffset = (function.option == Offset);
@@ -1671,6 +1751,27 @@ namespace sw
 			vvvv = applyOffset(vvvv, offset.y, Int4(h), texelFetch ? ADDRESSING_TEXELFETCH : state.addressingModeV);
 		}
 
+		if(hasThirdCoordinate() && state.textureType != TEXTURE_2D_ARRAY)
+		{
+			if(!texelFetch)
+			{
+				wwww = MulHigh(As<UShort4>(wwww), *Pointer<UShort4>(mipmap + OFFSET(Mipmap, depth)));
+			}
+
+			if(hasOffset)
+			{
+				UShort4 d = *Pointer<UShort4>(mipmap + OFFSET(Mipmap, depth));
+				wwww = applyOffset(wwww, offset.z, Int4(d), texelFetch ? ADDRESSING_TEXELFETCH : state.addressingModeW);
+			}
+		}
+	}
+
+	void SamplerCore::computeIndices(UInt index[4], Short4 uuuu, Short4 vvvv, Short4 wwww, Vector4f &offset, const Pointer<Byte> &mipmap, SamplerFunction function)
+	{
+		bool texelFetch = (function == Fetch);
+
+		computeTexelCoordinates(uuuu, vvvv, wwww, offset, mipmap, function);
+
 		Short4 uuu2 = uuuu;
 		uuuu = As<Short4>(UnpackLow(uuuu, vvvv));
 		uuu2 = As<Short4>(UnpackHigh(uuu2, vvvv));
@@ -1679,20 +1780,6 @@ namespace sw
 
 		if(hasThirdCoordinate())
 		{
-			if(state.textureType != TEXTURE_2D_ARRAY)
-			{
-				if(!texelFetch)
-				{
-					wwww = MulHigh(As<UShort4>(wwww), *Pointer<UShort4>(mipmap + OFFSET(Mipmap, depth)));
-				}
-
-				if(hasOffset)
-				{
-					UShort4 d = *Pointer<UShort4>(mipmap + OFFSET(Mipmap, depth));
-					wwww = applyOffset(wwww, offset.z, Int4(d), texelFetch ? ADDRESSING_TEXELFETCH : state.addressingModeW);
-				}
-			}
-
 			UInt4 uv(As<UInt2>(uuuu), As<UInt2>(uuu2));
 			uv += As<UInt4>(Int4(As<UShort4>(wwww))) * *Pointer<UInt4>(mipmap + OFFSET(Mipmap, sliceP));
 
@@ -2006,6 +2093,27 @@ namespace sw
 	{
 		Vector4s c;
 
+		if(hasCompressedTextureFormat())
+		{
+			Short4 u = uuuu;
+			Short4 v = vvvv;
+			Short4 w = wwww;
+			computeTexelCoordinates(u, v, w, offset, mipmap, function);
+
+			Int4 x = Int4(As<UShort4>(u));
+			Int4 y = Int4(As<UShort4>(v));
+			Int4 z = Int4(As<UShort4>(w));
+
+			if(function == Fetch)
+			{
+				x = Min(Max(x, Int4(0)), Int4(*Pointer<UShort4>(mipmap + OFFSET(Mipmap, width))) - Int4(1));
+				y = Min(Max(y, Int4(0)), Int4(*Pointer<UShort4>(mipmap + OFFSET(Mipmap, height))) - Int4(1));
+				z = Min(Max(z, Int4(0)), Int4(*Pointer<UShort4>(mipmap + OFFSET(Mipmap, depth))) - Int4(1));
+			}
+
+			return sampleCompressedTexel(x, y, z, mipmap, buffer);
+		}
+
 		UInt index[4];
 		computeIndices(index, uuuu, vvvv, wwww, offset, mipmap, function);
 
@@ -2111,6 +2219,331 @@ namespace sw
 		return c;
 	}
 
+	Vector4s SamplerCore::sampleCompressedTexel(Int4 &x, Int4 &y, Int4 &z, Pointer<Byte> &mipmap, Pointer<Byte> buffer[4])
+	{
+		Vector4s c;
+
+		int f0 = state.textureType == TEXTURE_CUBE ? 0 : 0;
+		int f1 = state.textureType == TEXTURE_CUBE ? 1 : 0;
+		int f2 = state.textureType == TEXTURE_CUBE ? 2 : 0;
+		int f3 = state.textureType == TEXTURE_CUBE ? 3 : 0;
+
+		int bytes = Surface::bytes(state.textureFormat);
+		int blockSize = 16;
+		int rowsPerPitch = 1;   // Block rows covered by one pitch
+
+		switch(state.textureFormat)
+		{
+		case FORMAT_DXT1:
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:
+			blockSize = 8;
+			break;
+		case FORMAT_ATI1:
+			blockSize = 8;
+			rowsPerPitch = 4;
+			break;
+		case FORMAT_ATI2:
+			rowsPerPitch = 4;
+			break;
+		default:
+			break;
+		}
+
+		Int4 pitchB = *Pointer<Int4>(mipmap + OFFSET(Mipmap, pitchP), 16) * Int4(bytes * rowsPerPitch);
+		Int4 offset = (y >> 2) * pitchB + (x >> 2) * Int4(blockSize);
+
+		if(hasThirdCoordinate())
+		{
+			offset += z * *Pointer<Int4>(mipmap + OFFSET(Mipmap, sliceP), 16) * Int4(bytes);
+		}
+
+		Pointer<Byte> block[4];
+		block[0] = buffer[f0] + Extract(offset, 0);
+		block[1] = buffer[f1] + Extract(offset, 1);
+		block[2] = buffer[f2] + Extract(offset, 2);
+		block[3] = buffer[f3] + Extract(offset, 3);
+
+		// Texel position within the 4x4 block
+		Int4 i = x & Int4(3);
+		Int4 j = y & Int4(3);
+
+		Int4 r = Int4(0);
+		Int4 g = Int4(0);
+		Int4 b = Int4(0);
+		Int4 a = Int4(0);
+
+		switch(state.textureFormat)
+		{
+		case FORMAT_DXT1:
+			{
+				Int4 colors = loadBlockWords(block, 0);
+				Int4 lut = loadBlockWords(block, 4);
+				decodeColorBlock(r, g, b, a, colors, lut, i, j, true);
+			}
+			break;
+		case FORMAT_DXT3:
+			{
+				Int4 colors = loadBlockWords(block, 8);
+				Int4 lut = loadBlockWords(block, 12);
+				decodeColorBlock(r, g, b, a, colors, lut, i, j, false);
+
+				Int4 alpha = select(CmpLT(j, Int4(2)), loadBlockWords(block, 0), loadBlockWords(block, 4));
+				a = ((alpha >> ((((j & Int4(1)) << 2) + i) << 2)) & Int4(0xF)) * Int4(0x11);
+			}
+			break;
+		case FORMAT_DXT5:
+			{
+				Int4 colors = loadBlockWords(block, 8);
+				Int4 lut = loadBlockWords(block, 12);
+				decodeColorBlock(r, g, b, a, colors, lut, i, j, false);
+
+				Int4 lo = loadBlockWords(block, 0);
+				Int4 hi = loadBlockWords(block, 4);
+				a = decodeAlphaBlock(lo, hi, i, j);
+			}
+			break;
+		case FORMAT_ATI1:
+			{
+				Int4 lo = loadBlockWords(block, 0);
+				Int4 hi = loadBlockWords(block, 4);
+				r = decodeAlphaBlock(lo, hi, i, j);
+			}
+			break;
+		case FORMAT_ATI2:
+			{
+				Int4 xlo = loadBlockWords(block, 8);
+				Int4 xhi = loadBlockWords(block, 12);
+				r = decodeAlphaBlock(xlo, xhi, i, j);
+
+				Int4 ylo = loadBlockWords(block, 0);
+				Int4 yhi = loadBlockWords(block, 4);
+				g = decodeAlphaBlock(ylo, yhi, i, j);
+			}
+			break;
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:
+			{
+				Int4 lo = loadBlockWords(block, 0);
+				Int4 hi = loadBlockWords(block, 4);
+				decodeETC2Block(r, g, b, lo, hi, i, j);
+			}
+			break;
+		case FORMAT_RGBA8_ETC2_EAC:
+			{
+				Int4 lo = loadBlockWords(block, 8);
+				Int4 hi = loadBlockWords(block, 12);
+				decodeETC2Block(r, g, b, lo, hi, i, j);
+
+				Int4 alo = loadBlockWords(block, 0);
+				Int4 ahi = loadBlockWords(block, 4);
+				a = decodeEACBlock(alo, ahi, i, j);
+			}
+			break;
+		default:
+			ASSERT(false);
+		}
+
+		// Replicate the 8-bit values into 16-bit ones, like the byte unpacking of uncompressed formats
+		int componentCount = textureComponentCount();
+		if(componentCount >= 1) c.x = Short4(r);
+		if(componentCount >= 2) c.y = Short4(g);
+		if(componentCount >= 3) c.z = Short4(b);
+		if(componentCount >= 4) c.w = Short4(a);
+
+		for(int n = 0; n < componentCount; n++)
+		{
+			c[n] = c[n] | (c[n] << 8);
+
+			if(state.sRGB && isRGBComponent(n))
+			{
+				sRGBtoLinear16_8_16(c[n]);
+			}
+		}
+
+		return c;
+	}
+
+	void SamplerCore::decodeColorBlock(Int4 &r, Int4 &g, Int4 &b, Int4 &a, Int4 &colors, Int4 &lut, Int4 &i, Int4 &j, bool punchThrough)
+	{
+		Int4 c0 = colors & Int4(0xFFFF);
+		Int4 c1 = (colors >> 16) & Int4(0xFFFF);
+
+		Int4 r0 = extendTo8bit((c0 >> 11) & Int4(0x1F), 5);
+		Int4 g0 = extendTo8bit((c0 >> 5) & Int4(0x3F), 6);
+		Int4 b0 = extendTo8bit(c0 & Int4(0x1F), 5);
+		Int4 r1 = extendTo8bit((c1 >> 11) & Int4(0x1F), 5);
+		Int4 g1 = extendTo8bit((c1 >> 5) & Int4(0x3F), 6);
+		Int4 b1 = extendTo8bit(c1 & Int4(0x1F), 5);
+
+		// Divide by 3 through a reciprocal multiply, exact for this range
+		Int4 r2 = ((r0 + r0 + r1 + Int4(1)) * Int4(0xAAAB)) >> 17;
+		Int4 g2 = ((g0 + g0 + g1 + Int4(1)) * Int4(0xAAAB)) >> 17;
+		Int4 b2 = ((b0 + b0 + b1 + Int4(1)) * Int4(0xAAAB)) >> 17;
+		Int4 r3 = ((r0 + r1 + r1 + Int4(1)) * Int4(0xAAAB)) >> 17;
+		Int4 g3 = ((g0 + g1 + g1 + Int4(1)) * Int4(0xAAAB)) >> 17;
+		Int4 b3 = ((b0 + b1 + b1 + Int4(1)) * Int4(0xAAAB)) >> 17;
+
+		Int4 index = (lut >> ((i + (j << 2)) << 1)) & Int4(3);
+
+		a = Int4(0xFF);
+
+		if(punchThrough)
+		{
+			// Three colors and transparent black when c0 <= c1
+			Int4 transparent = CmpLE(c0, c1);
+
+			r2 = select(transparent, (r0 + r1) >> 1, r2);
+			g2 = select(transparent, (g0 + g1) >> 1, g2);
+			b2 = select(transparent, (b0 + b1) >> 1, b2);
+			r3 = ~transparent & r3;
+			g3 = ~transparent & g3;
+			b3 = ~transparent & b3;
+
+			a = ~(transparent & CmpEQ(index, Int4(3))) & Int4(0xFF);
+		}
+
+		r = select(index, r0, r1, r2, r3);
+		g = select(index, g0, g1, g2, g3);
+		b = select(index, b0, b1, b2, b3);
+	}
+
+	Int4 SamplerCore::decodeAlphaBlock(Int4 &lo, Int4 &hi, Int4 &i, Int4 &j)
+	{
+		Int4 a0 = lo & Int4(0xFF);
+		Int4 a1 = (lo >> 8) & Int4(0xFF);
+
+		// 3-bit indices follow the two endpoints, eight to a row pair
+		Int4 bits = select(CmpLT(j, Int4(2)), ((lo >> 16) & Int4(0xFFFF)) | ((hi & Int4(0xFF)) << 16), (hi >> 8) & Int4(0xFFFFFF));
+		Int4 k = (bits >> ((((j & Int4(1)) << 2) + i) * Int4(3))) & Int4(7);
+
+		// Divide by 7 and 5 through reciprocal multiplies, exact for this range
+		Int4 a8 = (((Int4(8) - k) * a0 + (k - Int4(1)) * a1 + Int4(3)) * Int4(9363)) >> 16;
+		Int4 a6 = (((Int4(6) - k) * a0 + (k - Int4(1)) * a1 + Int4(2)) * Int4(13108)) >> 16;
+		a6 = select(CmpEQ(k, Int4(6)), Int4(0x00), a6);
+		a6 = select(CmpEQ(k, Int4(7)), Int4(0xFF), a6);
+
+		Int4 alpha = select(CmpNLE(a0, a1), a8, a6);
+		alpha = select(CmpEQ(k, Int4(0)), a0, alpha);
+		alpha = select(CmpEQ(k, Int4(1)), a1, alpha);
+
+		return alpha;
+	}
+
+	void SamplerCore::decodeETC2Block(Int4 &r, Int4 &g, Int4 &b, Int4 &lo, Int4 &hi, Int4 &i, Int4 &j)
+	{
+		Int4 data[8];
+		data[0] = lo & Int4(0xFF);
+		data[1] = (lo >> 8) & Int4(0xFF);
+		data[2] = (lo >> 16) & Int4(0xFF);
+		data[3] = (lo >> 24) & Int4(0xFF);
+		data[4] = hi & Int4(0xFF);
+		data[5] = (hi >> 8) & Int4(0xFF);
+		data[6] = (hi >> 16) & Int4(0xFF);
+		data[7] = (hi >> 24) & Int4(0xFF);
+
+		Pointer<Byte> distances = constants + OFFSET(Constants,etcDistances);
+
+		// Pixel index for the individual, differential, T and H modes
+		Int4 k = (i << 2) + j;
+		Int4 msb = (((data[4] << 8) | data[5]) >> k) & Int4(1);
+		Int4 lsb = (((data[6] << 8) | data[7]) >> k) & Int4(1);
+		Int4 index = (msb << 1) | lsb;
+
+		Int4 diff = CmpNEQ(data[3] & Int4(2), Int4(0));
+		Int4 flip = CmpNEQ(data[3] & Int4(1), Int4(0));
+		Int4 second = select(flip, CmpNLT(j, Int4(2)), CmpNLT(i, Int4(2)));   // Texel lies in the second subblock
+
+		// Individual and differential modes, and detection of the others by overflow of the differential colors
+		Int4 cw = select(second, (data[3] >> 2) & Int4(7), data[3] >> 5);
+		Int4 modifier = lookup(constants + OFFSET(Constants,etcModifiers), (cw << 2) + index);
+
+		Int4 subblock[3];
+		Int4 overflow[3];
+
+		for(int n = 0; n < 3; n++)
+		{
+			Int4 individual = select(second, data[n] & Int4(0xF), data[n] >> 4);
+			Int4 base = data[n] >> 3;
+			Int4 sum = base + (((data[n] & Int4(7)) ^ Int4(4)) - Int4(4));
+			Int4 differential = select(second, sum, base);
+
+			overflow[n] = diff & CmpNEQ(sum & Int4(~0x1F), Int4(0));
+			subblock[n] = clampByte(select(diff, extendTo8bit(differential, 5), extendTo8bit(individual, 4)) + modifier);
+		}
+
+		Int4 tMode = overflow[0];
+		Int4 hMode = ~tMode & overflow[1];
+		Int4 planarMode = ~tMode & ~hMode & overflow[2];
+
+		// T mode
+		Int4 t1[3], t2[3];
+		t1[0] = extendTo8bit(((data[0] >> 1) & Int4(0xC)) | (data[0] & Int4(3)), 4);
+		t1[1] = extendTo8bit(data[1] >> 4, 4);
+		t1[2] = extendTo8bit(data[1] & Int4(0xF), 4);
+		t2[0] = extendTo8bit(data[2] >> 4, 4);
+		t2[1] = extendTo8bit(data[2] & Int4(0xF), 4);
+		t2[2] = extendTo8bit(data[3] >> 4, 4);
+		Int4 tDistance = lookup(distances, ((data[3] >> 1) & Int4(6)) | (data[3] & Int4(1)));
+
+		// H mode
+		Int4 h1[3], h2[3];
+		h1[0] = extendTo8bit((data[0] >> 3) & Int4(0xF), 4);
+		h1[1] = extendTo8bit(((data[0] & Int4(7)) << 1) | ((data[1] >> 4) & Int4(1)), 4);
+		h1[2] = extendTo8bit((data[1] & Int4(8)) | ((data[1] & Int4(3)) << 1) | (data[2] >> 7), 4);
+		h2[0] = extendTo8bit((data[2] >> 3) & Int4(0xF), 4);
+		h2[1] = extendTo8bit(((data[2] & Int4(7)) << 1) | (data[3] >> 7), 4);
+		h2[2] = extendTo8bit((data[3] >> 3) & Int4(0xF), 4);
+		Int4 order = CmpNLT((h1[0] << 16) | (h1[1] << 8) | h1[2], (h2[0] << 16) | (h2[1] << 8) | h2[2]) & Int4(1);
+		Int4 hDistance = lookup(distances, (data[3] & Int4(4)) | ((data[3] & Int4(1)) << 1) | order);
+
+		// Planar mode
+		Int4 o[3], h[3], v[3];
+		o[0] = extendTo8bit((data[0] >> 1) & Int4(0x3F), 6);
+		o[1] = extendTo8bit(((data[0] & Int4(1)) << 6) | ((data[1] >> 1) & Int4(0x3F)), 7);
+		o[2] = extendTo8bit(((data[1] & Int4(1)) << 5) | (data[2] & Int4(0x18)) | ((data[2] & Int4(3)) << 1) | (data[3] >> 7), 6);
+		h[0] = extendTo8bit((((data[3] >> 2) & Int4(0x1F)) << 1) | (data[3] & Int4(1)), 6);
+		h[1] = extendTo8bit(data[4] >> 1, 7);
+		h[2] = extendTo8bit(((data[4] & Int4(1)) << 5) | (data[5] >> 3), 6);
+		v[0] = extendTo8bit(((data[5] & Int4(7)) << 3) | (data[6] >> 5), 6);
+		v[1] = extendTo8bit(((data[6] & Int4(0x1F)) << 2) | (data[7] >> 6), 7);
+		v[2] = extendTo8bit(data[7] & Int4(0x3F), 6);
+
+		Int4 color[3];
+
+		for(int n = 0; n < 3; n++)
+		{
+			Int4 t = select(index, t1[n], t2[n] + tDistance, t2[n], t2[n] - tDistance);
+			Int4 hh = select(index, h1[n] + hDistance, h1[n] - hDistance, h2[n] + hDistance, h2[n] - hDistance);
+			Int4 planar = ((i * (h[n] - o[n]) + j * (v[n] - o[n]) + Int4(2)) >> 2) + o[n];
+
+			color[n] = select(tMode, clampByte(t), subblock[n]);
+			color[n] = select(hMode, clampByte(hh), color[n]);
+			color[n] = select(planarMode, clampByte(planar), color[n]);
+		}
+
+		r = color[0];
+		g = color[1];
+		b = color[2];
+	}
+
+	Int4 SamplerCore::decodeEACBlock(Int4 &lo, Int4 &hi, Int4 &i, Int4 &j)
+	{
+		Int4 base = lo & Int4(0xFF);
+		Int4 table = (lo >> 8) & Int4(0xF);
+		Int4 multiplier = (lo >> 12) & Int4(0xF);
+
+		// 3-bit indices are stored big-endian in the remaining six bytes, column by column
+		Int4 upper = ((lo >> 16) & Int4(0xFF)) << 16 | ((lo >> 24) & Int4(0xFF)) << 8 | (hi & Int4(0xFF));
+		Int4 lower = ((hi >> 8) & Int4(0xFF)) << 16 | ((hi >> 16) & Int4(0xFF)) << 8 | ((hi >> 24) & Int4(0xFF));
+		Int4 bits = select(CmpLT(i, Int4(2)), upper, lower);
+		Int4 k = (bits >> (Int4(21) - (((i & Int4(1)) << 2) + j) * Int4(3))) & Int4(7);
+
+		Int4 modifier = lookup(constants + OFFSET(Constants,eacModifiers), (table << 3) + k);
+
+		return clampByte(base + modifier * multiplier);
+	}
+
 	Vector4f SamplerCore::sampleTexel(Int4 &uuuu, Int4 &vvvv, Int4 &wwww, Float4 &z, Pointer<Byte> &mipmap, Pointer<Byte> buffer[4], SamplerFunction function)
 	{
 		Vector4f c;
@@ -2197,7 +2630,7 @@ namespace sw
 		{
 			ASSERT(!hasYuvFormat());
 
-			Vector4s cs = sampleTexel(index, buffer);
+			Vector4s cs = hasCompressedTextureFormat() ? sampleCompressedTexel(uuuu, vvvv, wwww, mipmap, buffer) : sampleTexel(index, buffer);
 
 			bool isInteger = Surface::isNonNormalizedInteger(state.textureFormat);
 			int componentCount = textureComponentCount();
@@ -2657,6 +3090,14 @@ namespace sw
 		case FORMAT_YV12_BT601:
 		case FORMAT_YV12_BT709:
 		case FORMAT_YV12_JFIF:
+		case FORMAT_DXT1:
+		case FORMAT_DXT3:
+		case FORMAT_DXT5:
+		case FORMAT_ATI1:
+		case FORMAT_ATI2:
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:
+		case FORMAT_RGBA8_ETC2_EAC:
 			return false;
 		default:
 			ASSERT(false);
@@ -2695,6 +3136,14 @@ namespace sw
 		case FORMAT_X8B8G8R8UI:
 		case FORMAT_A8B8G8R8I:
 		case FORMAT_A8B8G8R8UI:
+		case FORMAT_DXT1:
+		case FORMAT_DXT3:
+		case FORMAT_DXT5:
+		case FORMAT_ATI1:
+		case FORMAT_ATI2:
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:
+		case FORMAT_RGBA8_ETC2_EAC:
 			return true;
 		case FORMAT_R5G6B5:
 		case FORMAT_R32F:
@@ -2790,6 +3239,14 @@ namespace sw
 		case FORMAT_YV12_BT601:
 		case FORMAT_YV12_BT709:
 		case FORMAT_YV12_JFIF:
+		case FORMAT_DXT1:
+		case FORMAT_DXT3:
+		case FORMAT_DXT5:
+		case FORMAT_ATI1:
+		case FORMAT_ATI2:
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:
+		case FORMAT_RGBA8_ETC2_EAC:
 			return false;
 		case FORMAT_L16:
 		case FORMAT_G16R16:
@@ -2870,6 +3327,14 @@ namespace sw
 		case FORMAT_YV12_BT601:
 		case FORMAT_YV12_BT709:
 		case FORMAT_YV12_JFIF:
+		case FORMAT_DXT1:
+		case FORMAT_DXT3:
+		case FORMAT_DXT5:
+		case FORMAT_ATI1:
+		case FORMAT_ATI2:
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:
+		case FORMAT_RGBA8_ETC2_EAC:
 			return false;
 		case FORMAT_R32I:
 		case FORMAT_R32UI:
@@ -2953,6 +3418,14 @@ namespace sw
 		case FORMAT_V16U16:
 		case FORMAT_A16W16V16U16:
 		case FORMAT_Q16W16V16U16:
+		case FORMAT_DXT1:
+		case FORMAT_DXT3:
+		case FORMAT_DXT5:
+		case FORMAT_ATI1:
+		case FORMAT_ATI2:
+		case FORMAT_ETC1:
+		case FORMAT_RGB8_ETC2:
+		case FORMAT_RGBA8_ETC2_EAC:
 			return false;
 		default:
 			ASSERT(false);
@@ -2961,6 +3434,11 @@ namespace sw
 		return false;
 	}
 
+	bool SamplerCore::hasCompressedTextureFormat() const
+	{
+		return Surface::isCompressedSampleable(state.textureFormat);
+	}
+
 	bool SamplerCore::isRGBComponent(int component) const
 	{
 		switch(state.textureFormat)
@@ -3026,6 +3504,14 @@ namespace sw
 		case FORMAT_YV12_BT601:     return component < 3;
 		case FORMAT_YV12_BT709:     return component < 3;
 		case FORMAT_YV12_JFIF:      return component < 3;
+		case FORMAT_DXT1:           return component < 3;
+		case FORMAT_DXT3:           return component < 3;
+		case FORMAT_DXT5:           return component < 3;
+		case FORMAT_ATI1:           return component < 1;
+		case FORMAT_ATI2:           return component < 2;
+		case FORMAT_ETC1:           return component < 3;
+		case FORMAT_RGB8_ETC2:      return component < 3;
+		case FORMAT_RGBA8_ETC2_EAC: return component < 3;
 		default:
 			ASSERT(false);
 		}
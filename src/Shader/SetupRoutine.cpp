@@ -197,6 +197,31 @@ namespace sw
 			yMin = Max(yMin, *Pointer<Int>(data + OFFSET(DrawData,scissorY0)));
 			yMax = Min(yMax, *Pointer<Int>(data + OFFSET(DrawData,scissorY1)));
 
+			if(Renderer::getTileSize() != 0)
+			{
+				// Horizontal range, used for binning primitives into tiles. It only has
+				// to be conservative since the outline determines the covered pixels.
+				Int xMin = X[0];
+				Int xMax = X[0];
+
+				Int i = 1;
+
+				Do
+				{
+					xMin = Min(X[i], xMin);
+					xMax = Max(X[i], xMax);
+
+					i++;
+				}
+				Until(i >= n)
+
+				xMin = Max((xMin >> 4) - 1, *Pointer<Int>(data + OFFSET(DrawData,scissorX0)));
+				xMax = Min((xMax >> 4) + 2, *Pointer<Int>(data + OFFSET(DrawData,scissorX1)));
+
+				*Pointer<Int>(primitive + OFFSET(Primitive,xMin)) = xMin;
+				*Pointer<Int>(primitive + OFFSET(Primitive,xMax)) = xMax;
+			}
+
 			For(Int q = 0, q < state.multiSample, q++)
 			{
 				Array<Int> Xq(16);
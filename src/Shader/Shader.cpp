@@ -1129,7 +1129,7 @@ namespace sw
 		       analysisLeave;
 	}
 
-	Shader::Shader() : serialID(serialCounter++)
+	Shader::Shader() : serialID(serialCounter++), generatorReferences(0)
 	{
 		usedSamplers = 0;
 	}
@@ -1423,11 +1423,117 @@ namespace sw
 		return (usedSamplers & (1 << index)) != 0;
 	}
 
+	void Shader::addGeneratorReference() const
+	{
+		std::unique_lock<std::mutex> lock(generatorMutex);
+		++generatorReferences;
+	}
+
+	void Shader::releaseGeneratorReference() const
+	{
+		std::unique_lock<std::mutex> lock(generatorMutex);
+
+		if(--generatorReferences == 0)
+		{
+			generatorCondition.notify_all();
+		}
+	}
+
+	void Shader::waitForGenerators() const
+	{
+		std::unique_lock<std::mutex> lock(generatorMutex);
+		generatorCondition.wait(lock, [this]() { return generatorReferences == 0; });
+	}
+
 	int Shader::getSerialID() const
 	{
 		return serialID;
 	}
 
+	uint64_t Shader::combineHash(uint64_t hash, uint64_t value)
+	{
+		// FNV-1a, one byte at a time
+		for(int i = 0; i < 8; i++)
+		{
+			hash ^= (value >> (8 * i)) & 0xFF;
+			hash *= 0x100000001B3ull;
+		}
+
+		return hash;
+	}
+
+	uint64_t Shader::computeContentHash() const
+	{
+		// Hashes fields individually, since instructions contain pointers and padding
+		uint64_t hash = 0xCBF29CE484222325ull;
+
+		hash = combineHash(hash, shaderType);
+		hash = combineHash(hash, shaderModel);
+		hash = combineHash(hash, usedSamplers);
+		hash = combineHash(hash, dirtyConstantsF);
+		hash = combineHash(hash, dirtyConstantsI);
+		hash = combineHash(hash, dirtyConstantsB);
+		hash = combineHash(hash, indirectAddressableTemporaries << 0 | indirectAddressableInput << 1 | indirectAddressableOutput << 2);
+		hash = combineHash(hash, dynamicBranching << 0 | containsBreak << 1 | containsContinue << 2 | containsLeave << 3 | containsDefine << 4);
+		hash = combineHash(hash, instruction.size());
+
+		for(const Instruction *inst : instruction)
+		{
+			hash = combineHash(hash, inst->opcode);
+			hash = combineHash(hash, inst->control);
+			hash = combineHash(hash, inst->predicate << 0 | inst->predicateNot << 1 | inst->coissue << 2);
+			hash = combineHash(hash, inst->predicateSwizzle);
+			hash = combineHash(hash, inst->samplerType);
+			hash = combineHash(hash, inst->usage);
+			hash = combineHash(hash, inst->usageIndex);
+			hash = combineHash(hash, inst->analysis);
+
+			const Parameter *parameter[6] = {&inst->dst, &inst->src[0], &inst->src[1], &inst->src[2], &inst->src[3], &inst->src[4]};
+
+			for(const Parameter *p : parameter)
+			{
+				hash = combineHash(hash, p->type);
+
+				switch(p->type)
+				{
+				case PARAMETER_FLOAT4LITERAL:
+				case PARAMETER_BOOL1LITERAL:
+				case PARAMETER_INT4LITERAL:
+					for(int i = 0; i < 4; i++)
+					{
+						hash = combineHash(hash, (unsigned int)p->integer[i]);
+					}
+					break;
+				case PARAMETER_LABEL:
+					hash = combineHash(hash, p->label);
+					hash = combineHash(hash, p->callSite);
+					break;
+				default:
+					hash = combineHash(hash, p->index);
+					hash = combineHash(hash, p->rel.type);
+					hash = combineHash(hash, p->rel.index);
+					hash = combineHash(hash, p->rel.swizzle);
+					hash = combineHash(hash, p->rel.scale);
+					hash = combineHash(hash, p->rel.dynamic);
+					break;
+				}
+			}
+
+			hash = combineHash(hash, inst->dst.mask);
+			hash = combineHash(hash, inst->dst.saturate << 0 | inst->dst.partialPrecision << 1 | inst->dst.centroid << 2);
+			hash = combineHash(hash, inst->dst.shift);
+
+			for(const SourceParameter &src : inst->src)
+			{
+				hash = combineHash(hash, src.swizzle);
+				hash = combineHash(hash, src.modifier);
+				hash = combineHash(hash, src.bufferIndex);
+			}
+		}
+
+		return hash;
+	}
+
 	size_t Shader::getLength() const
 	{
 		return instruction.size();
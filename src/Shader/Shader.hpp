@@ -17,6 +17,8 @@
 
 #include "Common/Types.hpp"
 
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -559,6 +561,7 @@ namespace sw
 		virtual ~Shader();
 
 		int getSerialID() const;
+		virtual uint64_t computeContentHash() const;   // Unlike the serial ID, identical across processes
 		size_t getLength() const;
 		ShaderType getShaderType() const;
 		unsigned short getShaderModel() const;
@@ -584,6 +587,10 @@ namespace sw
 		bool containsDefineInstruction() const;
 		bool usesSampler(int i) const;
 
+		// Held while a routine is generated from this shader on a background thread
+		void addGeneratorReference() const;
+		void releaseGeneratorReference() const;
+
 		struct Semantic
 		{
 			Semantic(unsigned char usage = 0xFF, unsigned char index = 0xFF, bool flat = false) : usage(usage), index(index), centroid(false), flat(flat)
@@ -618,6 +625,10 @@ namespace sw
 		bool indirectAddressableOutput;
 
 	protected:
+		static uint64_t combineHash(uint64_t hash, uint64_t value);
+
+		void waitForGenerators() const;   // Must be called by the most derived destructor
+
 		void parse(const unsigned long *token);
 
 		void optimizeLeave();
@@ -652,6 +663,10 @@ namespace sw
 		const int serialID;
 		static volatile int serialCounter;
 
+		mutable int generatorReferences;
+		mutable std::mutex generatorMutex;
+		mutable std::condition_variable generatorCondition;
+
 		bool dynamicBranching;
 		bool containsBreak;
 		bool containsContinue;
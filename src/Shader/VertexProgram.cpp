@@ -46,7 +46,7 @@ namespace sw
 
 		if(shader->isInstanceIdDeclared())
 		{
-			instanceID = *Pointer<Int>(data + OFFSET(DrawData,instanceID));
+			instanceID = *Pointer<Int>(task + OFFSET(VertexTask,instanceID));
 		}
 	}
 
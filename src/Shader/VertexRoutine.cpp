@@ -42,8 +42,10 @@ namespace sw
 		const bool textureSampling = state.textureSampling;
 
 		Pointer<Byte> cache = task + OFFSET(VertexTask,vertexCache);
-		Pointer<Byte> vertexCache = cache + OFFSET(VertexCache,vertex);
-		Pointer<Byte> tagCache = cache + OFFSET(VertexCache,tag);
+		Pointer<Byte> vertexCache = *Pointer<Pointer<Byte>>(cache + OFFSET(VertexCache,vertex));
+		Pointer<Byte> tagCache = *Pointer<Pointer<Byte>>(cache + OFFSET(VertexCache,tag));
+		Pointer<Byte> victimCache = *Pointer<Pointer<Byte>>(cache + OFFSET(VertexCache,victim));
+		UInt setMask = *Pointer<UInt>(cache + OFFSET(VertexCache,setMask));
 
 		UInt vertexCount = *Pointer<UInt>(task + OFFSET(VertexTask,vertexCount));
 		UInt primitiveNumber = *Pointer<UInt>(task + OFFSET(VertexTask, primitiveStart));
@@ -51,26 +53,66 @@ namespace sw
 
 		constants = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData,constants));
 
+		if(state.bulkVertices)   // Shade the listed groups of four consecutive indices, without going through the cache
+		{
+			Do
+			{
+				UInt index = *Pointer<UInt>(batch);
+
+				readInput(index);
+				pipeline(index);
+				postTransform();
+				computeClipFlags();
+				writeCache(vertex);
+
+				vertex += 4 * sizeof(Vertex);
+				batch += sizeof(unsigned int);
+				vertexCount -= 4;
+			}
+			Until(vertexCount == 0)
+
+			Return();
+
+			return;
+		}
+
+		*Pointer<UInt>(cache + OFFSET(VertexCache,lookups)) += vertexCount;
+
+		static_assert(VertexCache::WAYS == 2, "Replacement policy assumes a two-way set associative cache");
+
 		Do
 		{
 			UInt index = *Pointer<UInt>(batch);
-			UInt tagIndex = index & 0x0000003C;
 			UInt indexQ = !textureSampling ? UInt(index & 0xFFFFFFFC) : index;   // FIXME: TEXLDL hack to have independent LODs, hurts performance.
+			UInt set = (!textureSampling ? UInt(index >> 2) : index) & setMask;   // Adjacent index ranges map to different sets
+			UInt line = set * UInt(VertexCache::WAYS);
 
-			If(*Pointer<UInt>(tagCache + tagIndex) != indexQ)
+			If(*Pointer<UInt>(tagCache + line * 4) != indexQ)
 			{
-				*Pointer<UInt>(tagCache + tagIndex) = indexQ;
+				If(*Pointer<UInt>(tagCache + (line + 1) * 4) == indexQ)
+				{
+					line += 1;
+				}
+				Else
+				{
+					line += *Pointer<UInt>(victimCache + set * 4);
+					*Pointer<UInt>(tagCache + line * 4) = indexQ;
 
-				readInput(indexQ);
-				pipeline(indexQ);
-				postTransform();
-				computeClipFlags();
+					readInput(indexQ);
+					pipeline(indexQ);
+					postTransform();
+					computeClipFlags();
+
+					Pointer<Byte> cacheLine0 = vertexCache + line * UInt((int)sizeof(Vertex[4]));
+					writeCache(cacheLine0);
 
-				Pointer<Byte> cacheLine0 = vertexCache + tagIndex * UInt((int)sizeof(Vertex));
-				writeCache(cacheLine0);
+					*Pointer<UInt>(cache + OFFSET(VertexCache,misses)) += UInt(1);
+				}
 			}
 
-			UInt cacheIndex = index & 0x0000003F;
+			*Pointer<UInt>(victimCache + set * 4) = (line & 1) ^ 1;   // Replace the least recently used way
+
+			UInt cacheIndex = line * 4 + (index & 3);
 			Pointer<Byte> cacheLine = vertexCache + cacheIndex * UInt((int)sizeof(Vertex));
 			writeVertex(vertex, cacheLine);
 
@@ -102,7 +144,19 @@ namespace sw
 			Pointer<Byte> input = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData,input) + sizeof(void*) * i);
 			UInt stride = *Pointer<UInt>(data + OFFSET(DrawData,stride) + sizeof(unsigned int) * i);
 
-			v[i] = readStream(input, stride, state.input[i], index);
+			if(state.input[i].instanced)
+			{
+				UInt divisor = *Pointer<UInt>(data + OFFSET(DrawData,divisor) + sizeof(unsigned int) * i);
+				UInt instance = *Pointer<UInt>(task + OFFSET(VertexTask,instanceID)) / divisor;
+				UInt zero = 0;
+
+				input += instance * stride;
+				v[i] = readStream(input, zero, state.input[i], zero);   // Same element for all vertices
+			}
+			else
+			{
+				v[i] = readStream(input, stride, state.input[i], index);
+			}
 		}
 	}
 
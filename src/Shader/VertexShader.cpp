@@ -79,6 +79,33 @@ namespace sw
 
 	VertexShader::~VertexShader()
 	{
+		waitForGenerators();
+	}
+
+	uint64_t VertexShader::computeContentHash() const
+	{
+		uint64_t hash = Shader::computeContentHash();
+
+		for(int i = 0; i < MAX_VERTEX_INPUTS; i++)
+		{
+			hash = combineHash(hash, input[i].usage | input[i].index << 8 | input[i].centroid << 16 | input[i].flat << 17);
+			hash = combineHash(hash, attribType[i]);
+		}
+
+		for(int i = 0; i < MAX_VERTEX_OUTPUTS; i++)
+		{
+			for(int component = 0; component < 4; component++)
+			{
+				const Semantic &semantic = output[i][component];
+				hash = combineHash(hash, semantic.usage | semantic.index << 8 | semantic.centroid << 16 | semantic.flat << 17);
+			}
+		}
+
+		hash = combineHash(hash, positionRegister);
+		hash = combineHash(hash, pointSizeRegister);
+		hash = combineHash(hash, instanceIdDeclared << 0 | vertexIdDeclared << 1 | textureSampling << 2);
+
+		return hash;
 	}
 
 	int VertexShader::validate(const unsigned long *const token)
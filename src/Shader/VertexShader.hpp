@@ -55,6 +55,8 @@ namespace sw
 		bool isInstanceIdDeclared() const { return instanceIdDeclared; }
 		bool isVertexIdDeclared() const { return vertexIdDeclared; }
 
+		uint64_t computeContentHash() const override;
+
 	private:
 		void analyze();
 		void analyzeInput();
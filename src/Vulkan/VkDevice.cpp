@@ -16,8 +16,10 @@
 
 #include "VkConfig.h"
 #include "VkDebug.hpp"
+#include "VkFence.hpp"
 #include "VkQueue.hpp"
 
+#include <chrono>
 #include <new> // Must #include this to use "placement new"
 
 namespace vk
@@ -40,7 +42,7 @@ Device::Device(const Device::CreateInfo* info, void* mem)
 
 		for(uint32_t j = 0; j < queueCreateInfo.queueCount; j++, queueID++)
 		{
-			new (&queues[queueID]) Queue(queueCreateInfo.queueFamilyIndex, queueCreateInfo.pQueuePriorities[j]);
+			new (&queues[queueID]) Queue(this, queueCreateInfo.queueFamilyIndex, queueCreateInfo.pQueuePriorities[j]);
 		}
 	}
 
@@ -84,9 +86,70 @@ VkQueue Device::getQueue(uint32_t queueFamilyIndex, uint32_t queueIndex) const
 	return queues[queueIndex];
 }
 
-void Device::waitForFences(uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t timeout)
+VkResult Device::waitForFences(uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t timeout)
 {
-	// FIXME(b/117835459) : noop
+	using time_point = std::chrono::steady_clock::time_point;
+
+	const time_point start = std::chrono::steady_clock::now();
+	const uint64_t maxTimeout = std::chrono::duration_cast<std::chrono::nanoseconds>(time_point::max() - start).count();
+	const bool infiniteTimeout = (timeout > maxTimeout);
+	const time_point deadline = infiniteTimeout ? time_point::max() : start + std::chrono::nanoseconds(timeout);
+
+	if(waitAll)
+	{
+		for(uint32_t i = 0; i < fenceCount; i++)
+		{
+			VkResult result = infiniteTimeout ? Cast(pFences[i])->wait() : Cast(pFences[i])->wait(deadline);
+
+			if(result != VK_SUCCESS)
+			{
+				return result;
+			}
+		}
+
+		return VK_SUCCESS;
+	}
+
+	// Fences are signaled from different queue threads, which all notify the device
+	auto anySignaled = [fenceCount, pFences]()
+	{
+		for(uint32_t i = 0; i < fenceCount; i++)
+		{
+			if(Cast(pFences[i])->getStatus() == VK_SUCCESS)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	};
+
+	std::unique_lock<std::mutex> lock(fenceMutex);
+
+	if(infiniteTimeout)
+	{
+		fenceCondition.wait(lock, anySignaled);
+		return VK_SUCCESS;
+	}
+
+	return fenceCondition.wait_until(lock, deadline, anySignaled) ? VK_SUCCESS : VK_TIMEOUT;
+}
+
+void Device::signalFence(Fence* fence)
+{
+	fence->signal();
+
+	// Taking the mutex orders the notification after the check of a waiting thread
+	std::unique_lock<std::mutex> lock(fenceMutex);
+	fenceCondition.notify_all();
+}
+
+void Device::waitIdle()
+{
+	for(uint32_t i = 0; i < queueCount; i++)
+	{
+		queues[i].waitIdle();
+	}
 }
 
 void Device::getDescriptorSetLayoutSupport(const VkDescriptorSetLayoutCreateInfo* pCreateInfo,
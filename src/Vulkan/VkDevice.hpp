@@ -17,9 +17,13 @@
 
 #include "VkObject.hpp"
 
+#include <condition_variable>
+#include <mutex>
+
 namespace vk
 {
 
+class Fence;
 class Queue;
 
 class Device
@@ -39,7 +43,9 @@ public:
 	static size_t ComputeRequiredAllocationSize(const CreateInfo* info);
 
 	VkQueue getQueue(uint32_t queueFamilyIndex, uint32_t queueIndex) const;
-	void waitForFences(uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t timeout);
+	VkResult waitForFences(uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t timeout);
+	void signalFence(Fence* fence);   // Called by the queue threads
+	void waitIdle();
 	void getDescriptorSetLayoutSupport(const VkDescriptorSetLayoutCreateInfo* pCreateInfo,
 	                                   VkDescriptorSetLayoutSupport* pSupport) const;
 	VkPhysicalDevice getPhysicalDevice() const { return physicalDevice; }
@@ -48,6 +54,9 @@ private:
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	Queue* queues = nullptr;
 	uint32_t queueCount = 0;
+
+	std::mutex fenceMutex;   // Wakes threads waiting for any of several fences
+	std::condition_variable fenceCondition;
 };
 
 using DispatchableDevice = DispatchableObject<Device, VkDevice>;
@@ -17,6 +17,10 @@
 
 #include "VkObject.hpp"
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 namespace vk
 {
 
@@ -35,23 +39,44 @@ public:
 		return 0;
 	}
 
+	// Called by the queue thread once all work submitted with this fence has completed
 	void signal()
 	{
+		std::unique_lock<std::mutex> lock(mutex);
 		status = VK_SUCCESS;
+		condition.notify_all();
 	}
 
 	void reset()
 	{
+		std::unique_lock<std::mutex> lock(mutex);
 		status = VK_NOT_READY;
 	}
 
-	VkResult getStatus() const
+	VkResult getStatus()
 	{
+		std::unique_lock<std::mutex> lock(mutex);
 		return status;
 	}
 
+	VkResult wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this] { return status == VK_SUCCESS; });
+		return VK_SUCCESS;
+	}
+
+	VkResult wait(const std::chrono::steady_clock::time_point& deadline)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		bool signaled = condition.wait_until(lock, deadline, [this] { return status == VK_SUCCESS; });
+		return signaled ? VK_SUCCESS : VK_TIMEOUT;
+	}
+
 private:
 	VkResult status = VK_NOT_READY;
+	std::mutex mutex;
+	std::condition_variable condition;
 };
 
 static inline Fence* Cast(VkFence object)
@@ -13,7 +13,11 @@
 // limitations under the License.
 
 #include "VkPipeline.hpp"
+#include "VkPipelineCache.hpp"
 #include "VkShaderModule.hpp"
+#include "System/Math.hpp"
+
+#include <cstring>
 
 namespace
 {
@@ -370,6 +374,10 @@ GraphicsPipeline::GraphicsPipeline(const VkGraphicsPipelineCreateInfo* pCreateIn
 
 void GraphicsPipeline::destroyPipeline(const VkAllocationCallbacks* pAllocator)
 {
+	if(routineCache)
+	{
+		routineCache->unbind();
+	}
 }
 
 size_t GraphicsPipeline::ComputeRequiredAllocationSize(const VkGraphicsPipelineCreateInfo* pCreateInfo)
@@ -377,10 +385,39 @@ size_t GraphicsPipeline::ComputeRequiredAllocationSize(const VkGraphicsPipelineC
 	return 0;
 }
 
-void GraphicsPipeline::compileShaders(const VkAllocationCallbacks* pAllocator, const VkGraphicsPipelineCreateInfo* pCreateInfo)
+void GraphicsPipeline::compileShaders(const VkAllocationCallbacks* pAllocator, const VkGraphicsPipelineCreateInfo* pCreateInfo, PipelineCache* pipelineCache)
 {
 	vertexRoutine = Cast(pCreateInfo->pStages[0].module)->compile(pAllocator);
 	fragmentRoutine = Cast(pCreateInfo->pStages[1].module)->compile(pAllocator);
+
+	// Identifies the shader code independently of the process, for keying cached routines
+	uint64_t shaderHash = 0;
+	for(uint32_t i = 0; i < pCreateInfo->stageCount; i++)
+	{
+		const VkPipelineShaderStageCreateInfo& stage = pCreateInfo->pStages[i];
+		const VkSpecializationInfo* specialization = stage.pSpecializationInfo;
+
+		shaderHash = (shaderHash * 0x100000001B3ull) ^ stage.stage;
+		shaderHash = (shaderHash * 0x100000001B3ull) ^ Cast(stage.module)->getHash();
+		shaderHash = (shaderHash * 0x100000001B3ull) ^ sw::FNV_1a(reinterpret_cast<const unsigned char*>(stage.pName), static_cast<int>(strlen(stage.pName)));
+
+		if(specialization)
+		{
+			shaderHash = (shaderHash * 0x100000001B3ull) ^ sw::FNV_1a(reinterpret_cast<const unsigned char*>(specialization->pMapEntries),
+			                                                          static_cast<int>(specialization->mapEntryCount * sizeof(VkSpecializationMapEntry)));
+			shaderHash = (shaderHash * 0x100000001B3ull) ^ sw::FNV_1a(reinterpret_cast<const unsigned char*>(specialization->pData),
+			                                                          static_cast<int>(specialization->dataSize));
+		}
+	}
+
+	context.shaderHash = shaderHash;
+
+	if(pipelineCache)
+	{
+		routineCache = pipelineCache->getRoutineCache();
+		routineCache->bind();   // Outlives the pipeline cache object if needed
+		context.routineCache = routineCache;
+	}
 }
 
 uint32_t GraphicsPipeline::computePrimitiveCount(uint32_t vertexCount) const
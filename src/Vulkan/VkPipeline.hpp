@@ -21,6 +21,9 @@
 namespace vk
 {
 
+class PipelineCache;
+class PipelineRoutineCache;
+
 class Pipeline
 {
 public:
@@ -56,7 +59,7 @@ public:
 
 	static size_t ComputeRequiredAllocationSize(const VkGraphicsPipelineCreateInfo* pCreateInfo);
 
-	void compileShaders(const VkAllocationCallbacks* pAllocator, const VkGraphicsPipelineCreateInfo* pCreateInfo);
+	void compileShaders(const VkAllocationCallbacks* pAllocator, const VkGraphicsPipelineCreateInfo* pCreateInfo, PipelineCache* pipelineCache);
 
 	uint32_t computePrimitiveCount(uint32_t vertexCount) const;
 	const sw::Context& getContext() const;
@@ -67,6 +70,7 @@ public:
 private:
 	rr::Routine* vertexRoutine;
 	rr::Routine* fragmentRoutine;
+	PipelineRoutineCache* routineCache = nullptr;
 	sw::Context context;
 	sw::Rect scissor;
 	VkViewport viewport;
@@ -0,0 +1,394 @@
+// Copyright 2018 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "VkPipelineCache.hpp"
+#include "VkConfig.h"
+#include "Reactor/Nucleus.hpp"
+#include "System/CPUID.hpp"
+
+#include <cstring>
+
+namespace
+{
+
+// Layout mandated by the Vulkan spec for the start of pipeline cache data
+struct CacheHeader
+{
+	uint32_t headerSize;
+	uint32_t headerVersion;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+// Followed by the entries, each an EntryHeader, the key and the object code
+struct DataHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint8_t buildID[rr::BUILD_ID_SIZE];   // Object code is only compatible with the build which generated it
+	uint32_t cpuFeatures;                 // Generated code depends on the instruction set extensions
+	uint32_t entryCount;
+	uint64_t checksum;                    // Of the entries
+};
+
+struct EntryHeader
+{
+	uint32_t keySize;
+	uint32_t codeSize;
+};
+
+enum
+{
+	DATA_MAGIC = 0x43505753,   // "SWPC"
+	DATA_VERSION = 2,
+};
+
+void initCacheHeader(CacheHeader &header)
+{
+	header.headerSize = sizeof(CacheHeader);
+	header.headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+	header.vendorID = vk::VENDOR_ID;
+	header.deviceID = vk::DEVICE_ID;
+	memcpy(header.pipelineCacheUUID, SWIFTSHADER_UUID, VK_UUID_SIZE);
+}
+
+} // anonymous namespace
+
+namespace vk
+{
+
+PipelineRoutineCache::PipelineRoutineCache() : bindCount(1)
+{
+}
+
+PipelineRoutineCache::~PipelineRoutineCache()
+{
+	for(auto &entry : entries)
+	{
+		if(entry.second.routine)
+		{
+			entry.second.routine->unbind();
+		}
+	}
+}
+
+void PipelineRoutineCache::bind()
+{
+	bindCount++;
+}
+
+void PipelineRoutineCache::unbind()
+{
+	if(--bindCount == 0)
+	{
+		delete this;
+	}
+}
+
+PipelineRoutineCache::Key PipelineRoutineCache::makeKey(Type type, const void *state, size_t stateSize, uint64_t shaderHash)
+{
+	Key key(sizeof(uint32_t) + stateSize + sizeof(shaderHash));
+
+	uint32_t routineType = type;
+	memcpy(&key[0], &routineType, sizeof(routineType));
+	memcpy(&key[sizeof(routineType)], state, stateSize);
+	memcpy(&key[sizeof(routineType) + stateSize], &shaderHash, sizeof(shaderHash));
+
+	return key;
+}
+
+rr::Routine *PipelineRoutineCache::query(Type type, const void *state, size_t stateSize, uint64_t shaderHash)
+{
+	Key key = makeKey(type, state, stateSize, shaderHash);
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	auto it = entries.find(key);
+
+	if(it == entries.end())
+	{
+		return nullptr;
+	}
+
+	Entry &entry = it->second;
+
+	if(!entry.routine)   // Loaded from serialized data, link it now
+	{
+		entry.routine = rr::Nucleus::loadRoutine(entry.objectCode.data(), entry.objectCode.size());
+
+		if(!entry.routine)
+		{
+			entries.erase(it);   // Stale or corrupt, generate it anew
+			return nullptr;
+		}
+
+		entry.routine->bind();
+	}
+
+	return entry.routine;
+}
+
+void PipelineRoutineCache::add(Type type, const void *state, size_t stateSize, uint64_t shaderHash, rr::Routine *routine)
+{
+	Key key = makeKey(type, state, stateSize, shaderHash);
+
+	size_t codeSize = 0;
+	const uint8_t *code = static_cast<const uint8_t*>(routine->getObjectCode(codeSize));
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	Entry &entry = entries[key];
+
+	if(entry.routine)
+	{
+		return;   // Another renderer got there first
+	}
+
+	routine->bind();
+	entry.routine = routine;
+
+	if(code)
+	{
+		entry.objectCode.assign(code, code + codeSize);
+	}
+}
+
+size_t PipelineRoutineCache::getData(size_t dataSize, void* pData)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	DataHeader header;
+	header.magic = DATA_MAGIC;
+	header.version = DATA_VERSION;
+	memcpy(header.buildID, rr::buildID(), sizeof(header.buildID));
+	header.cpuFeatures = rr::cpuFeatures<sw::CPUID>();
+	header.entryCount = 0;
+	header.checksum = 0xCBF29CE484222325ull;
+
+	size_t size = sizeof(DataHeader);
+
+	if(pData && dataSize < size)
+	{
+		return 0;
+	}
+
+	uint8_t *data = static_cast<uint8_t*>(pData);
+
+	for(const auto &entry : entries)
+	{
+		if(entry.second.objectCode.empty())
+		{
+			continue;   // Can't be serialized
+		}
+
+		EntryHeader entryHeader;
+		entryHeader.keySize = static_cast<uint32_t>(entry.first.size());
+		entryHeader.codeSize = static_cast<uint32_t>(entry.second.objectCode.size());
+
+		size_t entrySize = sizeof(EntryHeader) + entryHeader.keySize + entryHeader.codeSize;
+
+		if(data)
+		{
+			// Only write complete entries, so that partial data remains valid
+			if(size + entrySize > dataSize)
+			{
+				break;
+			}
+
+			uint8_t *entryData = data + size;
+			memcpy(entryData, &entryHeader, sizeof(EntryHeader));
+			memcpy(entryData + sizeof(EntryHeader), entry.first.data(), entryHeader.keySize);
+			memcpy(entryData + sizeof(EntryHeader) + entryHeader.keySize, entry.second.objectCode.data(), entryHeader.codeSize);
+
+			header.checksum = rr::hashBytes(header.checksum, entryData, entrySize);
+		}
+
+		header.entryCount++;
+		size += entrySize;
+	}
+
+	if(data)
+	{
+		memcpy(data, &header, sizeof(DataHeader));
+	}
+
+	return size;
+}
+
+void PipelineRoutineCache::setData(size_t dataSize, const void* pData)
+{
+	// Incompatible or corrupt data is ignored, as if no initial data was provided
+	DataHeader header;
+
+	if(dataSize < sizeof(DataHeader))
+	{
+		return;
+	}
+
+	memcpy(&header, pData, sizeof(DataHeader));
+
+	if(header.magic != DATA_MAGIC ||
+	   header.version != DATA_VERSION ||
+	   memcmp(header.buildID, rr::buildID(), sizeof(header.buildID)) != 0 ||
+	   header.cpuFeatures != rr::cpuFeatures<sw::CPUID>())
+	{
+		return;
+	}
+
+	const uint8_t *data = static_cast<const uint8_t*>(pData) + sizeof(DataHeader);
+	const uint8_t *end = static_cast<const uint8_t*>(pData) + dataSize;
+
+	if(rr::hashBytes(0xCBF29CE484222325ull, data, end - data) != header.checksum)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for(uint32_t i = 0; i < header.entryCount; i++)
+	{
+		EntryHeader entryHeader;
+
+		if(static_cast<size_t>(end - data) < sizeof(EntryHeader))
+		{
+			return;
+		}
+
+		memcpy(&entryHeader, data, sizeof(EntryHeader));
+		data += sizeof(EntryHeader);
+
+		if(static_cast<size_t>(end - data) < static_cast<size_t>(entryHeader.keySize) + entryHeader.codeSize)
+		{
+			return;
+		}
+
+		Key key(data, data + entryHeader.keySize);
+		data += entryHeader.keySize;
+
+		Entry &entry = entries[key];
+
+		if(!entry.routine && entry.objectCode.empty())
+		{
+			entry.objectCode.assign(data, data + entryHeader.codeSize);
+		}
+
+		data += entryHeader.codeSize;
+	}
+}
+
+void PipelineRoutineCache::merge(PipelineRoutineCache* source)
+{
+	std::map<Key, Entry> sourceEntries;
+
+	{
+		std::unique_lock<std::mutex> lock(source->mutex);
+
+		sourceEntries = source->entries;
+
+		for(auto &entry : sourceEntries)
+		{
+			if(entry.second.routine)
+			{
+				entry.second.routine->bind();   // Keep it alive while unlocked
+			}
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for(auto &sourceEntry : sourceEntries)
+	{
+		Entry &entry = entries[sourceEntry.first];
+
+		if(!entry.routine && sourceEntry.second.routine)
+		{
+			entry.routine = sourceEntry.second.routine;
+			entry.routine->bind();
+		}
+
+		if(entry.objectCode.empty())
+		{
+			entry.objectCode = sourceEntry.second.objectCode;
+		}
+
+		if(sourceEntry.second.routine)
+		{
+			sourceEntry.second.routine->unbind();
+		}
+	}
+}
+
+PipelineCache::PipelineCache(const VkPipelineCacheCreateInfo* pCreateInfo, void* mem)
+{
+	routineCache = new PipelineRoutineCache();
+
+	if(pCreateInfo->initialDataSize >= sizeof(CacheHeader))
+	{
+		CacheHeader header;
+		CacheHeader expected;
+		memcpy(&header, pCreateInfo->pInitialData, sizeof(CacheHeader));
+		initCacheHeader(expected);
+
+		if(memcmp(&header, &expected, sizeof(CacheHeader)) == 0)
+		{
+			routineCache->setData(pCreateInfo->initialDataSize - sizeof(CacheHeader),
+			                      static_cast<const uint8_t*>(pCreateInfo->pInitialData) + sizeof(CacheHeader));
+		}
+	}
+}
+
+void PipelineCache::destroy(const VkAllocationCallbacks* pAllocator)
+{
+	routineCache->unbind();
+}
+
+VkResult PipelineCache::getData(size_t* pDataSize, void* pData)
+{
+	if(!pData)
+	{
+		*pDataSize = sizeof(CacheHeader) + routineCache->getData(0, nullptr);
+		return VK_SUCCESS;
+	}
+
+	if(*pDataSize < sizeof(CacheHeader) + sizeof(DataHeader))
+	{
+		*pDataSize = 0;
+		return VK_INCOMPLETE;
+	}
+
+	CacheHeader header;
+	initCacheHeader(header);
+	memcpy(pData, &header, sizeof(CacheHeader));
+
+	size_t available = *pDataSize - sizeof(CacheHeader);
+	size_t required = routineCache->getData(0, nullptr);
+	size_t written = routineCache->getData(available, static_cast<uint8_t*>(pData) + sizeof(CacheHeader));
+
+	*pDataSize = sizeof(CacheHeader) + written;
+
+	return (written < required) ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VkResult PipelineCache::merge(uint32_t srcCacheCount, const VkPipelineCache* pSrcCaches)
+{
+	for(uint32_t i = 0; i < srcCacheCount; i++)
+	{
+		routineCache->merge(Cast(pSrcCaches[i])->routineCache);
+	}
+
+	return VK_SUCCESS;
+}
+
+} // namespace vk
@@ -16,25 +16,72 @@
 #define VK_PIPELINE_CACHE_HPP_
 
 #include "VkObject.hpp"
+#include "Device/RoutineCache.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
 
 namespace vk
 {
 
-class PipelineCache : public Object<PipelineCache, VkPipelineCache>
+// Vertex, setup and pixel routines, keyed by processor state and SPIR-V hash. Routines
+// loaded from serialized data are only linked once a renderer asks for them. Reference
+// counted, since pipelines keep using it after their pipeline cache has been destroyed.
+class PipelineRoutineCache : public sw::SharedRoutineCache
 {
 public:
-	PipelineCache(const VkPipelineCacheCreateInfo* pCreateInfo, void* mem)
+	PipelineRoutineCache();
+
+	rr::Routine *query(Type type, const void *state, size_t stateSize, uint64_t shaderHash) override;
+	void add(Type type, const void *state, size_t stateSize, uint64_t shaderHash, rr::Routine *routine) override;
+
+	void bind();
+	void unbind();
+
+	size_t getData(size_t dataSize, void* pData);
+	void setData(size_t dataSize, const void* pData);
+	void merge(PipelineRoutineCache* source);
+
+private:
+	~PipelineRoutineCache() override;
+
+	typedef std::vector<uint8_t> Key;   // Type, state and shader hash
+
+	struct Entry
 	{
-	}
+		rr::Routine *routine;
+		std::vector<uint8_t> objectCode;   // Empty if the routine doesn't retain it
+	};
 
+	static Key makeKey(Type type, const void *state, size_t stateSize, uint64_t shaderHash);
+
+	std::atomic<int> bindCount;
+
+	std::mutex mutex;
+	std::map<Key, Entry> entries;
+};
+
+class PipelineCache : public Object<PipelineCache, VkPipelineCache>
+{
+public:
+	PipelineCache(const VkPipelineCacheCreateInfo* pCreateInfo, void* mem);
 	~PipelineCache() = delete;
+	void destroy(const VkAllocationCallbacks* pAllocator);
 
 	static size_t ComputeRequiredAllocationSize(const VkPipelineCacheCreateInfo* pCreateInfo)
 	{
 		return 0;
 	}
 
+	VkResult getData(size_t* pDataSize, void* pData);
+	VkResult merge(uint32_t srcCacheCount, const VkPipelineCache* pSrcCaches);
+
+	PipelineRoutineCache* getRoutineCache() const { return routineCache; }
+
 private:
+	PipelineRoutineCache* routineCache = nullptr;
 };
 
 static inline PipelineCache* Cast(VkPipelineCache object)
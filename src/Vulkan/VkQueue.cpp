@@ -13,31 +13,168 @@
 // limitations under the License.
 
 #include "VkCommandBuffer.hpp"
+#include "VkDevice.hpp"
 #include "VkFence.hpp"
 #include "VkQueue.hpp"
 #include "VkSemaphore.hpp"
 #include "Device/Renderer.hpp"
 
+#include <cstring>
+
+namespace
+{
+
+size_t alignOffset(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+VkSubmitInfo* DeepCopySubmitInfo(uint32_t submitCount, const VkSubmitInfo* pSubmits)
+{
+	// Non-dispatchable handles are 64-bit even on 32-bit targets, so each array gets aligned for its own type
+	size_t size = sizeof(VkSubmitInfo) * submitCount;
+	for(uint32_t i = 0; i < submitCount; i++)
+	{
+		size = alignOffset(size, alignof(VkSemaphore)) + pSubmits[i].waitSemaphoreCount * sizeof(VkSemaphore);
+		size = alignOffset(size, alignof(VkCommandBuffer)) + pSubmits[i].commandBufferCount * sizeof(VkCommandBuffer);
+		size = alignOffset(size, alignof(VkSemaphore)) + pSubmits[i].signalSemaphoreCount * sizeof(VkSemaphore);
+	}
+
+	for(uint32_t i = 0; i < submitCount; i++)
+	{
+		size = alignOffset(size, alignof(VkPipelineStageFlags)) + pSubmits[i].waitSemaphoreCount * sizeof(VkPipelineStageFlags);
+	}
+
+	uint8_t* memory = static_cast<uint8_t*>(vk::allocate(size, vk::REQUIRED_MEMORY_ALIGNMENT,
+	                                                     vk::DEVICE_MEMORY, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+
+	auto submits = reinterpret_cast<VkSubmitInfo*>(memory);
+	size_t offset = sizeof(VkSubmitInfo) * submitCount;
+
+	for(uint32_t i = 0; i < submitCount; i++)
+	{
+		submits[i] = pSubmits[i];
+		submits[i].pNext = nullptr;
+
+		offset = alignOffset(offset, alignof(VkSemaphore));
+		size_t waitSemaphoresSize = pSubmits[i].waitSemaphoreCount * sizeof(VkSemaphore);
+		submits[i].pWaitSemaphores = reinterpret_cast<const VkSemaphore*>(memory + offset);
+		memcpy(memory + offset, pSubmits[i].pWaitSemaphores, waitSemaphoresSize);
+		offset += waitSemaphoresSize;
+
+		offset = alignOffset(offset, alignof(VkCommandBuffer));
+		size_t commandBuffersSize = pSubmits[i].commandBufferCount * sizeof(VkCommandBuffer);
+		submits[i].pCommandBuffers = reinterpret_cast<const VkCommandBuffer*>(memory + offset);
+		memcpy(memory + offset, pSubmits[i].pCommandBuffers, commandBuffersSize);
+		offset += commandBuffersSize;
+
+		offset = alignOffset(offset, alignof(VkSemaphore));
+		size_t signalSemaphoresSize = pSubmits[i].signalSemaphoreCount * sizeof(VkSemaphore);
+		submits[i].pSignalSemaphores = reinterpret_cast<const VkSemaphore*>(memory + offset);
+		memcpy(memory + offset, pSubmits[i].pSignalSemaphores, signalSemaphoresSize);
+		offset += signalSemaphoresSize;
+	}
+
+	for(uint32_t i = 0; i < submitCount; i++)
+	{
+		offset = alignOffset(offset, alignof(VkPipelineStageFlags));
+		size_t waitDstStageMaskSize = pSubmits[i].waitSemaphoreCount * sizeof(VkPipelineStageFlags);
+		submits[i].pWaitDstStageMask = reinterpret_cast<const VkPipelineStageFlags*>(memory + offset);
+		memcpy(memory + offset, pSubmits[i].pWaitDstStageMask, waitDstStageMaskSize);
+		offset += waitDstStageMaskSize;
+	}
+
+	ASSERT(offset == size);
+
+	return submits;
+}
+
+} // anonymous namespace
+
 namespace vk
 {
 
-Queue::Queue(uint32_t pFamilyIndex, float pPriority) : familyIndex(pFamilyIndex), priority(pPriority)
+Queue::Queue(Device* device, uint32_t pFamilyIndex, float pPriority) : device(device), familyIndex(pFamilyIndex), priority(pPriority),
+	head(0), tail(0), exitThread(false)
 {
 	context = new sw::Context();
 	renderer = new sw::Renderer(context, sw::OpenGL, true);
+
+	thread = new sw::Thread(taskLoop, this);
 }
 
 void Queue::destroy()
 {
+	// The queue thread drains any remaining submissions before exiting
+	exitThread = true;
+	submitted.signal();
+	thread->join();
+	delete thread;
+
 	delete context;
 	delete renderer;
 }
 
 void Queue::submit(uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence)
 {
-	for(uint32_t i = 0; i < submitCount; i++)
+	uint32_t h = head.load(std::memory_order_relaxed);
+
+	while(h - tail.load(std::memory_order_acquire) >= RING_SIZE)
 	{
-		auto& submitInfo = pSubmits[i];
+		completed.wait();
+	}
+
+	Submission& submission = ring[h % RING_SIZE];
+	submission.submitCount = submitCount;
+	submission.pSubmits = (submitCount > 0) ? DeepCopySubmitInfo(submitCount, pSubmits) : nullptr;
+	submission.fence = fence;
+
+	head.store(h + 1, std::memory_order_release);
+	submitted.signal();
+}
+
+void Queue::waitIdle()
+{
+	while(tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed))
+	{
+		completed.wait();
+	}
+}
+
+void Queue::taskLoop(void* parameters)
+{
+	static_cast<Queue*>(parameters)->taskLoop();
+}
+
+void Queue::taskLoop()
+{
+	while(true)
+	{
+		uint32_t t = tail.load(std::memory_order_relaxed);
+
+		if(t == head.load(std::memory_order_acquire))
+		{
+			if(exitThread)
+			{
+				return;
+			}
+
+			submitted.wait();
+			continue;
+		}
+
+		execute(ring[t % RING_SIZE]);
+
+		tail.store(t + 1, std::memory_order_release);
+		completed.signal();
+	}
+}
+
+void Queue::execute(const Submission& submission)
+{
+	for(uint32_t i = 0; i < submission.submitCount; i++)
+	{
+		auto& submitInfo = submission.pSubmits[i];
 		for(uint32_t j = 0; j < submitInfo.waitSemaphoreCount; j++)
 		{
 			vk::Cast(submitInfo.pWaitSemaphores[j])->wait(submitInfo.pWaitDstStageMask[j]);
@@ -52,17 +189,30 @@ void Queue::submit(uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence f
 			}
 		}
 
-		for(uint32_t j = 0; j < submitInfo.signalSemaphoreCount; j++)
+		if(submitInfo.signalSemaphoreCount > 0)
 		{
-			vk::Cast(submitInfo.pSignalSemaphores[j])->signal();
+			// Semaphores signal completion, not just submission, of the batch
+			renderer->synchronize();
+
+			for(uint32_t j = 0; j < submitInfo.signalSemaphoreCount; j++)
+			{
+				vk::Cast(submitInfo.pSignalSemaphores[j])->signal();
+			}
 		}
 	}
 
-	// FIXME (b\117835459): signal the fence only once the work is completed
-	if(fence != VK_NULL_HANDLE)
+	// Waiting here also makes waitIdle() cover the work of this submission
+	renderer->synchronize();
+
+	if(submission.fence != VK_NULL_HANDLE)
+	{
+		device->signalFence(vk::Cast(submission.fence));
+	}
+
+	if(submission.pSubmits)
 	{
-		vk::Cast(fence)->signal();
+		vk::deallocate(submission.pSubmits, DEVICE_MEMORY);
 	}
 }
 
-} // namespace vk
\ No newline at end of file
+} // namespace vk
@@ -16,8 +16,11 @@
 #define VK_QUEUE_HPP_
 
 #include "VkObject.hpp"
+#include "System/Thread.hpp"
 #include <vulkan/vk_icd.h>
 
+#include <atomic>
+
 namespace sw
 {
 	class Context;
@@ -27,12 +30,14 @@ namespace sw
 namespace vk
 {
 
+class Device;
+
 class Queue
 {
 	VK_LOADER_DATA loaderData = { ICD_LOADER_MAGIC };
 
 public:
-	Queue(uint32_t pFamilyIndex, float pPriority);
+	Queue(Device* device, uint32_t pFamilyIndex, float pPriority);
 	~Queue() = delete;
 
 	operator VkQueue()
@@ -42,12 +47,39 @@ public:
 
 	void destroy();
 	void submit(uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
+	void waitIdle();
 
 private:
+	// Submissions are handed over to the queue thread through a single-producer,
+	// single-consumer ring. The application externally synchronizes access to the
+	// queue, so only one thread ever writes to the ring at a time.
+	struct Submission
+	{
+		uint32_t submitCount;
+		VkSubmitInfo* pSubmits;   // Deep copy, owned by the submission
+		VkFence fence;
+	};
+
+	enum { RING_SIZE = 64 };
+
+	static void taskLoop(void* parameters);
+	void taskLoop();
+	void execute(const Submission& submission);
+
+	Device* device = nullptr;
 	sw::Context* context = nullptr;
 	sw::Renderer* renderer = nullptr;
 	uint32_t familyIndex = 0;
 	float    priority = 0.0f;
+
+	Submission ring[RING_SIZE];
+	std::atomic<uint32_t> head;   // Next slot to be written by submit()
+	std::atomic<uint32_t> tail;   // Next slot to be executed by the queue thread
+	std::atomic<bool> exitThread;
+
+	sw::Event submitted;   // Signaled when head advances
+	sw::Event completed;   // Signaled when tail advances
+	sw::Thread* thread = nullptr;
 };
 
 static inline Queue* Cast(VkQueue object)
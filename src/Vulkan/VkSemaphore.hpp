@@ -17,6 +17,9 @@
 
 #include "VkObject.hpp"
 
+#include <condition_variable>
+#include <mutex>
+
 namespace vk
 {
 
@@ -32,24 +35,33 @@ public:
 		return 0;
 	}
 
+	// Binary semaphore: a wait consumes the signal operation it was waiting on
 	void wait()
 	{
-		// Semaphores are noop for now
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this] { return signaled; });
+		signaled = false;
 	}
 
 	void wait(const VkPipelineStageFlags& flag)
 	{
-		// VkPipelineStageFlags is the pipeline stage at which the semaphore wait will occur
-
-		// Semaphores are noop for now
+		// VkPipelineStageFlags is the pipeline stage at which the semaphore wait will occur.
+		// Queues execute submissions serially, so waiting before any command is recorded
+		// satisfies every stage.
+		wait();
 	}
 
 	void signal()
 	{
-		// Semaphores are noop for now
+		std::unique_lock<std::mutex> lock(mutex);
+		signaled = true;
+		condition.notify_all();
 	}
 
 private:
+	bool signaled = false;
+	std::mutex mutex;
+	std::condition_variable condition;
 };
 
 static inline Semaphore* Cast(VkSemaphore object)
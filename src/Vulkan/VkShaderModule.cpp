@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "VkShaderModule.hpp"
+#include "System/Math.hpp"
 
 #include <cstring>
 
@@ -22,6 +23,7 @@ namespace vk
 ShaderModule::ShaderModule(const VkShaderModuleCreateInfo* pCreateInfo, void* mem) : code(reinterpret_cast<uint32_t*>(mem))
 {
 	memcpy(code, pCreateInfo->pCode, pCreateInfo->codeSize);
+	hash = sw::FNV_1a(reinterpret_cast<const unsigned char*>(code), static_cast<int>(pCreateInfo->codeSize));
 }
 
 void ShaderModule::destroy(const VkAllocationCallbacks* pAllocator)
@@ -33,11 +33,13 @@ public:
 	void destroy(const VkAllocationCallbacks* pAllocator);
 
 	rr::Routine* compile(const VkAllocationCallbacks* pAllocator);
+	uint64_t getHash() const { return hash; }
 
 	static size_t ComputeRequiredAllocationSize(const VkShaderModuleCreateInfo* pCreateInfo);
 
 private:
 	uint32_t* code = nullptr;
+	uint64_t hash = 0;   // Of the SPIR-V code
 };
 
 static inline ShaderModule* Cast(VkShaderModule object)
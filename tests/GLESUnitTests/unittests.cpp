@@ -19,6 +19,7 @@
 #include "gmock/gmock.h"
 
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <GLES3/gl3.h>
@@ -30,7 +31,10 @@
 #endif
 
 #include <string.h>
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <vector>
 
 #define EXPECT_GLENUM_EQ(expected, actual) EXPECT_EQ(static_cast<GLenum>(expected), static_cast<GLenum>(actual))
 
@@ -50,6 +54,25 @@ protected:
 		#endif
 	}
 
+	void TearDown() override
+	{
+		if(configured)
+		{
+			remove("SwiftShader.ini");
+		}
+	}
+
+	// Renderer settings for the contexts created afterwards, which read them from the working directory
+	void Configure(const char *settings)
+	{
+		FILE *file = fopen("SwiftShader.ini", "w");
+		ASSERT_NE(nullptr, file);
+		fputs(settings, file);
+		fclose(file);
+
+		configured = true;
+	}
+
 	void expectFramebufferColor(const unsigned char referenceColor[4], GLint x = 0, GLint y = 0)
 	{
 		unsigned char color[4] = { 0 };
@@ -326,6 +349,7 @@ private:
 	EGLConfig config;
 	EGLSurface surface;
 	EGLContext context;
+	bool configured = false;
 };
 
 TEST_F(SwiftShaderTest, Initalization)
@@ -1382,6 +1406,912 @@ TEST_F(SwiftShaderTest, TextureRectangle_CopyTexSubImage)
 	Uninitialize();
 }
 
+// Test that a large indexed mesh, shaded in bulk a window of primitives at a time,
+// renders the same as when drawn in small pieces through the vertex cache
+TEST_F(SwiftShaderTest, BulkVertexShading)
+{
+	Initialize(3, false);
+
+	const std::string vs =
+		"#version 300 es\n"
+		"in vec2 position;\n"
+		"out vec4 color;\n"
+		"void main()\n"
+		"{\n"
+		"    color = vec4(position * 0.5 + 0.5, fract(position.x * 7.0), 1.0);\n"
+		"    gl_Position = vec4(position, 0.0, 1.0);\n"
+		"}\n";
+
+	const std::string fs =
+		"#version 300 es\n"
+		"precision mediump float;\n"
+		"in vec4 color;\n"
+		"out vec4 fragColor;\n"
+		"void main()\n"
+		"{\n"
+		"    fragColor = color;\n"
+		"}\n";
+
+	const ProgramHandles ph = createProgram(vs, fs);
+
+	glUseProgram(ph.program);
+	GLint posLoc = glGetAttribLocation(ph.program, "position");
+	EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+	// A perturbed grid, with its vertices at every other index so that groups of four
+	// consecutive indices are only partially referenced
+	const int size = 48;
+	std::vector<float> vertices(2 * 2 * size * size, 1.0e6f);
+
+	for(int y = 0; y < size; y++)
+	{
+		for(int x = 0; x < size; x++)
+		{
+			float *vertex = &vertices[2 * 2 * (y * size + x)];
+			vertex[0] = 2.0f * x / (size - 1) - 1.0f + ((x * 7 + y * 3) % 5 - 2) * 0.004f;
+			vertex[1] = 2.0f * y / (size - 1) - 1.0f + ((x * 5 + y * 11) % 7 - 3) * 0.003f;
+		}
+	}
+
+	std::vector<GLushort> indices;
+
+	for(int y = 0; y < size - 1; y++)
+	{
+		for(int x = 0; x < size - 1; x++)
+		{
+			GLushort i = 2 * (y * size + x);
+			GLushort row = 2 * size;
+
+			indices.insert(indices.end(), { i, GLushort(i + 2), GLushort(i + row), GLushort(i + 2), GLushort(i + row + 2), GLushort(i + row) });
+		}
+	}
+
+	glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 0, vertices.data());
+	glEnableVertexAttribArray(posLoc);
+	glViewport(0, 0, 128, 128);
+
+	std::vector<unsigned char> bulk(4 * 128 * 128);
+	std::vector<unsigned char> cached(4 * 128 * 128);
+
+	// The whole mesh spans thousands of indices, each used several times
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_SHORT, indices.data());
+	glReadPixels(0, 0, 128, 128, GL_RGBA, GL_UNSIGNED_BYTE, bulk.data());
+	EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+	// Each row of the mesh spans too few indices to be shaded in bulk
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	for(int y = 0; y < size - 1; y++)
+	{
+		glDrawElements(GL_TRIANGLES, 6 * (size - 1), GL_UNSIGNED_SHORT, &indices[6 * (size - 1) * y]);
+	}
+
+	glReadPixels(0, 0, 128, 128, GL_RGBA, GL_UNSIGNED_BYTE, cached.data());
+	EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+	EXPECT_EQ(255, bulk[4 * (64 * 128 + 64) + 3]);   // Covered by the mesh
+	EXPECT_TRUE(bulk == cached);
+
+	glDisableVertexAttribArray(posLoc);
+	deleteProgram(ph);
+
+	Uninitialize();
+}
+
+// Overlapping primitives spread over several batches have to be drawn in order, whichever
+// cluster claims each of their tiles.
+TEST_F(SwiftShaderTest, TileBasedRasterization)
+{
+	const std::string vs =
+		"#version 300 es\n"
+		"in vec2 position;\n"
+		"in vec4 color;\n"
+		"out vec4 vColor;\n"
+		"void main()\n"
+		"{\n"
+		"    vColor = color;\n"
+		"    gl_Position = vec4(position, 0.0, 1.0);\n"
+		"}\n";
+
+	const std::string fs =
+		"#version 300 es\n"
+		"precision mediump float;\n"
+		"in vec4 vColor;\n"
+		"out vec4 fragColor;\n"
+		"void main()\n"
+		"{\n"
+		"    fragColor = vColor;\n"
+		"}\n";
+
+	// Triangles of all sizes, each of its own color, with later ones covering earlier ones
+	const int triangles = 1500;
+	std::vector<float> positions;
+	std::vector<unsigned char> colors;
+	unsigned int random = 1;
+
+	auto next = [&random]()
+	{
+		random = random * 1103515245 + 12345;
+		return ((random >> 16) % 1000) / 1000.0f;   // [0, 1)
+	};
+
+	for(int i = 0; i < triangles; i++)
+	{
+		float extent = (i % 10 == 0) ? 2.0f : 0.4f;
+		float x = next() * 2.0f - 1.0f;
+		float y = next() * 2.0f - 1.0f;
+
+		for(int j = 0; j < 3; j++)
+		{
+			positions.push_back(x + (next() - 0.5f) * extent);
+			positions.push_back(y + (next() - 0.5f) * extent);
+			colors.insert(colors.end(), { (unsigned char)(i * 37), (unsigned char)(i * 11), (unsigned char)(i / 6), 255 });
+		}
+	}
+
+	const int size = 256;
+	std::vector<unsigned char> interleaved(4 * size * size);
+	std::vector<unsigned char> tiled(4 * size * size);
+
+	const char *settings[] =
+	{
+		"[Processor]\nThreadCount=4\nTileSize=0\n",
+		"[Processor]\nThreadCount=4\nTileSize=16\n",
+		"[Processor]\nThreadCount=3\nTileSize=64\n",
+	};
+
+	for(const char *setting : settings)
+	{
+		Configure(setting);
+		Initialize(3, false);
+
+		const ProgramHandles ph = createProgram(vs, fs);
+		glUseProgram(ph.program);
+		GLint posLoc = glGetAttribLocation(ph.program, "position");
+		GLint colorLoc = glGetAttribLocation(ph.program, "color");
+
+		glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 0, positions.data());
+		glEnableVertexAttribArray(posLoc);
+		glVertexAttribPointer(colorLoc, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, colors.data());
+		glEnableVertexAttribArray(colorLoc);
+
+		glViewport(0, 0, size, size);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDrawArrays(GL_TRIANGLES, 0, 3 * triangles);
+
+		std::vector<unsigned char> &result = (setting == settings[0]) ? interleaved : tiled;
+		glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, result.data());
+		EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+		glDisableVertexAttribArray(posLoc);
+		glDisableVertexAttribArray(colorLoc);
+		deleteProgram(ph);
+
+		Uninitialize();
+
+		if(setting != settings[0])
+		{
+			EXPECT_TRUE(tiled == interleaved) << setting;
+		}
+	}
+
+	EXPECT_EQ(255, interleaved[4 * (size / 2 * size + size / 2) + 3]);   // Covered
+}
+
+// Entire clears are only filled in once rows get drawn to or the buffer is read
+TEST_F(SwiftShaderTest, DeferredClear)
+{
+	Initialize(3, false);
+
+	const std::string vs =
+		"#version 300 es\n"
+		"in vec4 position;\n"
+		"uniform float depth;\n"
+		"void main()\n"
+		"{\n"
+		"    gl_Position = vec4(position.xy, depth, 1.0);\n"
+		"}\n";
+
+	const std::string fs =
+		"#version 300 es\n"
+		"precision mediump float;\n"
+		"uniform vec4 color;\n"
+		"out vec4 fragColor;\n"
+		"void main()\n"
+		"{\n"
+		"    fragColor = color;\n"
+		"}\n";
+
+	const ProgramHandles ph = createProgram(vs, fs);
+	GLint depthLoc = glGetUniformLocation(ph.program, "depth");
+	GLint colorLoc = glGetUniformLocation(ph.program, "color");
+	glUseProgram(ph.program);
+
+	const int size = 128;
+
+	GLuint renderbuffers[2];
+	glGenRenderbuffers(2, renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size, size);
+
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+	EXPECT_GLENUM_EQ(GL_FRAMEBUFFER_COMPLETE, glCheckFramebufferStatus(GL_FRAMEBUFFER));
+	EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+	glViewport(0, 0, size, size);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+
+	unsigned char red[4] = { 255, 0, 0, 255 };
+	unsigned char green[4] = { 0, 255, 0, 255 };
+	unsigned char blue[4] = { 0, 0, 255, 255 };
+	unsigned char black[4] = { 0, 0, 0, 255 };
+
+	// The primitives only touch some of the cleared rows, and depth tests against the cleared depth
+	glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+	glClearDepthf(0.5f);
+	glClearStencil(0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, 8, size, 16);
+	glUniform1f(depthLoc, -0.5f);   // Passes
+	glUniform4f(colorLoc, 0.0f, 1.0f, 0.0f, 1.0f);
+	drawQuad(ph.program);
+
+	glScissor(0, 64, size, 16);
+	glUniform1f(depthLoc, 0.5f);   // Fails
+	glUniform4f(colorLoc, 0.0f, 0.0f, 1.0f, 1.0f);
+	drawQuad(ph.program);
+	glDisable(GL_SCISSOR_TEST);
+
+	expectFramebufferColor(red, 64, 0);
+	expectFramebufferColor(green, 0, 8);
+	expectFramebufferColor(green, 64, 16);
+	expectFramebufferColor(green, size - 1, 23);
+	expectFramebufferColor(red, 64, 24);
+	expectFramebufferColor(red, 64, 72);
+	expectFramebufferColor(red, size - 1, size - 1);
+
+	// A second clear replaces both the drawn rows and the ones still pending
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClearDepthf(1.0f);
+	glClearStencil(1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+	glEnable(GL_STENCIL_TEST);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, 64, size, 16);
+	glStencilFunc(GL_EQUAL, 1, 0xFF);   // Passes
+	glUniform1f(depthLoc, 0.5f);
+	drawQuad(ph.program);
+
+	glScissor(0, 100, size, 16);
+	glStencilFunc(GL_EQUAL, 0, 0xFF);   // Fails
+	glUniform4f(colorLoc, 0.0f, 1.0f, 0.0f, 1.0f);
+	drawQuad(ph.program);
+	glDisable(GL_SCISSOR_TEST);
+	glDisable(GL_STENCIL_TEST);
+
+	expectFramebufferColor(black, 64, 16);
+	expectFramebufferColor(blue, 64, 72);
+	expectFramebufferColor(black, 64, 108);
+	expectFramebufferColor(black, 0, 0);
+
+	// Copies read the cleared contents
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 0, 0, size, size, 0);
+	EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+	GLuint copyFramebuffer;
+	glGenFramebuffers(1, &copyFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, copyFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	expectFramebufferColor(black, 64, 16);
+	expectFramebufferColor(blue, 64, 72);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &copyFramebuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &texture);
+	glDeleteRenderbuffers(2, renderbuffers);
+	glDisable(GL_DEPTH_TEST);
+	deleteProgram(ph);
+
+	Uninitialize();
+}
+
+// Tiles culled with the hierarchical depth bounds have to match per-pixel depth testing
+TEST_F(SwiftShaderTest, HierarchicalDepth)
+{
+	Configure("[Processor]\nThreadCount=2\nTileSize=16\n");
+	Initialize(3, false);
+
+	const std::string vs =
+		"#version 300 es\n"
+		"in vec4 position;\n"
+		"uniform float depth;\n"
+		"void main()\n"
+		"{\n"
+		"    gl_Position = vec4(position.xy, depth, 1.0);\n"
+		"}\n";
+
+	const std::string fs =
+		"#version 300 es\n"
+		"precision mediump float;\n"
+		"uniform vec4 color;\n"
+		"out vec4 fragColor;\n"
+		"void main()\n"
+		"{\n"
+		"    fragColor = color;\n"
+		"}\n";
+
+	const ProgramHandles ph = createProgram(vs, fs);
+	GLint depthLoc = glGetUniformLocation(ph.program, "depth");
+	GLint colorLoc = glGetUniformLocation(ph.program, "color");
+	glUseProgram(ph.program);
+
+	const int size = 128;
+
+	GLuint renderbuffers[2];
+	glGenRenderbuffers(2, renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+	EXPECT_GLENUM_EQ(GL_FRAMEBUFFER_COMPLETE, glCheckFramebufferStatus(GL_FRAMEBUFFER));
+	EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+	glViewport(0, 0, size, size);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+
+	unsigned char red[4] = { 255, 0, 0, 255 };
+	unsigned char green[4] = { 0, 255, 0, 255 };
+	unsigned char blue[4] = { 0, 0, 255, 255 };
+	unsigned char yellow[4] = { 255, 255, 0, 255 };
+	unsigned char white[4] = { 255, 255, 255, 255 };
+
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClearDepthf(1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Covers every tile at depth 0.25, which lowers their bounds
+	glUniform1f(depthLoc, -0.5f);
+	glUniform4f(colorLoc, 0.0f, 1.0f, 0.0f, 1.0f);
+	drawQuad(ph.program);
+
+	// Behind, so culled
+	glUniform1f(depthLoc, 0.5f);
+	glUniform4f(colorLoc, 1.0f, 0.0f, 0.0f, 1.0f);
+	drawQuad(ph.program);
+
+	expectFramebufferColor(green, 10, 64);
+	expectFramebufferColor(green, 100, 64);
+
+	// Nearer, ending in the middle of a tile, which keeps that tile's bound
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, 0, 60, size);
+	glUniform1f(depthLoc, -0.8f);
+	glUniform4f(colorLoc, 0.0f, 0.0f, 1.0f, 1.0f);
+	drawQuad(ph.program);
+	glDisable(GL_SCISSOR_TEST);
+
+	// Between the two depths, so only visible right of the scissor edge
+	glUniform1f(depthLoc, -0.6f);
+	glUniform4f(colorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
+	drawQuad(ph.program);
+
+	expectFramebufferColor(blue, 10, 64);
+	expectFramebufferColor(blue, 59, 64);
+	expectFramebufferColor(yellow, 60, 64);
+	expectFramebufferColor(yellow, 63, 64);
+	expectFramebufferColor(yellow, 100, 64);
+
+	// Moving depth further away invalidates the bounds
+	glDepthFunc(GL_GREATER);
+	glUniform1f(depthLoc, 0.8f);
+	glUniform4f(colorLoc, 1.0f, 1.0f, 1.0f, 1.0f);
+	drawQuad(ph.program);
+
+	expectFramebufferColor(white, 10, 64);
+	expectFramebufferColor(white, 100, 64);
+
+	glDepthFunc(GL_LESS);
+	glUniform1f(depthLoc, 0.0f);
+	glUniform4f(colorLoc, 1.0f, 0.0f, 0.0f, 1.0f);
+	drawQuad(ph.program);
+
+	expectFramebufferColor(red, 10, 64);
+	expectFramebufferColor(red, 100, 64);
+
+	// So do writes through other paths, like partial clears
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, 0, size / 2, size);
+	glClearDepthf(0.1f);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+
+	glUniform1f(depthLoc, -0.5f);
+	glUniform4f(colorLoc, 0.0f, 1.0f, 0.0f, 1.0f);
+	drawQuad(ph.program);
+
+	expectFramebufferColor(red, 10, 64);
+	expectFramebufferColor(green, 100, 64);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(2, renderbuffers);
+	glDisable(GL_DEPTH_TEST);
+	deleteProgram(ph);
+
+	Uninitialize();
+}
+
+// Swaps with damage rectangles, and partial writes tracked as damage, keep the surface contents intact
+TEST_F(SwiftShaderTest, SwapBuffersWithDamage)
+{
+	Initialize(3, false);
+
+	const char *extensions = eglQueryString(getDisplay(), EGL_EXTENSIONS);
+	EXPECT_EQ(EGL_SUCCESS, eglGetError());
+	EXPECT_THAT(extensions, testing::HasSubstr("EGL_KHR_swap_buffers_with_damage"));
+	EXPECT_THAT(extensions, testing::HasSubstr("EGL_EXT_swap_buffers_with_damage"));
+
+	PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapBuffersWithDamage = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+	ASSERT_NE(nullptr, swapBuffersWithDamage);
+	EXPECT_NE(nullptr, eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+
+	unsigned char red[4] = { 255, 0, 0, 255 };
+	unsigned char green[4] = { 0, 255, 0, 255 };
+	unsigned char blue[4] = { 0, 0, 255, 255 };
+
+	glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, 0, 64, 16);
+	glClearColor(0.0f, 1.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+
+	EGLint damage[8] = { 0, 0, 64, 16,   100, 100, 8, 8 };
+	EXPECT_EQ((EGLBoolean)EGL_TRUE, swapBuffersWithDamage(getDisplay(), getSurface(), damage, 2));
+	EXPECT_EQ(EGL_SUCCESS, eglGetError());
+
+	expectFramebufferColor(green, 0, 0);
+	expectFramebufferColor(green, 63, 15);
+	expectFramebufferColor(red, 64, 0);
+	expectFramebufferColor(red, 0, 16);
+	expectFramebufferColor(red, 1000, 1000);
+
+	// A blit only damages its destination rectangle
+	GLuint renderbuffer;
+	glGenRenderbuffers(1, &renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 32, 32);
+
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+	glClearColor(0.0f, 0.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, 32, 32, 200, 300, 232, 332, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+	EGLint blitDamage[4] = { 200, 300, 32, 32 };
+	EXPECT_EQ((EGLBoolean)EGL_TRUE, swapBuffersWithDamage(getDisplay(), getSurface(), blitDamage, 1));
+
+	// Without rectangles it's a regular swap
+	EXPECT_EQ((EGLBoolean)EGL_TRUE, swapBuffersWithDamage(getDisplay(), getSurface(), nullptr, 0));
+	EXPECT_EQ(EGL_SUCCESS, eglGetError());
+
+	expectFramebufferColor(blue, 200, 300);
+	expectFramebufferColor(blue, 231, 331);
+	expectFramebufferColor(red, 199, 300);
+	expectFramebufferColor(red, 232, 331);
+	expectFramebufferColor(green, 0, 0);
+
+	EXPECT_EQ((EGLBoolean)EGL_FALSE, swapBuffersWithDamage(getDisplay(), getSurface(), damage, -1));
+	EXPECT_EQ(EGL_BAD_PARAMETER, eglGetError());
+	EXPECT_EQ((EGLBoolean)EGL_FALSE, swapBuffersWithDamage(getDisplay(), getSurface(), nullptr, 1));
+	EXPECT_EQ(EGL_BAD_PARAMETER, eglGetError());
+	EXPECT_EQ((EGLBoolean)EGL_FALSE, swapBuffersWithDamage(getDisplay(), EGL_NO_SURFACE, damage, 1));
+	EXPECT_EQ(EGL_BAD_SURFACE, eglGetError());
+
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &renderbuffer);
+
+	Uninitialize();
+}
+
+// Instanced attributes with different divisors, over more instances than fit in one batch of primitives
+TEST_F(SwiftShaderTest, InstancedDivisors)
+{
+	Initialize(3, false);
+
+	const std::string vs =
+		"#version 300 es\n"
+		"in vec2 position;\n"
+		"in vec2 offset;\n"
+		"in vec4 color;\n"
+		"out vec4 vColor;\n"
+		"void main()\n"
+		"{\n"
+		"    vColor = vec4(color.rgb, float(gl_InstanceID) / 255.0);\n"
+		"    gl_Position = vec4(position + offset, 0.0, 1.0);\n"
+		"}\n";
+
+	const std::string fs =
+		"#version 300 es\n"
+		"precision mediump float;\n"
+		"in vec4 vColor;\n"
+		"out vec4 fragColor;\n"
+		"void main()\n"
+		"{\n"
+		"    fragColor = vColor;\n"
+		"}\n";
+
+	const ProgramHandles ph = createProgram(vs, fs);
+	glUseProgram(ph.program);
+	GLint posLoc = glGetAttribLocation(ph.program, "position");
+	GLint offsetLoc = glGetAttribLocation(ph.program, "offset");
+	GLint colorLoc = glGetAttribLocation(ph.program, "color");
+
+	// One small quad per cell of a grid, each instance in its own cell
+	const int columns = 20;
+	const int rows = 15;
+	const int cell = 8;
+	const int instances = columns * rows;
+
+	float w = 0.8f / columns;
+	float h = 0.8f / rows;
+	float corners[12] = { -w, -h,   w, -h,   w, h,   -w, -h,   w, h,   -w, h };
+	GLushort indices[6] = { 0, 1, 2, 0, 2, 5 };
+
+	std::vector<float> offsets;
+	std::vector<unsigned char> colors;
+
+	for(int i = 0; i < instances; i++)
+	{
+		offsets.push_back(-1.0f + (2.0f * (i % columns) + 1.0f) / columns);
+		offsets.push_back(-1.0f + (2.0f * (i / columns) + 1.0f) / rows);
+	}
+
+	for(int i = 0; i < (instances + 1) / 2; i++)   // One color per two instances
+	{
+		colors.insert(colors.end(), { (unsigned char)(i * 7), (unsigned char)(i * 13), (unsigned char)(i * 29), 255 });
+	}
+
+	glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 0, corners);
+	glEnableVertexAttribArray(posLoc);
+	glVertexAttribPointer(offsetLoc, 2, GL_FLOAT, GL_FALSE, 0, offsets.data());
+	glVertexAttribDivisor(offsetLoc, 1);
+	glEnableVertexAttribArray(offsetLoc);
+	glVertexAttribPointer(colorLoc, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, colors.data());
+	glVertexAttribDivisor(colorLoc, 2);
+	glEnableVertexAttribArray(colorLoc);
+	EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+	const int width = columns * cell;
+	const int height = rows * cell;
+	glViewport(0, 0, width, height);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+	for(int indexed = 0; indexed < 2; indexed++)
+	{
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		if(indexed)
+		{
+			glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices, instances);
+		}
+		else
+		{
+			glDrawArraysInstanced(GL_TRIANGLES, 0, 6, instances);
+		}
+
+		std::vector<unsigned char> pixels(4 * width * height);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+		for(int i = 0; i < instances; i++)
+		{
+			int x = (i % columns) * cell + cell / 2;
+			int y = (i / columns) * cell + cell / 2;
+			const unsigned char *pixel = &pixels[4 * (y * width + x)];
+			const unsigned char *color = &colors[4 * (i / 2)];
+
+			EXPECT_EQ(color[0], pixel[0]) << "instance " << i;
+			EXPECT_EQ(color[1], pixel[1]) << "instance " << i;
+			EXPECT_EQ(color[2], pixel[2]) << "instance " << i;
+			EXPECT_EQ(std::min(i, 255), pixel[3]) << "instance " << i;
+
+			// The gaps between the cells stay clear
+			EXPECT_EQ(0, pixels[4 * (y * width + x - cell / 2) + 3]) << "instance " << i;
+		}
+	}
+
+	glVertexAttribDivisor(offsetLoc, 0);
+	glVertexAttribDivisor(colorLoc, 0);
+	glDisableVertexAttribArray(posLoc);
+	glDisableVertexAttribArray(offsetLoc);
+	glDisableVertexAttribArray(colorLoc);
+	deleteProgram(ph);
+
+	Uninitialize();
+}
+
+// Indices which keep mapping to the same sets of the post-transform vertex cache, so that
+// lines get evicted and reloaded, have to give the same result as unindexed vertices
+TEST_F(SwiftShaderTest, VertexCacheConflicts)
+{
+	const std::string vs =
+		"#version 300 es\n"
+		"in vec2 position;\n"
+		"in vec4 color;\n"
+		"out vec4 vColor;\n"
+		"void main()\n"
+		"{\n"
+		"    vColor = color;\n"
+		"    gl_Position = vec4(position, 0.0, 1.0);\n"
+		"}\n";
+
+	const std::string fs =
+		"#version 300 es\n"
+		"precision mediump float;\n"
+		"in vec4 vColor;\n"
+		"out vec4 fragColor;\n"
+		"void main()\n"
+		"{\n"
+		"    fragColor = vColor;\n"
+		"}\n";
+
+	const int vertexCount = 1024;
+	std::vector<float> positions;
+	std::vector<unsigned char> colors;
+
+	for(int i = 0; i < vertexCount; i++)
+	{
+		positions.push_back(((i * 37) % 64) / 32.0f - 1.0f);
+		positions.push_back(((i * 91) % 64) / 32.0f - 1.0f);
+		colors.insert(colors.end(), { (unsigned char)i, (unsigned char)(i >> 2), (unsigned char)(i * 5), 255 });
+	}
+
+	// Indices 32 apart share a set of the smallest cache. Too few triangles
+	// for the indices to be shaded in bulk.
+	std::vector<GLushort> indices;
+	unsigned int random = 1;
+
+	for(int i = 0; i < 3 * 400; i++)
+	{
+		random = random * 1103515245 + 12345;
+		int line = (random >> 16) % 32;
+		int offset = (random >> 24) % 4;
+		indices.push_back(GLushort(32 * line + 4 * ((i / 3) % 2) + offset));
+	}
+
+	std::vector<float> expandedPositions;
+	std::vector<unsigned char> expandedColors;
+
+	for(GLushort index : indices)
+	{
+		expandedPositions.insert(expandedPositions.end(), &positions[2 * index], &positions[2 * index + 2]);
+		expandedColors.insert(expandedColors.end(), &colors[4 * index], &colors[4 * index + 4]);
+	}
+
+	const int size = 128;
+	std::vector<unsigned char> reference;
+
+	const char *settings[] =
+	{
+		"[Caches]\nVertexCacheSize=64\n",
+		"[Caches]\nVertexCacheSize=1024\n",
+	};
+
+	for(const char *setting : settings)
+	{
+		Configure(setting);
+		Initialize(3, false);
+
+		const ProgramHandles ph = createProgram(vs, fs);
+		glUseProgram(ph.program);
+		GLint posLoc = glGetAttribLocation(ph.program, "position");
+		GLint colorLoc = glGetAttribLocation(ph.program, "color");
+		glEnableVertexAttribArray(posLoc);
+		glEnableVertexAttribArray(colorLoc);
+
+		glViewport(0, 0, size, size);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+		for(int indexed = 0; indexed < 2; indexed++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			if(indexed)
+			{
+				glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 0, positions.data());
+				glVertexAttribPointer(colorLoc, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, colors.data());
+				glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_SHORT, indices.data());
+			}
+			else
+			{
+				glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 0, expandedPositions.data());
+				glVertexAttribPointer(colorLoc, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, expandedColors.data());
+				glDrawArrays(GL_TRIANGLES, 0, (GLsizei)indices.size());
+			}
+
+			std::vector<unsigned char> pixels(4 * size * size);
+			glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+			if(reference.empty())
+			{
+				reference = pixels;
+			}
+			else
+			{
+				EXPECT_TRUE(pixels == reference) << setting << (indexed ? " indexed" : " unindexed");
+			}
+		}
+
+		glDisableVertexAttribArray(posLoc);
+		glDisableVertexAttribArray(colorLoc);
+		deleteProgram(ph);
+
+		Uninitialize();
+	}
+
+	EXPECT_NE(0, std::count(reference.begin(), reference.end(), 255));   // Not empty
+}
+
+// Sampling compressed textures directly has to produce the same result as
+// decoding them when they're uploaded
+TEST_F(SwiftShaderTest, CompressedTextureSampling)
+{
+	const std::string vs =
+		"attribute vec4 position;\n"
+		"varying vec2 texCoord;\n"
+		"void main()\n"
+		"{\n"
+		"    texCoord = position.xy * 0.75 + 0.6;\n"
+		"    gl_Position = vec4(position.xy, 0.0, 1.0);\n"
+		"}\n";
+
+	const std::string fs =
+		"precision mediump float;\n"
+		"uniform sampler2D tex;\n"
+		"varying vec2 texCoord;\n"
+		"void main()\n"
+		"{\n"
+		"    gl_FragColor = texture2D(tex, texCoord);\n"
+		"}\n";
+
+	struct CompressedFormat
+	{
+		GLenum format;
+		int blockSize;
+		const char *extension;
+	};
+
+	const CompressedFormat formats[] =
+	{
+		{ GL_ETC1_RGB8_OES, 8, "GL_OES_compressed_ETC1_RGB8_texture" },
+		{ GL_COMPRESSED_RGB8_ETC2, 8, nullptr },
+		{ GL_COMPRESSED_RGBA8_ETC2_EAC, 16, nullptr },
+		{ GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 8, "GL_EXT_texture_compression_dxt1" },
+		{ GL_COMPRESSED_RGBA_S3TC_DXT3_ANGLE, 16, "GL_ANGLE_texture_compression_dxt3" },
+		{ GL_COMPRESSED_RGBA_S3TC_DXT5_ANGLE, 16, "GL_ANGLE_texture_compression_dxt5" },
+	};
+
+	const GLenum filters[] = { GL_NEAREST, GL_LINEAR };
+
+	const int textureSize = 16;
+	const int size = 64;
+	const int blockCount = (textureSize / 4) * (textureSize / 4);
+
+	// Decoded on upload first, then sampled directly
+	std::vector<std::vector<unsigned char>> results[2];
+
+	for(int compressed = 0; compressed < 2; compressed++)
+	{
+		Configure(compressed ? "[Quality]\nCompressedTextureSampling=1\n" : "[Quality]\nCompressedTextureSampling=0\n");
+		Initialize(3, false);
+
+		const char *extensions = (const char*)glGetString(GL_EXTENSIONS);
+		ASSERT_NE(nullptr, extensions);
+
+		const ProgramHandles ph = createProgram(vs, fs);
+		glViewport(0, 0, size, size);
+
+		GLuint tex = 0;
+		glGenTextures(1, &tex);
+		glBindTexture(GL_TEXTURE_2D, tex);
+
+		for(const CompressedFormat &format : formats)
+		{
+			if(format.extension && !strstr(extensions, format.extension))
+			{
+				continue;
+			}
+
+			std::vector<unsigned char> data(blockCount * format.blockSize);
+			unsigned int random = format.format;
+
+			for(unsigned char &byte : data)
+			{
+				random = random * 1103515245 + 12345;
+				byte = (unsigned char)(random >> 16);
+			}
+
+			glCompressedTexImage2D(GL_TEXTURE_2D, 0, format.format, textureSize, textureSize, 0, (GLsizei)data.size(), data.data());
+			EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+			for(GLenum filter : filters)
+			{
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+				drawQuad(ph.program, "tex");
+
+				std::vector<unsigned char> pixels(4 * size * size);
+				glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+				EXPECT_GLENUM_EQ(GL_NONE, glGetError());
+
+				results[compressed].push_back(pixels);
+			}
+		}
+
+		glDeleteTextures(1, &tex);
+		deleteProgram(ph);
+
+		Uninitialize();
+	}
+
+	ASSERT_EQ(results[0].size(), results[1].size());
+	ASSERT_GE(results[0].size(), 6u);   // At least the ETC formats
+
+	for(size_t i = 0; i < results[0].size(); i++)
+	{
+		// Linear filtering of decoded texels may round differently
+		const int tolerance = (i % 2 == 0) ? 0 : 1;
+
+		int mismatches = 0;
+		for(size_t j = 0; j < results[0][i].size(); j++)
+		{
+			if(abs(results[0][i][j] - results[1][i][j]) > tolerance)
+			{
+				mismatches++;
+			}
+		}
+
+		EXPECT_EQ(0, mismatches) << "format " << (i / 2) << ", " << ((i % 2 == 0) ? "nearest" : "linear") << " filtering";
+	}
+}
+
 #ifndef EGL_ANGLE_iosurface_client_buffer
 #define EGL_ANGLE_iosurface_client_buffer 1
 #define EGL_IOSURFACE_ANGLE 0x3454
@@ -0,0 +1,242 @@
+// Copyright 2018 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Unit tests for the routine cache behind VkPipelineCache, driving it directly
+// with Reactor routines instead of going through pipeline creation.
+
+#include "gtest/gtest.h"
+
+#include "Vulkan/VkPipelineCache.hpp"
+#include "Reactor/Reactor.hpp"
+
+#include <vector>
+
+using namespace rr;
+
+namespace
+{
+	const sw::SharedRoutineCache::Type type = sw::SharedRoutineCache::PIXEL;
+	const uint64_t shaderHash = 0x0123456789ABCDEFull;
+
+	// Offsets within the serialized data header
+	const size_t buildIDOffset = 8;
+	const size_t cpuFeaturesOffset = 28;
+
+	Routine *generateMultiply(int factor, bool retain = true)
+	{
+		RetainObjectCodeScope scope(retain);
+
+		Function<Int(Int)> function;
+		{
+			Int x = function.Arg<0>();
+			Return(x * Int(factor));
+		}
+
+		return function(L"multiply");
+	}
+
+	int call(Routine *routine, int x)
+	{
+		int (*callable)(int) = (int(*)(int))routine->getEntry();
+
+		return callable(x);
+	}
+
+	std::vector<uint8_t> getData(vk::PipelineRoutineCache *cache)
+	{
+		std::vector<uint8_t> data(cache->getData(0, nullptr));
+		EXPECT_EQ(cache->getData(data.size(), data.data()), data.size());
+
+		return data;
+	}
+}
+
+TEST(PipelineCacheUnitTests, RetainsCodeOnlyInScope)
+{
+	size_t codeSize = 0;
+
+	Routine *retained = generateMultiply(2, true);
+	EXPECT_NE(retained->getObjectCode(codeSize), nullptr);
+	EXPECT_GT(codeSize, 0u);
+
+	Routine *discarded = generateMultiply(3, false);
+	EXPECT_EQ(discarded->getObjectCode(codeSize), nullptr);
+
+	vk::PipelineRoutineCache *cache = new vk::PipelineRoutineCache();
+	int state[2] = {1, 2};
+	cache->add(type, &state[0], sizeof(int), shaderHash, retained);
+	cache->add(type, &state[1], sizeof(int), shaderHash, discarded);
+
+	// Only the routine with object code gets serialized
+	vk::PipelineRoutineCache *copy = new vk::PipelineRoutineCache();
+	std::vector<uint8_t> data = getData(cache);
+	copy->setData(data.size(), data.data());
+
+	EXPECT_NE(copy->query(type, &state[0], sizeof(int), shaderHash), nullptr);
+	EXPECT_EQ(copy->query(type, &state[1], sizeof(int), shaderHash), nullptr);
+
+	copy->unbind();
+	cache->unbind();
+}
+
+TEST(PipelineCacheUnitTests, Serialization)
+{
+	vk::PipelineRoutineCache *cache = new vk::PipelineRoutineCache();
+
+	for(int i = 0; i < 4; i++)
+	{
+		cache->add(type, &i, sizeof(i), shaderHash, generateMultiply(i + 2));
+	}
+
+	std::vector<uint8_t> data = getData(cache);
+	cache->unbind();
+
+	cache = new vk::PipelineRoutineCache();
+	cache->setData(data.size(), data.data());
+	EXPECT_EQ(getData(cache), data);
+
+	// Partial data only contains complete entries, and remains valid
+	std::vector<uint8_t> truncated(data.size() - 1);
+	size_t written = cache->getData(truncated.size(), truncated.data());
+	EXPECT_LT(written, data.size());
+	EXPECT_GT(written, 0u);
+	cache->unbind();
+
+	cache = new vk::PipelineRoutineCache();
+	cache->setData(written, truncated.data());
+
+	int found = 0;
+	for(int i = 0; i < 4; i++)
+	{
+		Routine *routine = cache->query(type, &i, sizeof(i), shaderHash);
+
+		if(routine)
+		{
+			EXPECT_EQ(call(routine, 5), 5 * (i + 2));
+			found++;
+		}
+	}
+
+	EXPECT_EQ(found, 3);
+	cache->unbind();
+}
+
+TEST(PipelineCacheUnitTests, WarmStart)
+{
+	vk::PipelineRoutineCache *cache = new vk::PipelineRoutineCache();
+	int state = 7;
+	cache->add(type, &state, sizeof(state), shaderHash, generateMultiply(3));
+	std::vector<uint8_t> data = getData(cache);
+	cache->unbind();
+
+	vk::PipelineRoutineCache *warm = new vk::PipelineRoutineCache();
+	warm->setData(data.size(), data.data());
+
+	// Routines are linked by Nucleus::loadRoutine() when first queried
+	Routine *routine = warm->query(type, &state, sizeof(state), shaderHash);
+	ASSERT_NE(routine, nullptr);
+	EXPECT_EQ(call(routine, 4), 12);
+	EXPECT_EQ(warm->query(type, &state, sizeof(state), shaderHash), routine);
+
+	// Different state or shader don't match
+	int other = 8;
+	EXPECT_EQ(warm->query(type, &other, sizeof(other), shaderHash), nullptr);
+	EXPECT_EQ(warm->query(type, &state, sizeof(state), shaderHash + 1), nullptr);
+	EXPECT_EQ(warm->query(sw::SharedRoutineCache::VERTEX, &state, sizeof(state), shaderHash), nullptr);
+
+	// Loaded routines can be serialized again
+	EXPECT_EQ(getData(warm), data);
+
+	warm->unbind();
+}
+
+TEST(PipelineCacheUnitTests, Merge)
+{
+	int states[3] = {1, 2, 3};
+
+	vk::PipelineRoutineCache *first = new vk::PipelineRoutineCache();
+	first->add(type, &states[0], sizeof(int), shaderHash, generateMultiply(2));
+	first->add(type, &states[1], sizeof(int), shaderHash, generateMultiply(3));
+
+	// Only present as serialized data, not linked yet
+	vk::PipelineRoutineCache *second = new vk::PipelineRoutineCache();
+	{
+		vk::PipelineRoutineCache *source = new vk::PipelineRoutineCache();
+		source->add(type, &states[2], sizeof(int), shaderHash, generateMultiply(4));
+		std::vector<uint8_t> data = getData(source);
+		source->unbind();
+
+		second->setData(data.size(), data.data());
+	}
+
+	vk::PipelineRoutineCache *merged = new vk::PipelineRoutineCache();
+	merged->merge(first);
+	merged->merge(second);
+
+	// Routines stay alive after their source cache is destroyed
+	first->unbind();
+	second->unbind();
+
+	for(int i = 0; i < 3; i++)
+	{
+		Routine *routine = merged->query(type, &states[i], sizeof(int), shaderHash);
+		ASSERT_NE(routine, nullptr);
+		EXPECT_EQ(call(routine, 10), 10 * (i + 2));
+	}
+
+	vk::PipelineRoutineCache *copy = new vk::PipelineRoutineCache();
+	std::vector<uint8_t> data = getData(merged);
+	copy->setData(data.size(), data.data());
+
+	for(int i = 0; i < 3; i++)
+	{
+		EXPECT_NE(copy->query(type, &states[i], sizeof(int), shaderHash), nullptr);
+	}
+
+	copy->unbind();
+	merged->unbind();
+}
+
+TEST(PipelineCacheUnitTests, RejectsIncompatibleData)
+{
+	vk::PipelineRoutineCache *cache = new vk::PipelineRoutineCache();
+	int state = 1;
+	cache->add(type, &state, sizeof(state), shaderHash, generateMultiply(2));
+	std::vector<uint8_t> data = getData(cache);
+	cache->unbind();
+
+	std::vector<uint8_t> otherBuild = data;
+	otherBuild[buildIDOffset] ^= 0xFF;
+
+	std::vector<uint8_t> otherCPU = data;
+	otherCPU[cpuFeaturesOffset] ^= 0x40;   // SSE4.1
+
+	std::vector<uint8_t> corrupt = data;
+	corrupt.back() ^= 0xFF;
+
+	for(const std::vector<uint8_t> *incompatible : {&otherBuild, &otherCPU, &corrupt})
+	{
+		cache = new vk::PipelineRoutineCache();
+		cache->setData(incompatible->size(), incompatible->data());
+		EXPECT_EQ(cache->query(type, &state, sizeof(state), shaderHash), nullptr);
+		EXPECT_LT(getData(cache).size(), data.size());
+		cache->unbind();
+	}
+
+	// The unmodified data is accepted
+	cache = new vk::PipelineRoutineCache();
+	cache->setData(data.size(), data.data());
+	EXPECT_NE(cache->query(type, &state, sizeof(state), shaderHash), nullptr);
+	cache->unbind();
+}
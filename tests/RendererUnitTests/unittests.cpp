@@ -0,0 +1,549 @@
+// Copyright 2018 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Unit tests for renderer internals which the API level tests can't reach
+// deterministically, like cache eviction order, lock contention and the
+// agreement between SIMD code paths.
+
+#include "gtest/gtest.h"
+
+#include "Renderer/LRUCache.hpp"
+#include "Renderer/Surface.hpp"
+#include "Common/CPUID.hpp"
+#include "Common/Resource.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace sw
+{
+	// Befriended by Resource, so tests can observe its lock state
+	struct ResourceTestAccess
+	{
+		static unsigned int blockedThreads(const Resource *resource)
+		{
+			return (unsigned int)((resource->state & Resource::BLOCKED_MASK) / Resource::BLOCKED_ONE);
+		}
+
+		static uint64_t lockCount(const Resource *resource)
+		{
+			return (resource->state & Resource::COUNT_MASK) / Resource::COUNT_ONE;
+		}
+	};
+}
+
+namespace
+{
+	using sw::ResourceTestAccess;
+
+	struct TestKey
+	{
+		TestKey(int value = 0, unsigned int hash = 0) : value(value), hash(hash) {}
+
+		bool operator==(const TestKey &other) const
+		{
+			return value == other.value;
+		}
+
+		int value;
+		unsigned int hash;
+	};
+
+	// Counts the references the cache holds
+	struct TestData
+	{
+		void bind() { bindCount++; }
+		void unbind() { bindCount--; }
+
+		int bindCount = 0;
+	};
+
+	// Returns once a thread is blocked on the resource, so it can't be holding the lock
+	void waitUntilBlocked(const sw::Resource *resource)
+	{
+		while(ResourceTestAccess::blockedThreads(resource) == 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// Deterministic pseudo-random contents, so failures reproduce
+	struct Random
+	{
+		unsigned int next()
+		{
+			state = state * 1664525u + 1013904223u;
+			return state >> 8;
+		}
+
+		unsigned int state = 1;
+	};
+
+	// Narrow enough to end in the scalar tail of every AVX2 kernel, and wide enough to
+	// also run their vector loops
+	const int testWidths[] = {1, 7, 13, 37};
+	const int testHeight = 3;
+
+	// Runs the test body with the AVX2 kernels disabled, then restores them
+	template<class Function>
+	auto withoutAVX2(Function function) -> decltype(function())
+	{
+		struct Restore
+		{
+			~Restore() { sw::CPUID::setEnableAVX2(true); }
+		} restore;
+
+		sw::CPUID::setEnableAVX2(false);
+
+		return function();
+	}
+
+	// Returns the internal rows a surface decodes from the given external rows
+	std::vector<unsigned char> decode(sw::Format format, int width, const std::vector<unsigned char> &pixels, int pitch)
+	{
+		sw::Surface *surface = sw::Surface::create(width, testHeight, 1, format, const_cast<unsigned char*>(pixels.data()), pitch, pitch * testHeight);
+
+		int rowBytes = width * sw::Surface::bytes(surface->getInternalFormat());
+		int internalPitch = surface->getInternalPitchB();
+		const unsigned char *buffer = (const unsigned char*)surface->lockInternal(0, 0, 0, sw::LOCK_READONLY, sw::PUBLIC);
+
+		std::vector<unsigned char> rows;
+
+		for(int y = 0; y < testHeight; y++)
+		{
+			rows.insert(rows.end(), buffer + y * internalPitch, buffer + y * internalPitch + rowBytes);
+		}
+
+		surface->unlockInternal();
+		delete surface;
+
+		return rows;
+	}
+
+	void testDecode(sw::Format format)
+	{
+		for(int width : testWidths)
+		{
+			// Padded rows start at unaligned addresses
+			int pitch = width * sw::Surface::bytes(format) + 3;
+			std::vector<unsigned char> pixels(pitch * testHeight);
+
+			Random random;
+
+			for(auto &byte : pixels)
+			{
+				byte = (unsigned char)random.next();
+			}
+
+			std::vector<unsigned char> expected = withoutAVX2([&]() { return decode(format, width, pixels, pitch); });
+			std::vector<unsigned char> result = decode(format, width, pixels, pitch);
+
+			EXPECT_EQ(result, expected) << "format " << format << ", width " << width;
+		}
+	}
+
+	// Returns the first sample's rows after resolving a render target filled with the given samples
+	std::vector<unsigned char> resolve(sw::Format format, int width, int samples, const std::vector<unsigned char> &contents)
+	{
+		sw::Surface *surface = sw::Surface::create(nullptr, width, testHeight, 1, 0, samples, format, true, true);
+		EXPECT_EQ(surface->getInternalFormat(), format);
+
+		int rowBytes = width * sw::Surface::bytes(format);
+		int pitch = surface->getInternalPitchB();
+		size_t size = (size_t)surface->getInternalSliceB() * samples;
+		EXPECT_LE(size, contents.size());
+
+		void *buffer = surface->lockInternal(0, 0, 0, sw::LOCK_WRITEONLY, sw::PUBLIC);
+		memcpy(buffer, contents.data(), size);
+		surface->unlockInternal();
+
+		// Reading back the render target resolves it into the first sample
+		const unsigned char *resolved = (const unsigned char*)surface->lockInternal(0, 0, 0, sw::LOCK_READONLY, sw::PUBLIC);
+
+		std::vector<unsigned char> rows;
+
+		for(int y = 0; y < testHeight; y++)
+		{
+			rows.insert(rows.end(), resolved + y * pitch, resolved + y * pitch + rowBytes);
+		}
+
+		surface->unlockInternal();
+		delete surface;
+
+		return rows;
+	}
+
+	void testResolve(sw::Format format)
+	{
+		for(int samples : {2, 4, 8})
+		{
+			for(int width : testWidths)
+			{
+				// Generously sized for any pitch alignment
+				std::vector<unsigned char> contents((width + 16) * sw::Surface::bytes(format) * (testHeight + 1) * samples);
+
+				Random random;
+
+				if(sw::Surface::isFloatFormat(format))
+				{
+					// Multiples of 1/64 sum exactly, so the accumulation order can't affect rounding
+					for(size_t i = 0; i + sizeof(float) <= contents.size(); i += sizeof(float))
+					{
+						float value = (float)(random.next() % 1024) / 64.0f;
+						memcpy(&contents[i], &value, sizeof(float));
+					}
+				}
+				else
+				{
+					for(auto &byte : contents)
+					{
+						byte = (unsigned char)random.next();
+					}
+				}
+
+				std::vector<unsigned char> expected = withoutAVX2([&]() { return resolve(format, width, samples, contents); });
+				std::vector<unsigned char> result = resolve(format, width, samples, contents);
+
+				EXPECT_EQ(result, expected) << "format " << format << ", samples " << samples << ", width " << width;
+			}
+		}
+	}
+}
+
+TEST(LRUCacheTest, QueryAndAdd)
+{
+	TestData data[2];
+
+	{
+		sw::LRUCache<TestKey, TestData> cache(4);
+
+		EXPECT_EQ(cache.query(TestKey(1, 1)), nullptr);
+
+		EXPECT_EQ(cache.add(TestKey(1, 1), &data[0]), &data[0]);
+		EXPECT_EQ(cache.add(TestKey(2, 2), &data[1]), &data[1]);
+		EXPECT_EQ(data[0].bindCount, 1);
+		EXPECT_EQ(data[1].bindCount, 1);
+
+		EXPECT_EQ(cache.query(TestKey(1, 1)), &data[0]);
+		EXPECT_EQ(cache.query(TestKey(2, 2)), &data[1]);
+		EXPECT_EQ(cache.query(TestKey(3, 3)), nullptr);
+	}
+
+	// The cache releases its references on destruction
+	EXPECT_EQ(data[0].bindCount, 0);
+	EXPECT_EQ(data[1].bindCount, 0);
+}
+
+TEST(LRUCacheTest, AddExistingKeyReplacesData)
+{
+	TestData data[2];
+	sw::LRUCache<TestKey, TestData> cache(4);
+
+	cache.add(TestKey(1, 1), &data[0]);
+	cache.add(TestKey(1, 1), &data[1]);
+
+	EXPECT_EQ(cache.query(TestKey(1, 1)), &data[1]);
+	EXPECT_EQ(data[0].bindCount, 0);
+	EXPECT_EQ(data[1].bindCount, 1);
+}
+
+TEST(LRUCacheTest, EvictsLeastRecentlyUsed)
+{
+	const int size = 4;
+	TestData data[size + 2];
+	sw::LRUCache<TestKey, TestData> cache(size);
+
+	for(int i = 0; i < size; i++)
+	{
+		cache.add(TestKey(i, i), &data[i]);
+	}
+
+	// Promote the oldest entry, so the second oldest is evicted next
+	EXPECT_EQ(cache.query(TestKey(0, 0)), &data[0]);
+
+	cache.add(TestKey(size, size), &data[size]);
+
+	EXPECT_EQ(data[1].bindCount, 0);
+	EXPECT_EQ(cache.query(TestKey(1, 1)), nullptr);
+	EXPECT_EQ(cache.query(TestKey(0, 0)), &data[0]);
+
+	// Entry 2 is now the least recently used one
+	cache.add(TestKey(size + 1, size + 1), &data[size + 1]);
+
+	EXPECT_EQ(data[2].bindCount, 0);
+	EXPECT_EQ(cache.query(TestKey(2, 2)), nullptr);
+
+	for(int i : {0, 3, size, size + 1})
+	{
+		EXPECT_EQ(cache.query(TestKey(i, i)), &data[i]);
+		EXPECT_EQ(data[i].bindCount, 1);
+	}
+}
+
+TEST(LRUCacheTest, HashCollisions)
+{
+	const int size = 8;
+	TestData data[size + 1];
+	sw::LRUCache<TestKey, TestData> cache(size);
+
+	// All keys share a hash, so they end up on one chain
+	for(int i = 0; i < size; i++)
+	{
+		cache.add(TestKey(i, 0x12345678), &data[i]);
+	}
+
+	for(int i = 0; i < size; i++)
+	{
+		EXPECT_EQ(cache.query(TestKey(i, 0x12345678)), &data[i]);
+	}
+
+	// Entry 0 is the least recently used one, at the end of the chain
+	cache.add(TestKey(size, 0x12345678), &data[size]);
+
+	EXPECT_EQ(cache.query(TestKey(0, 0x12345678)), nullptr);
+	EXPECT_EQ(data[0].bindCount, 0);
+
+	// Make entry 4 the least recently used one, in the middle of the chain
+	for(int i = 1; i <= size; i++)
+	{
+		if(i != 4)
+		{
+			EXPECT_EQ(cache.query(TestKey(i, 0x12345678)), &data[i]);
+		}
+	}
+
+	cache.add(TestKey(0, 0x12345678), &data[0]);
+
+	EXPECT_EQ(cache.query(TestKey(4, 0x12345678)), nullptr);
+	EXPECT_EQ(data[4].bindCount, 0);
+
+	for(int i = 0; i <= size; i++)
+	{
+		if(i != 4)
+		{
+			EXPECT_EQ(cache.query(TestKey(i, 0x12345678)), &data[i]);
+			EXPECT_EQ(data[i].bindCount, 1);
+		}
+	}
+}
+
+TEST(ResourceTest, ContendedAccessorsAreExclusive)
+{
+	sw::Resource *resource = new sw::Resource(16);
+
+	std::atomic<int> holders[2];
+	holders[0] = 0;
+	holders[1] = 0;
+	std::atomic<int> violations(0);
+
+	std::vector<std::thread> threads;
+
+	// Two threads per accessor, so locks by the same accessor overlap too
+	for(int i = 0; i < 4; i++)
+	{
+		sw::Accessor accessor = (i % 2 == 0) ? sw::PUBLIC : sw::PRIVATE;
+
+		threads.emplace_back([&, accessor]()
+		{
+			int self = (accessor == sw::PUBLIC) ? 0 : 1;
+
+			for(int j = 0; j < 2000; j++)
+			{
+				resource->lock(accessor);
+
+				holders[self]++;
+
+				if(holders[1 - self] != 0)
+				{
+					violations++;
+				}
+
+				holders[self]--;
+
+				resource->unlock();
+			}
+		});
+	}
+
+	for(auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ(violations, 0);
+
+	resource->destruct();
+}
+
+TEST(ResourceTest, LockRelinquishesAllLocksOfAccessor)
+{
+	sw::Resource *resource = new sw::Resource(16);
+
+	resource->lock(sw::PRIVATE);
+	resource->lock(sw::PRIVATE);
+
+	// Both private locks are released, and the public lock is claimed
+	EXPECT_EQ(resource->lock(sw::PRIVATE, sw::PUBLIC), resource->data());
+
+	std::atomic<bool> locked(false);
+
+	std::thread privateThread([&]()
+	{
+		resource->lock(sw::PRIVATE);
+		locked = true;
+		resource->unlock();
+	});
+
+	waitUntilBlocked(resource);
+	EXPECT_FALSE(locked);
+	EXPECT_EQ(ResourceTestAccess::blockedThreads(resource), 1u);
+
+	resource->unlock();
+	privateThread.join();
+	EXPECT_TRUE(locked);
+	EXPECT_EQ(ResourceTestAccess::blockedThreads(resource), 0u);
+
+	// Relinquishing an accessor which holds no locks leaves other locks in place
+	resource->lock(sw::PUBLIC);
+	EXPECT_EQ(resource->lock(sw::PRIVATE, sw::PUBLIC), resource->data());
+	resource->unlock();
+	resource->unlock();
+
+	resource->destruct();
+}
+
+TEST(ResourceTest, LockCountDoesNotOverflow)
+{
+	sw::Resource *resource = new sw::Resource(16);
+
+	// More locks than a 17-bit count holds, like queued draw calls locking many vertex streams
+	const int lockCount = 0x30000;
+
+	for(int i = 0; i < lockCount; i++)
+	{
+		EXPECT_EQ(resource->lock(sw::PRIVATE), resource->data());
+	}
+
+	EXPECT_EQ(ResourceTestAccess::lockCount(resource), (uint64_t)lockCount);
+	EXPECT_EQ(ResourceTestAccess::blockedThreads(resource), 0u);
+
+	std::atomic<bool> locked(false);
+
+	std::thread publicThread([&]()
+	{
+		resource->lock(sw::PUBLIC);
+		locked = true;
+		resource->unlock();
+	});
+
+	waitUntilBlocked(resource);
+
+	for(int i = 0; i < lockCount - 1; i++)
+	{
+		resource->unlock();
+	}
+
+	EXPECT_FALSE(locked);
+	EXPECT_EQ(ResourceTestAccess::lockCount(resource), 1u);
+
+	resource->unlock();
+	publicThread.join();
+	EXPECT_TRUE(locked);
+	EXPECT_EQ(ResourceTestAccess::lockCount(resource), 0u);
+
+	resource->destruct();
+}
+
+TEST(ResourceTest, DestructWhileLocked)
+{
+	// Deleted by the last unlock
+	sw::Resource *resource = new sw::Resource(16);
+
+	unsigned char *buffer = (unsigned char*)resource->lock(sw::PUBLIC);
+	resource->destruct();
+
+	buffer[0] = 1;   // Still valid while locked
+	resource->unlock();
+
+	// Deleted once the waiting thread is done with it
+	resource = new sw::Resource(16);
+	resource->lock(sw::PUBLIC);
+
+	std::atomic<bool> locked(false);
+
+	std::thread privateThread([&]()
+	{
+		unsigned char *buffer = (unsigned char*)resource->lock(sw::PRIVATE);
+		locked = true;
+		buffer[0] = 1;
+		resource->unlock();
+	});
+
+	waitUntilBlocked(resource);
+	resource->destruct();   // Not deleted while a thread is blocked on it
+	EXPECT_FALSE(locked);
+	EXPECT_EQ(ResourceTestAccess::blockedThreads(resource), 1u);
+
+	resource->unlock();
+	privateThread.join();
+	EXPECT_TRUE(locked);
+
+	// Deleted when relinquishing the last lock, which then fails to claim a new one
+	resource = new sw::Resource(16);
+	resource->lock(sw::PRIVATE);
+	resource->destruct();
+
+	EXPECT_EQ(resource->lock(sw::PRIVATE, sw::PUBLIC), nullptr);
+}
+
+// The AVX2 kernels only run where the CPU supports them, and match the SSE and C++ paths exactly
+TEST(SurfaceTest, ResolveAVX2Matches8Bit)
+{
+	testResolve(sw::FORMAT_A8R8G8B8);
+}
+
+TEST(SurfaceTest, ResolveAVX2Matches16Bit)
+{
+	testResolve(sw::FORMAT_A16B16G16R16);
+}
+
+TEST(SurfaceTest, ResolveAVX2MatchesFloat)
+{
+	testResolve(sw::FORMAT_A32B32G32R32F);
+}
+
+TEST(SurfaceTest, DecodeAVX2MatchesR8G8B8)
+{
+	testDecode(sw::FORMAT_R8G8B8);
+}
+
+TEST(SurfaceTest, DecodeAVX2Matches5551)
+{
+	testDecode(sw::FORMAT_X1R5G5B5);
+	testDecode(sw::FORMAT_A1R5G5B5);
+}
+
+TEST(SurfaceTest, DecodeAVX2Matches4444)
+{
+	testDecode(sw::FORMAT_X4R4G4B4);
+	testDecode(sw::FORMAT_A4R4G4B4);
+}
+
+TEST(SurfaceTest, DecodeAVX2Matches1010102)
+{
+	testDecode(sw::FORMAT_A2R10G10B10);
+	testDecode(sw::FORMAT_A2B10G10R10);
+}
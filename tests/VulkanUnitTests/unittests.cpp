@@ -21,7 +21,10 @@
 #include <vulkan/vulkan.h>
 #include <vulkan/vk_icd.h>
 
+#include <algorithm>
 #include <cstring>
+#include <utility>
+#include <vector>
 
 typedef PFN_vkVoidFunction(__stdcall *vk_icdGetInstanceProcAddrPtr)(VkInstance, const char*);
 
@@ -118,3 +121,360 @@ TEST_F(SwiftShaderVulkanTest, Version)
 
 	EXPECT_EQ(strncmp(physicalDeviceProperties.deviceName, "SwiftShader Device", VK_MAX_PHYSICAL_DEVICE_NAME_SIZE), 0);
 }
+
+class SwiftShaderVulkanDeviceTest : public SwiftShaderVulkanTest
+{
+protected:
+	void SetUp() override
+	{
+		SwiftShaderVulkanTest::SetUp();
+
+		const VkInstanceCreateInfo instanceCreateInfo =
+		{
+			VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO, // sType
+			nullptr, // pNext
+			0,       // flags
+			nullptr, // pApplicationInfo
+			0,       // enabledLayerCount
+			nullptr, // ppEnabledLayerNames
+			0,       // enabledExtensionCount
+			nullptr, // ppEnabledExtensionNames
+		};
+		ASSERT_EQ(vkCreateInstance(&instanceCreateInfo, nullptr, &instance), VK_SUCCESS);
+
+		uint32_t physicalDeviceCount = 1;
+		ASSERT_EQ(vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, &physicalDevice), VK_SUCCESS);
+
+		const float queuePriority = 1.0f;
+		const VkDeviceQueueCreateInfo queueCreateInfo =
+		{
+			VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, // sType
+			nullptr,        // pNext
+			0,              // flags
+			0,              // queueFamilyIndex
+			1,              // queueCount
+			&queuePriority, // pQueuePriorities
+		};
+		const VkDeviceCreateInfo deviceCreateInfo =
+		{
+			VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO, // sType
+			nullptr,          // pNext
+			0,                // flags
+			1,                // queueCreateInfoCount
+			&queueCreateInfo, // pQueueCreateInfos
+			0,                // enabledLayerCount
+			nullptr,          // ppEnabledLayerNames
+			0,                // enabledExtensionCount
+			nullptr,          // ppEnabledExtensionNames
+			nullptr,          // pEnabledFeatures
+		};
+		ASSERT_EQ(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device), VK_SUCCESS);
+
+		vkGetDeviceQueue(device, 0, 0, &queue);
+
+		const VkCommandPoolCreateInfo commandPoolCreateInfo =
+		{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, // sType
+			nullptr, // pNext
+			0,       // flags
+			0,       // queueFamilyIndex
+		};
+		ASSERT_EQ(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool), VK_SUCCESS);
+	}
+
+	void TearDown() override
+	{
+		if(device != VK_NULL_HANDLE)
+		{
+			vkDeviceWaitIdle(device);
+
+			for(auto &buffer : buffers)
+			{
+				vkDestroyBuffer(device, buffer.first, nullptr);
+				vkFreeMemory(device, buffer.second, nullptr);
+			}
+
+			vkDestroyCommandPool(device, commandPool, nullptr);
+			vkDestroyDevice(device, nullptr);
+		}
+
+		if(instance != VK_NULL_HANDLE)
+		{
+			vkDestroyInstance(instance, nullptr);
+		}
+	}
+
+	// Host visible buffer, filled with the given value
+	VkBuffer createBuffer(VkDeviceSize size, uint8_t value)
+	{
+		const VkBufferCreateInfo bufferCreateInfo =
+		{
+			VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, // sType
+			nullptr, // pNext
+			0,       // flags
+			size,    // size
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // usage
+			VK_SHARING_MODE_EXCLUSIVE, // sharingMode
+			0,       // queueFamilyIndexCount
+			nullptr, // pQueueFamilyIndices
+		};
+		VkBuffer buffer = VK_NULL_HANDLE;
+		EXPECT_EQ(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer), VK_SUCCESS);
+
+		VkMemoryRequirements memoryRequirements;
+		vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+		const VkMemoryAllocateInfo memoryAllocateInfo =
+		{
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, // sType
+			nullptr,                 // pNext
+			memoryRequirements.size, // allocationSize
+			0,                       // memoryTypeIndex
+		};
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		EXPECT_EQ(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &memory), VK_SUCCESS);
+		EXPECT_EQ(vkBindBufferMemory(device, buffer, memory, 0), VK_SUCCESS);
+
+		void *data = nullptr;
+		EXPECT_EQ(vkMapMemory(device, memory, 0, size, 0, &data), VK_SUCCESS);
+		memset(data, value, static_cast<size_t>(size));
+		vkUnmapMemory(device, memory);
+
+		buffers.push_back(std::make_pair(buffer, memory));
+
+		return buffer;
+	}
+
+	bool bufferContains(VkBuffer buffer, VkDeviceSize size, uint8_t value)
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+
+		for(auto &entry : buffers)
+		{
+			if(entry.first == buffer)
+			{
+				memory = entry.second;
+			}
+		}
+
+		void *data = nullptr;
+		EXPECT_EQ(vkMapMemory(device, memory, 0, size, 0, &data), VK_SUCCESS);
+
+		const uint8_t *bytes = static_cast<const uint8_t*>(data);
+		bool contains = std::all_of(bytes, bytes + size, [value](uint8_t byte) { return byte == value; });
+
+		vkUnmapMemory(device, memory);
+
+		return contains;
+	}
+
+	// Submits a copy of the whole source buffer into the destination buffer
+	void submitCopy(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkFence fence)
+	{
+		const VkCommandBufferAllocateInfo commandBufferAllocateInfo =
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, // sType
+			nullptr,                         // pNext
+			commandPool,                     // commandPool
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY, // level
+			1,                               // commandBufferCount
+		};
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		ASSERT_EQ(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer), VK_SUCCESS);
+
+		const VkCommandBufferBeginInfo beginInfo =
+		{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, // sType
+			nullptr, // pNext
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // flags
+			nullptr, // pInheritanceInfo
+		};
+		ASSERT_EQ(vkBeginCommandBuffer(commandBuffer, &beginInfo), VK_SUCCESS);
+
+		const VkBufferCopy region = { 0, 0, size };
+		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &region);
+
+		ASSERT_EQ(vkEndCommandBuffer(commandBuffer), VK_SUCCESS);
+
+		const VkSubmitInfo submitInfo =
+		{
+			VK_STRUCTURE_TYPE_SUBMIT_INFO, // sType
+			nullptr,        // pNext
+			0,              // waitSemaphoreCount
+			nullptr,        // pWaitSemaphores
+			nullptr,        // pWaitDstStageMask
+			1,              // commandBufferCount
+			&commandBuffer, // pCommandBuffers
+			0,              // signalSemaphoreCount
+			nullptr,        // pSignalSemaphores
+		};
+		ASSERT_EQ(vkQueueSubmit(queue, 1, &submitInfo, fence), VK_SUCCESS);
+	}
+
+	VkFence createFence()
+	{
+		const VkFenceCreateInfo fenceCreateInfo =
+		{
+			VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, // sType
+			nullptr, // pNext
+			0,       // flags
+		};
+		VkFence fence = VK_NULL_HANDLE;
+		EXPECT_EQ(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence), VK_SUCCESS);
+
+		return fence;
+	}
+
+	VkPipelineCache createPipelineCache(size_t initialDataSize, const void* pInitialData)
+	{
+		const VkPipelineCacheCreateInfo pipelineCacheCreateInfo =
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, // sType
+			nullptr,         // pNext
+			0,               // flags
+			initialDataSize, // initialDataSize
+			pInitialData,    // pInitialData
+		};
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		EXPECT_EQ(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache), VK_SUCCESS);
+
+		return pipelineCache;
+	}
+
+	static const VkDeviceSize copySize = 64 << 20;   // Large enough to still be in flight when submitted
+
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<std::pair<VkBuffer, VkDeviceMemory>> buffers;
+};
+
+TEST_F(SwiftShaderVulkanDeviceTest, FenceSignaledAfterWorkCompletes)
+{
+	VkBuffer srcBuffer = createBuffer(copySize, 0xAB);
+	VkBuffer dstBuffer = createBuffer(copySize, 0x00);
+	VkFence fence = createFence();
+
+	EXPECT_EQ(vkGetFenceStatus(device, fence), VK_NOT_READY);
+
+	submitCopy(srcBuffer, dstBuffer, copySize, fence);
+
+	EXPECT_EQ(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX), VK_SUCCESS);
+	EXPECT_EQ(vkGetFenceStatus(device, fence), VK_SUCCESS);
+	EXPECT_TRUE(bufferContains(dstBuffer, copySize, 0xAB));
+
+	vkDestroyFence(device, fence, nullptr);
+}
+
+TEST_F(SwiftShaderVulkanDeviceTest, WaitForAnyFence)
+{
+	VkBuffer srcBuffer = createBuffer(copySize, 0xCD);
+	VkBuffer dstBuffer = createBuffer(copySize, 0x00);
+	VkFence fences[2] = { createFence(), createFence() };   // The first one is never submitted
+
+	submitCopy(srcBuffer, dstBuffer, copySize, fences[1]);
+
+	EXPECT_EQ(vkWaitForFences(device, 2, fences, VK_FALSE, UINT64_MAX), VK_SUCCESS);
+	EXPECT_EQ(vkGetFenceStatus(device, fences[0]), VK_NOT_READY);
+	EXPECT_EQ(vkGetFenceStatus(device, fences[1]), VK_SUCCESS);
+	EXPECT_TRUE(bufferContains(dstBuffer, copySize, 0xCD));
+
+	vkDestroyFence(device, fences[0], nullptr);
+	vkDestroyFence(device, fences[1], nullptr);
+}
+
+TEST_F(SwiftShaderVulkanDeviceTest, QueueWaitIdle)
+{
+	VkBuffer srcBuffer = createBuffer(copySize, 0xEF);
+	VkBuffer dstBuffer = createBuffer(copySize, 0x00);
+
+	submitCopy(srcBuffer, dstBuffer, copySize, VK_NULL_HANDLE);
+
+	EXPECT_EQ(vkQueueWaitIdle(queue), VK_SUCCESS);
+	EXPECT_TRUE(bufferContains(dstBuffer, copySize, 0xEF));
+}
+
+TEST_F(SwiftShaderVulkanDeviceTest, WaitForFencesTimeout)
+{
+	VkFence fences[2] = { createFence(), createFence() };
+
+	EXPECT_EQ(vkWaitForFences(device, 1, fences, VK_TRUE, 0), VK_TIMEOUT);
+	EXPECT_EQ(vkWaitForFences(device, 2, fences, VK_TRUE, 1000000), VK_TIMEOUT);
+	EXPECT_EQ(vkWaitForFences(device, 2, fences, VK_FALSE, 1000000), VK_TIMEOUT);
+
+	vkDestroyFence(device, fences[0], nullptr);
+	vkDestroyFence(device, fences[1], nullptr);
+}
+
+TEST_F(SwiftShaderVulkanDeviceTest, PipelineCacheDataSize)
+{
+	VkPipelineCache pipelineCache = createPipelineCache(0, nullptr);
+
+	size_t dataSize = 0;
+	EXPECT_EQ(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr), VK_SUCCESS);
+	ASSERT_GE(dataSize, 4 * sizeof(uint32_t) + VK_UUID_SIZE);
+
+	std::vector<uint8_t> data(dataSize);
+	EXPECT_EQ(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()), VK_SUCCESS);
+	EXPECT_EQ(dataSize, data.size());
+
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+
+	uint32_t header[4];
+	memcpy(header, data.data(), sizeof(header));
+	EXPECT_EQ(header[0], sizeof(header) + VK_UUID_SIZE);
+	EXPECT_EQ(header[1], VK_PIPELINE_CACHE_HEADER_VERSION_ONE);
+	EXPECT_EQ(header[2], physicalDeviceProperties.vendorID);
+	EXPECT_EQ(header[3], physicalDeviceProperties.deviceID);
+	EXPECT_EQ(memcmp(data.data() + sizeof(header), physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE), 0);
+
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
+TEST_F(SwiftShaderVulkanDeviceTest, PipelineCacheDataIncomplete)
+{
+	VkPipelineCache pipelineCache = createPipelineCache(0, nullptr);
+
+	size_t dataSize = 0;
+	EXPECT_EQ(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr), VK_SUCCESS);
+
+	// Writes no more than the provided size, and only as much as is valid data
+	std::vector<uint8_t> data(dataSize, 0xFF);
+	size_t partialSize = dataSize - 1;
+	EXPECT_EQ(vkGetPipelineCacheData(device, pipelineCache, &partialSize, data.data()), VK_INCOMPLETE);
+	EXPECT_LT(partialSize, dataSize);
+	EXPECT_EQ(data[dataSize - 1], 0xFF);
+
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
+TEST_F(SwiftShaderVulkanDeviceTest, PipelineCacheDataRoundTrip)
+{
+	VkPipelineCache pipelineCache = createPipelineCache(0, nullptr);
+
+	size_t dataSize = 0;
+	EXPECT_EQ(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr), VK_SUCCESS);
+	std::vector<uint8_t> data(dataSize);
+	EXPECT_EQ(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()), VK_SUCCESS);
+
+	VkPipelineCache recreatedCache = createPipelineCache(data.size(), data.data());
+
+	size_t recreatedSize = 0;
+	EXPECT_EQ(vkGetPipelineCacheData(device, recreatedCache, &recreatedSize, nullptr), VK_SUCCESS);
+	ASSERT_EQ(recreatedSize, dataSize);
+	std::vector<uint8_t> recreatedData(recreatedSize);
+	EXPECT_EQ(vkGetPipelineCacheData(device, recreatedCache, &recreatedSize, recreatedData.data()), VK_SUCCESS);
+	EXPECT_EQ(recreatedData, data);
+
+	// Corrupt initial data must be ignored, not rejected
+	data.back() ^= 0xFF;
+	VkPipelineCache corruptCache = createPipelineCache(data.size(), data.data());
+	EXPECT_NE(corruptCache, (VkPipelineCache)VK_NULL_HANDLE);
+
+	vkDestroyPipelineCache(device, corruptCache, nullptr);
+	vkDestroyPipelineCache(device, recreatedCache, nullptr);
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}